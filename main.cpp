@@ -6,7 +6,24 @@
 #include <stdio.h>
 #include <cstdio>
 #include <cmath>
-#include <stack>
+#include <cstring>
+#include <cstdlib>
+
+// Clock used to time limit searches on the host
+#ifdef PACMAN_HOST
+#include <chrono>
+#endif
+
+// Names the places allocations came from when tracing them on the host (see 'HeapGuard')
+#if defined(PACMAN_HEAP_TRACE) && defined(__GLIBC__)
+#include <execinfo.h>
+#define HEAP_GUARD_BACKTRACE
+#endif
+
+// Vector instructions used by 'GhostMoveBatch' when the compiler has them turned on
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 // MBED Libraries
 #include "mbed.h"
@@ -34,6 +51,90 @@
 
 #define TILE_SIZE 8
 
+// LCD size (in pixels)
+#define SCREEN_WIDTH 240
+#define SCREEN_HEIGHT 240
+
+// Large arena defines
+#define CHUNK_SIZE 32 // Chunks are stored one 32 bit int per row, so this cannot be greater than 32
+#define MAX_ARENA_SIZE 1024 // Max width and height of a chunked maze (in tiles)
+
+// Number of chunks a chunked maze can store (chunks that are entirely wall aren't stored)
+// NOTE: Each chunk uses 256 bytes, the host has room for a full 1024 * 1024 tile arena but the target has to share its RAM
+#ifdef PACMAN_HOST
+#define MAX_ARENA_CHUNKS 1024
+#else
+#define MAX_ARENA_CHUNKS 48
+#endif
+
+// Viewport defines
+#define VIEW_TILES_X (SCREEN_WIDTH / TILE_SIZE) // Number of tiles across the screen
+#define VIEW_TILES_Y (SCREEN_HEIGHT / TILE_SIZE) // Number of tiles down the screen
+#define VIEW_SCROLL_MARGIN 8 // The camera scrolls when the followed object gets this many tiles from the edge of the screen
+
+// Maximum number of objects that can listen for pellet changes in a maze
+#define MAX_MAZE_LISTENERS 8
+
+// Maximum number of positions waiting to be redrawn in a maze (if more are marked, the whole maze is redrawn instead)
+// Each actor marks one or two positions a tick, and the queue is emptied every frame
+#define MAX_REDRAW_POSITIONS 64
+
+// Corridor graph sizes
+// NOTE: The classic maze compresses down to 34 nodes and 54 edges, these leave plenty of room for other layouts
+#define MAX_GRAPH_NODES 128
+#define MAX_GRAPH_EDGES 192
+
+// Maximum number of floor tiles in a maze that the distance table can cover
+// NOTE: The classic maze has 292 floor tiles
+#define MAX_FLOOR_TILES 320
+
+// Stored in the distance table between tiles that can't reach each other
+#define DISTANCE_UNREACHABLE 0xFF
+
+// Longest distance the distance table can store, longer paths are stored as this so they never wrap around to 'DISTANCE_UNREACHABLE'
+// NOTE: The longest path in the classic maze is well under this, only long winding generated mazes reach it
+#define DISTANCE_SATURATED 0xFE
+
+// Host (desktop) builds define 'PACMAN_HOST' and keep the full N * N distance table so that a lookup is a single index
+// On the target only one half of the table is kept as the distances are the same in both directions, halving the RAM used
+#ifndef PACMAN_HOST
+#define DISTANCE_TABLE_TRIANGULAR
+#endif
+
+// Ghost house position (in tiles)
+// The ghosts start on the corridor running around the top of the ghost house
+#define GHOST_HOUSE_LEFT 9
+#define GHOST_HOUSE_RIGHT 18
+#define GHOST_HOUSE_TOP 12
+#define GHOST_HOUSE_BOTTOM 16
+
+// Row of the tunnel either side of the ghost house
+#define TUNNEL_ROW 14
+
+// Player start position (in tiles)
+#define PLAYER_START_X 13
+#define PLAYER_START_Y 22
+
+// Enemy start positions (in tiles)
+#define GHOST_START_Y 12
+#define BLINKY_START_X 14
+#define PINKY_START_X 12
+#define INKY_START_X 10
+#define CLYDE_START_X 16
+
+// Movement speeds are 8.8 fixed point pixels per tick ('SPEED_ONE' is one pixel per tick)
+#define SPEED_SHIFT 8
+#define SPEED_ONE (1 << SPEED_SHIFT)
+
+// Fastest an actor can move (half a tile per tick), which keeps swept collisions down to neighbouring cells (see 'CollisionGrid')
+#define MAX_SPEED ((TILE_SIZE / 2) * SPEED_ONE)
+
+// Number of levels in the speed table, levels after the last use the last row
+#define SPEED_LEVELS 5
+
+// Number of tiles at each end of the tunnel row that count as the tunnel (ghosts slow down in them)
+#define TUNNEL_LENGTH 6
+
 // AI States
 #define BLINKY_AI 1
 #define PINKY_AI 2
@@ -50,12 +151,6 @@
 #define DEAD 6
 #define GAME_OVER 7
 
-/* GLOBALS */
-//////////////////////////////////////////////////////////////
-char CurGameState = SPLASH_SCREEN; // Stores the current state of the game
-char NextGameState = SPLASH_SCREEN; // Stores what the next state will be
-TS_StateTypeDef TS_State = { 0 }; // Stores the state of the touchscreen input
-
 /* STRUCTS */
 //////////////////////////////////////////////////////////////
 
@@ -66,1702 +161,9077 @@ struct Position
 	int y;
 };
 
-/* BASE GAME CLASS H */
-//////////////////////////////////////////////////////////////
-
-// This class is designed to be inherited by all objects used in the game engine
-class BaseGameClass
+// Struct used to store the state of one actor (the player or an enemy)
+struct ActorState
 {
-public:
-	Position position; // Stores the coordinate to draw the object on the screen
-	bool Updating; // When true, the object's "Update" function will be called in the main game engine loop
-	bool Visible; // When true, the object's "Draw" function will be called in the main game engine loop
-    bool Destroy; // Used as a flag to remove the object from the game engine
+    Position position;
+    Position moveStart; // Where the actor was at the start of its last move, so collisions can be swept along the move
+    char lastDir;
+    char nextDir;
+    bool animationFrame; // Whether the player's mouth is open, or which of its two images an enemy is showing
+    uint8_t subPixel; // Fraction of a pixel moved towards the next one (in 1/'SPEED_ONE's of a pixel)
+};
 
-    // Constructs the object, setting its position to (0, 0) and "Updating" and "Visible" flags to true
-    BaseGameClass();
+// Struct used to store the speeds for one level (8.8 fixed point pixels per tick, see 'SPEED_ONE')
+struct SpeedTableEntry
+{
+    short player;
+    short ghost;
+    short ghostTunnel; // Ghosts slow down in the tunnel
+    short ghostFrightened; // For ghosts running from the player (nothing frightens the ghosts yet)
+};
 
-    // Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
-	BaseGameClass(int x, int y);
+// Speeds for each level, the first level moves everything one pixel per tick (apart from ghosts in the tunnel)
+// NOTE: No speed can be more than 'MAX_SPEED'
+static const SpeedTableEntry SPEED_TABLE[SPEED_LEVELS] =
+{
+    // player, ghost, tunnel, frightened
+    { 256, 256, 128, 160 },
+    { 264, 272, 136, 168 },
+    { 272, 280, 140, 176 },
+    { 280, 288, 144, 184 },
+    { 288, 304, 152, 192 }
+};
 
-    // Virtual function to be overwritten by child classes
-    // Called in the main game engine "Init()"
-	virtual void Init();
+// Max number of enemies stored in a 'GameState'
+#define MAX_STATE_ENEMIES 4
 
-    // Virtual function to be overwritten by child classes
-    // Called in the main game engine "Update()"
-	virtual void Update();
+// Struct used to store the complete state of a game in a couple of hundred bytes
+// It contains no pointers, so it can be copied with 'memcpy' (or '='), which makes cloning a game for searching, rollback or rewinding cheap
+// Only things that change as the game is played are stored, not the layout of the maze or anything worked out from the state (e.g. paths)
+struct GameState
+{
+    int pellets[HEIGHT]; // Same format as '_pellets' in 'Maze'
+    ActorState player;
+    ActorState enemies[MAX_STATE_ENEMIES];
+    int score;
+    int lives;
+    int level;
+    char curGameState;
+    char nextGameState;
+};
 
-    // Virtual function to be overwritten by child classes
-    // Called in the main game engine "Draw()"
-	virtual void Draw();
+// Struct used to store the state shared by every object in one game
+// Each 'GameEngine' (or headless game) owns one, so any number of games can run side by side, even on different threads
+struct GameContext
+{
+    char curGameState; // Stores the current state of the game
+    char nextGameState; // Stores what the next state will be
+    TS_StateTypeDef tsState; // Stores the state of the touchscreen input
+    bool logEnabled; // When false, 'GAME_LOG' messages aren't printed (e.g. while running games headless)
 };
 
-/* BASE GAME CLASS CPP */
-//////////////////////////////////////////////////////////////
+// Prints a game message over serial, unless logging is turned off in the given 'GameContext'
+#define GAME_LOG(context, ...) do { if ((context)->logEnabled) { printf(__VA_ARGS__); } } while (0)
 
-// Constructs the object, setting its position to (0, 0) and "Updating" and "Visible" flags to true
-BaseGameClass::BaseGameClass()
+// Returns the direction opposite to the given direction (0x0 stays 0x0)
+inline char OppositeDirection(char direction)
 {
-    Updating = true;
-    Visible = true;
-    Destroy = false;
-	position.x = 0;
-	position.y = 0;
+    // Directions are single bits in the order N, E, S, W, so the opposite is two bits along
+    return ((direction << 2) | (direction >> 2)) & 0xF;
 }
 
-// Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
-BaseGameClass::BaseGameClass(int x, int y)
+/* FIXED CONTAINERS H */
+//////////////////////////////////////////////////////////////
+
+// What a fixed container does when something is added to it while it is full (or a 'BitSet' is given a bit past its end)
+#define CONTAINER_REJECT 0 // Nothing is changed and false is returned
+#define CONTAINER_OVERWRITE 1 // The oldest item is dropped to make room ('RingBuffer' only)
+#define CONTAINER_HALT 2 // The program stops with 'error()', for containers that should never fill up
+
+// Returned by 'BitSet::FindNext' when there are no more set bits
+#define BITSET_NONE -1
+
+/*
+Fixed capacity containers used in place of the STL ones, so nothing in the game loop allocates memory
+
+All of the storage is inside the container itself, so they cost nothing to create and live wherever their owner does
+Each container takes its overflow policy ('CONTAINER_*') as a template parameter, so what happens when it fills up is
+part of its type rather than something the caller has to remember to check
+
+    RingBuffer   - First in, first out queue
+    StaticVector - Array that can grow up to its capacity, added to and taken from the end
+    BitSet       - Fixed number of bits, with 'FindNext' to step through only the set ones
+*/
+template <typename T, int Capacity, int Policy = CONTAINER_REJECT>
+class RingBuffer
 {
-    Updating = true;
-    Visible = true;
-    Destroy = false;
-	position.x = x;
-	position.y = y;
-}
+private:
+    T _items[Capacity];
+    int _head; // Index of the oldest item
+    int _count;
 
-// Virtual function to be overwritten by child classes
-// Called in the main game engine "Init()"
-void BaseGameClass::Init() {}
+public:
+    // Constructs an empty buffer
+    RingBuffer();
 
-// Virtual function to be overwritten by child classes
-// Called in the main game engine "Update()"
-void BaseGameClass::Update() {}
+    // Adds 'item' to the back of the buffer, following 'Policy' if the buffer is full
+    // Returns false if the item wasn't added
+    bool Push(const T& item);
 
-// Virtual function to be overwritten by child classes
-// Called in the main game engine "Draw()"
-void BaseGameClass::Draw() {}
+    // Takes the item at the front of the buffer (the oldest) and stores it in 'item'
+    // Returns false if the buffer is empty
+    bool Pop(T* item);
 
-/* BASE GAME SPRITE H */
-//////////////////////////////////////////////////////////////
+    // Returns the item at the front of the buffer (the buffer must not be empty)
+    T& Front();
 
-// This class is designed to be inherited by all sprite based objects used in the game engine
-// Inherits from "BaseGameClass"
-// Has extra functions for handling collisions and drawing basic single colour images stored as 1D char arrays
-class BaseGameSprite :
-	public BaseGameClass
+    void Clear();
+
+    bool IsEmpty();
+
+    bool IsFull();
+
+    int GetCount();
+};
+
+template <typename T, int Capacity, int Policy = CONTAINER_REJECT>
+class StaticVector
 {
-// Protected variables/functions are accessible from child classes
-protected:
-    Position _startPosition; // Stores the initial position of the object (used for resetting the position)
+private:
+    // Dropping an item to make room makes no sense for an array, so only rejecting or halting is allowed
+    typedef char PolicyIsNotOverwrite[Policy == CONTAINER_OVERWRITE ? -1 : 1];
 
-    // Sets the object's position to "_startPosition"
-    void MoveToStartPosition();
+    T _items[Capacity];
+    int _count;
 
-    // Moves the object one pixel in the given direction
-	void UpdatePosition(char direction);
+public:
+    // Constructs an empty vector
+    StaticVector();
 
-    // Draws a simple single colour image stored in a 1D char array to the object's current position
-    // Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not 
-    void DrawSprite(char spriteImageArray[], uint16_t colour);
+    // Adds 'item' to the end of the vector, following 'Policy' if the vector is full
+    // Returns false if the item wasn't added
+    bool PushBack(const T& item);
 
-    // Draws a simple single colour image stored in a 1D char array to the object's current position
-    // Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-    // The input image will be flipped horizontally on the display
-    void DrawSpriteFlippedHorizontal(char spriteImageArray[], uint16_t colour);
+    // Removes the last item, returning false if the vector is empty
+    bool PopBack();
 
-    // Draws a simple single colour image stored in a 1D char array to the object's current position
-    // Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-    // The input image will be rotated anti-clockwise 90 degrees on the display
-    void DrawSpriteRotated90(char spriteImageArray[], uint16_t colour);
+    // Returns the item at 'index' (which must be less than 'GetCount()')
+    T& operator[](int index);
+
+    T& Back();
+
+    void Clear();
+
+    bool IsEmpty();
+
+    bool IsFull();
+
+    int GetCount();
+};
+
+template <int Bits, int Policy = CONTAINER_REJECT>
+class BitSet
+{
+private:
+    // Again, there is nothing to drop for a bit past the end
+    typedef char PolicyIsNotOverwrite[Policy == CONTAINER_OVERWRITE ? -1 : 1];
+
+    uint32_t _words[(Bits + 31) / 32];
+
+    // Returns true if 'index' is a bit in the set, following 'Policy' if it isn't
+    static bool IsInRange(int index);
+
+    // Returns the index of the lowest set bit in 'word' (which must not be 0)
+    static int LowestBit(uint32_t word);
 
-    // Draws a simple single colour image stored in a 1D char array to the object's current position
-    // Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-    // The input image will be rotated anti-clockwise 270 degrees on the display
-    void DrawSpriteRotated270(char spriteImageArray[], uint16_t colour);
 public:
-    // Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
-    // "_startPosition" will be set to (x, y)
-	BaseGameSprite(int x, int y);
+    // Constructs a set with every bit cleared
+    BitSet();
 
-    // Checks if this object has collided with the object "sprite"
-    // Collision is done using a simple bounding box algorithm, with the box dimensions of TILE_SIZE * TILE_SIZE
-    bool HasCollided(BaseGameSprite *sprite);
+    // Sets the bit at 'index', returning false if it is out of range
+    bool Set(int index);
+
+    // Clears the bit at 'index', returning false if it is out of range
+    bool Reset(int index);
+
+    // Returns true if the bit at 'index' is set (always false if it is out of range)
+    bool Test(int index);
+
+    // Clears every bit
+    void Clear();
+
+    // Returns the number of set bits
+    int Count();
+
+    // Returns the index of the first set bit at or after 'index', or 'BITSET_NONE' if there aren't any
+    // Steps a whole word at a time, so going through every set bit is:
+    //     for (int i = bits.FindNext(0); i != BITSET_NONE; i = bits.FindNext(i + 1))
+    int FindNext(int index);
 };
 
-/* BASE GAME SPRITE CPP */
+/* FIXED CONTAINERS CPP */
 //////////////////////////////////////////////////////////////
 
-// Sets the object's position to "_startPosition"
-void BaseGameSprite::MoveToStartPosition()
+// Constructs an empty buffer
+template <typename T, int Capacity, int Policy>
+RingBuffer<T, Capacity, Policy>::RingBuffer()
 {
-    position = _startPosition;
+    _head = 0;
+    _count = 0;
 }
 
-// Moves the object one pixel in the given direction
-void BaseGameSprite::UpdatePosition(char direction)
+// Adds 'item' to the back of the buffer, following 'Policy' if the buffer is full
+// Returns false if the item wasn't added
+template <typename T, int Capacity, int Policy>
+bool RingBuffer<T, Capacity, Policy>::Push(const T& item)
 {
-	if (direction == NORTH)
-	{
-		position.y--;
-	}
-	else if (direction == EAST)
-	{
-		position.x++;
-	}
-	else if (direction == SOUTH)
-	{
-		position.y++;
-	}
-	else if (direction == WEST)
-	{
-		position.x--;
-	}
+    if (_count == Capacity)
+    {
+        if (Policy == CONTAINER_HALT)
+        {
+            error("RingBuffer is full\n");
+        }
 
-    // Teleport logic here:
-    // This handles the object appearing on the other side of the map when it reaches the left or right edge
+        if (Policy != CONTAINER_OVERWRITE)
+        {
+            return false;
+        }
 
-    // If the object is on the left of the screen
-    if (position.x == 0)
-    {
-        // Set the position to the right side (taking into account the object's size)
-        position.x = (WIDTH - 1) * TILE_SIZE;
+        // Drop the oldest item
+        _head = _head + 1 == Capacity ? 0 : _head + 1;
+        _count--;
     }
-    // If the object if on the right of the screen (taking into account the object's size)
-    else if (position.x == (WIDTH - 1) * TILE_SIZE)
+
+    // Wrap with a compare rather than '%', as the capacity doesn't have to be a power of 2
+    int tail = _head + _count;
+
+    if (tail >= Capacity)
     {
-        // Set the position to the left side
-        position.x = 0;
+        tail -= Capacity;
     }
+
+    _items[tail] = item;
+    _count++;
+
+    return true;
 }
 
-// Draws a simple single colour image stored in a 1D char array to the object's current position
-// Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not 
-void BaseGameSprite::DrawSprite(char spriteImageArray[], uint16_t colour)
+// Takes the item at the front of the buffer (the oldest) and stores it in 'item'
+// Returns false if the buffer is empty
+template <typename T, int Capacity, int Policy>
+bool RingBuffer<T, Capacity, Policy>::Pop(T* item)
 {
-    // Iterate through each pixel of the 'spriteImageArray'
-    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
-    for (int i = 0; i < TILE_SIZE; i++)
+    if (_count == 0)
     {
-        for (int j = 0; j < TILE_SIZE; j++)
-        {
-            // Check if a pixel should be drawn at this point (if bit is high)
-            if (((spriteImageArray[j] >> i) & 0x1))
-            {
-                // Draw a pixel on the screen of the given colour 
-                BSP_LCD_DrawPixel(position.x + i, position.y + j, colour);
-            }
-        }
+        return false;
     }
+
+    *item = _items[_head];
+    _head = _head + 1 == Capacity ? 0 : _head + 1;
+    _count--;
+
+    return true;
 }
 
-// Draws a simple single colour image stored in a 1D char array to the object's current position
-// Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-// The input image will be flipped horizontally on the display
-void BaseGameSprite::DrawSpriteFlippedHorizontal(char spriteImageArray[], uint16_t colour)
+// Returns the item at the front of the buffer (the buffer must not be empty)
+template <typename T, int Capacity, int Policy>
+T& RingBuffer<T, Capacity, Policy>::Front()
 {
-    // Iterate through each pixel of the 'spriteImageArray'
-    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
-    for (int i = 0; i < TILE_SIZE; i++)
-    {
-        for (int j = 0; j < TILE_SIZE; j++)
-        {
-            // Check if a pixel should be drawn at this point (if bit is high)
-            if (((spriteImageArray[j] >> i) & 0x1))
-            {
-                // Draw a pixel on the screen of the given colour, flipping the x direction
-                BSP_LCD_DrawPixel(position.x + (TILE_SIZE - 1 - i), position.y + j, colour);
-            }
-        }
-    }
+    return _items[_head];
 }
 
-// Draws a simple single colour image stored in a 1D char array to the object's current position
-// Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-// The input image will be rotated anti-clockwise 90 degrees on the display
-void BaseGameSprite::DrawSpriteRotated90(char spriteImageArray[], uint16_t colour)
+template <typename T, int Capacity, int Policy>
+void RingBuffer<T, Capacity, Policy>::Clear()
 {
-    // Iterate through each pixel of the 'spriteImageArray'
-    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
-    for (int i = 0; i < TILE_SIZE; i++)
+    _head = 0;
+    _count = 0;
+}
+
+template <typename T, int Capacity, int Policy>
+bool RingBuffer<T, Capacity, Policy>::IsEmpty()
+{
+    return _count == 0;
+}
+
+template <typename T, int Capacity, int Policy>
+bool RingBuffer<T, Capacity, Policy>::IsFull()
+{
+    return _count == Capacity;
+}
+
+template <typename T, int Capacity, int Policy>
+int RingBuffer<T, Capacity, Policy>::GetCount()
+{
+    return _count;
+}
+
+// Constructs an empty vector
+template <typename T, int Capacity, int Policy>
+StaticVector<T, Capacity, Policy>::StaticVector()
+{
+    _count = 0;
+}
+
+// Adds 'item' to the end of the vector, following 'Policy' if the vector is full
+// Returns false if the item wasn't added
+template <typename T, int Capacity, int Policy>
+bool StaticVector<T, Capacity, Policy>::PushBack(const T& item)
+{
+    if (_count == Capacity)
     {
-        for (int j = 0; j < TILE_SIZE; j++)
+        if (Policy == CONTAINER_HALT)
         {
-            // Check if a pixel should be drawn at this point (if bit is high)
-            // Pixel being read is rotated here
-            if (((spriteImageArray[i] >> j) & 0x1))
-            {
-                // Draw a pixel on the screen of the given colour
-                BSP_LCD_DrawPixel(position.x + i, position.y + j, colour);
-            }
+            error("StaticVector is full\n");
         }
+
+        return false;
     }
+
+    _items[_count] = item;
+    _count++;
+
+    return true;
 }
 
-// Draws a simple single colour image stored in a 1D char array to the object's current position
-// Array accessed like a 2D array, where each bit of the char stores whether the pixel should be drawn or not
-// The input image will be rotated anti-clockwise 90 degrees on the display
-void BaseGameSprite::DrawSpriteRotated270(char spriteImageArray[], uint16_t colour)
+// Removes the last item, returning false if the vector is empty
+template <typename T, int Capacity, int Policy>
+bool StaticVector<T, Capacity, Policy>::PopBack()
 {
-    // Iterate through each pixel of the 'spriteImageArray'
-    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
-    for (int i = 0; i < TILE_SIZE; i++)
+    if (_count == 0)
     {
-        for (int j = 0; j < TILE_SIZE; j++)
-        {
-            // Check if a pixel should be drawn at this point (if bit is high)
-            // Pixel being read is rotated here
-            if (((spriteImageArray[i] >> (TILE_SIZE - 1 - j)) & 0x1))
-            {
-                // Draw a pixel on the screen of the given colour
-                BSP_LCD_DrawPixel(position.x + i, position.y + j, colour);
-            }
-        }
+        return false;
     }
+
+    _count--;
+
+    return true;
 }
 
-// Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
-// "_startPosition" will be set to (x, y)
-BaseGameSprite::BaseGameSprite(int x, int y) : BaseGameClass(x, y)
+// Returns the item at 'index' (which must be less than 'GetCount()')
+template <typename T, int Capacity, int Policy>
+T& StaticVector<T, Capacity, Policy>::operator[](int index)
 {
-    _startPosition.x = x;
-    _startPosition.y = y;
+    return _items[index];
 }
 
-// Checks if this object has collided with the object "sprite"
-// Collision is done using a simple bounding box algorithm, with the box dimensions of TILE_SIZE * TILE_SIZE
-bool BaseGameSprite::HasCollided(BaseGameSprite *sprite)
+template <typename T, int Capacity, int Policy>
+T& StaticVector<T, Capacity, Policy>::Back()
 {
-    // Bounding box collision detection logic here
-    return position.x < sprite->position.x + TILE_SIZE && position.x + TILE_SIZE > sprite->position.x && position.y < sprite->position.y + TILE_SIZE && position.y + TILE_SIZE > sprite->position.y;
+    return _items[_count - 1];
 }
 
-/* GAME ENGINE H */
-//////////////////////////////////////////////////////////////
-
-/*
-This class is designed to run the the game
-It has a master array containing all objects in the game as well as the game's main loop
+template <typename T, int Capacity, int Policy>
+void StaticVector<T, Capacity, Policy>::Clear()
+{
+    _count = 0;
+}
 
-The game loop performs the following:
-    1 - Initialises all game objects        (Calls Init() for all objects in the master array)
-    2 - Updates game objects                (Calls Update() for all objects in the master array)
-    3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
-    4 - Return to step 2
+template <typename T, int Capacity, int Policy>
+bool StaticVector<T, Capacity, Policy>::IsEmpty()
+{
+    return _count == 0;
+}
 
-*/
-class GameEngine
+template <typename T, int Capacity, int Policy>
+bool StaticVector<T, Capacity, Policy>::IsFull()
 {
-private:
+    return _count == Capacity;
+}
 
-    // This is the master array which stores all of the game's objects
-    // NOTE: Make sure that the defined 'MAX_GAME_OBJECTS' has a value greater or equal to the number of objects in the game or bad things will happen!
-    // NOTE: Something fancier like a linked list could be used here, but this works and is fast to operate on
-	BaseGameClass* _GameObjects[MAX_GAME_OBJECTS];
+template <typename T, int Capacity, int Policy>
+int StaticVector<T, Capacity, Policy>::GetCount()
+{
+    return _count;
+}
 
-    // Stores the number of objects in the game
-	int _GameObjectCount;
+// Returns true if 'index' is a bit in the set, following 'Policy' if it isn't
+template <int Bits, int Policy>
+bool BitSet<Bits, Policy>::IsInRange(int index)
+{
+    if (index >= 0 && index < Bits)
+    {
+        return true;
+    }
 
-    // Calls the 'Init()' function of all objects stored in '_GameObjects'
-	void Init();
+    if (Policy == CONTAINER_HALT)
+    {
+        error("BitSet index out of range\n");
+    }
 
-    // Calls the 'Update()' function of all objects stored in '_GameObjects'
-    // Objects with the 'Updating' flag set to false will be skipped
-	void Update();
+    return false;
+}
 
-    // Calls the 'Draw()' function of all objects stored in '_GameObjects'
-    // Objects with the 'Visible' flag set to false will be skipped
-	void Draw();
+// Returns the index of the lowest set bit in 'word' (which must not be 0)
+template <int Bits, int Policy>
+int BitSet<Bits, Policy>::LowestBit(uint32_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(word);
+#else
+    int bit = 0;
 
-public:
+    while (!(word & 0x1))
+    {
+        word >>= 1;
+        bit++;
+    }
 
-    // Constructs a new 'GameEngine' object
-    // '_GameObjectCount' is set to 0 
-	GameEngine();
+    return bit;
+#endif
+}
 
-    // Adds the given game object to the master array
-    // Increments '_GameObjectCount'
-	void AddGameObject(BaseGameClass* gameObject);
+// Constructs a set with every bit cleared
+template <int Bits, int Policy>
+BitSet<Bits, Policy>::BitSet()
+{
+    Clear();
+}
 
-    // Main game loop function
-    // The game loop performs the following:
-    //     1 - Initialises all game objects        (Calls Init() for all objects in the master array)
-    //     2 - Updates game objects                (Calls Update() for all objects in the master array)
-    //     3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
-    //     4 - Return to step 2
-	void MainGameLoop();
-};
+// Sets the bit at 'index', returning false if it is out of range
+template <int Bits, int Policy>
+bool BitSet<Bits, Policy>::Set(int index)
+{
+    if (!IsInRange(index))
+    {
+        return false;
+    }
 
-/* GAME ENGINE CPP */
-//////////////////////////////////////////////////////////////
+    _words[index >> 5] |= (uint32_t)0x1 << (index & 31);
 
-// Calls the 'Init()' function of all objects stored in '_GameObjects'
-void GameEngine::Init()
-{
-	for (int i = 0; i < _GameObjectCount; i++)
-	{
-		_GameObjects[i]->Init();
-	}
+    return true;
 }
 
-// Calls the 'Update()' function of all objects stored in '_GameObjects'
-// Objects with the 'Updating' flag set to false will be skipped
-void GameEngine::Update()
+// Clears the bit at 'index', returning false if it is out of range
+template <int Bits, int Policy>
+bool BitSet<Bits, Policy>::Reset(int index)
 {
-	for (int i = 0; i < _GameObjectCount; i++)
-	{
-		if (_GameObjects[i]->Updating)
-		{
-			_GameObjects[i]->Update();
-		}
-	}
+    if (!IsInRange(index))
+    {
+        return false;
+    }
+
+    _words[index >> 5] &= ~((uint32_t)0x1 << (index & 31));
+
+    return true;
 }
 
-// Calls the 'Draw()' function of all objects stored in '_GameObjects'
-// Objects with the 'Visible' flag set to false will be skipped
-void GameEngine::Draw()
+// Returns true if the bit at 'index' is set (always false if it is out of range)
+template <int Bits, int Policy>
+bool BitSet<Bits, Policy>::Test(int index)
 {
-	for (int i = 0; i < _GameObjectCount; i++)
-	{
-		if (_GameObjects[i]->Visible)
-		{
-			_GameObjects[i]->Draw();
-		}
-	}
+    if (!IsInRange(index))
+    {
+        return false;
+    }
+
+    return (_words[index >> 5] >> (index & 31)) & 0x1;
 }
 
-// Constructs a new 'GameEngine' object
-// '_GameObjectCount' is set to 0 
-GameEngine::GameEngine()
+// Clears every bit
+template <int Bits, int Policy>
+void BitSet<Bits, Policy>::Clear()
 {
-    _GameObjectCount = 0;
+    memset(_words, 0, sizeof(_words));
 }
 
-// Adds the given game object to the master array
-// Increments '_GameObjectCount'
-void GameEngine::AddGameObject(BaseGameClass* gameObject)
+// Returns the number of set bits
+template <int Bits, int Policy>
+int BitSet<Bits, Policy>::Count()
 {
-	_GameObjects[_GameObjectCount] = gameObject;
-	_GameObjectCount++;
+    int count = 0;
+
+    for (int i = 0; i < (Bits + 31) / 32; i++)
+    {
+        // Clear the lowest set bit until none are left
+        for (uint32_t word = _words[i]; word != 0x0; word &= word - 1)
+        {
+            count++;
+        }
+    }
+
+    return count;
 }
 
-// Main game loop function
-// The game loop performs the following:
-//     1 - Initialises all game objects        (Calls Init() for all objects in the master array)
-//     2 - Updates game objects                (Calls Update() for all objects in the master array)
-//     3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
-//     4 - Return to step 2
-void GameEngine::MainGameLoop()
+// Returns the index of the first set bit at or after 'index', or 'BITSET_NONE' if there aren't any
+template <int Bits, int Policy>
+int BitSet<Bits, Policy>::FindNext(int index)
 {
-    // Initialise all objects
-	Init();
+    if (index < 0)
+    {
+        index = 0;
+    }
 
-	while (true)
-	{
-        // Read the state of the touch screen and store it to 'TS_State'
-        BSP_TS_GetState(&TS_State);
+    if (index >= Bits)
+    {
+        return BITSET_NONE;
+    }
 
-        // Update game logic for all objects
-		Update();
+    int wordIndex = index >> 5;
 
-        // Draw all game objects to the screen
-		Draw();
+    // Ignore the bits before 'index' in its word
+    uint32_t word = _words[wordIndex] & (0xFFFFFFFFu << (index & 31));
 
-        // Change the game's state to the next game state
-        CurGameState = NextGameState;
+    while (word == 0x0)
+    {
+        wordIndex++;
 
-        // Wait a small amount of time
-        wait_ms(10);
-	}
+        if (wordIndex == (Bits + 31) / 32)
+        {
+            return BITSET_NONE;
+        }
+
+        word = _words[wordIndex];
+    }
+
+    return (wordIndex << 5) + LowestBit(word);
 }
 
-/* MAZE H */
+/* HEAP GUARD H */
 //////////////////////////////////////////////////////////////
 
+// Number of different places allocations can be counted from when tracing (allocations from any more are counted as untracked)
+#define MAX_HEAP_CALL_SITES 16
+
+// Stores the allocations counted from one place in the program
+struct HeapCallSite
+{
+    void* caller; // Return address of the call to 'new' or 'malloc'
+    int count;
+    unsigned long bytes;
+};
+
 /*
-This class is used to store the maze tilemap used in the game
+This class checks that nothing is allocated on the heap once the game is running
+Over days of uptime even small allocations in the game loop fragment the heap until one fails, so once 'Lock()' is called
+(after every object is initialised) the game loop is expected to never allocate again
 
-The tilemap is simple with only two state; either a tile being a 'FLOOR' or a 'WALL'
-Due to only needing two states for each given tile, the 2D maze can be stored in a 1D array of 32 bit ints, where each bit of the int stores whether the given tile is a 'FLOOR' or 'WALL'
+It does nothing unless the program is built with one of these defined:
+    PACMAN_ZERO_HEAP        - Any allocation after 'Lock()' stops the program with 'error()', giving its size and where it was called from
+    PACMAN_HEAP_TRACE       - Allocations after 'Lock()' are counted for each frame and for each place they were called from,
+                              so they can be found on the host (see 'tools/heap_check.cpp')
+
+Both replace the global 'operator new' and 'operator delete'
+'malloc', 'calloc' and 'realloc' are only caught when 'PACMAN_HEAP_WRAP_MALLOC' is defined too, and the program is linked with:
+    -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+
+NOTE: The counts aren't thread safe, so tracing is for single threaded runs only
 */
-class Maze :
-	public BaseGameClass
+class HeapGuard
 {
 private:
+    static bool _locked;
+    static int _frameAllocations;
+    static long _totalAllocations;
 
-    // Flag used to store whether the entire map should be redrawn when 'Draw()' is called
-    // NOTE: The MBED simulator LCD is quite slow at redrawing the entire screen so minimising the amount of pixels being set massively improves performance  
-    bool _initialDraw;
+#ifdef PACMAN_HEAP_TRACE
+    static int _frame;
+    static StaticVector<HeapCallSite, MAX_HEAP_CALL_SITES> _callSites;
+    static int _untracked; // Allocations from places after '_callSites' filled up
+#endif
 
-    // Used like a 2D array to store the maze. Each bit of the int stores whether the tile is a floor or a wall
-    // NOTE: Due to x position being stored in a 32 bit int, the width of the maze cannot be greater than 32 tiles
-    // NOTE: To reduce ram usage, this could be stored as a const, however, leaving it like this allows for the possibility of different mazes being used
-    int _maze[HEIGHT];
+public:
+    // From now on, allocations stop the program or are counted (depending on the build)
+    static void Lock();
 
-    // Used like a 2D array to store if there is a pellet on a given square
-    // NOTE: Due to x position being stored in a 32 bit int, the width of the maze cannot be greater than 32 tiles
-    // NOTE: To reduce ram usage, this could be stored as a const, however, leaving it like this allows for the possibility of different mazes being used
-    int _pellets[HEIGHT]; 
+    // Allows allocations again, e.g. while shutting down
+    static void Unlock();
 
-    // Sets the maze tile at (x, y) to be a floor tile 
-    void SetFloor(int x, int y);
+    static bool IsLocked();
 
-    // Sets the maze tile at (x, y) to be a wall tile 
-    void SetWall(int x, int y);
+    // Called by the game engine around every frame, so allocations can be counted per frame
+    // When tracing, 'EndFrame' prints a line for each frame that allocated
+    static void BeginFrame();
+    static void EndFrame();
 
-    // Sets the maze to be similar to the classic Pacman maze
-    // NOTE: Map is slightly shrunk to fit on the LCD screen
-    void SetClassicMaze();
+    // Returns the number of allocations since 'BeginFrame' was last called
+    static int GetFrameAllocations();
 
-    // Sets the pellets on the classic maze
-    void SetPelletsClassicMaze();
+    // Returns the number of allocations since 'Lock' was first called
+    static long GetTotalAllocations();
 
-    // Draws the maze tile at (x, y) onto the LCD
-    void DrawTile(int x, int y);
+    // Called by the replaced allocation functions with the size asked for and the return address of the call
+    static void RecordAllocation(size_t size, void* caller);
 
-    // Get the current number of pellets left in the maze
-    int GetPelletCount();
-public:
-    // Stack used to store position to be redrawn
-    // This is used help reduce the number of pixels being drawn to the LCD at a given time
-    // When the Player/Enemy changes its position, it adds its position to this stack
-    // Each position in this stack, as well as some neighbouring tiles are redrawn, preventing the Player/Enemy image from smearing
-    std::stack<Position> redrawStack;
+    // Prints every place allocations were counted from while locked (only when tracing)
+    static void PrintCallSites();
+};
 
-    // Stores the maximum amount of pellets in the maze
-    int maxPellets;
+/* HEAP GUARD CPP */
+//////////////////////////////////////////////////////////////
 
-    // Constructs a new maze objects
-    // '_initialDraw' is set to true, 'SetClassicMaze()' and 'SetPelletsClassicMaze()' are called to initialise the map
-	Maze();
+bool HeapGuard::_locked = false;
+int HeapGuard::_frameAllocations = 0;
+long HeapGuard::_totalAllocations = 0;
 
-    // Returns true if the given coordinate (x, y) is within the bounds of the map
-    bool IsInBounds(int x, int y);
+#ifdef PACMAN_HEAP_TRACE
+int HeapGuard::_frame = 0;
+StaticVector<HeapCallSite, MAX_HEAP_CALL_SITES> HeapGuard::_callSites;
+int HeapGuard::_untracked = 0;
+#endif
 
-    // Returns true in the given tile coordinate (x, y) is a floor tile
-    // If (x, y) is out of bounds, this returns false
-	bool IsFloor(int x, int y);
+// From now on, allocations stop the program or are counted (depending on the build)
+void HeapGuard::Lock()
+{
+    _locked = true;
+}
 
-    // Returns true if the tile in the given direction from the given coordinate (x, y) is a tile
-    // (e.g. if 'IsFloorAdjacent(10, 14, EAST)' was called, the tile at (11, 14) would be checked)
-	bool IsFloorAdjacent(int x, int y, char direction);
+// Allows allocations again, e.g. while shutting down
+void HeapGuard::Unlock()
+{
+    _locked = false;
+}
 
-    // Returns true if the tile in the given direction from the given coordinate (position.x, position.y) is a tile
-	bool IsFloorAdjacent(Position position, char direction);
+bool HeapGuard::IsLocked()
+{
+    return _locked;
+}
 
-    // Checks if the screen position one pixel in the given direction is a floor tile
-    // Does a simple check to make sure that the entire object of size TILE_SIZE * TILE_SIZE could move into the position
-    bool IsFloorAdjacentScreenPos(Position screenPos, char direction);
+// Called by the game engine around every frame, so allocations can be counted per frame
+void HeapGuard::BeginFrame()
+{
+    _frameAllocations = 0;
+}
 
-    // Returns true if the tile position (x, y) contains a pellet
-    bool IsPellet(int x, int y);
+// When tracing, prints a line for each frame that allocated
+void HeapGuard::EndFrame()
+{
+#ifdef PACMAN_HEAP_TRACE
+    if (_frameAllocations > 0)
+    {
+        // Printing can allocate (e.g. the first time stdout is used), which shouldn't be counted
+        bool locked = _locked;
+        _locked = false;
+        printf("Heap: %d allocations in frame %d\n", _frameAllocations, _frame);
+        _locked = locked;
+    }
 
-    // Removes the pellet at the tile position (x, y)
-    // If there is a pellet at the given position, returns true
-    // If there is no pellet at the given position, returns false
-    bool TryRemovePellet(int x, int y);
+    _frame++;
+#endif
+}
 
-    // Converts the given screen position into a tile position
-    // Once the tile position is acquired, 'TryRemovePellet' at the tile position is called
-    bool TryRemovePelletScreenPos(Position screenPos);
+// Returns the number of allocations since 'BeginFrame' was last called
+int HeapGuard::GetFrameAllocations()
+{
+    return _frameAllocations;
+}
 
-    // Converts the given screen position (x, y) to a position on the tilemap
-    // Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
-    Position ScreenPosToTilePos(int x, int y);
+// Returns the number of allocations since 'Lock' was first called
+long HeapGuard::GetTotalAllocations()
+{
+    return _totalAllocations;
+}
 
-    // Converts the given screen position (screenPos) to a position on the tilemap
-    // Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
-    Position ScreenPosToTilePos(Position screenPos);
+// Called by the replaced allocation functions with the size asked for and the return address of the call
+void HeapGuard::RecordAllocation(size_t size, void* caller)
+{
+    // Only read by the trap report and the trace, so unused when built with neither
+    (void)size;
+    (void)caller;
 
-    // Update function
-    // State:
-    //      STARTUP: Make the maze visible + set '_initialDraw' to true + add the pellets to the maze
-    //      CONTINUE: Set '_initalDraw' to true
-    //      NEXT_LEVEL: Same as 'STARTUP' state
-    //      PLAY: Do nothing
-    //      DEAD: Do nothing
-    //      default: Set the maze to be invisible
-    void Update();
+    if (!_locked)
+    {
+        return;
+    }
 
-    // Draw function
-    // When '_initialDraw' is true, all tiles within the maze are draw
-    // When 'initialDraw' is false, only positions in 'redrawStack' are drawn
-	void Draw();
-};
+    _frameAllocations++;
+    _totalAllocations++;
 
-/* MAZE CPP */
-//////////////////////////////////////////////////////////////
-// Sets the maze tile at (x, y) to be a floor tile 
-void Maze::SetFloor(int x, int y)
+#ifdef PACMAN_ZERO_HEAP
+    // Unlocked first, as 'error()' may allocate while printing
+    _locked = false;
+    error("Heap allocation of %u bytes after initialisation (called from %p)\n", (unsigned int)size, caller);
+#endif
+
+#ifdef PACMAN_HEAP_TRACE
+    for (int i = 0; i < _callSites.GetCount(); i++)
+    {
+        if (_callSites[i].caller == caller)
+        {
+            _callSites[i].count++;
+            _callSites[i].bytes += size;
+            return;
+        }
+    }
+
+    HeapCallSite site;
+    site.caller = caller;
+    site.count = 1;
+    site.bytes = size;
+
+    if (!_callSites.PushBack(site))
+    {
+        _untracked++;
+    }
+#endif
+}
+
+// Prints every place allocations were counted from while locked (only when tracing)
+void HeapGuard::PrintCallSites()
 {
-	_maze[y] |= 0x1 << x; // Set the x'th bit
+#ifdef PACMAN_HEAP_TRACE
+    bool locked = _locked;
+    _locked = false;
+
+    for (int i = 0; i < _callSites.GetCount(); i++)
+    {
+        printf("    %d allocations (%lu bytes) from %p\n", _callSites[i].count, _callSites[i].bytes, _callSites[i].caller);
+
+#ifdef HEAP_GUARD_BACKTRACE
+        // Names the function the address is in (needs '-rdynamic' on the host to see the game's own functions)
+        fflush(stdout);
+        backtrace_symbols_fd(&_callSites[i].caller, 1, fileno(stdout));
+#endif
+    }
+
+    if (_untracked > 0)
+    {
+        printf("    %d allocations from other places\n", _untracked);
+    }
+
+    _locked = locked;
+#endif
 }
 
-// Sets the maze tile at (x, y) to be a wall tile 
-void Maze::SetWall(int x, int y)
+#if defined(PACMAN_ZERO_HEAP) || defined(PACMAN_HEAP_TRACE)
+
+// With 'malloc' wrapped, 'operator new' goes straight to the real one so its allocations aren't counted twice
+#ifdef PACMAN_HEAP_WRAP_MALLOC
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t count, size_t size);
+extern "C" void* __real_realloc(void* memory, size_t size);
+
+#define HEAP_GUARD_MALLOC __real_malloc
+
+// Stand in for 'malloc', 'calloc' and 'realloc' when linked with '--wrap'
+extern "C" void* __wrap_malloc(size_t size)
 {
-	_maze[y] &= ~(0x1 << x); // Clear the x'th bit
+    HeapGuard::RecordAllocation(size, __builtin_return_address(0));
+    return __real_malloc(size);
 }
 
-// Sets the maze to be similar to the classic Pacman maze
-// NOTE: Map is slightly shrunk to fit on the LCD screen
-void Maze::SetClassicMaze()
+extern "C" void* __wrap_calloc(size_t count, size_t size)
 {
-    _maze[0] = 0x0;
-    _maze[1] = 0x0;
-    _maze[2] = 0x7FF9FFE;
-    _maze[3] = 0x4209042;
-    _maze[4] = 0x4209042;
-    _maze[5] = 0x4209042;
-    _maze[6] = 0x7FFFFFE;
-    _maze[7] = 0x4240242;
-    _maze[8] = 0x4240242;
-    _maze[9] = 0x7E79E7E;
-    _maze[10] = 0x0209040;
-    _maze[11] = 0x0209040;
-    _maze[12] = 0x027FE40;
-    _maze[13] = 0x0240240;
-    _maze[14] = 0xFFC03FF;
-    _maze[15] = 0x0240240;
-    _maze[16] = 0x027FE40;
-    _maze[17] = 0x0240240;
-    _maze[18] = 0x0240240;
-    _maze[19] = 0x7FF9FFE;
-    _maze[20] = 0x4209042;
-    _maze[21] = 0x4209042;
-    _maze[22] = 0x73FFFCE;
-    _maze[23] = 0x1240248;
-    _maze[24] = 0x1240248;
-    _maze[25] = 0x7E79E7E;
-    _maze[26] = 0x4009002;
-    _maze[27] = 0x4009002;
-    _maze[28] = 0x7FFFFFE;
-    _maze[29] = 0x0;
+    HeapGuard::RecordAllocation(count * size, __builtin_return_address(0));
+    return __real_calloc(count, size);
 }
 
-// Sets the pellets on the classic maze
-void Maze::SetPelletsClassicMaze()
+extern "C" void* __wrap_realloc(void* memory, size_t size)
 {
-    _pellets[0] = 0x0;
-    _pellets[1] = 0x0;
-    _pellets[2] = 0x7FF9FFE;
-    _pellets[3] = 0x4209042;
-    _pellets[4] = 0x4209042;
-    _pellets[5] = 0x4209042;
-    _pellets[6] = 0x7FFFFFE;
-    _pellets[7] = 0x4240242;
-    _pellets[8] = 0x4240242;
-    _pellets[9] = 0x7E79E7E;
-    _pellets[10] = 0x0200040;
-    _pellets[11] = 0x0200040;
-    _pellets[12] = 0x0200040;
-    _pellets[13] = 0x0200040;
-    _pellets[14] = 0x0200040;
-    _pellets[15] = 0x0200040;
-    _pellets[16] = 0x0200040;
-    _pellets[17] = 0x0200040;
-    _pellets[18] = 0x0200040;
-    _pellets[19] = 0x7FF9FFE;
-    _pellets[20] = 0x4209042;
-    _pellets[21] = 0x4209042;
-    _pellets[22] = 0x73FDFCE;
-    _pellets[23] = 0x1240248;
-    _pellets[24] = 0x1240248;
-    _pellets[25] = 0x7E79E7E;
-    _pellets[26] = 0x4009002;
-    _pellets[27] = 0x4009002;
-    _pellets[28] = 0x7FFFFFE;
-    _pellets[29] = 0x0;
+    HeapGuard::RecordAllocation(size, __builtin_return_address(0));
+    return __real_realloc(memory, size);
 }
+#else
+#define HEAP_GUARD_MALLOC malloc
+#endif
 
-// Get the current number of pellets left in the maze
-int Maze::GetPelletCount()
+void* operator new(size_t size)
 {
-    int count = 0;
+    HeapGuard::RecordAllocation(size, __builtin_return_address(0));
+    void* memory = HEAP_GUARD_MALLOC(size == 0 ? 1 : size);
 
-    // Iterate through the map
-    for (int i = 0; i < WIDTH; i++)
+    if (memory == NULL)
     {
-        for (int j = 0; j < HEIGHT; j++)
-        {
-            // If there is a pellet at the given position, increment count
-            count += IsPellet(i, j);
-        }
+        error("Out of heap memory (%u bytes)\n", (unsigned int)size);
     }
 
-    return count;
+    return memory;
 }
 
-// Constructs a new maze objects
-// '_initialDraw' is set to true, 'SetClassicMaze()' and 'SetPelletsClassicMaze()' are called to initialise the map
-Maze::Maze() : BaseGameClass(0, 0)
+void* operator new[](size_t size)
 {
-    _initialDraw = true;
-	SetClassicMaze();
-    SetPelletsClassicMaze();
-    maxPellets = GetPelletCount();
+    HeapGuard::RecordAllocation(size, __builtin_return_address(0));
+    void* memory = HEAP_GUARD_MALLOC(size == 0 ? 1 : size);
+
+    if (memory == NULL)
+    {
+        error("Out of heap memory (%u bytes)\n", (unsigned int)size);
+    }
+
+    return memory;
 }
 
-// Returns true if the given coordinate (x, y) is within the bounds of the map
-bool Maze::IsInBounds(int x, int y)
+void operator delete(void* memory) throw()
 {
-    return x > -1 && x < WIDTH && y > -1 && y < HEIGHT;
+    free(memory);
 }
 
-// Returns true in the given tile coordinate (x, y) is a floor tile
-// If (x, y) is out of bounds, this returns false
-bool Maze::IsFloor(int x, int y)
+void operator delete[](void* memory) throw()
 {
-	return IsInBounds(x, y) && ((_maze[y] >> x) & 0x1);
+    free(memory);
 }
 
-// Returns true if the tile in the given direction from the given coordinate (x, y) is a tile
-// (e.g. if 'IsFloorAdjacent(10, 14, EAST)' was called, the tile at (11, 14) would be checked)
-bool Maze::IsFloorAdjacent(int x, int y, char direction)
+#endif
+
+/* BASE GAME CLASS H */
+//////////////////////////////////////////////////////////////
+
+// This class is designed to be inherited by all objects used in the game engine
+class BaseGameClass
 {
-	if (direction == NORTH && y > 0)
-	{
-		return IsFloor(x, y - 1);
-	}
-	else if (direction == EAST && x < WIDTH - 1)
-	{
-		return IsFloor(x + 1, y);
-	}
-	else if (direction == SOUTH && y < HEIGHT - 1)
-	{
-		return IsFloor(x, y + 1);
-	}
-	else if (direction == WEST && x > 0)
-	{
-		return IsFloor(x - 1, y);
-	}
-	else
-	{
-		return false;
-	}
+public:
+	Position position; // Stores the coordinate to draw the object on the screen
+	bool Updating; // When true, the object's "Update" function will be called in the main game engine loop
+	bool Visible; // When true, the object's "Draw" function will be called in the main game engine loop
+    bool Destroy; // Used as a flag to remove the object from the game engine
+    GameContext* context; // Stores the state of the game the object belongs to (set by 'GameEngine::AddGameObject', must be set before 'Update()' is called)
+
+    // Constructs the object, setting its position to (0, 0) and "Updating" and "Visible" flags to true
+    BaseGameClass();
+
+    // Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
+	BaseGameClass(int x, int y);
+
+    // Virtual function to be overwritten by child classes
+    // Called in the main game engine "Init()"
+	virtual void Init();
+
+    // Virtual function to be overwritten by child classes
+    // Called in the main game engine "Update()"
+	virtual void Update();
+
+    // Virtual function to be overwritten by child classes
+    // Called in the main game engine "Draw()"
+	virtual void Draw();
+
+    // Virtual function to be overwritten by child classes
+    // Called in the main game engine "Update()" once every object has been updated, to make the object's new state visible to the others
+    virtual void PublishState();
+
+    // Virtual function to be overwritten by child classes
+    // Called in the main game engine "Update()" once every object has published its state, for objects that need to see this tick's state
+    virtual void LateUpdate();
+};
+
+/* BASE GAME CLASS CPP */
+//////////////////////////////////////////////////////////////
+
+// Constructs the object, setting its position to (0, 0) and "Updating" and "Visible" flags to true
+BaseGameClass::BaseGameClass()
+{
+    Updating = true;
+    Visible = true;
+    Destroy = false;
+    context = NULL;
+	position.x = 0;
+	position.y = 0;
 }
 
-// Returns true if the tile in the given direction from the given coordinate (position.x, position.y) is a tile
-bool Maze::IsFloorAdjacent(Position position, char direction)
+// Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
+BaseGameClass::BaseGameClass(int x, int y)
 {
-	return IsFloorAdjacent(position.x, position.y, direction);
+    Updating = true;
+    Visible = true;
+    Destroy = false;
+    context = NULL;
+	position.x = x;
+	position.y = y;
 }
 
-// Checks if the screen position one pixel in the given direction is a floor tile
-// Does a simple check to make sure that the entire object of size TILE_SIZE * TILE_SIZE could move into the position
-bool Maze::IsFloorAdjacentScreenPos(Position screenPos, char direction)
+// Virtual function to be overwritten by child classes
+// Called in the main game engine "Init()"
+void BaseGameClass::Init() {}
+
+// Virtual function to be overwritten by child classes
+// Called in the main game engine "Update()"
+void BaseGameClass::Update() {}
+
+// Virtual function to be overwritten by child classes
+// Called in the main game engine "Draw()"
+void BaseGameClass::Draw() {}
+
+// Virtual function to be overwritten by child classes
+// Called in the main game engine "Update()" once every object has been updated, to make the object's new state visible to the others
+void BaseGameClass::PublishState() {}
+
+// Virtual function to be overwritten by child classes
+// Called in the main game engine "Update()" once every object has published its state, for objects that need to see this tick's state
+void BaseGameClass::LateUpdate() {}
+
+/* CHUNKED MAZE H */
+//////////////////////////////////////////////////////////////
+
+// Stores a CHUNK_SIZE * CHUNK_SIZE block of a 'ChunkedMaze'
+// Each row of the chunk is stored in a 32 bit int, in the same way as the rows of 'Maze'
+struct MazeChunk
 {
-    /*
-        Example with 2x2 pixel tiles:
-        Legend:
-            # - Wall at pixel
-            . - Floor at pixel
-            * - Pixel being checked
-            ~ - Object's pixel not being checked
+    uint32_t floor[CHUNK_SIZE];
+    uint32_t pellets[CHUNK_SIZE];
+};
 
-        Image A:
-            ##..####
-            ##..####
-            ##.~~...
-            ##.~~...
-            ##..####
-            ##..####
+/*
+This class stores mazes far too big for the screen (up to MAX_ARENA_SIZE * MAX_ARENA_SIZE tiles) for large arena stress scenarios
 
-        Image B:
-            ##..####
-            ##.**###
-            ##.~~...
-            ##.~~...
-            ##..####
-            ##..####
+The maze is split into chunks of CHUNK_SIZE * CHUNK_SIZE tiles
+Chunks that are entirely wall aren't stored at all, the rest are taken from a fixed pool of 'MAX_ARENA_CHUNKS' chunks
+The tile functions work the same way as the ones in 'Maze', just with world positions instead of screen positions
 
-        Image A shows the initial world state
-        Image B shows the pixels being checked when the object is trying to move north
+NOTE: The chunk pool is large so objects of this class should be static rather than on the stack
+*/
+class ChunkedMaze
+{
+private:
+    // Size of the maze (in tiles)
+    int _width;
+    int _height;
 
-        If only a single pixel on the top left above the object was being checked, the object would be able to move partly into the wall above.
-        Checking both pixels above each edge of the object reveals that there is actually a wall in the way 
-    */
-    
-    // Create two empty Position structs
-    // These are used to check the edge of the object moving in the given direction
-    Position adjacentPosA;
-    Position adjacentPosB;
+    // Used like a 2D array to find the pool index of each chunk (-1 when the chunk is entirely wall)
+    short _chunkIndex[MAX_ARENA_SIZE / CHUNK_SIZE][MAX_ARENA_SIZE / CHUNK_SIZE];
 
-    if (direction == NORTH)
-    {
-        // Set the positions to be checked
-        adjacentPosA.x = screenPos.x;
-        adjacentPosA.y = screenPos.y - 1;
+    MazeChunk _chunks[MAX_ARENA_CHUNKS];
+    int _chunkCount;
 
-        adjacentPosB.x = screenPos.x + TILE_SIZE - 1;
-        adjacentPosB.y = screenPos.y - 1;
-    }
-    else if (direction == EAST)
-    {
-        // Set the positions to be checked
-        adjacentPosA.x = screenPos.x + TILE_SIZE;
-        adjacentPosA.y = screenPos.y;
+    // Returns the chunk holding the tile (x, y) or NULL if that chunk is entirely wall
+    MazeChunk* GetChunk(int x, int y);
 
-        adjacentPosB.x = screenPos.x + TILE_SIZE;
-        adjacentPosB.y = screenPos.y + TILE_SIZE - 1;
-    }
-    else if (direction == SOUTH)
-    {
-        // Set the positions to be checked
-        adjacentPosA.x = screenPos.x;
-        adjacentPosA.y = screenPos.y + TILE_SIZE;
+public:
+    // Constructs an empty (entirely wall) maze of the given size in tiles
+    ChunkedMaze(int width, int height);
 
-        adjacentPosB.x = screenPos.x + TILE_SIZE - 1;
-        adjacentPosB.y = screenPos.y + TILE_SIZE;
-    }
-    else if (direction == WEST)
-    {
-        // Set the positions to be checked
-        adjacentPosA.x = screenPos.x - 1;
-        adjacentPosA.y = screenPos.y;
+    // Sets every tile back to a wall and frees all of the chunks
+    void Clear();
 
-        adjacentPosB.x = screenPos.x - 1;
-        adjacentPosB.y = screenPos.y + TILE_SIZE - 1;
-    }
+    // Sets the tile (x, y) to be a floor tile, with or without a pellet
+    // Returns false if the tile is out of bounds or a new chunk was needed and the pool is full
+    bool SetFloor(int x, int y, bool pellet);
 
-    // Convert the screen positions to tile positions in the maze
-    Position tilePosA = ScreenPosToTilePos(adjacentPosA);
-    Position tilePosB = ScreenPosToTilePos(adjacentPosB);
+    // Fills the maze by repeating a 'WIDTH' * 'HEIGHT' layout (in the format used by 'Maze') as many times as fits
+    // Neighbouring copies line up through their tunnels, so actors can travel between them
+    // Returns false if the chunk pool ran out
+    bool RepeatLayout(const int maze[], const int pellets[]);
+
+    int GetWidth();
+
+    int GetHeight();
+
+    // Returns the number of chunks taken from the pool
+    int GetChunkCount();
+
+    // Returns true if the given tile coordinate (x, y) is within the bounds of the maze
+    bool IsInBounds(int x, int y);
+
+    // Returns true if the tile (x, y) is a floor tile
+    bool IsFloor(int x, int y);
+
+    // Returns true if the tile (x, y) contains a pellet
+    bool IsPellet(int x, int y);
+
+    // Removes the pellet at the tile (x, y), returning true if there was one
+    bool TryRemovePellet(int x, int y);
+
+    // Checks if the world position one pixel in the given direction is a floor tile
+    // Works the same way as 'Maze::IsFloorAdjacentScreenPos'
+    bool IsFloorAdjacentWorldPos(Position worldPos, char direction);
+};
+
+/* CHUNKED MAZE CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns the chunk holding the tile (x, y) or NULL if that chunk is entirely wall
+MazeChunk* ChunkedMaze::GetChunk(int x, int y)
+{
+    short index = _chunkIndex[y / CHUNK_SIZE][x / CHUNK_SIZE];
+
+    if (index == -1)
+    {
+        return NULL;
+    }
+
+    return &_chunks[index];
+}
+
+// Constructs an empty (entirely wall) maze of the given size in tiles
+ChunkedMaze::ChunkedMaze(int width, int height)
+{
+    _width = width < MAX_ARENA_SIZE ? width : MAX_ARENA_SIZE;
+    _height = height < MAX_ARENA_SIZE ? height : MAX_ARENA_SIZE;
+    Clear();
+}
+
+// Sets every tile back to a wall and frees all of the chunks
+void ChunkedMaze::Clear()
+{
+    for (int i = 0; i < MAX_ARENA_SIZE / CHUNK_SIZE; i++)
+    {
+        for (int j = 0; j < MAX_ARENA_SIZE / CHUNK_SIZE; j++)
+        {
+            _chunkIndex[i][j] = -1;
+        }
+    }
+
+    _chunkCount = 0;
+}
+
+// Sets the tile (x, y) to be a floor tile, with or without a pellet
+// Returns false if the tile is out of bounds or a new chunk was needed and the pool is full
+bool ChunkedMaze::SetFloor(int x, int y, bool pellet)
+{
+    if (!IsInBounds(x, y))
+    {
+        return false;
+    }
+
+    MazeChunk* chunk = GetChunk(x, y);
+
+    // Take a new chunk from the pool the first time a floor tile is set inside it
+    if (chunk == NULL)
+    {
+        if (_chunkCount == MAX_ARENA_CHUNKS)
+        {
+            return false;
+        }
+
+        chunk = &_chunks[_chunkCount];
+        memset(chunk, 0, sizeof(MazeChunk));
+        _chunkIndex[y / CHUNK_SIZE][x / CHUNK_SIZE] = _chunkCount;
+        _chunkCount++;
+    }
+
+    uint32_t bit = 0x1u << (x % CHUNK_SIZE);
+    chunk->floor[y % CHUNK_SIZE] |= bit;
+
+    if (pellet)
+    {
+        chunk->pellets[y % CHUNK_SIZE] |= bit;
+    }
+
+    return true;
+}
+
+// Fills the maze by repeating a 'WIDTH' * 'HEIGHT' layout (in the format used by 'Maze') as many times as fits
+// Neighbouring copies line up through their tunnels, so actors can travel between them
+// Returns false if the chunk pool ran out
+bool ChunkedMaze::RepeatLayout(const int maze[], const int pellets[])
+{
+    Clear();
+
+    for (int y = 0; y < _height; y++)
+    {
+        for (int x = 0; x < _width; x++)
+        {
+            int layoutX = x % WIDTH;
+            int layoutY = y % HEIGHT;
+
+            if ((maze[layoutY] >> layoutX) & 0x1)
+            {
+                if (!SetFloor(x, y, (pellets[layoutY] >> layoutX) & 0x1))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+int ChunkedMaze::GetWidth()
+{
+    return _width;
+}
+
+int ChunkedMaze::GetHeight()
+{
+    return _height;
+}
+
+// Returns the number of chunks taken from the pool
+int ChunkedMaze::GetChunkCount()
+{
+    return _chunkCount;
+}
+
+// Returns true if the given tile coordinate (x, y) is within the bounds of the maze
+bool ChunkedMaze::IsInBounds(int x, int y)
+{
+    return x > -1 && x < _width && y > -1 && y < _height;
+}
+
+// Returns true if the tile (x, y) is a floor tile
+bool ChunkedMaze::IsFloor(int x, int y)
+{
+    if (!IsInBounds(x, y))
+    {
+        return false;
+    }
+
+    MazeChunk* chunk = GetChunk(x, y);
+    return chunk != NULL && ((chunk->floor[y % CHUNK_SIZE] >> (x % CHUNK_SIZE)) & 0x1);
+}
+
+// Returns true if the tile (x, y) contains a pellet
+bool ChunkedMaze::IsPellet(int x, int y)
+{
+    if (!IsInBounds(x, y))
+    {
+        return false;
+    }
+
+    MazeChunk* chunk = GetChunk(x, y);
+    return chunk != NULL && ((chunk->pellets[y % CHUNK_SIZE] >> (x % CHUNK_SIZE)) & 0x1);
+}
+
+// Removes the pellet at the tile (x, y), returning true if there was one
+bool ChunkedMaze::TryRemovePellet(int x, int y)
+{
+    bool hasPellet = IsPellet(x, y);
+
+    if (hasPellet)
+    {
+        GetChunk(x, y)->pellets[y % CHUNK_SIZE] &= ~(0x1u << (x % CHUNK_SIZE));
+    }
+
+    return hasPellet;
+}
+
+// Checks if the world position one pixel in the given direction is a floor tile
+// Works the same way as 'Maze::IsFloorAdjacentScreenPos'
+bool ChunkedMaze::IsFloorAdjacentWorldPos(Position worldPos, char direction)
+{
+    // The two pixels just past the edge of the object in the given direction
+    int ax = worldPos.x;
+    int ay = worldPos.y;
+    int bx = worldPos.x;
+    int by = worldPos.y;
+
+    if (direction == NORTH)
+    {
+        ay = by = worldPos.y - 1;
+        bx = worldPos.x + TILE_SIZE - 1;
+    }
+    else if (direction == EAST)
+    {
+        ax = bx = worldPos.x + TILE_SIZE;
+        by = worldPos.y + TILE_SIZE - 1;
+    }
+    else if (direction == SOUTH)
+    {
+        ay = by = worldPos.y + TILE_SIZE;
+        bx = worldPos.x + TILE_SIZE - 1;
+    }
+    else if (direction == WEST)
+    {
+        ax = bx = worldPos.x - 1;
+        by = worldPos.y + TILE_SIZE - 1;
+    }
+
+    // Negative positions are walls, so avoid dividing them towards zero
+    if (ax < 0 || ay < 0)
+    {
+        return false;
+    }
+
+    return IsFloor(ax / TILE_SIZE, ay / TILE_SIZE) && IsFloor(bx / TILE_SIZE, by / TILE_SIZE);
+}
+
+/* VIEWPORT H */
+//////////////////////////////////////////////////////////////
+
+// What has been drawn in each tile of the screen
+#define VIEW_TILE_UNKNOWN 0 // Needs drawing (e.g. a sprite has been drawn over it)
+#define VIEW_TILE_WALL 1
+#define VIEW_TILE_FLOOR 2
+#define VIEW_TILE_PELLET 3
+
+/*
+This class is a camera looking at part of a 'ChunkedMaze'
+
+The camera moves in whole tiles, keeping the followed object inside the middle of the screen
+It remembers what it drew in every tile of the screen, so when it scrolls only the tiles that look different at the new camera position are drawn
+Sprites given the viewport are drawn relative to the camera and skipped entirely when they are out of view
+Tiles that sprites are drawn over are marked so that they get drawn again on the next frame (the same job 'Maze::redrawQueue' does)
+
+The cost of a frame depends on the size of the screen, not the size of the maze
+The microbenchmarks ('tools/bench.cpp') time scrolling it across a full 'MAX_ARENA_SIZE' square arena, and following sprites that walk the arena
+
+'position' stores the world position (in pixels) of the top left of the screen
+NOTE: This should be added to the game engine before any sprites that use it so that it draws underneath them
+*/
+class Viewport :
+    public BaseGameClass
+{
+private:
+    ChunkedMaze* _maze;
+
+    // Object the camera follows (may be NULL)
+    BaseGameClass* _target;
+
+    // What has been drawn in each tile of the screen
+    uint8_t _drawn[VIEW_TILES_Y][VIEW_TILES_X];
+
+    // Screen tiles marked as needing drawing, bit (y * VIEW_TILES_X) + x for the tile (x, y)
+    BitSet<VIEW_TILES_X * VIEW_TILES_Y> _dirtyTiles;
+
+    // Set when the camera has moved, so every screen tile needs checking
+    bool _moved;
+
+    // Returns what should be drawn in the screen tile (x, y) at the current camera position
+    uint8_t GetWantedTile(int x, int y);
+
+    // Draws the screen tile (x, y) if it doesn't already show what it should
+    void RefreshTile(int x, int y);
+
+public:
+    // Constructs a viewport looking at the top left of the given maze
+    Viewport(ChunkedMaze* maze);
+
+    // Sets the object for the camera to follow
+    void Follow(BaseGameClass* target);
+
+    // Moves the camera so its top left is at the tile (x, y), keeping it inside the maze
+    void MoveTo(int x, int y);
+
+    // Forgets everything that has been drawn, so the whole screen is drawn on the next frame
+    void Invalidate();
+
+    // Returns true if any part of an object of size TILE_SIZE * TILE_SIZE at the given world position is on the screen
+    bool IsVisible(Position worldPos);
+
+    // Converts a world position (in pixels) to a screen position
+    Position WorldToScreen(Position worldPos);
+
+    // Marks the screen tiles under an object of size TILE_SIZE * TILE_SIZE at the given world position to be drawn again
+    void MarkDirty(Position worldPos);
+
+    // Update function
+    // Moves the camera to keep the followed object in view
+    void Update();
+
+    // Draw function
+    // Draws every screen tile that doesn't already show what it should
+    void Draw();
+};
+
+/* VIEWPORT CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns what should be drawn in the screen tile (x, y) at the current camera position
+uint8_t Viewport::GetWantedTile(int x, int y)
+{
+    int worldX = (position.x / TILE_SIZE) + x;
+    int worldY = (position.y / TILE_SIZE) + y;
+
+    // Outside the maze is drawn as empty floor, the same as 'Maze::DrawTile'
+    if (!_maze->IsInBounds(worldX, worldY))
+    {
+        return VIEW_TILE_FLOOR;
+    }
+
+    if (!_maze->IsFloor(worldX, worldY))
+    {
+        return VIEW_TILE_WALL;
+    }
+
+    return _maze->IsPellet(worldX, worldY) ? VIEW_TILE_PELLET : VIEW_TILE_FLOOR;
+}
+
+// Draws the screen tile (x, y) if it doesn't already show what it should
+void Viewport::RefreshTile(int x, int y)
+{
+    uint8_t wanted = GetWantedTile(x, y);
+
+    if (_drawn[y][x] == wanted)
+    {
+        return;
+    }
+
+    _drawn[y][x] = wanted;
+
+    if (wanted == VIEW_TILE_WALL)
+    {
+        BSP_LCD_SetTextColor(LCD_COLOR_BLUE);
+        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+    }
+    else
+    {
+        BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+
+        if (wanted == VIEW_TILE_PELLET)
+        {
+            BSP_LCD_SetTextColor(LCD_COLOR_YELLOW);
+            BSP_LCD_FillCircle((x * TILE_SIZE) + (TILE_SIZE / 2), (y * TILE_SIZE) + (TILE_SIZE / 2), 1);
+        }
+    }
+}
+
+// Constructs a viewport looking at the top left of the given maze
+Viewport::Viewport(ChunkedMaze* maze) : BaseGameClass(0, 0)
+{
+    _maze = maze;
+    _target = NULL;
+    Invalidate();
+}
+
+// Sets the object for the camera to follow
+void Viewport::Follow(BaseGameClass* target)
+{
+    _target = target;
+}
+
+// Moves the camera so its top left is at the tile (x, y), keeping it inside the maze
+void Viewport::MoveTo(int x, int y)
+{
+    int maxX = _maze->GetWidth() - VIEW_TILES_X;
+    int maxY = _maze->GetHeight() - VIEW_TILES_Y;
+
+    x = x > maxX ? maxX : x;
+    y = y > maxY ? maxY : y;
+    x = x < 0 ? 0 : x;
+    y = y < 0 ? 0 : y;
+
+    if (x * TILE_SIZE != position.x || y * TILE_SIZE != position.y)
+    {
+        position.x = x * TILE_SIZE;
+        position.y = y * TILE_SIZE;
+        _moved = true;
+    }
+}
+
+// Forgets everything that has been drawn, so the whole screen is drawn on the next frame
+void Viewport::Invalidate()
+{
+    for (int y = 0; y < VIEW_TILES_Y; y++)
+    {
+        for (int x = 0; x < VIEW_TILES_X; x++)
+        {
+            _drawn[y][x] = VIEW_TILE_UNKNOWN;
+        }
+    }
+
+    _dirtyTiles.Clear();
+    _moved = true;
+}
+
+// Returns true if any part of an object of size TILE_SIZE * TILE_SIZE at the given world position is on the screen
+bool Viewport::IsVisible(Position worldPos)
+{
+    return worldPos.x + TILE_SIZE > position.x && worldPos.x < position.x + (VIEW_TILES_X * TILE_SIZE) && worldPos.y + TILE_SIZE > position.y && worldPos.y < position.y + (VIEW_TILES_Y * TILE_SIZE);
+}
+
+// Converts a world position (in pixels) to a screen position
+Position Viewport::WorldToScreen(Position worldPos)
+{
+    Position screenPos;
+    screenPos.x = worldPos.x - position.x;
+    screenPos.y = worldPos.y - position.y;
+    return screenPos;
+}
+
+// Marks the screen tiles under an object of size TILE_SIZE * TILE_SIZE at the given world position to be drawn again
+void Viewport::MarkDirty(Position worldPos)
+{
+    Position screenPos = WorldToScreen(worldPos);
+
+    // An object that isn't lined up with the tiles covers up to four of them
+    for (int y = screenPos.y; y < screenPos.y + (2 * TILE_SIZE); y += TILE_SIZE)
+    {
+        for (int x = screenPos.x; x < screenPos.x + (2 * TILE_SIZE); x += TILE_SIZE)
+        {
+            if (x < 0 || y < 0 || x >= VIEW_TILES_X * TILE_SIZE || y >= VIEW_TILES_Y * TILE_SIZE)
+            {
+                continue;
+            }
+
+            int tileX = x / TILE_SIZE;
+            int tileY = y / TILE_SIZE;
+
+            _drawn[tileY][tileX] = VIEW_TILE_UNKNOWN;
+            _dirtyTiles.Set((tileY * VIEW_TILES_X) + tileX);
+        }
+    }
+}
+
+// Update function
+// Moves the camera to keep the followed object in view
+void Viewport::Update()
+{
+    if (_target == NULL)
+    {
+        return;
+    }
+
+    int cameraX = position.x / TILE_SIZE;
+    int cameraY = position.y / TILE_SIZE;
+    int targetX = _target->position.x / TILE_SIZE;
+    int targetY = _target->position.y / TILE_SIZE;
+
+    // Only move the camera when the target gets within 'VIEW_SCROLL_MARGIN' tiles of the edge of the screen
+    if (targetX < cameraX + VIEW_SCROLL_MARGIN)
+    {
+        cameraX = targetX - VIEW_SCROLL_MARGIN;
+    }
+    else if (targetX >= cameraX + VIEW_TILES_X - VIEW_SCROLL_MARGIN)
+    {
+        cameraX = targetX - VIEW_TILES_X + VIEW_SCROLL_MARGIN + 1;
+    }
+
+    if (targetY < cameraY + VIEW_SCROLL_MARGIN)
+    {
+        cameraY = targetY - VIEW_SCROLL_MARGIN;
+    }
+    else if (targetY >= cameraY + VIEW_TILES_Y - VIEW_SCROLL_MARGIN)
+    {
+        cameraY = targetY - VIEW_TILES_Y + VIEW_SCROLL_MARGIN + 1;
+    }
+
+    MoveTo(cameraX, cameraY);
+}
+
+// Draw function
+// Draws every screen tile that doesn't already show what it should
+void Viewport::Draw()
+{
+    if (_moved)
+    {
+        // The camera has moved, so check every tile on the screen
+        // Tiles that look the same at the new camera position are left alone
+        for (int y = 0; y < VIEW_TILES_Y; y++)
+        {
+            for (int x = 0; x < VIEW_TILES_X; x++)
+            {
+                RefreshTile(x, y);
+            }
+        }
+
+        _moved = false;
+    }
+    else
+    {
+        // Only the tiles that have been drawn over need checking
+        for (int i = _dirtyTiles.FindNext(0); i != BITSET_NONE; i = _dirtyTiles.FindNext(i + 1))
+        {
+            RefreshTile(i % VIEW_TILES_X, i / VIEW_TILES_X);
+        }
+    }
+
+    _dirtyTiles.Clear();
+}
+
+/* BASE GAME SPRITE H */
+//////////////////////////////////////////////////////////////
+
+// Sprite images (indexes into 'SPRITE_IMAGES')
+// Ghost images come in pairs, with the B image straight after the A image
+#define SPRITE_PLAYER_CLOSED 0
+#define SPRITE_PLAYER_OPEN 1
+#define SPRITE_GHOST_HORIZONTAL_A 2
+#define SPRITE_GHOST_HORIZONTAL_B 3
+#define SPRITE_GHOST_NORTH_A 4
+#define SPRITE_GHOST_NORTH_B 5
+#define SPRITE_GHOST_SOUTH_A 6
+#define SPRITE_GHOST_SOUTH_B 7
+#define SPRITE_COUNT 8
+
+// Simple, monocolour images for every sprite, one row of TILE_SIZE pixels per byte (bit 0 is the leftmost pixel)
+// The table is const, so it is kept in flash and shared by every sprite instead of each one keeping its own copy in RAM
+static const uint8_t SPRITE_IMAGES[SPRITE_COUNT][TILE_SIZE] =
+{
+    { 0x18, 0x3C, 0x7E, 0xFF, 0xFF, 0x7E, 0x3C, 0x18 }, // SPRITE_PLAYER_CLOSED
+    { 0x18, 0x3C, 0x7E, 0xF0, 0xE0, 0x70, 0x3E, 0x18 }, // SPRITE_PLAYER_OPEN
+    { 0x18, 0x3C, 0x7E, 0x6A, 0x6A, 0x7E, 0x7E, 0x2A }, // SPRITE_GHOST_HORIZONTAL_A
+    { 0x18, 0x3C, 0x7E, 0x6A, 0x6A, 0x7E, 0x7E, 0x54 }, // SPRITE_GHOST_HORIZONTAL_B
+    { 0x18, 0x3C, 0x5A, 0x5A, 0x7E, 0x7E, 0x7E, 0x2A }, // SPRITE_GHOST_NORTH_A
+    { 0x18, 0x3C, 0x5A, 0x5A, 0x7E, 0x7E, 0x7E, 0x54 }, // SPRITE_GHOST_NORTH_B
+    { 0x18, 0x3C, 0x5A, 0x5A, 0x7E, 0x7E, 0x7E, 0x2A }, // SPRITE_GHOST_SOUTH_A
+    { 0x18, 0x3C, 0x7E, 0x5A, 0x5A, 0x7E, 0x7E, 0x54 }  // SPRITE_GHOST_SOUTH_B
+};
+
+// This class is designed to be inherited by all sprite based objects used in the game engine
+// Inherits from "BaseGameClass"
+// Has extra functions for handling collisions and drawing basic single colour images from 'SPRITE_IMAGES'
+class BaseGameSprite :
+	public BaseGameClass
+{
+    // The microbenchmarks ('tools/bench.cpp') time the drawing functions on their own
+    friend struct BenchmarkAccess;
+
+// Protected variables/functions are accessible from child classes
+protected:
+    Position _startPosition; // Stores the initial position of the object (used for resetting the position)
+    Viewport* _viewport; // When set, 'position' is a world position and the sprite is drawn relative to the viewport's camera
+
+    // Read-only copy of the sprite's state as it was at the end of the last tick (see 'GetPreviousState')
+    ActorState _previousState;
+
+    // Speed in 8.8 fixed point pixels per tick, and the fraction of a pixel moved towards the next one
+    // Together with 'position' this is the sprite's position in 24.8 fixed point
+    int _speed;
+    int _subPixel;
+
+    // Where the sprite was when it started its last move (set by child classes when they start moving each tick)
+    Position _moveStart;
+
+    // Adds the sprite's speed to its fraction of a pixel, returning the number of whole pixels to move this tick
+    int TakeSteps();
+
+    // Finds the screen position to draw the sprite at
+    // Returns false if the sprite is out of view and shouldn't be drawn
+    bool GetDrawPosition(Position* screenPos);
+
+    // Draws a single pixel, skipping it if it is off the edge of the screen
+    void PlotPixel(int x, int y, uint16_t colour);
+
+    // Sets the object's position to "_startPosition" (with no fraction of a pixel, and not moving)
+    void MoveToStartPosition();
+
+    // Moves the object one pixel in the given direction
+	void UpdatePosition(char direction);
+
+    // Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+    // Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not 
+    void DrawSprite(int sprite, uint16_t colour);
+
+    // Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+    // Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+    // The input image will be flipped horizontally on the display
+    void DrawSpriteFlippedHorizontal(int sprite, uint16_t colour);
+
+    // Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+    // Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+    // The input image will be rotated anti-clockwise 90 degrees on the display
+    void DrawSpriteRotated90(int sprite, uint16_t colour);
+
+    // Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+    // Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+    // The input image will be rotated anti-clockwise 270 degrees on the display
+    void DrawSpriteRotated270(int sprite, uint16_t colour);
+public:
+    // Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
+    // "_startPosition" will be set to (x, y)
+	BaseGameSprite(int x, int y);
+
+    // Checks if this object has collided with the object "sprite" (where "sprite" was at the end of the last tick)
+    // Collision is done using a simple bounding box algorithm, with the box dimensions of TILE_SIZE * TILE_SIZE
+    bool HasCollided(BaseGameSprite *sprite);
+
+    // Draws the sprite through the given viewport (or straight to the screen if NULL)
+    void SetViewport(Viewport* viewport);
+
+    // Sets the sprite's speed in 8.8 fixed point pixels per tick (up to 'MAX_SPEED')
+    void SetSpeed(int speed);
+
+    int GetSpeed();
+
+    // Returns the speeds for the given level from 'SPEED_TABLE'
+    static const SpeedTableEntry* GetSpeeds(int level);
+
+    // Returns the sprite's state as it was at the end of the last tick
+    // Other objects read this rather than 'position' while updating, so what they see doesn't depend on whether the sprite has been updated yet this tick
+    const ActorState* GetPreviousState();
+
+    // Copies the sprite's position into the state returned by 'GetPreviousState'
+    // Child classes with directions should overwrite this to copy those too
+    virtual void PublishState();
+};
+
+/* BASE GAME SPRITE CPP */
+//////////////////////////////////////////////////////////////
+
+// Finds the screen position to draw the sprite at
+// Returns false if the sprite is out of view and shouldn't be drawn
+bool BaseGameSprite::GetDrawPosition(Position* screenPos)
+{
+    if (_viewport == NULL)
+    {
+        *screenPos = position;
+        return true;
+    }
+
+    if (!_viewport->IsVisible(position))
+    {
+        return false;
+    }
+
+    // The tiles underneath need drawing again on the next frame to rub the sprite out
+    _viewport->MarkDirty(position);
+    *screenPos = _viewport->WorldToScreen(position);
+    return true;
+}
+
+// Draws a single pixel, skipping it if it is off the edge of the screen
+void BaseGameSprite::PlotPixel(int x, int y, uint16_t colour)
+{
+    if (x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT)
+    {
+        BSP_LCD_DrawPixel(x, y, colour);
+    }
+}
+
+// Sets the object's position to "_startPosition"
+void BaseGameSprite::MoveToStartPosition()
+{
+    position = _startPosition;
+    _moveStart = position;
+    _subPixel = 0;
+}
+
+// Adds the sprite's speed to its fraction of a pixel, returning the number of whole pixels to move this tick
+int BaseGameSprite::TakeSteps()
+{
+    _subPixel += _speed;
+
+    int steps = _subPixel >> SPEED_SHIFT;
+    _subPixel &= SPEED_ONE - 1;
+
+    return steps;
+}
+
+// Moves the object one pixel in the given direction
+void BaseGameSprite::UpdatePosition(char direction)
+{
+	if (direction == NORTH)
+	{
+		position.y--;
+	}
+	else if (direction == EAST)
+	{
+		position.x++;
+	}
+	else if (direction == SOUTH)
+	{
+		position.y++;
+	}
+	else if (direction == WEST)
+	{
+		position.x--;
+	}
+
+    // Teleport logic here:
+    // This handles the object appearing on the other side of the map when it reaches the left or right edge
+
+    // If the object is on the left of the screen
+    if (position.x == 0)
+    {
+        // Set the position to the right side (taking into account the object's size)
+        position.x = (WIDTH - 1) * TILE_SIZE;
+    }
+    // If the object if on the right of the screen (taking into account the object's size)
+    else if (position.x == (WIDTH - 1) * TILE_SIZE)
+    {
+        // Set the position to the left side
+        position.x = 0;
+    }
+}
+
+// Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+// Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not 
+void BaseGameSprite::DrawSprite(int sprite, uint16_t colour)
+{
+    const uint8_t* spriteImageArray = SPRITE_IMAGES[sprite];
+
+    // Find where to draw the sprite on the screen, skipping it if it is out of view
+    Position screenPos;
+    if (!GetDrawPosition(&screenPos))
+    {
+        return;
+    }
+
+    // Iterate through each pixel of the 'spriteImageArray'
+    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
+    for (int i = 0; i < TILE_SIZE; i++)
+    {
+        for (int j = 0; j < TILE_SIZE; j++)
+        {
+            // Check if a pixel should be drawn at this point (if bit is high)
+            if (((spriteImageArray[j] >> i) & 0x1))
+            {
+                // Draw a pixel on the screen of the given colour 
+                PlotPixel(screenPos.x + i, screenPos.y + j, colour);
+            }
+        }
+    }
+}
+
+// Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+// Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+// The input image will be flipped horizontally on the display
+void BaseGameSprite::DrawSpriteFlippedHorizontal(int sprite, uint16_t colour)
+{
+    const uint8_t* spriteImageArray = SPRITE_IMAGES[sprite];
+
+    // Find where to draw the sprite on the screen, skipping it if it is out of view
+    Position screenPos;
+    if (!GetDrawPosition(&screenPos))
+    {
+        return;
+    }
+
+    // Iterate through each pixel of the 'spriteImageArray'
+    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
+    for (int i = 0; i < TILE_SIZE; i++)
+    {
+        for (int j = 0; j < TILE_SIZE; j++)
+        {
+            // Check if a pixel should be drawn at this point (if bit is high)
+            if (((spriteImageArray[j] >> i) & 0x1))
+            {
+                // Draw a pixel on the screen of the given colour, flipping the x direction
+                PlotPixel(screenPos.x + (TILE_SIZE - 1 - i), screenPos.y + j, colour);
+            }
+        }
+    }
+}
+
+// Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+// Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+// The input image will be rotated anti-clockwise 90 degrees on the display
+void BaseGameSprite::DrawSpriteRotated90(int sprite, uint16_t colour)
+{
+    const uint8_t* spriteImageArray = SPRITE_IMAGES[sprite];
+
+    // Find where to draw the sprite on the screen, skipping it if it is out of view
+    Position screenPos;
+    if (!GetDrawPosition(&screenPos))
+    {
+        return;
+    }
+
+    // Iterate through each pixel of the 'spriteImageArray'
+    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
+    for (int i = 0; i < TILE_SIZE; i++)
+    {
+        for (int j = 0; j < TILE_SIZE; j++)
+        {
+            // Check if a pixel should be drawn at this point (if bit is high)
+            // Pixel being read is rotated here
+            if (((spriteImageArray[i] >> j) & 0x1))
+            {
+                // Draw a pixel on the screen of the given colour
+                PlotPixel(screenPos.x + i, screenPos.y + j, colour);
+            }
+        }
+    }
+}
+
+// Draws the image 'SPRITE_IMAGES[sprite]' in a single colour to the object's current position
+// Array accessed like a 2D array, where each bit of the byte stores whether the pixel should be drawn or not
+// The input image will be rotated anti-clockwise 90 degrees on the display
+void BaseGameSprite::DrawSpriteRotated270(int sprite, uint16_t colour)
+{
+    const uint8_t* spriteImageArray = SPRITE_IMAGES[sprite];
+
+    // Find where to draw the sprite on the screen, skipping it if it is out of view
+    Position screenPos;
+    if (!GetDrawPosition(&screenPos))
+    {
+        return;
+    }
+
+    // Iterate through each pixel of the 'spriteImageArray'
+    // NOTE: This code presumes the 'spriteImageArray' has dimensions of exactly TILE_SIZE * TILE_SIZE
+    for (int i = 0; i < TILE_SIZE; i++)
+    {
+        for (int j = 0; j < TILE_SIZE; j++)
+        {
+            // Check if a pixel should be drawn at this point (if bit is high)
+            // Pixel being read is rotated here
+            if (((spriteImageArray[i] >> (TILE_SIZE - 1 - j)) & 0x1))
+            {
+                // Draw a pixel on the screen of the given colour
+                PlotPixel(screenPos.x + i, screenPos.y + j, colour);
+            }
+        }
+    }
+}
+
+// Constructs the object, setting its position to (x, y) and "Updating" and "Visible" flags to true
+// "_startPosition" will be set to (x, y)
+BaseGameSprite::BaseGameSprite(int x, int y) : BaseGameClass(x, y)
+{
+    _startPosition.x = x;
+    _startPosition.y = y;
+    _viewport = NULL;
+    _speed = SPEED_ONE;
+    _subPixel = 0;
+    _moveStart = position;
+
+    memset(&_previousState, 0, sizeof(_previousState));
+    _previousState.position = position;
+    _previousState.moveStart = position;
+}
+
+// Checks if this object has collided with the object "sprite" (where "sprite" was at the end of the last tick)
+// Collision is done using a simple bounding box algorithm, with the box dimensions of TILE_SIZE * TILE_SIZE
+bool BaseGameSprite::HasCollided(BaseGameSprite *sprite)
+{
+    Position other = sprite->GetPreviousState()->position;
+
+    // Bounding box collision detection logic here
+    return position.x < other.x + TILE_SIZE && position.x + TILE_SIZE > other.x && position.y < other.y + TILE_SIZE && position.y + TILE_SIZE > other.y;
+}
+
+// Draws the sprite through the given viewport (or straight to the screen if NULL)
+void BaseGameSprite::SetViewport(Viewport* viewport)
+{
+    _viewport = viewport;
+}
+
+// Sets the sprite's speed in 8.8 fixed point pixels per tick (up to 'MAX_SPEED')
+void BaseGameSprite::SetSpeed(int speed)
+{
+    _speed = speed > MAX_SPEED ? MAX_SPEED : speed;
+}
+
+int BaseGameSprite::GetSpeed()
+{
+    return _speed;
+}
+
+// Returns the speeds for the given level from 'SPEED_TABLE'
+const SpeedTableEntry* BaseGameSprite::GetSpeeds(int level)
+{
+    if (level < 1)
+    {
+        level = 1;
+    }
+    else if (level > SPEED_LEVELS)
+    {
+        level = SPEED_LEVELS;
+    }
+
+    return &SPEED_TABLE[level - 1];
+}
+
+// Returns the sprite's state as it was at the end of the last tick
+// Other objects read this rather than 'position' while updating, so what they see doesn't depend on whether the sprite has been updated yet this tick
+const ActorState* BaseGameSprite::GetPreviousState()
+{
+    return &_previousState;
+}
+
+// Copies the sprite's position into the state returned by 'GetPreviousState'
+// Child classes with directions should overwrite this to copy those too
+void BaseGameSprite::PublishState()
+{
+    _previousState.position = position;
+    _previousState.moveStart = _moveStart;
+    _previousState.subPixel = (uint8_t)_subPixel;
+}
+
+/* INPUT RECORDER H */
+//////////////////////////////////////////////////////////////
+
+// Most changes of input one recording can hold
+// A tap is two changes (touching then letting go), though a finger dragged across the screen is one every frame it moves
+#define MAX_RECORDED_INPUTS 1024
+
+// Values of 'x' in an 'InputEvent' that isn't a touch
+#define INPUT_RELEASED 0xFFFF // The touchscreen was let go
+#define INPUT_DIRECTION 0xFFFE // The player was steered in the direction in 'y' (0x0 for none), e.g. by an agent through 'Player::SetInput'
+
+// One change of input, kept in 8 bytes so a long session fits in a few KB
+struct InputEvent
+{
+    uint32_t tick; // Frames (or headless ticks) run before the one the change was seen on
+    uint16_t x; // Touch position, or 'INPUT_RELEASED' / 'INPUT_DIRECTION'
+    uint16_t y;
+};
+
+/*
+This class records a session's input as the changes to it, each with the tick it happened on
+Only the first touch is recorded, as it is the only one the game reads
+
+Starting from the same point (e.g. the board being switched on), playing the recording back gives exactly the same game,
+so a bug seen on a kiosk can be reproduced on a workstation from the recording alone (see 'tools/replay.cpp')
+Once it is full, nothing else is recorded and the recording is marked as truncated, as it can only be replayed up to that point
+
+Recordings are printed (and read back by 'tools/replay.cpp') one change a line, '#' starting a comment:
+    512 120 96      - Touched at (120, 96) on tick 512
+    530 -           - Let go on tick 530
+    600 N           - Steered NORTH on tick 600 ('N', 'E', 'S', 'W', or '0' for no direction)
+*/
+class InputRecorder
+{
+private:
+    StaticVector<InputEvent, MAX_RECORDED_INPUTS> _events;
+
+    // Stores the last input recorded (not touched to begin with)
+    InputEvent _last;
+
+    bool _truncated;
+
+    // Adds the input to the recording if it isn't the same as the last input
+    void Record(uint32_t tick, uint16_t x, uint16_t y);
+
+public:
+    InputRecorder();
+
+    // Forgets everything recorded
+    void Clear();
+
+    // Records the state of the touchscreen on 'tick'
+    void RecordTouch(uint32_t tick, const TS_StateTypeDef* state);
+
+    // Records the direction the player is steered in on 'tick'
+    void RecordDirection(uint32_t tick, char direction);
+
+    int GetCount();
+
+    const InputEvent* GetEvents();
+
+    // Returns true if something couldn't be recorded because the recording was full
+    bool IsTruncated();
+
+    // Prints the recording over serial
+    void Print();
+};
+
+/*
+This class plays back a recording made by 'InputRecorder' (stored by the caller) a tick at a time
+Ticks must be asked for in order, starting from the tick the recording was started on
+*/
+class InputReplayer
+{
+private:
+    const InputEvent* _events;
+    int _count;
+
+    // Index of the next event to be reached
+    int _next;
+
+    // Stores the input in effect (not touched to begin with)
+    InputEvent _current;
+
+    // Moves on to the last event at or before 'tick'
+    void Advance(uint32_t tick);
+
+public:
+    // Plays back the 'count' events in 'events'
+    InputReplayer(const InputEvent events[], int count);
+
+    // Goes back to the start of the recording
+    void Rewind();
+
+    // Sets the touchscreen's state for 'tick'
+    void ApplyTouch(uint32_t tick, TS_StateTypeDef* state);
+
+    // Returns the direction the player is steered in on 'tick' (0x0 for none)
+    char GetDirection(uint32_t tick);
+
+    // Returns the tick of the last event
+    uint32_t GetLastTick();
+};
+
+/* INPUT RECORDER CPP */
+//////////////////////////////////////////////////////////////
+
+InputRecorder::InputRecorder()
+{
+    Clear();
+}
+
+// Forgets everything recorded
+void InputRecorder::Clear()
+{
+    _events.Clear();
+    _last.tick = 0;
+    _last.x = INPUT_RELEASED;
+    _last.y = 0;
+    _truncated = false;
+}
+
+// Adds the input to the recording if it isn't the same as the last input
+void InputRecorder::Record(uint32_t tick, uint16_t x, uint16_t y)
+{
+    if (x == _last.x && y == _last.y)
+    {
+        return;
+    }
+
+    InputEvent event;
+    event.tick = tick;
+    event.x = x;
+    event.y = y;
+
+    if (!_events.PushBack(event))
+    {
+        _truncated = true;
+        return;
+    }
+
+    _last = event;
+}
+
+// Records the state of the touchscreen on 'tick'
+void InputRecorder::RecordTouch(uint32_t tick, const TS_StateTypeDef* state)
+{
+    if (state->touchDetected)
+    {
+        Record(tick, state->touchX[0], state->touchY[0]);
+    }
+    else
+    {
+        Record(tick, INPUT_RELEASED, 0);
+    }
+}
+
+// Records the direction the player is steered in on 'tick'
+void InputRecorder::RecordDirection(uint32_t tick, char direction)
+{
+    Record(tick, INPUT_DIRECTION, (uint16_t)direction);
+}
+
+int InputRecorder::GetCount()
+{
+    return _events.GetCount();
+}
+
+const InputEvent* InputRecorder::GetEvents()
+{
+    return _events.GetCount() > 0 ? &_events[0] : NULL;
+}
+
+// Returns true if something couldn't be recorded because the recording was full
+bool InputRecorder::IsTruncated()
+{
+    return _truncated;
+}
+
+// Prints the recording over serial
+void InputRecorder::Print()
+{
+    printf("# Input recording, %d changes%s\n", _events.GetCount(), _truncated ? " (TRUNCATED, the recording was full)" : "");
+
+    for (int i = 0; i < _events.GetCount(); i++)
+    {
+        const InputEvent& event = _events[i];
+
+        if (event.x == INPUT_RELEASED)
+        {
+            printf("%lu -\n", (unsigned long)event.tick);
+        }
+        else if (event.x == INPUT_DIRECTION)
+        {
+            char name = event.y == NORTH ? 'N' : event.y == EAST ? 'E' : event.y == SOUTH ? 'S' : event.y == WEST ? 'W' : '0';
+            printf("%lu %c\n", (unsigned long)event.tick, name);
+        }
+        else
+        {
+            printf("%lu %u %u\n", (unsigned long)event.tick, event.x, event.y);
+        }
+    }
+
+    printf("# End of input recording\n");
+}
+
+// Plays back the 'count' events in 'events'
+InputReplayer::InputReplayer(const InputEvent events[], int count)
+{
+    _events = events;
+    _count = count;
+    Rewind();
+}
+
+// Goes back to the start of the recording
+void InputReplayer::Rewind()
+{
+    _next = 0;
+    _current.tick = 0;
+    _current.x = INPUT_RELEASED;
+    _current.y = 0;
+}
+
+// Moves on to the last event at or before 'tick'
+void InputReplayer::Advance(uint32_t tick)
+{
+    while (_next < _count && _events[_next].tick <= tick)
+    {
+        _current = _events[_next];
+        _next++;
+    }
+}
+
+// Sets the touchscreen's state for 'tick'
+void InputReplayer::ApplyTouch(uint32_t tick, TS_StateTypeDef* state)
+{
+    Advance(tick);
+
+    if (_current.x == INPUT_RELEASED || _current.x == INPUT_DIRECTION)
+    {
+        state->touchDetected = 0;
+        return;
+    }
+
+    state->touchDetected = 1;
+    state->touchX[0] = _current.x;
+    state->touchY[0] = _current.y;
+}
+
+// Returns the direction the player is steered in on 'tick' (0x0 for none)
+char InputReplayer::GetDirection(uint32_t tick)
+{
+    Advance(tick);
+    return _current.x == INPUT_DIRECTION ? (char)_current.y : 0x0;
+}
+
+// Returns the tick of the last event
+uint32_t InputReplayer::GetLastTick()
+{
+    return _count > 0 ? _events[_count - 1].tick : 0;
+}
+
+/* GAME ENGINE H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class is designed to run the the game
+It has a master array containing all objects in the game as well as the game's main loop
+
+The game loop performs the following:
+    1 - Initialises all game objects        (Calls Init() for all objects in the master array)
+    2 - Updates game objects                (Calls Update(), PublishState() then LateUpdate() for all objects in the master array)
+    3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
+    4 - Return to step 2
+
+Object state is double buffered: while updating, objects only read each other's state from the end of the last tick ('GetPreviousState')
+and only write their own, which is published once every object has been updated
+So the order objects are added in doesn't change how the game plays, and objects could be updated in any order (or at the same time)
+Objects that need the state at the end of this tick (e.g. 'CollisionSystem') use 'LateUpdate', which is run once everything has been published
+
+*/
+class GameEngine
+{
+private:
+
+    // This is the master array which stores all of the game's objects
+    // NOTE: Adding more than 'MAX_GAME_OBJECTS' objects stops the program, so make sure it is big enough for every object in the game
+	StaticVector<BaseGameClass*, MAX_GAME_OBJECTS, CONTAINER_HALT> _GameObjects;
+
+    // Stores the state of the game, shared by every object added to the engine
+    GameContext _context;
+
+    // Frames run since the engine was constructed
+    uint32_t _frame;
+
+    // When set, the touchscreen's state is recorded every frame
+    InputRecorder* _recorder;
+
+    // When false, 'RunFrame' skips drawing (e.g. to replay a session as fast as possible)
+    bool _drawEnabled;
+
+    // Calls the 'Update()' function of all objects stored in '_GameObjects', then their 'PublishState()' function, then their 'LateUpdate()' function
+    // Objects with the 'Updating' flag set to false will be skipped
+	void Update();
+
+    // Calls the 'Draw()' function of all objects stored in '_GameObjects'
+    // Objects with the 'Visible' flag set to false will be skipped
+	void Draw();
+
+    // Changes the game's state to the next game state and counts the frame
+    void EndFrame();
+
+public:
+
+    // Constructs a new 'GameEngine' object with no game objects
+	GameEngine();
+
+    // Adds the given game object to the master array
+    // Points the object's 'context' at the engine's game state
+	void AddGameObject(BaseGameClass* gameObject);
+
+    // Returns the state of the game run by the engine
+    GameContext* GetContext();
+
+    // Calls the 'Init()' function of all objects stored in '_GameObjects'
+	void Init();
+
+    // Runs one frame of the game with the touchscreen state already stored in the context
+    // Updates then draws every object and moves on to the next game state, counting the frame's heap allocations (see 'HeapGuard')
+    void RunFrame();
+
+    // Runs one frame of the game without drawing, recording input or counting heap allocations
+    // 'HeapGuard' is shared by every engine, so this is what headless games (e.g. 'PacmanEnv') run so they can be stepped on several threads at once
+    void RunHeadlessFrame();
+
+    // Returns the number of frames run so far (the tick input is recorded against)
+    uint32_t GetFrame();
+
+    // Records the touchscreen's state on every frame into 'recorder' (NULL to stop)
+    // The recording is printed over serial whenever the game is over, so a session can be replayed from the log
+    void SetInputRecorder(InputRecorder* recorder);
+
+    // Turns drawing on or off
+    // Nothing drawn is read back by the game, so a session plays out the same either way
+    void SetDrawEnabled(bool enabled);
+
+    // Main game loop function
+    // The game loop performs the following:
+    //     1 - Initialises all game objects        (Calls Init() for all objects in the master array)
+    //     2 - Updates game objects                (Calls Update(), PublishState() then LateUpdate() for all objects in the master array)
+    //     3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
+    //     4 - Return to step 2
+	void MainGameLoop();
+};
+
+/* GAME ENGINE CPP */
+//////////////////////////////////////////////////////////////
+
+// Calls the 'Init()' function of all objects stored in '_GameObjects'
+void GameEngine::Init()
+{
+	for (int i = 0; i < _GameObjects.GetCount(); i++)
+	{
+		_GameObjects[i]->Init();
+	}
+}
+
+// Calls the 'Update()' function of all objects stored in '_GameObjects', then their 'PublishState()' function, then their 'LateUpdate()' function
+// Objects with the 'Updating' flag set to false will be skipped
+void GameEngine::Update()
+{
+	for (int i = 0; i < _GameObjects.GetCount(); i++)
+	{
+		if (_GameObjects[i]->Updating)
+		{
+			_GameObjects[i]->Update();
+		}
+	}
+
+    // Only once everything has been updated, so every object saw the same state from the last tick
+    for (int i = 0; i < _GameObjects.GetCount(); i++)
+    {
+        if (_GameObjects[i]->Updating)
+        {
+            _GameObjects[i]->PublishState();
+        }
+    }
+
+    // Only once everything has been published, so every object sees the same state from this tick
+    for (int i = 0; i < _GameObjects.GetCount(); i++)
+    {
+        if (_GameObjects[i]->Updating)
+        {
+            _GameObjects[i]->LateUpdate();
+        }
+    }
+}
+
+// Calls the 'Draw()' function of all objects stored in '_GameObjects'
+// Objects with the 'Visible' flag set to false will be skipped
+void GameEngine::Draw()
+{
+	for (int i = 0; i < _GameObjects.GetCount(); i++)
+	{
+		if (_GameObjects[i]->Visible)
+		{
+			_GameObjects[i]->Draw();
+		}
+	}
+}
+
+// Changes the game's state to the next game state and counts the frame
+void GameEngine::EndFrame()
+{
+    _context.curGameState = _context.nextGameState;
+    _frame++;
+}
+
+// Constructs a new 'GameEngine' object with no game objects
+GameEngine::GameEngine()
+{
+    memset(&_context, 0, sizeof(_context));
+    _context.curGameState = SPLASH_SCREEN;
+    _context.nextGameState = SPLASH_SCREEN;
+    _context.logEnabled = true;
+    _frame = 0;
+    _recorder = NULL;
+    _drawEnabled = true;
+}
+
+// Adds the given game object to the master array
+// Points the object's 'context' at the engine's game state
+void GameEngine::AddGameObject(BaseGameClass* gameObject)
+{
+	_GameObjects.PushBack(gameObject);
+    gameObject->context = &_context;
+}
+
+// Returns the state of the game run by the engine
+GameContext* GameEngine::GetContext()
+{
+    return &_context;
+}
+
+// Runs one frame of the game with the touchscreen state already stored in the context
+// Updates then draws every object and moves on to the next game state, counting the frame's heap allocations (see 'HeapGuard')
+void GameEngine::RunFrame()
+{
+    HeapGuard::BeginFrame();
+
+    if (_recorder != NULL)
+    {
+        _recorder->RecordTouch(_frame, &_context.tsState);
+    }
+
+    // Update game logic for all objects
+    Update();
+
+    // Draw all game objects to the screen
+    if (_drawEnabled)
+    {
+        Draw();
+    }
+
+    // Print the recording at the end of each game, so the log has everything up to that point
+    if (_recorder != NULL && _context.logEnabled && _context.nextGameState == GAME_OVER && _context.curGameState != GAME_OVER)
+    {
+        _recorder->Print();
+    }
+
+    // Change the game's state to the next game state
+    EndFrame();
+
+    HeapGuard::EndFrame();
+}
+
+// Runs one frame of the game without drawing, recording input or counting heap allocations
+// 'HeapGuard' is shared by every engine, so this is what headless games (e.g. 'PacmanEnv') run so they can be stepped on several threads at once
+void GameEngine::RunHeadlessFrame()
+{
+    Update();
+    EndFrame();
+}
+
+// Returns the number of frames run so far (the tick input is recorded against)
+uint32_t GameEngine::GetFrame()
+{
+    return _frame;
+}
+
+// Records the touchscreen's state on every frame into 'recorder' (NULL to stop)
+// The recording is printed over serial whenever the game is over, so a session can be replayed from the log
+void GameEngine::SetInputRecorder(InputRecorder* recorder)
+{
+    _recorder = recorder;
+}
+
+// Turns drawing on or off
+// Nothing drawn is read back by the game, so a session plays out the same either way
+void GameEngine::SetDrawEnabled(bool enabled)
+{
+    _drawEnabled = enabled;
+}
+
+// Main game loop function
+// The game loop performs the following:
+//     1 - Initialises all game objects        (Calls Init() for all objects in the master array)
+//     2 - Updates game objects                (Calls Update(), PublishState() then LateUpdate() for all objects in the master array)
+//     3 - Draws game objects to the screen    (Calls Draw() for all objects in the master array)
+//     4 - Return to step 2
+void GameEngine::MainGameLoop()
+{
+    // Initialise all objects
+	Init();
+
+    // Everything is set up, so nothing should be allocated from here on
+    HeapGuard::Lock();
+
+	while (true)
+	{
+        // Read the state of the touch screen and store it in the game's context
+        BSP_TS_GetState(&_context.tsState);
+
+        RunFrame();
+
+        // Wait a small amount of time
+        wait_ms(10);
+	}
+}
+
+/* BITBOARD SEARCH H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class searches the maze using bitboards ('HEIGHT' ints, one bit per tile, the same format as the '_maze' and '_pellets' arrays in 'Maze')
+
+Instead of taking tiles out of a queue one at a time, every tile in the frontier is expanded at once:
+    - Shifting a row left and right moves every tile one step west and east (wrapping around through the tunnel)
+    - The rows above and below move every tile one step north and south
+    - ANDing with the floor removes any steps into walls
+
+One step of the search costs a handful of operations per row no matter how many tiles are in the frontier
+*/
+class BitboardSearch
+{
+public:
+    // Moves every tile in 'frontier' one step in every direction, keeping the tiles it started on
+    // The result is masked with 'floor' and stored in 'next' (which must not be the same array as 'frontier')
+    // Returns true if any new tiles were reached
+    static bool Step(const int floor[], const int frontier[], int next[]);
+
+    // Stores every tile reachable from the tiles in 'start' in 'reached'
+    // Returns the number of steps taken to reach the furthest tile
+    static int FloodFill(const int floor[], const int start[], int reached[]);
+
+    // Stores every tile reachable within 'steps' steps of the tiles in 'start' in 'reached'
+    static void ReachableWithin(const int floor[], const int start[], int steps, int reached[]);
+
+    // Returns true if every floor tile can reach every other floor tile
+    static bool IsConnected(const int floor[]);
+
+    // Returns true if every tile in 'targets' can be reached from the tiles in 'start'
+    static bool AllReachable(const int floor[], const int start[], const int targets[]);
+
+    // Returns the number of tiles set in the bitboard
+    static int CountTiles(const int board[]);
+};
+
+/* BITBOARD SEARCH CPP */
+//////////////////////////////////////////////////////////////
+
+// Moves every tile in 'frontier' one step in every direction, keeping the tiles it started on
+// The result is masked with 'floor' and stored in 'next' (which must not be the same array as 'frontier')
+// Returns true if any new tiles were reached
+bool BitboardSearch::Step(const int floor[], const int frontier[], int next[])
+{
+    const uint32_t rowMask = (0x1u << WIDTH) - 1;
+    uint32_t changed = 0x0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        uint32_t row = frontier[y];
+
+        // East and west, wrapping around the edges through the tunnel
+        uint32_t east = (row >> 1) | ((row & 0x1) << (WIDTH - 1));
+        uint32_t west = ((row << 1) | (row >> (WIDTH - 1))) & rowMask;
+
+        uint32_t expanded = row | east | west;
+
+        // North and south
+        if (y > 0)
+        {
+            expanded |= frontier[y - 1];
+        }
+        if (y < HEIGHT - 1)
+        {
+            expanded |= frontier[y + 1];
+        }
+
+        expanded &= floor[y];
+        changed |= expanded ^ row;
+        next[y] = expanded;
+    }
+
+    return changed != 0x0;
+}
+
+// Stores every tile reachable from the tiles in 'start' in 'reached'
+// Returns the number of steps taken to reach the furthest tile
+int BitboardSearch::FloodFill(const int floor[], const int start[], int reached[])
+{
+    int buffer[HEIGHT];
+    int steps = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        reached[y] = start[y] & floor[y];
+    }
+
+    // Step back and forth between the two arrays until nothing new is reached
+    while (true)
+    {
+        if (!Step(floor, reached, buffer))
+        {
+            return steps;
+        }
+        steps++;
+
+        if (!Step(floor, buffer, reached))
+        {
+            return steps;
+        }
+        steps++;
+    }
+}
+
+// Stores every tile reachable within 'steps' steps of the tiles in 'start' in 'reached'
+void BitboardSearch::ReachableWithin(const int floor[], const int start[], int steps, int reached[])
+{
+    int buffer[HEIGHT];
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        reached[y] = start[y] & floor[y];
+    }
+
+    for (int i = 0; i < steps; i++)
+    {
+        bool changed = Step(floor, reached, buffer);
+        memcpy(reached, buffer, sizeof(buffer));
+
+        // Stop early once everything reachable has been found
+        if (!changed)
+        {
+            return;
+        }
+    }
+}
+
+// Returns true if every floor tile can reach every other floor tile
+bool BitboardSearch::IsConnected(const int floor[])
+{
+    int start[HEIGHT];
+    int reached[HEIGHT];
+    bool found = false;
+
+    // Start from the lowest bit of the first row with any floor in it
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        start[y] = found ? 0x0 : floor[y] & -floor[y];
+        found |= floor[y] != 0x0;
+    }
+
+    FloodFill(floor, start, reached);
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        if (reached[y] != floor[y])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if every tile in 'targets' can be reached from the tiles in 'start'
+bool BitboardSearch::AllReachable(const int floor[], const int start[], const int targets[])
+{
+    int reached[HEIGHT];
+    FloodFill(floor, start, reached);
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        if ((targets[y] & ~reached[y]) != 0x0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the number of tiles set in the bitboard
+int BitboardSearch::CountTiles(const int board[])
+{
+    int count = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        // Clear the lowest set bit until none are left
+        for (uint32_t row = board[y]; row != 0x0; row &= row - 1)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* MAZE LISTENER H */
+//////////////////////////////////////////////////////////////
+
+// Interface for objects that need to know when the pellets in a maze change
+// Listeners are registered with 'Maze::AddListener()' and are called straight after the maze has been changed
+class MazeListener
+{
+public:
+    // Listeners made on the host (e.g. by 'tools/batch_runner.cpp') can be deleted through this interface
+    virtual ~MazeListener() {}
+
+    // Called after the pellet at the tile position (x, y) has been removed
+    virtual void OnPelletRemoved(int x, int y) = 0;
+
+    // Called after every pellet in the maze has been put back (e.g. at the start of a level)
+    virtual void OnPelletsReset() = 0;
+
+    // Called after a new layout of walls and pellets has been loaded into the maze
+    virtual void OnMazeLoaded() = 0;
+};
+
+/* MAZE H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class is used to store the maze tilemap used in the game
+
+The tilemap is simple with only two state; either a tile being a 'FLOOR' or a 'WALL'
+Due to only needing two states for each given tile, the 2D maze can be stored in a 1D array of 32 bit ints, where each bit of the int stores whether the given tile is a 'FLOOR' or 'WALL'
+*/
+class Maze :
+	public BaseGameClass
+{
+    // The microbenchmarks ('tools/bench.cpp') time 'DrawTile' and the full redraw on their own
+    friend struct BenchmarkAccess;
+
+private:
+
+    // Flag used to store whether the entire map should be redrawn when 'Draw()' is called
+    // NOTE: The MBED simulator LCD is quite slow at redrawing the entire screen so minimising the amount of pixels being set massively improves performance  
+    bool _initialDraw;
+
+    // Used like a 2D array to store the maze. Each bit of the int stores whether the tile is a floor or a wall
+    // NOTE: Due to x position being stored in a 32 bit int, the width of the maze cannot be greater than 32 tiles
+    // NOTE: To reduce ram usage, this could be stored as a const, however, leaving it like this allows for the possibility of different mazes being used
+    int _maze[HEIGHT];
+
+    // Used like a 2D array to store if there is a pellet on a given square
+    // NOTE: Due to x position being stored in a 32 bit int, the width of the maze cannot be greater than 32 tiles
+    // NOTE: To reduce ram usage, this could be stored as a const, however, leaving it like this allows for the possibility of different mazes being used
+    int _pellets[HEIGHT]; 
+
+    // Used like a 2D array to store the pellets at the start of each level
+    int _levelPellets[HEIGHT];
+
+    // Used like a 2D array to store which directions lead to a floor tile from each tile (NORTH | EAST | SOUTH | WEST)
+    // Worked out once when the maze is loaded, so actors don't have to check each direction every time they decide where to go
+    char _exits[HEIGHT][WIDTH];
+
+    // Objects to be told whenever the pellets in the maze change
+    StaticVector<MazeListener*, MAX_MAZE_LISTENERS, CONTAINER_HALT> _listeners;
+
+    // When false, 'MarkForRedraw' does nothing (e.g. when the maze is never drawn)
+    bool _redrawEnabled;
+
+    // Sets the maze tile at (x, y) to be a floor tile 
+    void SetFloor(int x, int y);
+
+    // Sets the maze tile at (x, y) to be a wall tile 
+    void SetWall(int x, int y);
+
+    // Sets the maze to be similar to the classic Pacman maze
+    // NOTE: Map is slightly shrunk to fit on the LCD screen
+    void SetClassicMaze();
+
+    // Sets the pellets on the classic maze
+    void SetPelletsClassicMaze();
+
+    // Fills the maze with the pellets from the start of the level and tells every listener that the pellets have been reset
+    void ResetPellets();
+
+    // Works out '_exits' for every tile
+    void FindExits();
+
+    // Draws the maze tile at (x, y) onto the LCD
+    void DrawTile(int x, int y);
+
+    // Get the current number of pellets left in the maze
+    int GetPelletCount();
+public:
+    // Queue used to store positions to be redrawn
+    // This is used help reduce the number of pixels being drawn to the LCD at a given time
+    // When the Player/Enemy changes its position, it adds its position to this queue
+    // Each position in this queue, as well as some neighbouring tiles are redrawn, preventing the Player/Enemy image from smearing
+    // If the queue fills up, it is emptied and the whole maze is redrawn on the next frame instead
+    RingBuffer<Position, MAX_REDRAW_POSITIONS> redrawQueue;
+
+    // Stores the maximum amount of pellets in the maze
+    int maxPellets;
+
+    // Adds the screen position to 'redrawQueue' so it gets drawn again on the next frame
+    void MarkForRedraw(Position screenPos);
+
+    // Turns 'MarkForRedraw' on or off
+    // Headless games should turn it off, as nothing ever draws the queue
+    void SetRedrawEnabled(bool enabled);
+
+    // Copies the maze into 'maze' ('HEIGHT' ints in the same format as '_maze')
+    void CopyFloor(int32_t maze[]);
+
+    // Copies the pellets into 'pellets' ('HEIGHT' ints in the same format as '_pellets')
+    void CopyPellets(int32_t pellets[]);
+
+    // Stores the pellets in 'state'
+    void SaveState(GameState* state);
+
+    // Puts the pellets back from 'state' and tells every listener that the pellets have been reset
+    void LoadState(const GameState* state);
+
+    // Constructs a new maze objects
+    // '_initialDraw' is set to true, 'SetClassicMaze()' and 'SetPelletsClassicMaze()' are called to initialise the map
+    // The classic layout is loaded through 'LoadMaze' so it gets the same checks as any other layout
+	Maze();
+
+    // Replaces the walls and pellets of the maze with the given layout (e.g. one from 'MazeGenerator')
+    // Both arrays are stored in the same format as '_maze' and '_pellets', with 'HEIGHT' rows
+    // Returns false (leaving the maze as it was) if the floor isn't fully connected or a pellet can't be reached from the player start
+    bool LoadMaze(const int maze[], const int pellets[]);
+
+    // Returns true if every pellet left in the maze can be reached from the tile (x, y)
+    bool ArePelletsReachable(int x, int y);
+
+    // Stores every tile that can be reached within 'steps' steps of the tile (x, y) in the bitboard 'reached'
+    void GetReachableWithin(int x, int y, int steps, int reached[]);
+
+    // Adds the given listener to be told whenever the pellets in the maze change
+    // NOTE: Adding more than 'MAX_MAZE_LISTENERS' listeners stops the program
+    void AddListener(MazeListener* listener);
+
+    // Returns true if the given coordinate (x, y) is within the bounds of the map
+    bool IsInBounds(int x, int y);
+
+    // Returns true in the given tile coordinate (x, y) is a floor tile
+    // If (x, y) is out of bounds, this returns false
+	bool IsFloor(int x, int y);
+
+    // Returns true if the tile in the given direction from the given coordinate (x, y) is a tile
+    // (e.g. if 'IsFloorAdjacent(10, 14, EAST)' was called, the tile at (11, 14) would be checked)
+	bool IsFloorAdjacent(int x, int y, char direction);
+
+    // Returns true if the tile in the given direction from the given coordinate (position.x, position.y) is a tile
+	bool IsFloorAdjacent(Position position, char direction);
+
+    // Returns the tile position one tile in the given direction from the tile position (x, y)
+    // Moving off the left or right edge of the maze wraps around to the other side, the same as the tunnel teleport
+    Position GetAdjacentTilePos(int x, int y, char direction);
+
+    // Returns the directions that lead to a floor tile from the tile (x, y) (NORTH | EAST | SOUTH | WEST)
+    // Matches 'IsFloorAdjacent', so the tunnel isn't counted
+    char GetExits(int x, int y);
+
+    // Returns the floor tile closest to the tile (x, y), moving it inside the maze first if needed
+    // Returns (x, y) unchanged if there are no floor tiles
+    Position GetNearestFloorTile(int x, int y);
+
+    // Checks if the screen position one pixel in the given direction is a floor tile
+    // Does a simple check to make sure that the entire object of size TILE_SIZE * TILE_SIZE could move into the position
+    bool IsFloorAdjacentScreenPos(Position screenPos, char direction);
+
+    // Returns true if the tile position (x, y) contains a pellet
+    bool IsPellet(int x, int y);
+
+    // Removes the pellet at the tile position (x, y)
+    // If there is a pellet at the given position, returns true
+    // If there is no pellet at the given position, returns false
+    bool TryRemovePellet(int x, int y);
+
+    // Converts the given screen position into a tile position
+    // Once the tile position is acquired, 'TryRemovePellet' at the tile position is called
+    bool TryRemovePelletScreenPos(Position screenPos);
+
+    // Converts the given screen position (x, y) to a position on the tilemap
+    // Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
+    Position ScreenPosToTilePos(int x, int y);
+
+    // Converts the given screen position (screenPos) to a position on the tilemap
+    // Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
+    Position ScreenPosToTilePos(Position screenPos);
+
+    // Update function
+    // State:
+    //      STARTUP: Make the maze visible + set '_initialDraw' to true + add the pellets to the maze
+    //      CONTINUE: Set '_initalDraw' to true
+    //      NEXT_LEVEL: Same as 'STARTUP' state
+    //      PLAY: Do nothing
+    //      DEAD: Do nothing
+    //      default: Set the maze to be invisible
+    void Update();
+
+    // Draw function
+    // When '_initialDraw' is true, all tiles within the maze are draw
+    // When 'initialDraw' is false, only positions in 'redrawQueue' are drawn
+	void Draw();
+};
+
+/* MAZE CPP */
+//////////////////////////////////////////////////////////////
+// Sets the maze tile at (x, y) to be a floor tile 
+void Maze::SetFloor(int x, int y)
+{
+	_maze[y] |= 0x1 << x; // Set the x'th bit
+}
+
+// Sets the maze tile at (x, y) to be a wall tile 
+void Maze::SetWall(int x, int y)
+{
+	_maze[y] &= ~(0x1 << x); // Clear the x'th bit
+}
+
+// Sets the maze to be similar to the classic Pacman maze
+// NOTE: Map is slightly shrunk to fit on the LCD screen
+void Maze::SetClassicMaze()
+{
+    _maze[0] = 0x0;
+    _maze[1] = 0x0;
+    _maze[2] = 0x7FF9FFE;
+    _maze[3] = 0x4209042;
+    _maze[4] = 0x4209042;
+    _maze[5] = 0x4209042;
+    _maze[6] = 0x7FFFFFE;
+    _maze[7] = 0x4240242;
+    _maze[8] = 0x4240242;
+    _maze[9] = 0x7E79E7E;
+    _maze[10] = 0x0209040;
+    _maze[11] = 0x0209040;
+    _maze[12] = 0x027FE40;
+    _maze[13] = 0x0240240;
+    _maze[14] = 0xFFC03FF;
+    _maze[15] = 0x0240240;
+    _maze[16] = 0x027FE40;
+    _maze[17] = 0x0240240;
+    _maze[18] = 0x0240240;
+    _maze[19] = 0x7FF9FFE;
+    _maze[20] = 0x4209042;
+    _maze[21] = 0x4209042;
+    _maze[22] = 0x73FFFCE;
+    _maze[23] = 0x1240248;
+    _maze[24] = 0x1240248;
+    _maze[25] = 0x7E79E7E;
+    _maze[26] = 0x4009002;
+    _maze[27] = 0x4009002;
+    _maze[28] = 0x7FFFFFE;
+    _maze[29] = 0x0;
+}
+
+// Sets the pellets on the classic maze
+void Maze::SetPelletsClassicMaze()
+{
+    _pellets[0] = 0x0;
+    _pellets[1] = 0x0;
+    _pellets[2] = 0x7FF9FFE;
+    _pellets[3] = 0x4209042;
+    _pellets[4] = 0x4209042;
+    _pellets[5] = 0x4209042;
+    _pellets[6] = 0x7FFFFFE;
+    _pellets[7] = 0x4240242;
+    _pellets[8] = 0x4240242;
+    _pellets[9] = 0x7E79E7E;
+    _pellets[10] = 0x0200040;
+    _pellets[11] = 0x0200040;
+    _pellets[12] = 0x0200040;
+    _pellets[13] = 0x0200040;
+    _pellets[14] = 0x0200040;
+    _pellets[15] = 0x0200040;
+    _pellets[16] = 0x0200040;
+    _pellets[17] = 0x0200040;
+    _pellets[18] = 0x0200040;
+    _pellets[19] = 0x7FF9FFE;
+    _pellets[20] = 0x4209042;
+    _pellets[21] = 0x4209042;
+    _pellets[22] = 0x73FDFCE;
+    _pellets[23] = 0x1240248;
+    _pellets[24] = 0x1240248;
+    _pellets[25] = 0x7E79E7E;
+    _pellets[26] = 0x4009002;
+    _pellets[27] = 0x4009002;
+    _pellets[28] = 0x7FFFFFE;
+    _pellets[29] = 0x0;
+}
+
+// Fills the maze with the pellets from the start of the level and tells every listener that the pellets have been reset
+void Maze::ResetPellets()
+{
+    for (int i = 0; i < HEIGHT; i++)
+    {
+        _pellets[i] = _levelPellets[i];
+    }
+
+    for (int i = 0; i < _listeners.GetCount(); i++)
+    {
+        _listeners[i]->OnPelletsReset();
+    }
+}
+
+// Works out '_exits' for every tile
+void Maze::FindExits()
+{
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            _exits[y][x] = 0x0;
+
+            for (char direction = NORTH; direction <= WEST; direction <<= 1)
+            {
+                if (IsFloorAdjacent(x, y, direction))
+                {
+                    _exits[y][x] |= direction;
+                }
+            }
+        }
+    }
+}
+
+// Adds the screen position to 'redrawQueue' so it gets drawn again on the next frame
+void Maze::MarkForRedraw(Position screenPos)
+{
+    if (_redrawEnabled && !redrawQueue.Push(screenPos))
+    {
+        // Too many to redraw one at a time, so redraw everything instead
+        redrawQueue.Clear();
+        _initialDraw = true;
+    }
+}
+
+// Turns 'MarkForRedraw' on or off
+// Headless games should turn it off, as nothing ever draws the queue
+void Maze::SetRedrawEnabled(bool enabled)
+{
+    _redrawEnabled = enabled;
+
+    if (!_redrawEnabled)
+    {
+        redrawQueue.Clear();
+    }
+}
+
+// Copies the maze into 'maze' ('HEIGHT' ints in the same format as '_maze')
+void Maze::CopyFloor(int32_t maze[])
+{
+    memcpy(maze, _maze, sizeof(_maze));
+}
+
+// Copies the pellets into 'pellets' ('HEIGHT' ints in the same format as '_pellets')
+void Maze::CopyPellets(int32_t pellets[])
+{
+    memcpy(pellets, _pellets, sizeof(_pellets));
+}
+
+// Stores the pellets in 'state'
+void Maze::SaveState(GameState* state)
+{
+    memcpy(state->pellets, _pellets, sizeof(_pellets));
+}
+
+// Puts the pellets back from 'state' and tells every listener that the pellets have been reset
+void Maze::LoadState(const GameState* state)
+{
+    memcpy(_pellets, state->pellets, sizeof(_pellets));
+
+    for (int i = 0; i < _listeners.GetCount(); i++)
+    {
+        _listeners[i]->OnPelletsReset();
+    }
+}
+
+// Get the current number of pellets left in the maze
+int Maze::GetPelletCount()
+{
+    int count = 0;
+
+    // Iterate through the map
+    for (int i = 0; i < WIDTH; i++)
+    {
+        for (int j = 0; j < HEIGHT; j++)
+        {
+            // If there is a pellet at the given position, increment count
+            count += IsPellet(i, j);
+        }
+    }
+
+    return count;
+}
+
+// Constructs a new maze objects
+// '_initialDraw' is set to true, 'SetClassicMaze()' and 'SetPelletsClassicMaze()' are called to initialise the map
+// The classic layout is loaded through 'LoadMaze' so it gets the same checks as any other layout
+Maze::Maze() : BaseGameClass(0, 0)
+{
+    _initialDraw = true;
+    _redrawEnabled = true;
+	SetClassicMaze();
+    SetPelletsClassicMaze();
+
+    if (!LoadMaze(_maze, _pellets))
+    {
+        error("The classic maze isn't connected or has pellets that can't be reached\n");
+    }
+}
+
+// Replaces the walls and pellets of the maze with the given layout (e.g. one from 'MazeGenerator')
+// Both arrays are stored in the same format as '_maze' and '_pellets', with 'HEIGHT' rows
+// Returns false (leaving the maze as it was) if the floor isn't fully connected or a pellet can't be reached from the player start
+bool Maze::LoadMaze(const int maze[], const int pellets[])
+{
+    int start[HEIGHT] = { 0 };
+    start[PLAYER_START_Y] = 0x1 << PLAYER_START_X;
+
+    if (!BitboardSearch::IsConnected(maze) || !BitboardSearch::AllReachable(maze, start, pellets))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < HEIGHT; i++)
+    {
+        _maze[i] = maze[i];
+        _pellets[i] = pellets[i];
+        _levelPellets[i] = pellets[i];
+    }
+
+    FindExits();
+    maxPellets = GetPelletCount();
+    _initialDraw = true;
+
+    for (int i = 0; i < _listeners.GetCount(); i++)
+    {
+        _listeners[i]->OnMazeLoaded();
+    }
+
+    return true;
+}
+
+// Returns true if every pellet left in the maze can be reached from the tile (x, y)
+bool Maze::ArePelletsReachable(int x, int y)
+{
+    int start[HEIGHT] = { 0 };
+
+    if (IsInBounds(x, y))
+    {
+        start[y] = 0x1 << x;
+    }
+
+    return BitboardSearch::AllReachable(_maze, start, _pellets);
+}
+
+// Stores every tile that can be reached within 'steps' steps of the tile (x, y) in the bitboard 'reached'
+void Maze::GetReachableWithin(int x, int y, int steps, int reached[])
+{
+    int start[HEIGHT] = { 0 };
+
+    if (IsInBounds(x, y))
+    {
+        start[y] = 0x1 << x;
+    }
+
+    BitboardSearch::ReachableWithin(_maze, start, steps, reached);
+}
+
+// Adds the given listener to be told whenever the pellets in the maze change
+// NOTE: Adding more than 'MAX_MAZE_LISTENERS' listeners stops the program
+void Maze::AddListener(MazeListener* listener)
+{
+    _listeners.PushBack(listener);
+}
+
+// Returns true if the given coordinate (x, y) is within the bounds of the map
+bool Maze::IsInBounds(int x, int y)
+{
+    return x > -1 && x < WIDTH && y > -1 && y < HEIGHT;
+}
+
+// Returns true in the given tile coordinate (x, y) is a floor tile
+// If (x, y) is out of bounds, this returns false
+bool Maze::IsFloor(int x, int y)
+{
+	return IsInBounds(x, y) && ((_maze[y] >> x) & 0x1);
+}
+
+// Returns true if the tile in the given direction from the given coordinate (x, y) is a tile
+// (e.g. if 'IsFloorAdjacent(10, 14, EAST)' was called, the tile at (11, 14) would be checked)
+bool Maze::IsFloorAdjacent(int x, int y, char direction)
+{
+	if (direction == NORTH && y > 0)
+	{
+		return IsFloor(x, y - 1);
+	}
+	else if (direction == EAST && x < WIDTH - 1)
+	{
+		return IsFloor(x + 1, y);
+	}
+	else if (direction == SOUTH && y < HEIGHT - 1)
+	{
+		return IsFloor(x, y + 1);
+	}
+	else if (direction == WEST && x > 0)
+	{
+		return IsFloor(x - 1, y);
+	}
+	else
+	{
+		return false;
+	}
+}
+
+// Returns true if the tile in the given direction from the given coordinate (position.x, position.y) is a tile
+bool Maze::IsFloorAdjacent(Position position, char direction)
+{
+	return IsFloorAdjacent(position.x, position.y, direction);
+}
+
+// Returns the tile position one tile in the given direction from the tile position (x, y)
+// Moving off the left or right edge of the maze wraps around to the other side, the same as the tunnel teleport
+Position Maze::GetAdjacentTilePos(int x, int y, char direction)
+{
+    Position adjacent;
+    adjacent.x = x;
+    adjacent.y = y;
+
+    if (direction == NORTH)
+    {
+        adjacent.y--;
+    }
+    else if (direction == EAST)
+    {
+        adjacent.x++;
+    }
+    else if (direction == SOUTH)
+    {
+        adjacent.y++;
+    }
+    else if (direction == WEST)
+    {
+        adjacent.x--;
+    }
+
+    // Wrap around the left and right edges
+    if (adjacent.x < 0)
+    {
+        adjacent.x = WIDTH - 1;
+    }
+    else if (adjacent.x >= WIDTH)
+    {
+        adjacent.x = 0;
+    }
+
+    return adjacent;
+}
+
+// Returns the directions that lead to a floor tile from the tile (x, y) (NORTH | EAST | SOUTH | WEST)
+// Matches 'IsFloorAdjacent', so the tunnel isn't counted
+char Maze::GetExits(int x, int y)
+{
+    if (!IsInBounds(x, y))
+    {
+        return 0x0;
+    }
+
+    return _exits[y][x];
+}
+
+// Returns the floor tile closest to the tile (x, y), moving it inside the maze first if needed
+// Returns (x, y) unchanged if there are no floor tiles
+Position Maze::GetNearestFloorTile(int x, int y)
+{
+    Position tile;
+    tile.x = x < 0 ? 0 : (x >= WIDTH ? WIDTH - 1 : x);
+    tile.y = y < 0 ? 0 : (y >= HEIGHT ? HEIGHT - 1 : y);
+
+    // Check rings of tiles further and further away (by manhattan distance) until a floor tile is found
+    for (int radius = 0; radius < WIDTH + HEIGHT; radius++)
+    {
+        for (int dx = -radius; dx <= radius; dx++)
+        {
+            int dy = radius - abs(dx);
+
+            if (IsFloor(tile.x + dx, tile.y - dy))
+            {
+                tile.x += dx;
+                tile.y -= dy;
+                return tile;
+            }
+
+            if (dy != 0 && IsFloor(tile.x + dx, tile.y + dy))
+            {
+                tile.x += dx;
+                tile.y += dy;
+                return tile;
+            }
+        }
+    }
+
+    tile.x = x;
+    tile.y = y;
+    return tile;
+}
+
+// Checks if the screen position one pixel in the given direction is a floor tile
+// Does a simple check to make sure that the entire object of size TILE_SIZE * TILE_SIZE could move into the position
+bool Maze::IsFloorAdjacentScreenPos(Position screenPos, char direction)
+{
+    /*
+        Example with 2x2 pixel tiles:
+        Legend:
+            # - Wall at pixel
+            . - Floor at pixel
+            * - Pixel being checked
+            ~ - Object's pixel not being checked
+
+        Image A:
+            ##..####
+            ##..####
+            ##.~~...
+            ##.~~...
+            ##..####
+            ##..####
+
+        Image B:
+            ##..####
+            ##.**###
+            ##.~~...
+            ##.~~...
+            ##..####
+            ##..####
+
+        Image A shows the initial world state
+        Image B shows the pixels being checked when the object is trying to move north
+
+        If only a single pixel on the top left above the object was being checked, the object would be able to move partly into the wall above.
+        Checking both pixels above each edge of the object reveals that there is actually a wall in the way 
+    */
+    
+    // Create two empty Position structs
+    // These are used to check the edge of the object moving in the given direction
+    Position adjacentPosA;
+    Position adjacentPosB;
+
+    if (direction == NORTH)
+    {
+        // Set the positions to be checked
+        adjacentPosA.x = screenPos.x;
+        adjacentPosA.y = screenPos.y - 1;
+
+        adjacentPosB.x = screenPos.x + TILE_SIZE - 1;
+        adjacentPosB.y = screenPos.y - 1;
+    }
+    else if (direction == EAST)
+    {
+        // Set the positions to be checked
+        adjacentPosA.x = screenPos.x + TILE_SIZE;
+        adjacentPosA.y = screenPos.y;
+
+        adjacentPosB.x = screenPos.x + TILE_SIZE;
+        adjacentPosB.y = screenPos.y + TILE_SIZE - 1;
+    }
+    else if (direction == SOUTH)
+    {
+        // Set the positions to be checked
+        adjacentPosA.x = screenPos.x;
+        adjacentPosA.y = screenPos.y + TILE_SIZE;
+
+        adjacentPosB.x = screenPos.x + TILE_SIZE - 1;
+        adjacentPosB.y = screenPos.y + TILE_SIZE;
+    }
+    else if (direction == WEST)
+    {
+        // Set the positions to be checked
+        adjacentPosA.x = screenPos.x - 1;
+        adjacentPosA.y = screenPos.y;
+
+        adjacentPosB.x = screenPos.x - 1;
+        adjacentPosB.y = screenPos.y + TILE_SIZE - 1;
+    }
+    else
+    {
+        // No direction given (e.g. the player hasn't asked to turn), so there is nothing to move into
+        return false;
+    }
+
+    // Convert the screen positions to tile positions in the maze
+    Position tilePosA = ScreenPosToTilePos(adjacentPosA);
+    Position tilePosB = ScreenPosToTilePos(adjacentPosB);
+
+    // Check if both tile positions are floor tiles
+    return IsFloor(tilePosA.x, tilePosA.y) && IsFloor(tilePosB.x, tilePosB.y);
+}
+
+// Returns true if the tile position (x, y) contains a pellet
+bool Maze::IsPellet(int x, int y)
+{
+	return IsInBounds(x, y) && ((_pellets[y] >> x) & 0x1);
+}
+
+// Removes the pellet at the tile position (x, y)
+// If there is a pellet at the given position, returns true
+// If there is no pellet at the given position, returns false
+bool Maze::TryRemovePellet(int x, int y) {
+    // Check if there is a pellet at the given position (x, y)
+    bool hasPellet = IsPellet(x, y);
+
+    // If there is a pellet
+    if (hasPellet)
+    {
+        // Remove the pellet
+        _pellets[y] &= ~(0x1 << x); // Clear the x'th bit
+
+        // Tell the listeners which pellet has gone
+        for (int i = 0; i < _listeners.GetCount(); i++)
+        {
+            _listeners[i]->OnPelletRemoved(x, y);
+        }
+    }
+    
+    // Returns true if a pellet was removed
+    return hasPellet;
+}
+
+// Converts the given screen position into a tile position
+// Once the tile position is acquired, 'TryRemovePellet' at the tile position is called
+bool Maze::TryRemovePelletScreenPos(Position screenPos) {
+    // Convert the screen position to a tile position
+    Position tilePos = ScreenPosToTilePos(screenPos);
+
+    // Try and remove a pellet at the tile position
+    return TryRemovePellet(tilePos.x, tilePos.y);
+}
+
+// Converts the given screen position (x, y) to a position on the tilemap
+// Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
+Position Maze::ScreenPosToTilePos(int x, int y)
+{
+    // Divide the screen position by 'TILE_SIZE'
+	int tileX = x / TILE_SIZE;
+	int tileY = y / TILE_SIZE;
+    
+    // Create a new 'Position' struct to store the new tile position to
+    Position tilePos;
+
+    // Set the 'x' and 'y' of the new 'Position' struct to the tile positions
+    tilePos.x = tileX;
+    tilePos.y = tileY;
+    
+    // Return the new created 'Position' struct
+    return tilePos;
+}
+
+// Converts the given screen position (screenPos) to a position on the tilemap
+// Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
+Position Maze::ScreenPosToTilePos(Position screenPos)
+{
+	return ScreenPosToTilePos(screenPos.x, screenPos.y);
+}
+
+// Update function
+// State:
+//      STARTUP: Make the maze visible + set '_initialDraw' to true + add the pellets to the maze
+//      CONTINUE: Set '_initalDraw' to true
+//      NEXT_LEVEL: Same as 'STARTUP' state
+//      PLAY: Do nothing
+//      DEAD: Do nothing
+//      default: Set the maze to be invisible
+void Maze::Update()
+{
+    // Game State Switch
+    switch (context->curGameState) {
+    // 
+    case STARTUP:
+        _initialDraw = true; // Set the intial draw flag
+        Visible = true; // Make the maze visible
+        ResetPellets(); // Fill the maze with pellets
+        break;
+    case CONTINUE:
+        _initialDraw = true; // Set the intial draw flag
+        break;
+    case NEXT_LEVEL:
+        _initialDraw = true; // Set the intial draw flag
+        Visible = true; // Make the maze visible
+        ResetPellets(); // Fill the maze with pellets
+        break;
+    case PLAY:
+        break;
+    case DEAD:
+        break;
+    default:
+        Visible = false; // Make the maze invisible
+        break;
+    }
+}
+
+// Draws the maze tile at (x, y) onto the LCD
+void Maze::DrawTile(int x, int y)
+{
+    // If the position is a floor tile or out of bounds
+    if (IsFloor(x, y) || !IsInBounds(x, y)) 
+    {
+        // Draw a black tile
+        BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
+        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+
+        // If the position is in bounds and contains a pellet
+        if (IsInBounds(x, y) && IsPellet(x, y))
+        {
+            // Draw a small yellow circle at the centre of the tile
+            BSP_LCD_SetTextColor(LCD_COLOR_YELLOW);
+            BSP_LCD_FillCircle((x * TILE_SIZE) + (TILE_SIZE / 2), (y * TILE_SIZE) + (TILE_SIZE / 2), 1);
+        }
+    } 
+    else 
+    {
+        // Draw a blue tile
+        BSP_LCD_SetTextColor(LCD_COLOR_BLUE);
+        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+    }
+}
+
+// Draw function
+// When '_initialDraw' is true, all tiles within the maze are draw
+// When 'initialDraw' is false, only positions in 'redrawQueue' are drawn
+void Maze::Draw()
+{
+    // If the '_initialDraw' flag is high
+    if (_initialDraw)
+    {
+        // Unset the flag
+        _initialDraw = false;
+
+        // Every tile is about to be drawn, so nothing else needs redrawing
+        redrawQueue.Clear();
+
+        // Redraw every tile in the maze
+        for (int j = 0; j < HEIGHT; j++) {
+            for (int i = 0; i < WIDTH; i++) {
+                DrawTile(i, j);
+            }
+        }
+    }
+    else 
+    {
+        Position redrawPos;
+
+        // While there are still tiles to be redrawn in the queue, take the position from the front of the queue
+        while (redrawQueue.Pop(&redrawPos))
+        {
+            // Convert the screen position to a tile position
+            Position tilePos = ScreenPosToTilePos(redrawPos);
+
+            // Redraw the tile and some surrounding tiles
+            DrawTile(tilePos.x, tilePos.y);
+            DrawTile(tilePos.x, tilePos.y + 1);
+            DrawTile(tilePos.x + 1, tilePos.y);
+        }
+    }
+}
+
+/* ZOBRIST HASH H */
+//////////////////////////////////////////////////////////////
+
+// What a Zobrist key is for (kept in the top bits of the key index so every kind gets different keys)
+#define ZOBRIST_PELLET 1
+#define ZOBRIST_ACTOR 2
+#define ZOBRIST_SCORE 3
+#define ZOBRIST_LIVES 4
+#define ZOBRIST_LEVEL 5
+#define ZOBRIST_STATE 6
+
+// Actor numbers used for the keys (enemies are 'ZOBRIST_FIRST_ENEMY' + their index in 'GameState::enemies')
+#define ZOBRIST_PLAYER 0
+#define ZOBRIST_FIRST_ENEMY 1
+
+/*
+This class keeps a 64 bit Zobrist hash of a game's state up to date as the game is played
+
+The hash is the XOR of one random key for each thing in the state:
+    Each pellet left in the maze
+    Each actor's position, directions, fraction of a pixel and last move (one key for the combination)
+    The player's score, lives and level
+    The current and next game state
+Keys are made by mixing the thing's index with splitmix64 rather than stored in tables, so the hash costs no memory for keys
+
+Every change only XORs out the old key and XORs in the new one, so keeping the hash up to date is O(1):
+    Pellets     - The hash is added as a listener to the maze, so it is told about every pellet eaten
+    Actors      - The player and enemies update their key after every move (see 'SetZobristHash')
+    Game state  - Whatever runs the game calls 'UpdateGameState' whenever the game state changes
+When the pellets are reset (or a snapshot is restored), only the pellets that are different from before are toggled
+
+Equal states always give equal hashes ('ComputeHash' works one out from scratch, for checking)
+Animation frames aren't included as they don't change how the game plays out
+*/
+class ZobristHash :
+    public MazeListener
+{
+private:
+    Maze* _maze;
+    uint64_t _hash;
+
+    // Pellets included in '_hash' (same format as '_pellets' in 'Maze')
+    int _pellets[HEIGHT];
+
+    // Key currently included in '_hash' for the game state
+    uint64_t _gameStateKey;
+
+    // Toggles the pellet keys for every tile that differs between '_pellets' and the maze
+    void SyncPellets();
+
+public:
+    // Constructs the hash for the given maze (with no actors and no game state)
+    // The hash is added as a listener to the maze so that it knows when pellets are eaten
+    ZobristHash(Maze* maze);
+
+    // Returns the key for the 'index'th thing of the given kind ('ZOBRIST_*')
+    static uint64_t GetKey(int kind, uint32_t index);
+
+    // Returns the key for the given actor ('ZOBRIST_PLAYER' or 'ZOBRIST_FIRST_ENEMY' + index) in the given state
+    static uint64_t GetActorKey(int actor, const ActorState* state);
+
+    // Returns the hash of 'state' worked out from scratch
+    static uint64_t ComputeHash(const GameState* state);
+
+    // Returns the current hash
+    uint64_t GetHash();
+
+    // XORs 'key' into the hash
+    // Used by the actors to swap their old key for their new one
+    void Toggle(uint64_t key);
+
+    // Swaps the game state part of the hash for the given current and next game state
+    void UpdateGameState(char curGameState, char nextGameState);
+
+    // Called by the maze when a pellet is removed
+    void OnPelletRemoved(int x, int y);
+
+    // Called by the maze when all pellets are put back
+    void OnPelletsReset();
+
+    // Called by the maze when a new layout is loaded
+    void OnMazeLoaded();
+};
+
+/* ZOBRIST HASH CPP */
+//////////////////////////////////////////////////////////////
+
+// Toggles the pellet keys for every tile that differs between '_pellets' and the maze
+void ZobristHash::SyncPellets()
+{
+    int pellets[HEIGHT];
+    _maze->CopyPellets(pellets);
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        int changed = pellets[y] ^ _pellets[y];
+
+        // Rows are usually unchanged, so stop as soon as no changed bits are left
+        for (int x = 0; changed != 0x0; x++)
+        {
+            if ((changed >> x) & 0x1)
+            {
+                _hash ^= GetKey(ZOBRIST_PELLET, (y * WIDTH) + x);
+                changed &= ~(0x1 << x);
+            }
+        }
+
+        _pellets[y] = pellets[y];
+    }
+}
+
+// Constructs the hash for the given maze (with no actors and no game state)
+// The hash is added as a listener to the maze so that it knows when pellets are eaten
+ZobristHash::ZobristHash(Maze* maze)
+{
+    _maze = maze;
+    _hash = 0;
+    _gameStateKey = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        _pellets[y] = 0x0;
+    }
+
+    SyncPellets();
+    _maze->AddListener(this);
+}
+
+// Returns the key for the 'index'th thing of the given kind ('ZOBRIST_*')
+uint64_t ZobristHash::GetKey(int kind, uint32_t index)
+{
+    // splitmix64 of the kind and index
+    uint64_t z = (((uint64_t)kind << 32) | index) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Returns the key for the given actor ('ZOBRIST_PLAYER' or 'ZOBRIST_FIRST_ENEMY' + index) in the given state
+uint64_t ZobristHash::GetActorKey(int actor, const ActorState* state)
+{
+    // Actor (4 bits), x and y (10 bits each) and both directions (4 bits each) all fit in the 32 bit index
+    uint32_t index = ((uint32_t)actor << 28) | ((uint32_t)(state->position.x & 0x3FF) << 18) | ((uint32_t)(state->position.y & 0x3FF) << 8) | ((state->lastDir & 0xF) << 4) | (state->nextDir & 0xF);
+
+    // The fraction of a pixel and the last move (4 bits each way) go above the kind, so one key still covers the whole actor
+    // Only moves through the tunnel are too long to fit, they are cut down to 4 bits (which can't make equal states hash differently)
+    uint32_t move = state->subPixel | (((state->position.x - state->moveStart.x) & 0xF) << 8) | (((state->position.y - state->moveStart.y) & 0xF) << 12);
+
+    return GetKey(ZOBRIST_ACTOR | (int)(move << 8), index);
+}
+
+// Returns the hash of 'state' worked out from scratch
+uint64_t ZobristHash::ComputeHash(const GameState* state)
+{
+    uint64_t hash = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if ((state->pellets[y] >> x) & 0x1)
+            {
+                hash ^= GetKey(ZOBRIST_PELLET, (y * WIDTH) + x);
+            }
+        }
+    }
+
+    hash ^= GetActorKey(ZOBRIST_PLAYER, &state->player);
+    hash ^= GetKey(ZOBRIST_SCORE, state->score);
+    hash ^= GetKey(ZOBRIST_LIVES, state->lives);
+    hash ^= GetKey(ZOBRIST_LEVEL, state->level);
+
+    for (int i = 0; i < MAX_STATE_ENEMIES; i++)
+    {
+        hash ^= GetActorKey(ZOBRIST_FIRST_ENEMY + i, &state->enemies[i]);
+    }
+
+    hash ^= GetKey(ZOBRIST_STATE, (state->curGameState << 8) | state->nextGameState);
+
+    return hash;
+}
+
+// Returns the current hash
+uint64_t ZobristHash::GetHash()
+{
+    return _hash;
+}
+
+// XORs 'key' into the hash
+// Used by the actors to swap their old key for their new one
+void ZobristHash::Toggle(uint64_t key)
+{
+    _hash ^= key;
+}
+
+// Swaps the game state part of the hash for the given current and next game state
+void ZobristHash::UpdateGameState(char curGameState, char nextGameState)
+{
+    uint64_t key = GetKey(ZOBRIST_STATE, (curGameState << 8) | nextGameState);
+    _hash ^= _gameStateKey ^ key;
+    _gameStateKey = key;
+}
+
+// Called by the maze when a pellet is removed
+void ZobristHash::OnPelletRemoved(int x, int y)
+{
+    if ((_pellets[y] >> x) & 0x1)
+    {
+        _pellets[y] &= ~(0x1 << x);
+        _hash ^= GetKey(ZOBRIST_PELLET, (y * WIDTH) + x);
+    }
+}
+
+// Called by the maze when all pellets are put back
+void ZobristHash::OnPelletsReset()
+{
+    SyncPellets();
+}
+
+// Called by the maze when a new layout is loaded
+void ZobristHash::OnMazeLoaded()
+{
+    SyncPellets();
+}
+
+/* MAZE GRAPH H */
+//////////////////////////////////////////////////////////////
+
+// Stores a junction or dead end in a 'MazeGraph'
+struct MazeGraphNode
+{
+    Position tile; // Tile position of the node in the maze
+    short edges[4]; // Index of the edge leaving the node to the NORTH, EAST, SOUTH and WEST (-1 when there is no edge)
+    bool hasPellet; // True when there is a pellet on the node's own tile
+};
+
+// Stores a corridor between two nodes in a 'MazeGraph'
+struct MazeGraphEdge
+{
+    short nodeA; // Index of the node at the start of the corridor
+    short nodeB; // Index of the node at the end of the corridor
+    char dirA; // Direction the corridor leaves 'nodeA' in
+    char dirB; // Direction the corridor leaves 'nodeB' in
+    short length; // Number of steps to walk from 'nodeA' to 'nodeB'
+    short pelletCount; // Number of pellets on the tiles covered by the corridor (not including the nodes)
+    short firstTile; // Index into the graph's tile list of the first tile covered by the corridor
+    short tileCount; // Number of tiles covered by the corridor (not including the nodes)
+};
+
+/*
+This class compresses the maze tilemap into a graph of corridors
+
+Nodes are junctions (tiles with three or four exits) and dead ends (tiles with one exit)
+Edges are the corridors between nodes, each one storing its length, how many pellets are left on it and which tiles it covers
+Search based AI can then step from junction to junction instead of walking the corridors one tile at a time
+
+The graph listens to the maze, so when a pellet is eaten only the pellet count of the edge (or node) covering that tile changes
+*/
+class MazeGraph :
+    public MazeListener
+{
+private:
+    Maze* _maze;
+
+    MazeGraphNode _nodes[MAX_GRAPH_NODES];
+    int _nodeCount;
+
+    MazeGraphEdge _edges[MAX_GRAPH_EDGES];
+    int _edgeCount;
+
+    // Tiles covered by every edge, stored one after another as (y * WIDTH) + x
+    short _edgeTiles[WIDTH * HEIGHT];
+    int _edgeTileCount;
+
+    // Used like a 2D array to find what covers each tile
+    // Values: -1 = wall, 0 or above = index of the edge, below -1 = index of the node stored as -(index + 2)
+    short _tileOwner[HEIGHT][WIDTH];
+
+    // Returns the number of floor tiles next to the tile (x, y), including through the tunnel
+    int GetExitCount(int x, int y);
+
+    // Adds a node at the tile (x, y) and returns its index
+    // Returns -1 if there are already 'MAX_GRAPH_NODES' nodes
+    int AddNode(int x, int y);
+
+    // Walks along the corridor leaving the given node in the given direction until another node is reached
+    // The corridor is stored as a new edge
+    // Returns false if there are already 'MAX_GRAPH_EDGES' edges
+    bool WalkEdge(int node, char direction);
+
+    // Walks every corridor leaving the given node that hasn't already been walked from its other end
+    // Returns false if there are too many edges
+    bool WalkEdges(int node);
+
+    // Empties the graph, leaving every tile uncovered
+    void Clear();
+
+public:
+    // Constructs the graph and builds it from the given maze
+    // The graph is also added as a listener to the maze so that it is kept up to date
+    MazeGraph(Maze* maze);
+
+    // Throws away the current graph and builds it again from the maze
+    // Only needs calling when the walls of the maze change
+    // Returns false (leaving the graph empty) if the maze has more nodes than 'MAX_GRAPH_NODES' or more edges than 'MAX_GRAPH_EDGES'
+    bool Build();
+
+    // Counts the pellets on every node and edge again
+    void RecountPellets();
+
+    // Returns the index of a direction (NORTH = 0, EAST = 1, SOUTH = 2, WEST = 3)
+    static int DirectionIndex(char direction);
+
+
+    int GetNodeCount();
+
+    int GetEdgeCount();
+
+    MazeGraphNode* GetNode(int index);
+
+    MazeGraphEdge* GetEdge(int index);
+
+    // Returns the position of the i'th tile covered by the given edge, ordered from 'nodeA' to 'nodeB'
+    Position GetEdgeTile(int edge, int i);
+
+    // Returns the tile 'step' steps along the given edge from 'nodeA' (0 is the tile of 'nodeA' and 'length' is the tile of 'nodeB')
+    Position GetStepTile(int edge, int step);
+
+    // Returns the number of steps along the given edge from 'nodeA' to the tile (x, y), or -1 if the edge doesn't cover the tile
+    int GetEdgeStep(int edge, int x, int y);
+
+    // Returns the node at the other end of the given edge from the given node
+    int GetOtherNode(int edge, int node);
+
+    // Returns the index of the node at the tile (x, y) or -1 if the tile is not a node
+    int GetNodeAt(int x, int y);
+
+    // Returns the index of the edge covering the tile (x, y) or -1 if the tile is not part of a corridor
+    int GetEdgeAt(int x, int y);
+
+    // Called by the maze when a pellet is removed
+    // Takes the pellet off the count of whichever edge or node covers the tile
+    void OnPelletRemoved(int x, int y);
+
+    // Called by the maze when all pellets are put back
+    void OnPelletsReset();
+
+    // Called by the maze when a new layout is loaded
+    void OnMazeLoaded();
+};
+
+/* MAZE GRAPH CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns the number of floor tiles next to the tile (x, y), including through the tunnel
+int MazeGraph::GetExitCount(int x, int y)
+{
+    int count = 0;
+
+    for (char direction = NORTH; direction <= WEST; direction <<= 1)
+    {
+        Position adjacent = _maze->GetAdjacentTilePos(x, y, direction);
+        count += _maze->IsFloor(adjacent.x, adjacent.y);
+    }
+
+    return count;
+}
+
+// Adds a node at the tile (x, y) and returns its index
+// Returns -1 if there are already 'MAX_GRAPH_NODES' nodes
+int MazeGraph::AddNode(int x, int y)
+{
+    if (_nodeCount == MAX_GRAPH_NODES)
+    {
+        return -1;
+    }
+
+    int index = _nodeCount;
+    _nodeCount++;
+
+    _nodes[index].tile.x = x;
+    _nodes[index].tile.y = y;
+    _nodes[index].hasPellet = _maze->IsPellet(x, y);
+
+    for (int i = 0; i < 4; i++)
+    {
+        _nodes[index].edges[i] = -1;
+    }
+
+    _tileOwner[y][x] = -(index + 2);
+
+    return index;
+}
+
+// Walks along the corridor leaving the given node in the given direction until another node is reached
+// The corridor is stored as a new edge
+// Returns false if there are already 'MAX_GRAPH_EDGES' edges
+bool MazeGraph::WalkEdge(int node, char direction)
+{
+    if (_edgeCount == MAX_GRAPH_EDGES)
+    {
+        return false;
+    }
+
+    int index = _edgeCount;
+    _edgeCount++;
+
+    MazeGraphEdge* edge = &_edges[index];
+    edge->nodeA = node;
+    edge->dirA = direction;
+    edge->length = 0;
+    edge->pelletCount = 0;
+    edge->firstTile = _edgeTileCount;
+    edge->tileCount = 0;
+
+    _nodes[node].edges[DirectionIndex(direction)] = index;
+
+    Position tile = _nodes[node].tile;
+
+    while (true)
+    {
+        // Step into the next tile of the corridor
+        tile = _maze->GetAdjacentTilePos(tile.x, tile.y, direction);
+        edge->length++;
+
+        // Stop once another node has been reached
+        int endNode = GetNodeAt(tile.x, tile.y);
+        if (endNode != -1)
+        {
+            edge->nodeB = endNode;
+            edge->dirB = OppositeDirection(direction);
+            _nodes[endNode].edges[DirectionIndex(edge->dirB)] = index;
+            return true;
+        }
+
+        // Store the tile as part of the corridor
+        _tileOwner[tile.y][tile.x] = index;
+        _edgeTiles[_edgeTileCount] = (tile.y * WIDTH) + tile.x;
+        _edgeTileCount++;
+        edge->tileCount++;
+        edge->pelletCount += _maze->IsPellet(tile.x, tile.y);
+
+        // Corridor tiles only have two exits, so carry on through the one that isn't behind us
+        char back = OppositeDirection(direction);
+        for (char next = NORTH; next <= WEST; next <<= 1)
+        {
+            Position adjacent = _maze->GetAdjacentTilePos(tile.x, tile.y, next);
+            if (next != back && _maze->IsFloor(adjacent.x, adjacent.y))
+            {
+                direction = next;
+                break;
+            }
+        }
+    }
+}
+
+// Walks every corridor leaving the given node that hasn't already been walked from its other end
+// Returns false if there are too many edges
+bool MazeGraph::WalkEdges(int node)
+{
+    Position tile = _nodes[node].tile;
+
+    for (char direction = NORTH; direction <= WEST; direction <<= 1)
+    {
+        Position adjacent = _maze->GetAdjacentTilePos(tile.x, tile.y, direction);
+        if (_nodes[node].edges[DirectionIndex(direction)] == -1 && _maze->IsFloor(adjacent.x, adjacent.y))
+        {
+            if (!WalkEdge(node, direction))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Empties the graph, leaving every tile uncovered
+void MazeGraph::Clear()
+{
+    _nodeCount = 0;
+    _edgeCount = 0;
+    _edgeTileCount = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            _tileOwner[y][x] = -1;
+        }
+    }
+}
+
+// Constructs the graph and builds it from the given maze
+// The graph is also added as a listener to the maze so that it is kept up to date
+MazeGraph::MazeGraph(Maze* maze)
+{
+    _maze = maze;
+    Build();
+    _maze->AddListener(this);
+}
+
+// Throws away the current graph and builds it again from the maze
+// Only needs calling when the walls of the maze change
+// Returns false (leaving the graph empty) if the maze has more nodes than 'MAX_GRAPH_NODES' or more edges than 'MAX_GRAPH_EDGES'
+bool MazeGraph::Build()
+{
+    Clear();
+
+    // Every floor tile without exactly two exits becomes a node
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (_maze->IsFloor(x, y) && GetExitCount(x, y) != 2 && AddNode(x, y) == -1)
+            {
+                Clear();
+                return false;
+            }
+        }
+    }
+
+    // Walk every corridor leaving every node that hasn't already been walked from the other end
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        if (!WalkEdges(i))
+        {
+            Clear();
+            return false;
+        }
+    }
+
+    // Any floor tiles left over are on loops without any junctions on them
+    // These get a node added so that they still appear in the graph
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (_tileOwner[y][x] == -1 && _maze->IsFloor(x, y))
+            {
+                int node = AddNode(x, y);
+
+                if (node == -1 || !WalkEdges(node))
+                {
+                    Clear();
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Counts the pellets on every node and edge again
+void MazeGraph::RecountPellets()
+{
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        _nodes[i].hasPellet = _maze->IsPellet(_nodes[i].tile.x, _nodes[i].tile.y);
+    }
+
+    for (int i = 0; i < _edgeCount; i++)
+    {
+        _edges[i].pelletCount = 0;
+
+        for (int j = 0; j < _edges[i].tileCount; j++)
+        {
+            Position tile = GetEdgeTile(i, j);
+            _edges[i].pelletCount += _maze->IsPellet(tile.x, tile.y);
+        }
+    }
+}
+
+// Returns the index of a direction (NORTH = 0, EAST = 1, SOUTH = 2, WEST = 3)
+int MazeGraph::DirectionIndex(char direction)
+{
+    if (direction == NORTH)
+    {
+        return 0;
+    }
+    else if (direction == EAST)
+    {
+        return 1;
+    }
+    else if (direction == SOUTH)
+    {
+        return 2;
+    }
+    else
+    {
+        return 3;
+    }
+}
+
+int MazeGraph::GetNodeCount()
+{
+    return _nodeCount;
+}
+
+int MazeGraph::GetEdgeCount()
+{
+    return _edgeCount;
+}
+
+MazeGraphNode* MazeGraph::GetNode(int index)
+{
+    return &_nodes[index];
+}
+
+MazeGraphEdge* MazeGraph::GetEdge(int index)
+{
+    return &_edges[index];
+}
+
+// Returns the position of the i'th tile covered by the given edge, ordered from 'nodeA' to 'nodeB'
+Position MazeGraph::GetEdgeTile(int edge, int i)
+{
+    short packed = _edgeTiles[_edges[edge].firstTile + i];
+
+    Position tile;
+    tile.x = packed % WIDTH;
+    tile.y = packed / WIDTH;
+    return tile;
+}
+
+// Returns the tile 'step' steps along the given edge from 'nodeA' (0 is the tile of 'nodeA' and 'length' is the tile of 'nodeB')
+Position MazeGraph::GetStepTile(int edge, int step)
+{
+    if (step <= 0)
+    {
+        return _nodes[_edges[edge].nodeA].tile;
+    }
+    else if (step >= _edges[edge].length)
+    {
+        return _nodes[_edges[edge].nodeB].tile;
+    }
+
+    return GetEdgeTile(edge, step - 1);
+}
+
+// Returns the number of steps along the given edge from 'nodeA' to the tile (x, y), or -1 if the edge doesn't cover the tile
+int MazeGraph::GetEdgeStep(int edge, int x, int y)
+{
+    short packed = (y * WIDTH) + x;
+
+    for (int i = 0; i < _edges[edge].tileCount; i++)
+    {
+        if (_edgeTiles[_edges[edge].firstTile + i] == packed)
+        {
+            return i + 1;
+        }
+    }
+
+    return -1;
+}
+
+// Returns the node at the other end of the given edge from the given node
+int MazeGraph::GetOtherNode(int edge, int node)
+{
+    return _edges[edge].nodeA == node ? _edges[edge].nodeB : _edges[edge].nodeA;
+}
+
+// Returns the index of the node at the tile (x, y) or -1 if the tile is not a node
+int MazeGraph::GetNodeAt(int x, int y)
+{
+    if (!_maze->IsInBounds(x, y) || _tileOwner[y][x] > -2)
+    {
+        return -1;
+    }
+
+    return -(_tileOwner[y][x] + 2);
+}
+
+// Returns the index of the edge covering the tile (x, y) or -1 if the tile is not part of a corridor
+int MazeGraph::GetEdgeAt(int x, int y)
+{
+    if (!_maze->IsInBounds(x, y) || _tileOwner[y][x] < 0)
+    {
+        return -1;
+    }
+
+    return _tileOwner[y][x];
+}
+
+// Called by the maze when a pellet is removed
+// Takes the pellet off the count of whichever edge or node covers the tile
+void MazeGraph::OnPelletRemoved(int x, int y)
+{
+    int edge = GetEdgeAt(x, y);
+    if (edge != -1)
+    {
+        _edges[edge].pelletCount--;
+        return;
+    }
+
+    int node = GetNodeAt(x, y);
+    if (node != -1)
+    {
+        _nodes[node].hasPellet = false;
+    }
+}
+
+// Called by the maze when all pellets are put back
+void MazeGraph::OnPelletsReset()
+{
+    RecountPellets();
+}
+
+// Called by the maze when a new layout is loaded
+void MazeGraph::OnMazeLoaded()
+{
+    Build();
+}
+
+/* DISTANCE TABLE H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class stores the shortest path distance (in tiles) between every pair of floor tiles in the maze
+
+Floor tiles are given a dense index (0 to floor tile count - 1) so that the table doesn't waste any space on walls
+The table is filled at level load by running one breadth first search from every floor tile, after that any distance is a single lookup
+Paths through the tunnel are included
+Ghosts given a table ('Enemy::SetDistanceTable') use it to pick the exit at each junction with the fewest steps to their target
+
+NOTE: The table is sized for 'MAX_FLOOR_TILES' (100 KB on the host, 50 KB on the target) so objects of this class should be static rather than on the stack
+*/
+class DistanceTable :
+    public MazeListener
+{
+private:
+    Maze* _maze;
+
+    // Number of floor tiles in the maze
+    int _floorTileCount;
+
+    // Used like a 2D array to find the dense index of each tile (-1 for walls)
+    short _tileIndex[HEIGHT][WIDTH];
+
+    // Tile position of each dense index
+    Position _tiles[MAX_FLOOR_TILES];
+
+    // Dense index of the floor tile in each direction from each floor tile (-1 when there is a wall)
+    short _neighbours[MAX_FLOOR_TILES][4];
+
+    // Distance between every pair of floor tiles
+#ifdef DISTANCE_TABLE_TRIANGULAR
+    uint8_t _distances[(MAX_FLOOR_TILES * (MAX_FLOOR_TILES - 1)) / 2];
+#else
+    uint8_t _distances[MAX_FLOOR_TILES * MAX_FLOOR_TILES];
+#endif
+
+    // Returns where the distance between the floor tiles 'a' and 'b' is stored in '_distances'
+    int GetTableIndex(int a, int b);
+
+    // Fills in the distances from the floor tile 'start' to every other floor tile
+    // 'queue' is only passed in so it isn't made again for every search
+    void BreadthFirstSearch(int start, RingBuffer<short, MAX_FLOOR_TILES, CONTAINER_HALT>* queue);
+
+public:
+    // Constructs the table and fills it from the given maze
+    // The table is added as a listener to the maze so that it is filled again when a new layout is loaded
+    DistanceTable(Maze* maze);
+
+    // Numbers the floor tiles and fills in every distance
+    // Only needs calling when the walls of the maze change
+    // Returns false if the maze has more floor tiles than 'MAX_FLOOR_TILES'
+    bool Build();
+
+    // Returns the number of floor tiles in the maze
+    int GetFloorTileCount();
+
+    // Returns the dense index of the tile (x, y) or -1 if it isn't a floor tile
+    int GetTileIndex(int x, int y);
+
+    // Returns the tile position of the given dense index
+    Position GetTile(int index);
+
+    // Returns the number of steps between the floor tiles with dense indexes 'a' and 'b'
+    // Returns 'DISTANCE_UNREACHABLE' if there is no path between them, and 'DISTANCE_SATURATED' for paths that long or longer
+    uint8_t GetDistance(int a, int b);
+
+    // Returns the number of steps between the tile positions 'a' and 'b'
+    // Returns 'DISTANCE_UNREACHABLE' if either tile is a wall or there is no path between them
+    uint8_t GetDistance(Position a, Position b);
+
+    // Pellets don't change any distances, so these do nothing
+    void OnPelletRemoved(int x, int y);
+    void OnPelletsReset();
+
+    // Called by the maze when a new layout is loaded
+    void OnMazeLoaded();
+};
+
+/* DISTANCE TABLE CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns where the distance between the floor tiles 'a' and 'b' is stored in '_distances'
+int DistanceTable::GetTableIndex(int a, int b)
+{
+#ifdef DISTANCE_TABLE_TRIANGULAR
+    // Only pairs where 'a' is less than 'b' are stored, so swap them if needed
+    if (a > b)
+    {
+        int temp = a;
+        a = b;
+        b = temp;
+    }
+
+    // Row 'b' of the triangle starts after the 0 + 1 + ... + (b - 1) entries of the rows before it
+    return ((b * (b - 1)) / 2) + a;
+#else
+    return (a * _floorTileCount) + b;
+#endif
+}
+
+// Fills in the distances from the floor tile 'start' to every other floor tile
+// 'queue' is only passed in so it isn't made again for every search
+void DistanceTable::BreadthFirstSearch(int start, RingBuffer<short, MAX_FLOOR_TILES, CONTAINER_HALT>* queue)
+{
+    // Distances found so far from 'start', indexed by dense index
+    uint8_t found[MAX_FLOOR_TILES];
+
+    for (int i = 0; i < _floorTileCount; i++)
+    {
+        found[i] = DISTANCE_UNREACHABLE;
+    }
+
+    // Each tile is only queued once, so the queue can never fill up
+    short current;
+
+    found[start] = 0;
+    queue->Clear();
+    queue->Push(start);
+
+    while (queue->Pop(&current))
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            int next = _neighbours[current][i];
+
+            if (next != -1 && found[next] == DISTANCE_UNREACHABLE)
+            {
+                // Stop counting at 'DISTANCE_SATURATED' rather than wrapping to 'DISTANCE_UNREACHABLE', which would queue the tile again
+                found[next] = found[current] < DISTANCE_SATURATED ? found[current] + 1 : DISTANCE_SATURATED;
+                queue->Push(next);
+            }
+        }
+    }
+
+    // Store the results
+    // With the triangular table only the pairs with the higher index need storing, the rest were stored by earlier searches
+#ifdef DISTANCE_TABLE_TRIANGULAR
+    for (int i = 0; i < start; i++)
+#else
+    for (int i = 0; i < _floorTileCount; i++)
+#endif
+    {
+        _distances[GetTableIndex(start, i)] = found[i];
+    }
+}
+
+// Constructs the table and fills it from the given maze
+// The table is added as a listener to the maze so that it is filled again when a new layout is loaded
+DistanceTable::DistanceTable(Maze* maze)
+{
+    _maze = maze;
+    Build();
+    _maze->AddListener(this);
+}
+
+// Numbers the floor tiles and fills in every distance
+// Only needs calling when the walls of the maze change
+// Returns false if the maze has more floor tiles than 'MAX_FLOOR_TILES'
+bool DistanceTable::Build()
+{
+    _floorTileCount = 0;
+
+    // Give every floor tile a dense index
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            _tileIndex[y][x] = -1;
+
+            if (_maze->IsFloor(x, y))
+            {
+                if (_floorTileCount == MAX_FLOOR_TILES)
+                {
+                    _floorTileCount = 0;
+                    return false;
+                }
+
+                _tileIndex[y][x] = _floorTileCount;
+                _tiles[_floorTileCount].x = x;
+                _tiles[_floorTileCount].y = y;
+                _floorTileCount++;
+            }
+        }
+    }
+
+    // Find the neighbours of every floor tile, including through the tunnel
+    for (int i = 0; i < _floorTileCount; i++)
+    {
+        int direction = NORTH;
+
+        for (int j = 0; j < 4; j++)
+        {
+            Position adjacent = _maze->GetAdjacentTilePos(_tiles[i].x, _tiles[i].y, direction);
+            _neighbours[i][j] = _tileIndex[adjacent.y][adjacent.x];
+            direction <<= 1;
+        }
+    }
+
+    // One breadth first search from every floor tile
+    RingBuffer<short, MAX_FLOOR_TILES, CONTAINER_HALT> queue;
+
+    for (int i = 0; i < _floorTileCount; i++)
+    {
+        BreadthFirstSearch(i, &queue);
+    }
+
+    return true;
+}
+
+// Returns the number of floor tiles in the maze
+int DistanceTable::GetFloorTileCount()
+{
+    return _floorTileCount;
+}
+
+// Returns the dense index of the tile (x, y) or -1 if it isn't a floor tile
+int DistanceTable::GetTileIndex(int x, int y)
+{
+    if (!_maze->IsInBounds(x, y))
+    {
+        return -1;
+    }
+
+    return _tileIndex[y][x];
+}
+
+// Returns the tile position of the given dense index
+Position DistanceTable::GetTile(int index)
+{
+    return _tiles[index];
+}
+
+// Returns the number of steps between the floor tiles with dense indexes 'a' and 'b'
+// Returns 'DISTANCE_UNREACHABLE' if there is no path between them, and 'DISTANCE_SATURATED' for paths that long or longer
+uint8_t DistanceTable::GetDistance(int a, int b)
+{
+#ifdef DISTANCE_TABLE_TRIANGULAR
+    // The diagonal isn't stored
+    if (a == b)
+    {
+        return 0;
+    }
+#endif
+
+    return _distances[GetTableIndex(a, b)];
+}
+
+// Returns the number of steps between the tile positions 'a' and 'b'
+// Returns 'DISTANCE_UNREACHABLE' if either tile is a wall or there is no path between them
+uint8_t DistanceTable::GetDistance(Position a, Position b)
+{
+    int indexA = GetTileIndex(a.x, a.y);
+    int indexB = GetTileIndex(b.x, b.y);
+
+    if (indexA == -1 || indexB == -1)
+    {
+        return DISTANCE_UNREACHABLE;
+    }
+
+    return GetDistance(indexA, indexB);
+}
+
+// Pellets don't change any distances, so these do nothing
+void DistanceTable::OnPelletRemoved(int, int) {}
+void DistanceTable::OnPelletsReset() {}
+
+// Called by the maze when a new layout is loaded
+void DistanceTable::OnMazeLoaded()
+{
+    Build();
+}
+
+/* PATH FINDER H */
+//////////////////////////////////////////////////////////////
+
+// Highest f-cost (steps taken + estimated steps left) the open list has a bucket for
+// A path can't be longer than the number of floor tiles and the estimate can't be more than the width plus the height of the maze
+#define PATH_MAX_COST (MAX_FLOOR_TILES + WIDTH + HEIGHT)
+
+// Number of places in a search: every node of the 'MazeGraph', plus the goal when it is part way along a corridor
+#define PATH_MAX_PLACES (MAX_GRAPH_NODES + 1)
+
+// Number of entries the open list can hold during one search
+// A place is only added again when a shorter way to it is found, which can happen at most once per corridor end leading to it (plus the start)
+#define PATH_MAX_ENTRIES ((MAX_GRAPH_EDGES * 2) + 4)
+
+// Stores a path found by a 'PathFinder' so that it can be followed without searching again
+struct MazePath
+{
+    Position goal;                      // Tile the path leads to
+    Position tile;                      // Tile on the path the follower was last seen at
+    char directions[MAX_FLOOR_TILES];   // Direction to move from each tile along the path
+    short length;                       // Number of steps in the path
+    short step;                         // Index into 'directions' for 'tile'
+    int mazeVersion;                    // Layout of the maze the path was found in (-1 for no path)
+};
+
+/*
+This class finds the shortest path between two tiles in the maze using A* over the corridors of a 'MazeGraph'
+
+The search steps from junction to junction, with each corridor costing its length, rather than walking the corridors one tile at a time
+The start and the goal don't have to be junctions: a start part way along a corridor goes to either end of it,
+and a goal part way along a corridor is a place of its own, reached from either end of it
+The open list is a bucket queue: a linked list of places for each f-cost, all sharing one preallocated pool of entries
+The estimate (steps ignoring walls, including across the tunnel) never drops by more than the length of a corridor along it,
+so the lowest f-cost in the open list never goes down and finding the next place to visit is just moving along the buckets
+This means a search doesn't allocate anything
+
+One path finder can be shared by every enemy, each enemy keeps its own 'MazePath' so that it only searches again when its target tile changes or it leaves the path
+
+NOTE: The arrays add up to a few KB so objects of this class should be static rather than on the stack
+*/
+class PathFinder :
+    public MazeListener
+{
+private:
+    Maze* _maze;
+    MazeGraph* _graph;
+
+    // Increased every time a new layout is loaded, so that paths found in an old layout aren't followed
+    int _mazeVersion;
+
+    // Number of searches run (for profiling)
+    int _searchCount;
+
+    // Open list
+    // '_bucketHead' is the first entry with each f-cost (-1 for none) and '_entryNext' links entries with the same f-cost
+    short _bucketHead[PATH_MAX_COST];
+    short _entryPlace[PATH_MAX_ENTRIES];
+    short _entryNext[PATH_MAX_ENTRIES];
+    int _entryCount;
+
+    // Closed set, bit 'place' for each place (node index, or 'MAX_GRAPH_NODES' for a goal part way along a corridor)
+    BitSet<PATH_MAX_PLACES> _closed;
+
+    // Number of steps from the start to each place
+    short _cost[PATH_MAX_PLACES];
+
+    // How each place was reached: the place before it (-1 for the start) and the stretch of corridor walked from there
+    // The stretch is stored as steps along '_cameAlong' counted from its 'nodeA' end (see 'MazeGraph::GetStepTile'), -1 when the place is the start itself
+    short _cameFrom[PATH_MAX_PLACES];
+    short _cameAlong[PATH_MAX_PLACES];
+    short _cameFromStep[PATH_MAX_PLACES];
+    short _cameToStep[PATH_MAX_PLACES];
+
+    // Goal of the current search, and the edge it is part way along (-1 if it is a node)
+    Position _goal;
+    int _goalEdge;
+    int _goalStep;
+
+    // Returns the number of steps from the tile (x, y) to 'goal' if there were no walls
+    int GetEstimate(int x, int y, Position goal);
+
+    // Returns the tile the given place is at
+    Position GetPlaceTile(int place);
+
+    // Returns the direction to step in to get from the tile 'from' to the tile 'to' next to it (0x0 if they aren't next to each other)
+    char GetStepDirection(Position from, Position to);
+
+    // Reaches 'place' with 'cost' steps, from the place 'from' along the edge 'edge' between the given steps
+    // Adds the place to the open list if that is the shortest way to it so far
+    // Returns false if the open list is full
+    bool Reach(int place, int cost, int from, int edge, int fromStep, int toStep);
+
+    // Reaches the far end of the edge leaving the node 'node' in 'direction', and the goal if it is part way along that edge
+    // Returns false if the open list is full
+    bool ReachAlong(int node, char direction);
+
+    // Adds the start tile (x, y) to the open list, without leaving it in 'blockedDir'
+    // Returns false if the tile isn't part of the graph or the open list is full
+    bool AddStart(int x, int y, char blockedDir);
+
+    // Returns the direction to move from 'tile' if it is on 'path', otherwise returns 0x0
+    char FollowPath(Position tile, char lastDir, MazePath* path);
+
+public:
+    // Constructs a path finder for the given maze, searching over 'graph' (which must have been built from the same maze)
+    // The path finder is added as a listener to the maze so that it knows when a new layout is loaded
+    PathFinder(Maze* maze, MazeGraph* graph);
+
+    // Empties the path so that the next 'GetNextDirection' runs a new search
+    static void ClearPath(MazePath* path);
+
+    // Runs A* from 'start' to 'goal' without leaving 'start' in 'blockedDir', then stores the result in 'path'
+    // Returns false if there is no path
+    bool FindPath(Position start, Position goal, char blockedDir, MazePath* path);
+
+    // Returns the direction to move from 'tile' to get one step closer to 'goal' without turning back on 'lastDir'
+    // The path is kept in 'path' and only searched for again when 'goal' changes or the follower leaves it
+    // Returns 0x0 if the follower is at the goal or can't reach it
+    char GetNextDirection(Position tile, Position goal, char lastDir, MazePath* path);
+
+    // Returns the number of searches run so far
+    int GetSearchCount();
+
+    // Pellets don't change any paths, so these do nothing
+    void OnPelletRemoved(int x, int y);
+    void OnPelletsReset();
+
+    // Called by the maze when a new layout is loaded
+    void OnMazeLoaded();
+};
+
+/* PATH FINDER CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns the number of steps from the tile (x, y) to 'goal' if there were no walls
+int PathFinder::GetEstimate(int x, int y, Position goal)
+{
+    int dx = abs(x - goal.x);
+    int dy = abs(y - goal.y);
+
+    // Going the other way round through the tunnel might be shorter
+    if (WIDTH - dx < dx)
+    {
+        dx = WIDTH - dx;
+    }
+
+    return dx + dy;
+}
+
+// Returns the tile the given place is at
+Position PathFinder::GetPlaceTile(int place)
+{
+    if (place == MAX_GRAPH_NODES)
+    {
+        return _goal;
+    }
+
+    return _graph->GetNode(place)->tile;
+}
+
+// Returns the direction to step in to get from the tile 'from' to the tile 'to' next to it (0x0 if they aren't next to each other)
+char PathFinder::GetStepDirection(Position from, Position to)
+{
+    for (char direction = NORTH; direction <= WEST; direction <<= 1)
+    {
+        Position next = _maze->GetAdjacentTilePos(from.x, from.y, direction);
+
+        if (next.x == to.x && next.y == to.y)
+        {
+            return direction;
+        }
+    }
+
+    return 0x0;
+}
+
+// Reaches 'place' with 'cost' steps, from the place 'from' along the edge 'edge' between the given steps
+// Adds the place to the open list if that is the shortest way to it so far
+// Returns false if the open list is full
+bool PathFinder::Reach(int place, int cost, int from, int edge, int fromStep, int toStep)
+{
+    if (_closed.Test(place) || cost >= _cost[place])
+    {
+        return true;
+    }
+
+    _cost[place] = cost;
+    _cameFrom[place] = from;
+    _cameAlong[place] = edge;
+    _cameFromStep[place] = fromStep;
+    _cameToStep[place] = toStep;
+
+    Position tile = GetPlaceTile(place);
+    int bucket = cost + GetEstimate(tile.x, tile.y, _goal);
+
+    if (_entryCount >= PATH_MAX_ENTRIES || bucket >= PATH_MAX_COST)
+    {
+        return false;
+    }
+
+    _entryPlace[_entryCount] = place;
+    _entryNext[_entryCount] = _bucketHead[bucket];
+    _bucketHead[bucket] = _entryCount;
+    _entryCount++;
+
+    return true;
+}
+
+// Reaches the far end of the edge leaving the node 'node' in 'direction', and the goal if it is part way along that edge
+// Returns false if the open list is full
+bool PathFinder::ReachAlong(int node, char direction)
+{
+    int edge = _graph->GetNode(node)->edges[MazeGraph::DirectionIndex(direction)];
+
+    if (edge == -1)
+    {
+        return true;
+    }
+
+    MazeGraphEdge* walked = _graph->GetEdge(edge);
+
+    // A corridor that loops back to the same node has that node at both ends, so the direction says which end it was left from
+    bool fromA = walked->nodeA == node && walked->dirA == direction;
+    int fromStep = fromA ? 0 : walked->length;
+    int toStep = fromA ? walked->length : 0;
+    int cost = _cost[node];
+
+    if (edge == _goalEdge && !Reach(MAX_GRAPH_NODES, cost + abs(_goalStep - fromStep), node, edge, fromStep, _goalStep))
+    {
+        return false;
+    }
+
+    return Reach(fromA ? walked->nodeB : walked->nodeA, cost + walked->length, node, edge, fromStep, toStep);
+}
+
+// Adds the start tile (x, y) to the open list, without leaving it in 'blockedDir'
+// Returns false if the tile isn't part of the graph or the open list is full
+bool PathFinder::AddStart(int x, int y, char blockedDir)
+{
+    int node = _graph->GetNodeAt(x, y);
+
+    if (node != -1)
+    {
+        return Reach(node, 0, -1, -1, -1, -1);
+    }
+
+    int edge = _graph->GetEdgeAt(x, y);
+
+    if (edge == -1)
+    {
+        return false;
+    }
+
+    MazeGraphEdge* startEdge = _graph->GetEdge(edge);
+    int step = _graph->GetEdgeStep(edge, x, y);
+
+    Position start = _graph->GetStepTile(edge, step);
+    bool towardsA = GetStepDirection(start, _graph->GetStepTile(edge, step - 1)) != blockedDir;
+    bool towardsB = GetStepDirection(start, _graph->GetStepTile(edge, step + 1)) != blockedDir;
+
+    // The goal might be further along the same corridor
+    if (edge == _goalEdge && ((_goalStep < step && towardsA) || (_goalStep > step && towardsB)) &&
+        !Reach(MAX_GRAPH_NODES, abs(_goalStep - step), -1, edge, step, _goalStep))
+    {
+        return false;
+    }
+
+    if (towardsA && !Reach(startEdge->nodeA, step, -1, edge, step, 0))
+    {
+        return false;
+    }
+
+    if (towardsB && !Reach(startEdge->nodeB, startEdge->length - step, -1, edge, step, startEdge->length))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Runs A* from 'start' to 'goal' without leaving 'start' in 'blockedDir', then stores the result in 'path'
+// Returns false if there is no path
+bool PathFinder::FindPath(Position start, Position goal, char blockedDir, MazePath* path)
+{
+    _searchCount++;
+    ClearPath(path);
+
+    if (!_maze->IsFloor(start.x, start.y) || !_maze->IsFloor(goal.x, goal.y))
+    {
+        return false;
+    }
+
+    // Already there
+    if (start.x == goal.x && start.y == goal.y)
+    {
+        path->goal = goal;
+        path->tile = start;
+        path->mazeVersion = _mazeVersion;
+        return true;
+    }
+
+    // The goal is a place of its own when it is part way along a corridor
+    int goalPlace = _graph->GetNodeAt(goal.x, goal.y);
+
+    _goal = goal;
+    _goalEdge = goalPlace == -1 ? _graph->GetEdgeAt(goal.x, goal.y) : -1;
+    _goalStep = _goalEdge == -1 ? -1 : _graph->GetEdgeStep(_goalEdge, goal.x, goal.y);
+
+    if (goalPlace == -1)
+    {
+        goalPlace = MAX_GRAPH_NODES;
+    }
+
+    // Reset the open list, closed set and costs
+    memset(_bucketHead, 0xFF, sizeof(_bucketHead));
+    _closed.Clear();
+    memset(_cost, 0x7F, sizeof(_cost));
+    _entryCount = 0;
+
+    if (!AddStart(start.x, start.y, blockedDir))
+    {
+        return false;
+    }
+
+    bool found = false;
+    int startNode = _graph->GetNodeAt(start.x, start.y);
+    int bucket = GetEstimate(start.x, start.y, goal);
+
+    while (!found && bucket < PATH_MAX_COST)
+    {
+        // Move along to the next bucket once this one is empty
+        int entry = _bucketHead[bucket];
+
+        if (entry == -1)
+        {
+            bucket++;
+            continue;
+        }
+
+        _bucketHead[bucket] = _entryNext[entry];
+
+        int place = _entryPlace[entry];
+
+        // Skip places that were added again after a shorter way to them was found
+        if (_closed.Test(place))
+        {
+            continue;
+        }
+
+        _closed.Set(place);
+
+        if (place == goalPlace)
+        {
+            found = true;
+            break;
+        }
+
+        // A goal part way along a corridor is only ever reached, never left
+        if (place == MAX_GRAPH_NODES)
+        {
+            continue;
+        }
+
+        for (char direction = NORTH; direction <= WEST; direction <<= 1)
+        {
+            if (place == startNode && direction == blockedDir)
+            {
+                continue;
+            }
+
+            if (!ReachAlong(place, direction))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    // Walk back from the goal to the start, filling in the directions from the end of the path
+    int length = _cost[goalPlace];
+
+    if (length > MAX_FLOOR_TILES)
+    {
+        return false;
+    }
+
+    int i = length;
+
+    for (int place = goalPlace; place != -1; place = _cameFrom[place])
+    {
+        int edge = _cameAlong[place];
+
+        if (edge == -1)
+        {
+            continue;
+        }
+
+        int from = _cameFromStep[place];
+        int sign = _cameToStep[place] > from ? 1 : -1;
+
+        for (int step = _cameToStep[place]; step != from; step -= sign)
+        {
+            i--;
+            path->directions[i] = GetStepDirection(_graph->GetStepTile(edge, step - sign), _graph->GetStepTile(edge, step));
+        }
+    }
+
+    path->goal = goal;
+    path->tile = start;
+    path->length = length;
+    path->step = 0;
+    path->mazeVersion = _mazeVersion;
+
+    return true;
+}
+
+// Returns the direction to move from 'tile' if it is on 'path', otherwise returns 0x0
+char PathFinder::FollowPath(Position tile, char lastDir, MazePath* path)
+{
+    if (path->mazeVersion != _mazeVersion)
+    {
+        return 0x0;
+    }
+
+    // The follower doesn't check in on every tile (e.g. along corridors), so look ahead along the path for it
+    Position pathTile = path->tile;
+
+    for (int i = path->step; i < path->length; i++)
+    {
+        if (pathTile.x == tile.x && pathTile.y == tile.y)
+        {
+            // Following the path would mean turning back, so it needs searching for again
+            if (path->directions[i] == OppositeDirection(lastDir))
+            {
+                return 0x0;
+            }
+
+            path->tile = pathTile;
+            path->step = i;
+            return path->directions[i];
+        }
+
+        pathTile = _maze->GetAdjacentTilePos(pathTile.x, pathTile.y, path->directions[i]);
+    }
+
+    return 0x0;
+}
+
+// Constructs a path finder for the given maze, searching over 'graph' (which must have been built from the same maze)
+// The path finder is added as a listener to the maze so that it knows when a new layout is loaded
+PathFinder::PathFinder(Maze* maze, MazeGraph* graph)
+{
+    _maze = maze;
+    _graph = graph;
+    _mazeVersion = 0;
+    _searchCount = 0;
+    _entryCount = 0;
+
+    _maze->AddListener(this);
+}
+
+// Empties the path so that the next 'GetNextDirection' runs a new search
+void PathFinder::ClearPath(MazePath* path)
+{
+    path->goal.x = -1;
+    path->goal.y = -1;
+    path->tile = path->goal;
+    path->length = 0;
+    path->step = 0;
+    path->mazeVersion = -1;
+}
+
+// Returns the direction to move from 'tile' to get one step closer to 'goal' without turning back on 'lastDir'
+// The path is kept in 'path' and only searched for again when 'goal' changes or the follower leaves it
+// Returns 0x0 if the follower is at the goal or can't reach it
+char PathFinder::GetNextDirection(Position tile, Position goal, char lastDir, MazePath* path)
+{
+    goal = _maze->GetNearestFloorTile(goal.x, goal.y);
+
+    if (goal.x == path->goal.x && goal.y == path->goal.y)
+    {
+        char direction = FollowPath(tile, lastDir, path);
+
+        if (direction != 0x0)
+        {
+            return direction;
+        }
+    }
+
+    if (!FindPath(tile, goal, OppositeDirection(lastDir), path) || path->length == 0)
+    {
+        return 0x0;
+    }
+
+    return path->directions[0];
+}
+
+// Returns the number of searches run so far
+int PathFinder::GetSearchCount()
+{
+    return _searchCount;
+}
+
+// Pellets don't change any paths, so these do nothing
+void PathFinder::OnPelletRemoved(int, int)
+{
+}
+
+void PathFinder::OnPelletsReset()
+{
+}
+
+// Called by the maze when a new layout is loaded
+void PathFinder::OnMazeLoaded()
+{
+    _mazeVersion++;
+}
+
+/* MAZE GENERATOR H */
+//////////////////////////////////////////////////////////////
+
+// Size of the lattice of junctions that generated mazes are built on
+#define GENERATOR_COLUMNS 8
+#define GENERATOR_ROWS 10
+
+// Percentage chance of each optional corridor being removed when generating a maze
+#define GENERATOR_REMOVE_CHANCE 55
+
+// Number of times to try generating a maze before giving up
+#define GENERATOR_MAX_ATTEMPTS 32
+
+/*
+This class generates random Pacman style mazes in the same format as the '_maze' and '_pellets' arrays in 'Maze'
+
+Mazes are built on a lattice of possible junctions:
+    - Every corridor between two neighbouring junctions starts switched on
+    - Corridors are then removed in a random order, each removal being mirrored so the maze stays symmetrical
+    - Removals that would leave a dead end or split the maze in two are undone
+
+The ghost house, the tunnel and the player start position are in the same places as in the classic maze so the rest of the game works unchanged
+Every maze is checked with 'IsValid()' before being returned
+
+The same seed always gives the same sequence of mazes
+*/
+class MazeGenerator
+{
+private:
+    uint32_t _random;
+
+    // Corridors between each pair of neighbouring junctions
+    // '_horizontal[r][c]' joins lattice column c to column c + 1 on lattice row r
+    // '_vertical[r][c]' joins lattice row r to row r + 1 on lattice column c
+    bool _horizontal[GENERATOR_ROWS][GENERATOR_COLUMNS - 1];
+    bool _vertical[GENERATOR_ROWS - 1][GENERATOR_COLUMNS];
+
+    // Returns the next number from the random number generator (xorshift)
+    uint32_t NextRandom();
+
+    // Returns true if the given corridor has to stay (ghost house, tunnel and player start)
+    static bool IsForced(bool horizontal, int r, int c);
+
+    // Returns true if the given corridor must never be added (inside the ghost house)
+    static bool IsForbidden(bool horizontal, int r, int c);
+
+    // Returns the number of corridors joined to the junction at lattice position (r, c), including the tunnel
+    int GetDegree(int r, int c);
+
+    // Switches the given corridor and its mirror image on or off
+    void SetCorridor(bool horizontal, int r, int c, bool on);
+
+    // Returns true if every junction with a corridor can reach every other one
+    bool IsConnected();
+
+    // Tries to remove the given corridor (and its mirror image) without leaving dead ends or splitting the maze
+    // If it can't, the corridor is left switched on and false is returned
+    bool TryRemoveCorridor(bool horizontal, int r, int c);
+
+    // Draws the switched on corridors into the maze and pellet arrays
+    void Rasterise(int maze[], int pellets[]);
+
+public:
+    // Constructs a generator with the given seed
+    MazeGenerator(uint32_t seed);
+
+    // Generates the next maze and stores it in 'maze' and 'pellets', which must both have 'HEIGHT' rows
+    // Returns false if no valid maze could be made in 'GENERATOR_MAX_ATTEMPTS' tries
+    bool Generate(int maze[], int pellets[]);
+
+    // Returns true if the given maze is symmetrical, fully connected, has no dead ends or wide corridors, has the ghost house and has at least one tunnel
+    static bool IsValid(const int maze[]);
+
+    // Returns the given maze row mirrored left to right
+    static int MirrorRow(int row);
+};
+
+/* MAZE GENERATOR CPP */
+//////////////////////////////////////////////////////////////
+
+// Tile positions of the lattice junctions
+static const char GeneratorColumns[GENERATOR_COLUMNS] = { 1, 5, 9, 12, 15, 18, 22, 26 };
+static const char GeneratorRows[GENERATOR_ROWS] = { 2, 5, 8, 12, 14, 16, 19, 22, 25, 28 };
+
+// Returns the next number from the random number generator (xorshift)
+uint32_t MazeGenerator::NextRandom()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+// Returns true if the given corridor has to stay (ghost house, tunnel and player start)
+bool MazeGenerator::IsForced(bool horizontal, int r, int c)
+{
+    int row = GeneratorRows[r];
+    int column = GeneratorColumns[c];
+
+    if (horizontal)
+    {
+        int end = GeneratorColumns[c + 1];
+
+        // Corridors along the top and bottom of the ghost house
+        if ((row == GHOST_HOUSE_TOP || row == GHOST_HOUSE_BOTTOM) && column >= GHOST_HOUSE_LEFT && end <= GHOST_HOUSE_RIGHT)
+        {
+            return true;
+        }
+
+        // Tunnel on either side of the ghost house
+        if (row == TUNNEL_ROW && (end <= GHOST_HOUSE_LEFT || column >= GHOST_HOUSE_RIGHT))
+        {
+            return true;
+        }
+
+        // Corridor the player starts in
+        return row == PLAYER_START_Y && column <= PLAYER_START_X && end > PLAYER_START_X;
+    }
+    else
+    {
+        // Corridors down the sides of the ghost house
+        int end = GeneratorRows[r + 1];
+        return (column == GHOST_HOUSE_LEFT || column == GHOST_HOUSE_RIGHT) && row >= GHOST_HOUSE_TOP && end <= GHOST_HOUSE_BOTTOM;
+    }
+}
+
+// Returns true if the given corridor must never be added (inside the ghost house)
+bool MazeGenerator::IsForbidden(bool horizontal, int r, int c)
+{
+    int row = GeneratorRows[r];
+    int column = GeneratorColumns[c];
+
+    if (horizontal)
+    {
+        return row > GHOST_HOUSE_TOP && row < GHOST_HOUSE_BOTTOM && column >= GHOST_HOUSE_LEFT && GeneratorColumns[c + 1] <= GHOST_HOUSE_RIGHT;
+    }
+    else
+    {
+        return column > GHOST_HOUSE_LEFT && column < GHOST_HOUSE_RIGHT && row >= GHOST_HOUSE_TOP && GeneratorRows[r + 1] <= GHOST_HOUSE_BOTTOM;
+    }
+}
+
+// Returns the number of corridors joined to the junction at lattice position (r, c), including the tunnel
+int MazeGenerator::GetDegree(int r, int c)
+{
+    int degree = 0;
+
+    if (c > 0)
+    {
+        degree += _horizontal[r][c - 1];
+    }
+    if (c < GENERATOR_COLUMNS - 1)
+    {
+        degree += _horizontal[r][c];
+    }
+    if (r > 0)
+    {
+        degree += _vertical[r - 1][c];
+    }
+    if (r < GENERATOR_ROWS - 1)
+    {
+        degree += _vertical[r][c];
+    }
+
+    // The outside junctions on the tunnel row are joined to each other through the tunnel
+    if (GeneratorRows[r] == TUNNEL_ROW && (c == 0 || c == GENERATOR_COLUMNS - 1))
+    {
+        degree++;
+    }
+
+    return degree;
+}
+
+// Switches the given corridor and its mirror image on or off
+void MazeGenerator::SetCorridor(bool horizontal, int r, int c, bool on)
+{
+    if (horizontal)
+    {
+        _horizontal[r][c] = on;
+        _horizontal[r][GENERATOR_COLUMNS - 2 - c] = on;
+    }
+    else
+    {
+        _vertical[r][c] = on;
+        _vertical[r][GENERATOR_COLUMNS - 1 - c] = on;
+    }
+}
+
+// Returns true if every junction with a corridor can reach every other one
+bool MazeGenerator::IsConnected()
+{
+    bool visited[GENERATOR_ROWS][GENERATOR_COLUMNS];
+    char queue[GENERATOR_ROWS * GENERATOR_COLUMNS];
+    int head = 0;
+    int tail = 0;
+    int junctions = 0;
+
+    for (int r = 0; r < GENERATOR_ROWS; r++)
+    {
+        for (int c = 0; c < GENERATOR_COLUMNS; c++)
+        {
+            visited[r][c] = false;
+
+            if (GetDegree(r, c) > 0)
+            {
+                junctions++;
+
+                // Start the search from the first junction found
+                if (tail == 0)
+                {
+                    visited[r][c] = true;
+                    queue[tail] = (r * GENERATOR_COLUMNS) + c;
+                    tail++;
+                }
+            }
+        }
+    }
+
+    while (head < tail)
+    {
+        int r = queue[head] / GENERATOR_COLUMNS;
+        int c = queue[head] % GENERATOR_COLUMNS;
+        head++;
+
+        // Neighbouring junctions that are joined to this one
+        int neighbours[5];
+        int count = 0;
+
+        if (c > 0 && _horizontal[r][c - 1])
+        {
+            neighbours[count++] = queue[head - 1] - 1;
+        }
+        if (c < GENERATOR_COLUMNS - 1 && _horizontal[r][c])
+        {
+            neighbours[count++] = queue[head - 1] + 1;
+        }
+        if (r > 0 && _vertical[r - 1][c])
+        {
+            neighbours[count++] = queue[head - 1] - GENERATOR_COLUMNS;
+        }
+        if (r < GENERATOR_ROWS - 1 && _vertical[r][c])
+        {
+            neighbours[count++] = queue[head - 1] + GENERATOR_COLUMNS;
+        }
+        if (GeneratorRows[r] == TUNNEL_ROW && (c == 0 || c == GENERATOR_COLUMNS - 1))
+        {
+            neighbours[count++] = (r * GENERATOR_COLUMNS) + (GENERATOR_COLUMNS - 1 - c);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int nr = neighbours[i] / GENERATOR_COLUMNS;
+            int nc = neighbours[i] % GENERATOR_COLUMNS;
+
+            if (!visited[nr][nc])
+            {
+                visited[nr][nc] = true;
+                queue[tail] = neighbours[i];
+                tail++;
+            }
+        }
+    }
+
+    return tail == junctions;
+}
+
+// Tries to remove the given corridor (and its mirror image) without leaving dead ends or splitting the maze
+// If it can't, the corridor is left switched on and false is returned
+bool MazeGenerator::TryRemoveCorridor(bool horizontal, int r, int c)
+{
+    if (IsForced(horizontal, r, c) || (horizontal ? !_horizontal[r][c] : !_vertical[r][c]))
+    {
+        return false;
+    }
+
+    SetCorridor(horizontal, r, c, false);
+
+    // Any junction left with a single corridor would be a dead end
+    bool ok = true;
+
+    for (int jr = 0; jr < GENERATOR_ROWS && ok; jr++)
+    {
+        for (int jc = 0; jc < GENERATOR_COLUMNS && ok; jc++)
+        {
+            ok = GetDegree(jr, jc) != 1;
+        }
+    }
+
+    if (ok && IsConnected())
+    {
+        return true;
+    }
+
+    // Put the corridor back
+    SetCorridor(horizontal, r, c, true);
+    return false;
+}
+
+// Draws the switched on corridors into the maze and pellet arrays
+void MazeGenerator::Rasterise(int maze[], int pellets[])
+{
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        maze[y] = 0x0;
+    }
+
+    for (int r = 0; r < GENERATOR_ROWS; r++)
+    {
+        for (int c = 0; c < GENERATOR_COLUMNS - 1; c++)
+        {
+            if (_horizontal[r][c])
+            {
+                // Set every bit from the left junction to the right junction
+                int length = GeneratorColumns[c + 1] - GeneratorColumns[c] + 1;
+                maze[(int)GeneratorRows[r]] |= ((0x1 << length) - 1) << GeneratorColumns[c];
+            }
+        }
+    }
+
+    for (int r = 0; r < GENERATOR_ROWS - 1; r++)
+    {
+        for (int c = 0; c < GENERATOR_COLUMNS; c++)
+        {
+            if (_vertical[r][c])
+            {
+                for (int y = GeneratorRows[r]; y <= GeneratorRows[r + 1]; y++)
+                {
+                    maze[y] |= 0x1 << GeneratorColumns[c];
+                }
+            }
+        }
+    }
+
+    // Tunnel mouths on the edges of the maze
+    maze[TUNNEL_ROW] |= 0x1 | (0x1 << (WIDTH - 1));
+
+    // Pellets go everywhere except around the ghost house, along the tunnel and where the player starts
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        pellets[y] = maze[y];
+
+        if (y == TUNNEL_ROW)
+        {
+            pellets[y] = 0x0;
+        }
+        else if (y > GHOST_HOUSE_TOP - 3 && y < GHOST_HOUSE_BOTTOM + 3)
+        {
+            pellets[y] &= ~(((0x1 << (GHOST_HOUSE_RIGHT - GHOST_HOUSE_LEFT + 5)) - 1) << (GHOST_HOUSE_LEFT - 2));
+        }
+    }
+
+    pellets[PLAYER_START_Y] &= ~(0x1 << PLAYER_START_X);
+}
+
+// Constructs a generator with the given seed
+MazeGenerator::MazeGenerator(uint32_t seed)
+{
+    // xorshift gets stuck on 0, so avoid it
+    _random = seed != 0 ? seed : 0x9E3779B9;
+}
+
+// Generates the next maze and stores it in 'maze' and 'pellets', which must both have 'HEIGHT' rows
+// Returns false if no valid maze could be made in 'GENERATOR_MAX_ATTEMPTS' tries
+bool MazeGenerator::Generate(int maze[], int pellets[])
+{
+    // Corridors on the left half of the lattice plus the ones crossing the middle, the rest are mirror images
+    // Stored as (horizontal, r, c) packed into a short
+    short corridors[(GENERATOR_ROWS * (GENERATOR_COLUMNS / 2)) * 2];
+
+    for (int attempt = 0; attempt < GENERATOR_MAX_ATTEMPTS; attempt++)
+    {
+        int count = 0;
+
+        // Start with every corridor switched on
+        for (int r = 0; r < GENERATOR_ROWS; r++)
+        {
+            for (int c = 0; c < GENERATOR_COLUMNS; c++)
+            {
+                if (c < GENERATOR_COLUMNS - 1)
+                {
+                    _horizontal[r][c] = !IsForbidden(true, r, c);
+
+                    if (c < GENERATOR_COLUMNS / 2 && !IsForced(true, r, c) && _horizontal[r][c])
+                    {
+                        corridors[count++] = 0x1000 | (r << 4) | c;
+                    }
+                }
+
+                if (r < GENERATOR_ROWS - 1)
+                {
+                    _vertical[r][c] = !IsForbidden(false, r, c);
+
+                    if (c < GENERATOR_COLUMNS / 2 && !IsForced(false, r, c) && _vertical[r][c])
+                    {
+                        corridors[count++] = (r << 4) | c;
+                    }
+                }
+            }
+        }
+
+        // Shuffle the corridors (Fisher-Yates)
+        for (int i = count - 1; i > 0; i--)
+        {
+            int j = NextRandom() % (i + 1);
+            short temp = corridors[i];
+            corridors[i] = corridors[j];
+            corridors[j] = temp;
+        }
+
+        // Try removing some of them
+        for (int i = 0; i < count; i++)
+        {
+            if ((int)(NextRandom() % 100) < GENERATOR_REMOVE_CHANCE)
+            {
+                TryRemoveCorridor((corridors[i] & 0x1000) != 0, (corridors[i] >> 4) & 0xF, corridors[i] & 0xF);
+            }
+        }
+
+        Rasterise(maze, pellets);
+
+        if (IsValid(maze))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns the given maze row mirrored left to right
+int MazeGenerator::MirrorRow(int row)
+{
+    int mirrored = 0x0;
+
+    for (int x = 0; x < WIDTH; x++)
+    {
+        mirrored |= ((row >> x) & 0x1) << (WIDTH - 1 - x);
+    }
+
+    return mirrored;
+}
+
+// Returns true if the given maze is symmetrical, fully connected, has no dead ends or wide corridors, has the ghost house and has at least one tunnel
+bool MazeGenerator::IsValid(const int maze[])
+{
+    const int rowMask = (int)((0x1u << WIDTH) - 1);
+    bool hasTunnel = false;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        int row = maze[y];
+
+        // Symmetrical and inside the maze
+        if ((row & ~rowMask) != 0 || MirrorRow(row) != row)
+        {
+            return false;
+        }
+
+        // Floor either side of each tile, wrapping around through the tunnel
+        int north = y > 0 ? maze[y - 1] : 0x0;
+        int south = y < HEIGHT - 1 ? maze[y + 1] : 0x0;
+        int east = (row >> 1) | ((row & 0x1) << (WIDTH - 1));
+        int west = ((row << 1) | ((row >> (WIDTH - 1)) & 0x1)) & rowMask;
+
+        // Every floor tile needs at least two floor neighbours
+        int atLeastTwo = (north & south) | (north & east) | (north & west) | (south & east) | (south & west) | (east & west);
+        if ((row & ~atLeastTwo) != 0)
+        {
+            return false;
+        }
+
+        // No 2x2 blocks of floor (corridors are one tile wide)
+        if ((row & south & (row >> 1) & (south >> 1)) != 0)
+        {
+            return false;
+        }
+
+        hasTunnel |= (row & 0x1) && ((row >> (WIDTH - 1)) & 0x1);
+    }
+
+    if (!hasTunnel || BitboardSearch::CountTiles(maze) > MAX_FLOOR_TILES)
+    {
+        return false;
+    }
+
+    // Ghost house: corridors all the way around the outside and walls on the inside
+    int houseWidth = GHOST_HOUSE_RIGHT - GHOST_HOUSE_LEFT + 1;
+    int houseRow = ((0x1 << houseWidth) - 1) << GHOST_HOUSE_LEFT;
+    int houseSides = (0x1 << GHOST_HOUSE_LEFT) | (0x1 << GHOST_HOUSE_RIGHT);
+
+    if ((maze[GHOST_HOUSE_TOP] & houseRow) != houseRow || (maze[GHOST_HOUSE_BOTTOM] & houseRow) != houseRow)
+    {
+        return false;
+    }
+
+    for (int y = GHOST_HOUSE_TOP + 1; y < GHOST_HOUSE_BOTTOM; y++)
+    {
+        if ((maze[y] & houseRow) != houseSides)
+        {
+            return false;
+        }
+    }
+
+    // The player start must be a floor tile
+    if (!((maze[PLAYER_START_Y] >> PLAYER_START_X) & 0x1))
+    {
+        return false;
+    }
+
+    // Fully connected
+    return BitboardSearch::IsConnected(maze);
+}
+
+/* PLAYER H */
+//////////////////////////////////////////////////////////////
+class Player : public BaseGameSprite
+{
+private:
+	Maze* _maze;
+	int _lives;
+    int _score;
+    int _level;
+
+	char _nextDir;
+
+    bool _mouthOpen;
+
+    // When true, the player is steered by '_inputDir' rather than the touchscreen
+    bool _externalInput;
+    char _inputDir;
+
+    // Hash to keep up to date with the player's state, and the key currently included in it
+    ZobristHash* _zobrist;
+    uint64_t _zobristKey;
+
+    // Swaps the player's key in '_zobrist' for one matching its current position, directions, score, lives and level
+    void UpdateZobrist();
+
+    // Stores the player's position and directions in 'state'
+    void SaveActorState(ActorState* state);
+
+	void SetDirection();
+
+    // Returns true if the touchscreen is being touched, or always when using external input (so the start screens are skipped)
+    bool HasInput();
+
+public:
+	char lastDir;
+
+	Player(Maze* maze, int x, int y);
+
+    // Steers the player with 'SetInput' instead of the touchscreen (e.g. for an agent being trained)
+    void SetExternalInput(bool enabled);
+
+    // Sets the direction the player should try to turn in next (0x0 for no input)
+    // Only used when external input is turned on
+    void SetInput(char direction);
+
+    // Forgets which way the player was moving, as if it had just been constructed
+    // Used by headless games so every game starts the same no matter how the last one ended
+    void ResetMovement();
+
+    // Stores the player's position, directions, score, lives and level in 'state'
+    void SaveState(GameState* state);
+
+    // Puts the player's position, directions, score, lives and level back from 'state'
+    void LoadState(const GameState* state);
+
+    // Keeps the given hash up to date with the player's state (NULL to stop)
+    void SetZobristHash(ZobristHash* zobrist);
+
+    // Copies the player's position and directions into the state returned by 'GetPreviousState'
+    void PublishState();
+
+    // Returns the number of pixels the player will move next tick (if nothing is in the way)
+    int GetNextSteps();
+
+    int GetScore();
+
+    int GetLives();
+
+    int GetLevel();
+
+	void Init();
+
+	void Update();
+
+	void Draw();
+};
+
+/* PLAYER CPP */
+//////////////////////////////////////////////////////////////
+void Player::SetDirection()
+{
+    if (_externalInput)
+    {
+        if (_inputDir != 0x0)
+        {
+            _nextDir = _inputDir;
+        }
+        return;
+    }
+
+    if(context->tsState.touchDetected) {
+        /* Get X and Y position of the first touch post calibrated */
+        uint16_t x1 = context->tsState.touchX[0];
+        uint16_t y1 = context->tsState.touchY[0];
+
+        // Get difference in x and y of the player character and the player's input
+        int xDiff = (position.x) - x1;
+        int yDiff = (position.y) - y1;
+
+        // Find which has direction the greatest absolute value
+        if (abs(xDiff) >= abs(yDiff))
+        {
+            // More differece in the horizontal plane
+            // Check if direction was EAST or WEST of the player
+            if (xDiff < 0)
+            {
+                _nextDir = EAST;
+            }
+            else 
+            {
+                _nextDir = WEST;
+            }
+        }
+        else 
+        {
+            // More differece in the vertical plane
+            // Check if direction was NORTH or SOUTH of the player
+            if (yDiff < 0)
+            {
+                _nextDir = SOUTH;
+            }
+            else
+            {
+                _nextDir = NORTH;
+            }
+        }
+    }
+
+}
+
+
+Player::Player(Maze* maze, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
+{
+	_maze = maze;
+	_nextDir = 0x0;
+	lastDir = EAST;
+    _externalInput = false;
+    _inputDir = 0x0;
+    _zobrist = NULL;
+    _zobristKey = 0;
+    _score = 0;
+    _lives = 3;
+    _level = 1;
+    _mouthOpen = false;
+
+    PublishState();
+}
+
+// Returns true if the touchscreen is being touched, or always when using external input (so the start screens are skipped)
+bool Player::HasInput()
+{
+    return _externalInput || context->tsState.touchDetected;
+}
+
+// Steers the player with 'SetInput' instead of the touchscreen (e.g. for an agent being trained)
+void Player::SetExternalInput(bool enabled)
+{
+    _externalInput = enabled;
+}
+
+// Sets the direction the player should try to turn in next (0x0 for no input)
+// Only used when external input is turned on
+void Player::SetInput(char direction)
+{
+    _inputDir = direction;
+}
+
+// Forgets which way the player was moving, as if it had just been constructed
+// Used by headless games so every game starts the same no matter how the last one ended
+void Player::ResetMovement()
+{
+    _nextDir = 0x0;
+    _inputDir = 0x0;
+    lastDir = EAST;
+    _mouthOpen = false;
+    _subPixel = 0;
+    _moveStart = position;
+    UpdateZobrist();
+    PublishState();
+}
+
+// Stores the player's position, directions, score, lives and level in 'state'
+void Player::SaveState(GameState* state)
+{
+    SaveActorState(&state->player);
+    state->score = _score;
+    state->lives = _lives;
+    state->level = _level;
+}
+
+// Puts the player's position, directions, score, lives and level back from 'state'
+void Player::LoadState(const GameState* state)
+{
+    position = state->player.position;
+    _moveStart = state->player.moveStart;
+    _subPixel = state->player.subPixel;
+    lastDir = state->player.lastDir;
+    _nextDir = state->player.nextDir;
+    _mouthOpen = state->player.animationFrame;
+    _score = state->score;
+    _lives = state->lives;
+    _level = state->level;
+    UpdateZobrist();
+    PublishState();
+}
+
+// Swaps the player's key in '_zobrist' for one matching its current position, directions, score, lives and level
+void Player::UpdateZobrist()
+{
+    if (_zobrist == NULL)
+    {
+        return;
+    }
+
+    ActorState state;
+    SaveActorState(&state);
+
+    uint64_t key = ZobristHash::GetActorKey(ZOBRIST_PLAYER, &state);
+    key ^= ZobristHash::GetKey(ZOBRIST_SCORE, _score);
+    key ^= ZobristHash::GetKey(ZOBRIST_LIVES, _lives);
+    key ^= ZobristHash::GetKey(ZOBRIST_LEVEL, _level);
+
+    _zobrist->Toggle(_zobristKey ^ key);
+    _zobristKey = key;
+}
+
+// Keeps the given hash up to date with the player's state (NULL to stop)
+void Player::SetZobristHash(ZobristHash* zobrist)
+{
+    // Take the player's key back out of the old hash before adding it to the new one
+    if (_zobrist != NULL)
+    {
+        _zobrist->Toggle(_zobristKey);
+    }
+
+    _zobrist = zobrist;
+    _zobristKey = 0;
+    UpdateZobrist();
+}
+
+// Stores the player's position and directions in 'state'
+void Player::SaveActorState(ActorState* state)
+{
+    state->position = position;
+    state->moveStart = _moveStart;
+    state->lastDir = lastDir;
+    state->nextDir = _nextDir;
+    state->animationFrame = _mouthOpen;
+    state->subPixel = (uint8_t)_subPixel;
+}
+
+// Copies the player's position and directions into the state returned by 'GetPreviousState'
+void Player::PublishState()
+{
+    SaveActorState(&_previousState);
+}
+
+// Returns the number of pixels the player will move next tick (if nothing is in the way)
+int Player::GetNextSteps()
+{
+    return (_subPixel + GetSpeeds(_level)->player) >> SPEED_SHIFT;
+}
+
+int Player::GetScore()
+{
+    return _score;
+}
+
+int Player::GetLives()
+{
+    return _lives;
+}
+
+int Player::GetLevel()
+{
+    return _level;
+}
+
+void Player::Init()
+{
+    _score = 0;
+    _lives = 10;
+}
+
+void Player::Update()
+{
+    switch (context->curGameState) {
+    case STARTUP:
+        Visible = true;
+        Init();
+        MoveToStartPosition();
+        _mouthOpen = false;
+
+        if(HasInput()) 
+        {
+            SetDirection();
+            context->nextGameState = PLAY;
+        }
+        break;
+    case CONTINUE:
+        MoveToStartPosition();
+        _mouthOpen = false;
+
+        if(HasInput()) 
+        {
+            SetDirection();
+            context->nextGameState = PLAY;
+        }
+        break;
+    case NEXT_LEVEL:
+        MoveToStartPosition();
+
+        if(HasInput()) 
+        {
+            SetDirection();
+            context->nextGameState = PLAY;
+        }
+        break;
+    case PLAY:
+    {
+        _maze->MarkForRedraw(position);
+
+        SetDirection();
+        SetSpeed(GetSpeeds(_level)->player);
+        _moveStart = position;
+
+        // Moves one pixel at a time so no tile (or pellet) is skipped over
+        int steps = TakeSteps();
+
+        for (int i = 0; i < steps; i++)
+        {
+            if (_maze->IsFloorAdjacentScreenPos(position, _nextDir))
+            {
+                UpdatePosition(_nextDir);
+                _score += _maze->TryRemovePelletScreenPos(position);
+                lastDir = _nextDir;
+                _nextDir = 0x0;
+            }
+            else if (_maze->IsFloorAdjacentScreenPos(position, lastDir))
+            {
+                UpdatePosition(lastDir);
+                _score += _maze->TryRemovePelletScreenPos(position);
+            }
+
+            if (_score == _maze->maxPellets * _level)
+            {
+                _level++;
+                context->nextGameState = NEXT_LEVEL;
+                break;
+            }
+        }
+
+        _mouthOpen = !_mouthOpen;
+
+        break;
+    }
+    case DEAD:
+        context->nextGameState = CONTINUE;
+        _lives--;
+        GAME_LOG(context, "Score = %d\nLives = %d\n", _score, _lives);
+
+        if (_lives == 0)
+        {
+            context->nextGameState = GAME_OVER;
+        }
+        break;
+    case GAME_OVER:
+        Visible = false;
+        _level = 1;
+    default:
+        Visible = false;
+        break;
+    }
+
+    UpdateZobrist();
+}
+
+void Player::Draw()
+{
+    //BSP_LCD_DrawPixel(position.x, position.y, LCD_COLOR_YELLOW);
+    // BSP_LCD_SetTextColor(LCD_COLOR_YELLOW);
+    // BSP_LCD_FillRect(position.x, position.y, TILE_SIZE, TILE_SIZE);
+
+    if (!_mouthOpen)
+    {
+        DrawSprite(SPRITE_PLAYER_CLOSED, LCD_COLOR_YELLOW);
+    }
+    else if (lastDir == NORTH)
+    {
+        DrawSpriteRotated90(SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+    else if (lastDir == WEST)
+    {
+        DrawSprite(SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+    else if (lastDir == SOUTH)
+    {
+        DrawSpriteRotated270(SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+    else if (lastDir == EAST)
+    {
+        DrawSpriteFlippedHorizontal(SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+
+    // Draw game state info at the top of the screen
+    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+    BSP_LCD_SetBackColor(LCD_COLOR_BLUE);  
+
+    // Big enough for a whole line of 'Font8' across the screen
+    char buffer[64];
+    if (context->curGameState == PLAY)
+    {
+        snprintf(buffer, sizeof(buffer), "  LEVEL %d  SCORE %d  LIVES %d   ", _level, _score, _lives);
+    }
+    else 
+    {
+        snprintf(buffer, sizeof(buffer), "     TOUCH SCREEN TO START...");
+    }
+    BSP_LCD_DisplayStringAtLine(0, (uint8_t *) buffer);
+}
+
+/* FLOW FIELD H */
+//////////////////////////////////////////////////////////////
+
+// What a 'FlowField' leads towards
+#define FLOW_TO_PLAYER 0
+#define FLOW_TO_PELLETS 1
+
+/*
+This class runs a single breadth first search out from a target and keeps the results for every actor to read
+
+Two grids are kept:
+    Distance grid   - Number of steps from each tile to the nearest target tile
+    Direction grid  - Direction to move from each tile to get one step closer to the target
+
+The search is only run when the field is read after its target has changed:
+When following the player, that is once the player has moved into a new tile
+When following the pellets, every pellet is a target and that is once a pellet has been eaten or the pellets are reset
+This means any number of actors can path towards the target for the cost of one search, rather than one search per actor per decision
+
+Chasing ghosts given a field ('Enemy::SetFlowField') follow its directions to the player
+
+NOTE: The player is read as it was at the end of the last tick, so every actor reading the field in a tick sees the same grids
+      no matter what order they are updated in
+*/
+class FlowField :
+    public MazeListener
+{
+private:
+    Maze* _maze;
+    Player* _player;
+    char _mode;
+
+    // Tile the search was last run from when following the player
+    Position _sourceTile;
+
+    // Set when the search needs running again
+    bool _dirty;
+
+    // Used like 2D arrays to store the results of the search
+    uint8_t _distance[HEIGHT][WIDTH];
+    char _direction[HEIGHT][WIDTH];
+
+    // Runs the search out from every tile marked in the 'targets' bitboard
+    void Search(int targets[]);
+
+    // Returns the tile under the centre of the player (where it was at the end of the last tick)
+    Position GetPlayerTile();
+
+    // Runs the search again if the target has changed since it was last run
+    void Sync();
+
+public:
+    // Constructs a flow field leading to the player ('FLOW_TO_PLAYER') or to the pellets ('FLOW_TO_PELLETS')
+    // The flow field is added as a listener to the maze so that it knows when pellets are eaten
+    FlowField(Maze* maze, Player* player, char mode);
+
+    // Runs the search straight away, no matter whether the target has changed
+    void Refresh();
+
+    // Returns the number of steps from the tile (x, y) to the nearest target tile
+    // Returns 'DISTANCE_UNREACHABLE' for walls and tiles that can't reach a target
+    uint8_t GetDistance(int x, int y);
+
+    // Returns the direction to move from the tile (x, y) to get closer to the target
+    // Returns 0x0 for walls, target tiles and tiles that can't reach a target
+    char GetDirection(int x, int y);
+
+    // Called by the maze when a pellet is removed
+    void OnPelletRemoved(int x, int y);
+
+    // Called by the maze when all pellets are put back
+    void OnPelletsReset();
+
+    // Called by the maze when a new layout is loaded
+    void OnMazeLoaded();
+};
+
+/* FLOW FIELD CPP */
+//////////////////////////////////////////////////////////////
+
+// Runs the search out from every tile marked in the 'targets' bitboard
+void FlowField::Search(int targets[])
+{
+    short queue[WIDTH * HEIGHT];
+    int head = 0;
+    int tail = 0;
+
+    // Every target tile starts in the queue with a distance of 0
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            _direction[y][x] = 0x0;
+
+            if (_maze->IsFloor(x, y) && ((targets[y] >> x) & 0x1))
+            {
+                _distance[y][x] = 0;
+                queue[tail] = (y * WIDTH) + x;
+                tail++;
+            }
+            else
+            {
+                _distance[y][x] = DISTANCE_UNREACHABLE;
+            }
+        }
+    }
+
+    while (head < tail)
+    {
+        int x = queue[head] % WIDTH;
+        int y = queue[head] / WIDTH;
+        head++;
+
+        for (char direction = NORTH; direction <= WEST; direction <<= 1)
+        {
+            Position next = _maze->GetAdjacentTilePos(x, y, direction);
+
+            if (_maze->IsFloor(next.x, next.y) && _distance[next.y][next.x] == DISTANCE_UNREACHABLE)
+            {
+                // The new tile was reached by stepping in 'direction', so stepping the opposite way leads back towards the target
+                // Distances stop at 'DISTANCE_SATURATED' rather than wrapping to 'DISTANCE_UNREACHABLE', which would queue the tile again
+                _distance[next.y][next.x] = _distance[y][x] < DISTANCE_SATURATED ? _distance[y][x] + 1 : DISTANCE_SATURATED;
+                _direction[next.y][next.x] = OppositeDirection(direction);
+                queue[tail] = (next.y * WIDTH) + next.x;
+                tail++;
+            }
+        }
+    }
+
+    _dirty = false;
+}
+
+// Returns the tile under the centre of the player (where it was at the end of the last tick)
+Position FlowField::GetPlayerTile()
+{
+    Position player = _player->GetPreviousState()->position;
+    return _maze->ScreenPosToTilePos(player.x + (TILE_SIZE / 2), player.y + (TILE_SIZE / 2));
+}
+
+// Runs the search again if the target has changed since it was last run
+void FlowField::Sync()
+{
+    if (_mode == FLOW_TO_PLAYER)
+    {
+        Position tile = GetPlayerTile();
+
+        if (tile.x != _sourceTile.x || tile.y != _sourceTile.y)
+        {
+            _dirty = true;
+        }
+    }
+
+    if (_dirty)
+    {
+        Refresh();
+    }
+}
+
+// Constructs a flow field leading to the player ('FLOW_TO_PLAYER') or to the pellets ('FLOW_TO_PELLETS')
+// The flow field is added as a listener to the maze so that it knows when pellets are eaten
+FlowField::FlowField(Maze* maze, Player* player, char mode)
+{
+    _maze = maze;
+    _player = player;
+    _mode = mode;
+    _sourceTile.x = -1;
+    _sourceTile.y = -1;
+
+    _maze->AddListener(this);
+    Refresh();
+}
+
+// Runs the search straight away, no matter whether the target has changed
+void FlowField::Refresh()
+{
+    int targets[HEIGHT];
+
+    if (_mode == FLOW_TO_PLAYER)
+    {
+        _sourceTile = GetPlayerTile();
+
+        for (int y = 0; y < HEIGHT; y++)
+        {
+            targets[y] = 0x0;
+        }
+
+        if (_maze->IsInBounds(_sourceTile.x, _sourceTile.y))
+        {
+            targets[_sourceTile.y] = 0x1 << _sourceTile.x;
+        }
+    }
+    else
+    {
+        for (int y = 0; y < HEIGHT; y++)
+        {
+            targets[y] = 0x0;
+
+            for (int x = 0; x < WIDTH; x++)
+            {
+                targets[y] |= _maze->IsPellet(x, y) << x;
+            }
+        }
+    }
+
+    Search(targets);
+}
+
+// Returns the number of steps from the tile (x, y) to the nearest target tile
+// Returns 'DISTANCE_UNREACHABLE' for walls and tiles that can't reach a target
+uint8_t FlowField::GetDistance(int x, int y)
+{
+    if (!_maze->IsInBounds(x, y))
+    {
+        return DISTANCE_UNREACHABLE;
+    }
+
+    Sync();
+
+    return _distance[y][x];
+}
+
+// Returns the direction to move from the tile (x, y) to get closer to the target
+// Returns 0x0 for walls, target tiles and tiles that can't reach a target
+char FlowField::GetDirection(int x, int y)
+{
+    if (!_maze->IsInBounds(x, y))
+    {
+        return 0x0;
+    }
+
+    Sync();
+
+    return _direction[y][x];
+}
+
+// Called by the maze when a pellet is removed
+void FlowField::OnPelletRemoved(int, int)
+{
+    if (_mode == FLOW_TO_PELLETS)
+    {
+        _dirty = true;
+    }
+}
+
+// Called by the maze when all pellets are put back
+void FlowField::OnPelletsReset()
+{
+    if (_mode == FLOW_TO_PELLETS)
+    {
+        _dirty = true;
+    }
+}
+
+// Called by the maze when a new layout is loaded
+void FlowField::OnMazeLoaded()
+{
+    _dirty = true;
+}
+
+/* GHOST MOVE BATCH H */
+//////////////////////////////////////////////////////////////
+
+// Max number of ghosts one batch can evaluate at once (must be a multiple of 8 so the vector loops never run off the end)
+#define MAX_BATCH_GHOSTS 256
+
+// Positions and targets are clamped to +/- this many pixels so that every offset fits in 16 bits
+#define BATCH_MAX_COORD 16383
+
+/*
+This class picks the next direction for many ghosts at once, giving the same answer as 'Enemy::GetNextDir' for each of them
+
+Each ghost's position, target and exits are gathered into separate arrays (one per field), so the distances from all four neighbouring pixels
+to the target can be worked out for several ghosts at a time:
+    AVX2            - 8 ghosts per pass
+    SSE2            - 4 ghosts per pass
+    Cortex-M4 DSP   - 1 ghost per pass, with both squares of each distance done by one SMUAD
+    Anything else   - 1 ghost per pass in plain C++
+
+Positions and targets are clamped to 'BATCH_MAX_COORD' so that the x and y offsets to the target fit in 16 bits each,
+this lets them be packed into one 32 bit int and squared and added by a single multiply-accumulate (targets are never anywhere near that far off the screen)
+The closest allowed direction is then picked without branching, checking NORTH, SOUTH, EAST then WEST and only replacing the best when strictly closer,
+so ties and ghosts with no allowed direction come out the same as 'Enemy::GetNextDir'
+
+NOTE: The arrays add up to 6 KB so objects of this class should be static rather than on the stack
+*/
+class GhostMoveBatch
+{
+private:
+    // Number of ghosts added since the last 'Clear'
+    int _count;
+
+    // Gathered inputs, one entry per ghost
+    int32_t _positionX[MAX_BATCH_GHOSTS];
+    int32_t _positionY[MAX_BATCH_GHOSTS];
+    int32_t _targetX[MAX_BATCH_GHOSTS];
+    int32_t _targetY[MAX_BATCH_GHOSTS];
+    int32_t _exits[MAX_BATCH_GHOSTS];
+
+    // Direction picked for each ghost by 'Evaluate'
+    int32_t _directions[MAX_BATCH_GHOSTS];
+
+    // Picks the direction for the ghost in slot 'i' without any vector instructions
+    void EvaluateScalar(int i);
+
+    // Clamps a screen coordinate to +/- 'BATCH_MAX_COORD'
+    static int32_t ClampCoord(int value);
+
+public:
+    // Constructs an empty batch
+    GhostMoveBatch();
+
+    // Removes every ghost from the batch
+    void Clear();
+
+    // Adds a ghost at the screen position 'position' heading for the screen position 'target'
+    // 'exits' is the directions the ghost is allowed to move in (NORTH | EAST | SOUTH | WEST)
+    // Returns the ghost's slot in the batch, or -1 if the batch is full
+    int Add(Position position, Position target, char exits);
+
+    // Picks the direction for every ghost in the batch
+    void Evaluate();
+
+    // Returns the direction picked for the ghost in the given slot by the last 'Evaluate'
+    char GetDirection(int slot);
+
+    // Returns the number of ghosts in the batch
+    int GetCount();
+};
+
+/* GHOST MOVE BATCH CPP */
+//////////////////////////////////////////////////////////////
+
+// Picks the direction for the ghost in slot 'i' without any vector instructions
+void GhostMoveBatch::EvaluateScalar(int i)
+{
+    // Offset from the target to the neighbouring pixel in each direction, in the same order as 'Enemy::GetNextDir' checks them
+    int32_t dx = _positionX[i] - _targetX[i];
+    int32_t dy = _positionY[i] - _targetY[i];
+
+    const char dirs[4] = { NORTH, SOUTH, EAST, WEST };
+    const int32_t offsetX[4] = { dx, dx, dx + 1, dx - 1 };
+    const int32_t offsetY[4] = { dy - 1, dy + 1, dy, dy };
+
+    int32_t best = INT32_MAX;
+    int32_t bestDir = NORTH;
+
+    for (int c = 0; c < 4; c++)
+    {
+#if defined(__ARM_FEATURE_DSP)
+        // Pack both offsets into one word and square and add them in one instruction
+        uint32_t packed = __PKHBT(offsetX[c], offsetY[c], 16);
+        int32_t d = __SMUAD(packed, packed);
+#else
+        int32_t d = (offsetX[c] * offsetX[c]) + (offsetY[c] * offsetY[c]);
+#endif
+
+        // Directions that aren't allowed can never be the closest
+        int32_t allowed = -((_exits[i] & dirs[c]) != 0);
+        d = (d & allowed) | (INT32_MAX & ~allowed);
+
+        // Only take the new direction when strictly closer, so earlier directions win ties
+        int32_t closer = -(d < best);
+        best = (d & closer) | (best & ~closer);
+        bestDir = (dirs[c] & closer) | (bestDir & ~closer);
+    }
+
+    _directions[i] = bestDir;
+}
+
+// Clamps a screen coordinate to +/- 'BATCH_MAX_COORD'
+int32_t GhostMoveBatch::ClampCoord(int value)
+{
+    if (value > BATCH_MAX_COORD)
+    {
+        return BATCH_MAX_COORD;
+    }
+    else if (value < -BATCH_MAX_COORD)
+    {
+        return -BATCH_MAX_COORD;
+    }
+
+    return value;
+}
+
+// Constructs an empty batch
+GhostMoveBatch::GhostMoveBatch()
+{
+    memset(_positionX, 0, sizeof(_positionX));
+    memset(_positionY, 0, sizeof(_positionY));
+    memset(_targetX, 0, sizeof(_targetX));
+    memset(_targetY, 0, sizeof(_targetY));
+    memset(_exits, 0, sizeof(_exits));
+    memset(_directions, 0, sizeof(_directions));
+    _count = 0;
+}
+
+// Removes every ghost from the batch
+void GhostMoveBatch::Clear()
+{
+    _count = 0;
+}
+
+// Adds a ghost at the screen position 'position' heading for the screen position 'target'
+// 'exits' is the directions the ghost is allowed to move in (NORTH | EAST | SOUTH | WEST)
+// Returns the ghost's slot in the batch, or -1 if the batch is full
+int GhostMoveBatch::Add(Position position, Position target, char exits)
+{
+    if (_count >= MAX_BATCH_GHOSTS)
+    {
+        return -1;
+    }
+
+    _positionX[_count] = ClampCoord(position.x);
+    _positionY[_count] = ClampCoord(position.y);
+    _targetX[_count] = ClampCoord(target.x);
+    _targetY[_count] = ClampCoord(target.y);
+    _exits[_count] = exits;
+    _count++;
+
+    return _count - 1;
+}
+
+// Picks the direction for every ghost in the batch
+void GhostMoveBatch::Evaluate()
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i max = _mm256_set1_epi32(INT32_MAX);
+    const __m256i dirs[4] = { _mm256_set1_epi32(NORTH), _mm256_set1_epi32(SOUTH), _mm256_set1_epi32(EAST), _mm256_set1_epi32(WEST) };
+
+    // The arrays are a multiple of 8 long, so the last pass can read past '_count' (those slots are ignored)
+    for (; i < _count; i += 8)
+    {
+        __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)&_positionX[i]), _mm256_loadu_si256((const __m256i*)&_targetX[i]));
+        __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)&_positionY[i]), _mm256_loadu_si256((const __m256i*)&_targetY[i]));
+        __m256i exits = _mm256_loadu_si256((const __m256i*)&_exits[i]);
+
+        __m256i offsetX[4] = { dx, dx, _mm256_add_epi32(dx, one), _mm256_sub_epi32(dx, one) };
+        __m256i offsetY[4] = { _mm256_sub_epi32(dy, one), _mm256_add_epi32(dy, one), dy, dy };
+
+        __m256i best = max;
+        __m256i bestDir = dirs[0];
+
+        for (int c = 0; c < 4; c++)
+        {
+            // Pack to 16 bits and interleave x and y, then square and add each pair with one multiply-add
+            __m256i packed = _mm256_packs_epi32(offsetX[c], offsetY[c]);
+            packed = _mm256_unpacklo_epi16(packed, _mm256_srli_si256(packed, 8));
+            __m256i d = _mm256_madd_epi16(packed, packed);
+
+            __m256i allowed = _mm256_cmpgt_epi32(_mm256_and_si256(exits, dirs[c]), _mm256_setzero_si256());
+            d = _mm256_blendv_epi8(max, d, allowed);
+
+            __m256i closer = _mm256_cmpgt_epi32(best, d);
+            best = _mm256_blendv_epi8(best, d, closer);
+            bestDir = _mm256_blendv_epi8(bestDir, dirs[c], closer);
+        }
+
+        _mm256_storeu_si256((__m256i*)&_directions[i], bestDir);
+    }
+#elif defined(__SSE2__)
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i max = _mm_set1_epi32(INT32_MAX);
+    const __m128i dirs[4] = { _mm_set1_epi32(NORTH), _mm_set1_epi32(SOUTH), _mm_set1_epi32(EAST), _mm_set1_epi32(WEST) };
+
+    // The arrays are a multiple of 4 long, so the last pass can read past '_count' (those slots are ignored)
+    for (; i < _count; i += 4)
+    {
+        __m128i dx = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)&_positionX[i]), _mm_loadu_si128((const __m128i*)&_targetX[i]));
+        __m128i dy = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)&_positionY[i]), _mm_loadu_si128((const __m128i*)&_targetY[i]));
+        __m128i exits = _mm_loadu_si128((const __m128i*)&_exits[i]);
+
+        __m128i offsetX[4] = { dx, dx, _mm_add_epi32(dx, one), _mm_sub_epi32(dx, one) };
+        __m128i offsetY[4] = { _mm_sub_epi32(dy, one), _mm_add_epi32(dy, one), dy, dy };
+
+        __m128i best = max;
+        __m128i bestDir = dirs[0];
+
+        for (int c = 0; c < 4; c++)
+        {
+            // Pack to 16 bits and interleave x and y, then square and add each pair with one multiply-add
+            __m128i packed = _mm_packs_epi32(offsetX[c], offsetY[c]);
+            packed = _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8));
+            __m128i d = _mm_madd_epi16(packed, packed);
+
+            // SSE2 has no blend, so select with and/andnot/or
+            __m128i allowed = _mm_cmpgt_epi32(_mm_and_si128(exits, dirs[c]), _mm_setzero_si128());
+            d = _mm_or_si128(_mm_and_si128(allowed, d), _mm_andnot_si128(allowed, max));
+
+            __m128i closer = _mm_cmplt_epi32(d, best);
+            best = _mm_or_si128(_mm_and_si128(closer, d), _mm_andnot_si128(closer, best));
+            bestDir = _mm_or_si128(_mm_and_si128(closer, dirs[c]), _mm_andnot_si128(closer, bestDir));
+        }
+
+        _mm_storeu_si128((__m128i*)&_directions[i], bestDir);
+    }
+#endif
+
+    for (; i < _count; i++)
+    {
+        EvaluateScalar(i);
+    }
+}
+
+// Returns the direction picked for the ghost in the given slot by the last 'Evaluate'
+char GhostMoveBatch::GetDirection(int slot)
+{
+    return (char)_directions[slot];
+}
+
+// Returns the number of ghosts in the batch
+int GhostMoveBatch::GetCount()
+{
+    return _count;
+}
+
+/* COLLISION GRID H */
+//////////////////////////////////////////////////////////////
+
+// Max number of actors a collision grid can hold
+#define MAX_COLLISION_ACTORS 256
+
+// Max number of overlapping pairs stored each tick by a 'CollisionSystem'
+#define MAX_COLLISION_PAIRS 512
+
+// Number of buckets cells are hashed into (must be a power of 2)
+// Actors are spread out over the maze, so a few times the number of actors keeps most buckets down to one cell
+#define COLLISION_BUCKETS 512
+
+// Width and height of a cell in the grid
+// The box an actor sweeps in one tick is at most TILE_SIZE + 'MAX_SPEED' pixels wide, so with cells this big two boxes that overlap
+// always start at most one cell apart
+#define COLLISION_CELL_SIZE (2 * TILE_SIZE)
+
+// Marks the end of a bucket's list of actors
+#define COLLISION_NONE -1
+
+// With this many actors or fewer, every pair is simply tested (hashing costs more than it saves for the usual player and four ghosts)
+#define COLLISION_BRUTE_FORCE_ACTORS 12
+
+// Actor categories
+#define COLLISION_PLAYER 0x1
+#define COLLISION_GHOST 0x2
+#define COLLISION_FRUIT 0x4
+
+// Struct used to store two actors that overlap
+// The actors are stored in category order ('categoryA' <= 'categoryB'), so e.g. a ghost-player pair always has the player in 'a'
+struct CollisionPair
+{
+    short a; // Index the actor was given when it was added
+    short b;
+    char categoryA;
+    char categoryB;
+};
+
+/*
+This class is a broadphase for collisions between actors, finding every pair of actors that overlap in O(actors + pairs)
+
+Actors are swept: each one is a TILE_SIZE * TILE_SIZE box moving in a straight line from where it started the tick to where it
+ended it, and two actors collide if their boxes overlap at any point during the tick
+This means fast actors can't pass through each other between ticks, however their speeds line up
+
+Each actor is put in a bucket for the cell under the top left corner of the box it sweeps, using a spatial hash of the cell
+so that the grid is the same small size however big the maze is
+Two actors can only overlap if their cells are at most one apart, so each actor only has to be checked against the actors in its own cell
+and in half of the cells around it (the other half check it), which also means every pair is found exactly once
+
+Nothing is allocated: the buckets are linked lists through a fixed array, so a grid can be cleared and filled again every tick
+With only a handful of actors ('COLLISION_BRUTE_FORCE_ACTORS') every pair is tested instead, as that is quicker than hashing
+*/
+class CollisionGrid
+{
+private:
+    // Everything about one actor is kept together, as it is all read at once
+    struct Entry
+    {
+        Position start;
+        Position position;
+        Position low; // Top left and bottom right corners of the box swept by the actor
+        Position high;
+        Position cell;
+        short next; // Next actor in the same bucket
+        char category;
+    };
+
+    short _bucketHead[COLLISION_BUCKETS];
+    Entry _entries[MAX_COLLISION_ACTORS];
+    int _count;
+
+    // True once the actors have been put in their buckets (only done by 'FindPairs' when there are enough actors to need it)
+    bool _bucketed;
+
+    // Returns the bucket the cell (x, y) is stored in
+    static int GetBucket(int x, int y);
+
+    // Returns true if the boxes of actors 'a' and 'b' overlap at any point in their moves
+    // (the same test as 'BaseGameSprite::HasCollided' for actors that didn't move)
+    bool Overlaps(int a, int b);
+
+    // Narrows [tMin, tMax] down to the part of the move where the gap between two actors on one axis is less than TILE_SIZE
+    // The gap starts at 'gap' and changes by 'velocity' over the move, returns false if it never gets small enough
+    static bool ClipOverlap(int gap, int velocity, float* tMin, float* tMax);
+
+    // Adds the pair 'a', 'b' to 'pairs' if there is room, returning the new number of pairs
+    int AddPair(int a, int b, CollisionPair pairs[], int pairCount, int maxPairs);
+
+    // Puts every actor in the bucket for its cell
+    void FillBuckets();
+
+public:
+    // Constructs an empty grid
+    CollisionGrid();
+
+    // Removes every actor (in O(actors), not O(buckets))
+    void Clear();
+
+    // Adds an actor with its top left corner at 'position'
+    // Returns the index of the actor (used in 'CollisionPair'), or COLLISION_NONE if the grid is full
+    int Add(Position position, char category);
+
+    // Adds an actor that moved from 'start' to 'position' this tick
+    // Moves further than an actor can go in one tick (e.g. through the tunnel) are treated as if the actor started at 'position'
+    // Returns the index of the actor (used in 'CollisionPair'), or COLLISION_NONE if the grid is full
+    int Add(Position start, Position position, char category);
+
+    // Writes every pair of overlapping actors into 'pairs', returning the number of pairs
+    // Stops once 'maxPairs' pairs have been found
+    int FindPairs(CollisionPair pairs[], int maxPairs);
+
+    // Returns the number of actors in the grid
+    int GetCount();
+};
+
+/* COLLISION GRID CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns the bucket the cell (x, y) is stored in
+int CollisionGrid::GetBucket(int x, int y)
+{
+    // Multiply by two large primes so that neighbouring cells end up far apart
+    uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+
+    return (int)(hash & (COLLISION_BUCKETS - 1));
+}
+
+// Narrows [tMin, tMax] down to the part of the move where the gap between two actors on one axis is less than TILE_SIZE
+// The gap starts at 'gap' and changes by 'velocity' over the move, returns false if it never gets small enough
+bool CollisionGrid::ClipOverlap(int gap, int velocity, float* tMin, float* tMax)
+{
+    if (velocity == 0)
+    {
+        return gap > -TILE_SIZE && gap < TILE_SIZE;
+    }
+
+    // Times the gap crosses -TILE_SIZE and TILE_SIZE (the boxes overlap strictly between them)
+    float enter = (float)(-TILE_SIZE - gap) / velocity;
+    float exit = (float)(TILE_SIZE - gap) / velocity;
+
+    if (enter > exit)
+    {
+        float swap = enter;
+        enter = exit;
+        exit = swap;
+    }
+
+    if (enter > *tMin)
+    {
+        *tMin = enter;
+    }
+
+    if (exit < *tMax)
+    {
+        *tMax = exit;
+    }
+
+    return *tMin < *tMax;
+}
+
+// Returns true if the boxes of actors 'a' and 'b' overlap at any point in their moves
+// (the same test as 'BaseGameSprite::HasCollided' for actors that didn't move)
+bool CollisionGrid::Overlaps(int a, int b)
+{
+    const Entry* entryA = &_entries[a];
+    const Entry* entryB = &_entries[b];
+
+    // Actors whose swept boxes don't overlap can't have touched (which is most pairs, so this is checked first)
+    if (entryA->low.x >= entryB->high.x || entryB->low.x >= entryA->high.x || entryA->low.y >= entryB->high.y || entryB->low.y >= entryA->high.y)
+    {
+        return false;
+    }
+
+    // Work in 'a''s frame of reference, so only 'b' is moving
+    int gapX = entryB->start.x - entryA->start.x;
+    int gapY = entryB->start.y - entryA->start.y;
+    int velocityX = (entryB->position.x - entryB->start.x) - (entryA->position.x - entryA->start.x);
+    int velocityY = (entryB->position.y - entryB->start.y) - (entryA->position.y - entryA->start.y);
+
+    // Actors that moved the same way (or didn't move) only need testing once
+    if (velocityX == 0 && velocityY == 0)
+    {
+        return gapX > -TILE_SIZE && gapX < TILE_SIZE && gapY > -TILE_SIZE && gapY < TILE_SIZE;
+    }
+
+    // The boxes overlap at the times where both axes overlap at once, which has to be during the move ([0, 1])
+    // The end of the move counts, so the test agrees with the static one for where the actors ended up
+    float tMin = 0.0f;
+    float tMax = 1.0f;
+
+    return ClipOverlap(gapX, velocityX, &tMin, &tMax) && ClipOverlap(gapY, velocityY, &tMin, &tMax);
+}
+
+// Adds the pair 'a', 'b' to 'pairs' if there is room, returning the new number of pairs
+int CollisionGrid::AddPair(int a, int b, CollisionPair pairs[], int pairCount, int maxPairs)
+{
+    if (pairCount >= maxPairs)
+    {
+        return pairCount;
+    }
+
+    // Keep the pair in category order
+    if (_entries[b].category < _entries[a].category)
+    {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+
+    pairs[pairCount].a = (short)a;
+    pairs[pairCount].b = (short)b;
+    pairs[pairCount].categoryA = _entries[a].category;
+    pairs[pairCount].categoryB = _entries[b].category;
+
+    return pairCount + 1;
+}
+
+// Constructs an empty grid
+CollisionGrid::CollisionGrid()
+{
+    for (int i = 0; i < COLLISION_BUCKETS; i++)
+    {
+        _bucketHead[i] = COLLISION_NONE;
+    }
+
+    _count = 0;
+    _bucketed = false;
+}
+
+// Removes every actor
+void CollisionGrid::Clear()
+{
+    // Only the buckets that have actors in need emptying
+    if (_bucketed)
+    {
+        for (int i = 0; i < _count; i++)
+        {
+            _bucketHead[GetBucket(_entries[i].cell.x, _entries[i].cell.y)] = COLLISION_NONE;
+        }
+    }
+
+    _count = 0;
+    _bucketed = false;
+}
+
+// Puts every actor in the bucket for its cell
+void CollisionGrid::FillBuckets()
+{
+    for (int i = 0; i < _count; i++)
+    {
+        int bucket = GetBucket(_entries[i].cell.x, _entries[i].cell.y);
+        _entries[i].next = _bucketHead[bucket];
+        _bucketHead[bucket] = (short)i;
+    }
+
+    _bucketed = true;
+}
+
+// Adds an actor with its top left corner at 'position'
+// Returns the index of the actor (used in 'CollisionPair'), or COLLISION_NONE if the grid is full
+int CollisionGrid::Add(Position position, char category)
+{
+    return Add(position, position, category);
+}
+
+// Adds an actor that moved from 'start' to 'position' this tick
+// Moves further than an actor can go in one tick (e.g. through the tunnel) are treated as if the actor started at 'position'
+// Returns the index of the actor (used in 'CollisionPair'), or COLLISION_NONE if the grid is full
+int CollisionGrid::Add(Position start, Position position, char category)
+{
+    if (_count >= MAX_COLLISION_ACTORS)
+    {
+        return COLLISION_NONE;
+    }
+
+    int maxMove = MAX_SPEED >> SPEED_SHIFT;
+
+    if (abs(position.x - start.x) > maxMove || abs(position.y - start.y) > maxMove)
+    {
+        start = position;
+    }
+
+    int index = _count;
+    _count++;
+
+    Entry* entry = &_entries[index];
+    entry->start = start;
+    entry->position = position;
+    entry->category = category;
+
+    entry->low.x = start.x < position.x ? start.x : position.x;
+    entry->low.y = start.y < position.y ? start.y : position.y;
+    entry->high.x = (start.x > position.x ? start.x : position.x) + TILE_SIZE;
+    entry->high.y = (start.y > position.y ? start.y : position.y) + TILE_SIZE;
+
+    // The cell is the one under the top left corner of the box the actor swept
+    // Positions are never negative, so dividing rounds down
+    entry->cell.x = entry->low.x / COLLISION_CELL_SIZE;
+    entry->cell.y = entry->low.y / COLLISION_CELL_SIZE;
+
+    return index;
+}
+
+// Writes every pair of overlapping actors into 'pairs', returning the number of pairs
+// Stops once 'maxPairs' pairs have been found
+int CollisionGrid::FindPairs(CollisionPair pairs[], int maxPairs)
+{
+    // Half of the cells around a cell (the other half are checked from the other side)
+    static const int neighbourX[4] = { 1, -1, 0, 1 };
+    static const int neighbourY[4] = { 0, 1, 1, 1 };
+
+    int pairCount = 0;
+
+    if (_count <= COLLISION_BRUTE_FORCE_ACTORS)
+    {
+        for (int i = 0; i < _count; i++)
+        {
+            for (int j = i + 1; j < _count; j++)
+            {
+                if (Overlaps(i, j))
+                {
+                    pairCount = AddPair(i, j, pairs, pairCount, maxPairs);
+                }
+            }
+        }
+
+        return pairCount;
+    }
+
+    if (!_bucketed)
+    {
+        FillBuckets();
+    }
+
+    for (int i = 0; i < _count && pairCount < maxPairs; i++)
+    {
+        Position cell = _entries[i].cell;
+
+        // Actors in the same cell, only looking further along the list so each pair is only found once
+        for (int j = _entries[i].next; j != COLLISION_NONE; j = _entries[j].next)
+        {
+            if (_entries[j].cell.x == cell.x && _entries[j].cell.y == cell.y && Overlaps(i, j))
+            {
+                pairCount = AddPair(i, j, pairs, pairCount, maxPairs);
+            }
+        }
+
+        for (int n = 0; n < 4; n++)
+        {
+            int x = cell.x + neighbourX[n];
+            int y = cell.y + neighbourY[n];
+
+            // Other cells can share the bucket, so only actors actually in the neighbouring cell are checked
+            for (int j = _bucketHead[GetBucket(x, y)]; j != COLLISION_NONE; j = _entries[j].next)
+            {
+                if (_entries[j].cell.x == x && _entries[j].cell.y == y && Overlaps(i, j))
+                {
+                    pairCount = AddPair(i, j, pairs, pairCount, maxPairs);
+                }
+            }
+        }
+    }
+
+    return pairCount;
+}
+
+// Returns the number of actors in the grid
+int CollisionGrid::GetCount()
+{
+    return _count;
+}
+
+/* ENEMY H */
+//////////////////////////////////////////////////////////////
+class Enemy :
+	public BaseGameSprite
+{
+    // The microbenchmarks ('tools/bench.cpp') time 'GetNextDir' on their own
+    friend struct BenchmarkAccess;
+
+private:
+	Maze* _maze;
+	Player* _player;
+	Position _target;
+	Enemy* _blinky;
+	FlowField* _flowField;
+	PathFinder* _pathFinder;
+	MazePath _path;
+	DistanceTable* _distanceTable;
+	GhostMoveBatch* _moveBatch;
+	int _batchSlot;
+
+    // When false, the enemy doesn't check for the player itself (a 'CollisionSystem' does it instead)
+    bool _playerCollisions;
+
+    // Hash to keep up to date with the enemy's state, the enemy's actor number in it and the key currently included in it
+    ZobristHash* _zobrist;
+    int _zobristActor;
+    uint64_t _zobristKey;
+
+	char _lastDir;
+	char _nextDir;
+	char _aiType;
+    uint16_t _colour;
+
+    bool _imageA;
+
+	int GetManhattanDist(int x0, int y0, int x1, int y1);
+
+	int GetManhattanDist(Position start, Position target);
+
+	int GetDistanceSq(int x0, int y0, int x1, int y1);
+
+	int GetDistanceSq(int x0, int y0, Position target);
+
+	void SetTargetToPlayer();
+
+	void SetTargetInfrontOfPlayer();
+
+	void SetTargetBlockPlayer();
+
+	void SetTargetClyde();
+
+	void SetTarget();
+
+	void GetNextDir();
+
+    // Returns the exit in 'exits' that '_flowField' leads down towards the player
+    // When the field points back the way the enemy came, the exit with the fewest steps to the player is taken instead
+    // Returns 0x0 if the player can't be reached through any of them
+    char GetFlowDirection(Position tile, char exits);
+
+    // Returns the exit in 'exits' with the fewest steps through the maze (from '_distanceTable') to the target
+    // Ties go to NORTH, SOUTH, EAST then WEST, the same as 'GetNextDir'
+    // Returns 0x0 if the target can't be reached through any of them
+    char GetTableDirection(Position tile, char exits);
+
+    // Chooses the direction to leave the current tile in
+    // The targeting AI is only run when there is more than one way to go (not counting turning back)
+    void ChooseDirection();
+
+    // Swaps the enemy's key in '_zobrist' for one matching its current position and directions
+    void UpdateZobrist();
+
+public:
+	//char symbol = '~';
+
+	Enemy(Maze* maze, Player* player, uint16_t colour, char aiType, int x, int y);
+
+	Enemy(Maze* maze, Player* player, Enemy* blinky, uint16_t colour, char aiType, int x, int y);
+
+    // Gives the enemy a flow field leading to the player (NULL to go back to the classic AI)
+    // While the enemy targets the player directly (Blinky always, Clyde while far away), it follows the field along the shortest path
+    // through the maze instead of heading in a straight line
+    void SetFlowField(FlowField* flowField);
+
+    // Gives the enemy a path finder (NULL to go back to the classic AI)
+    // The enemy still picks its target the same way, but follows the shortest path to it through the maze instead of heading in a straight line
+    void SetPathFinder(PathFinder* pathFinder);
+
+    // Gives the enemy a distance table (NULL to go back to the classic AI)
+    // The enemy still picks its target the same way, but at each junction takes the exit with the fewest steps through the maze to it
+    void SetDistanceTable(DistanceTable* distanceTable);
+
+    // Puts the enemy in a move batch (NULL to take it back out)
+    // While in a batch the enemy doesn't move itself in the PLAY state, whatever owns the batch calls 'StartMove' and 'FinishMove' instead
+    void SetMoveBatch(GhostMoveBatch* moveBatch);
+
+    // Turns the enemy's own check for the player on or off (on by default)
+    // Turned off by 'CollisionSystem::AddEnemy', as the system checks every actor at once
+    void SetPlayerCollisions(bool enabled);
+
+    // Starts the enemy's movement for this tick: sets its speed for the level (and whether it is in the tunnel)
+    // Returns the number of one pixel moves ('StartMove' then 'FinishMove') to make this tick
+    int StartTick();
+
+    // First half of a move: picks a direction if the enemy is lined up with a tile
+    // In a move batch the choice is added to the batch rather than made straight away
+    void StartMove();
+
+    // Second half of a move: picks up the direction from the move batch (if one was added), moves and checks for the player
+    void FinishMove();
+
+    // Forgets which way the enemy was moving (and any path it was following), as if it had just been constructed
+    // Used by headless games so every game starts the same no matter how the last one ended
+    void ResetMovement();
+
+    // Stores the enemy's position and directions in 'state'
+    void SaveState(ActorState* state);
+
+    // Puts the enemy's position and directions back from 'state'
+    // Any path the enemy was following is forgotten, as it may not lead from the restored position
+    void LoadState(const ActorState* state);
+
+    // Keeps the given hash up to date with the enemy's state (NULL to stop)
+    // 'index' is the enemy's index in 'GameState::enemies'
+    void SetZobristHash(ZobristHash* zobrist, int index);
+
+    // Copies the enemy's position and directions into the state returned by 'GetPreviousState'
+    void PublishState();
+
+	void Init();
+
+	void Update();
+
+	void Draw();
+};
+
+/* ENEMY CPP */
+//////////////////////////////////////////////////////////////
+int Enemy::GetManhattanDist(int x0, int y0, int x1, int y1)
+{
+	return abs(x0 - x1) + abs(y0 - y1);
+}
+
+int Enemy::GetManhattanDist(Position start, Position target)
+{
+	return GetManhattanDist(start.x, start.y, target.x, target.y);
+}
+
+int Enemy::GetDistanceSq(int x0, int y0, int x1, int y1)
+{
+	return ((x0 - x1) * (x0 - x1)) + ((y0 - y1) * (y0 - y1));
+}
+
+int Enemy::GetDistanceSq(int x0, int y0, Position target)
+{
+	return GetDistanceSq(x0, y0, target.x, target.y);
+}
+
+void Enemy::SetTargetToPlayer()
+{
+	const ActorState* player = _player->GetPreviousState();
+
+	_target = player->position;
+}
+
+void Enemy::SetTargetInfrontOfPlayer()
+{
+	const ActorState* player = _player->GetPreviousState();
+
+	if (player->lastDir == NORTH)
+	{
+		//_target = { _player->position.x, _player->position.y - 4 };
+		_target.x = player->position.x;
+		_target.y = player->position.y - (4 * TILE_SIZE);
+	}
+	else if (player->lastDir == EAST)
+	{
+		//_target = { _player->position.x + 4, _player->position.y };
+		_target.x = player->position.x + (4 * TILE_SIZE);
+		_target.y = player->position.y;
+	}
+	else if (player->lastDir == SOUTH)
+	{
+		//_target = { _player->position.x, _player->position.y + 4 };
+		_target.x = player->position.x;
+		_target.y = player->position.y + (4 * TILE_SIZE);
+	}
+	else if (player->lastDir == WEST)
+	{
+		//_target = { _player->position.x - 4, _player->position.y };
+		_target.x = player->position.x - (4 * TILE_SIZE);
+		_target.y = player->position.y;
+	}
+}
+
+void Enemy::SetTargetBlockPlayer()
+{
+	// Read Blinky as it was at the end of the last tick, so Inky aims the same way whether Blinky has moved yet this tick or not
+	const ActorState* player = _player->GetPreviousState();
+	const ActorState* blinky = _blinky->GetPreviousState();
+
+	// Find two tiles ahed of the player
+	if (player->lastDir == NORTH)
+	{
+		//_target = { _player->position.x, _player->position.y - 2 };
+		_target.x = player->position.x;
+		_target.y = player->position.y - (2 * TILE_SIZE);
+	}
+	else if (player->lastDir == EAST)
+	{
+		//_target = { _player->position.x + 2, _player->position.y };
+		_target.x = player->position.x + (2 * TILE_SIZE);
+		_target.y = player->position.y;
+	}
+	else if (player->lastDir == SOUTH)
+	{
+		//_target = { _player->position.x, _player->position.y + 2 };
+		_target.x = player->position.x;
+		_target.y = player->position.y + (2 * TILE_SIZE);
+	}
+	else if (player->lastDir == WEST)
+	{
+		//_target = { _player->position.x - 2, _player->position.y };
+		_target.x = player->position.x - (2 * TILE_SIZE);
+		_target.y = player->position.y;
+	}
+
+	// Rotate the target by 180 degrees in relation to blinky
+	//int xDiff = _target.x - _blinky->position.x;
+	//int yDiff = _target.y - _blinky->position.y;
+    _target.x = _target.x + (_target.x - blinky->position.x);
+	_target.y = _target.y + (_target.y - blinky->position.y);
+	//_target = { _target.x + (_target.x - _blinky->position.x), _target.y + (_target.y - _blinky->position.y) };
+}
+
+void Enemy::SetTargetClyde()
+{
+	const ActorState* player = _player->GetPreviousState();
+
+	// If distance to the player is greater than 8 tiles
+	if (GetManhattanDist(position, player->position) > (8 * TILE_SIZE))
+	{
+		SetTargetToPlayer();
+	}
+	else
+	{
+		//_target = { 0, HEIGHT };
+		_target.x = 0;
+		_target.y = HEIGHT * TILE_SIZE;
+		
+	}
+
+}
+
+void Enemy::SetTarget()
+{
+	if (_aiType == BLINKY_AI)
+	{
+		SetTargetToPlayer();
+	}
+	else if (_aiType == PINKY_AI)
+	{
+		SetTargetInfrontOfPlayer();
+	}
+	else if (_aiType == INKY_AI)
+	{
+		SetTargetBlockPlayer();
+	}
+	else if (_aiType == CLYDE_AI)
+	{
+		SetTargetClyde();
+	}
+}
+
+void Enemy::GetNextDir()
+{
+	// Find all possible tiles the enemy can move into, excluding the tile it has just moved away from
+	bool north = _lastDir != SOUTH && _maze->IsFloorAdjacentScreenPos(position, NORTH);
+	bool east = _lastDir != WEST && _maze->IsFloorAdjacentScreenPos(position, EAST);
+	bool south = _lastDir != NORTH && _maze->IsFloorAdjacentScreenPos(position, SOUTH);
+	bool west = _lastDir != EAST && _maze->IsFloorAdjacentScreenPos(position, WEST);
+
+	// For each passable tile, get manhattan distance to target
+	int northDist = -1;
+	int eastDist = -1;
+	int southDist = -1;
+	int westDist = -1;
+
+	char dirs[4] = { NORTH, SOUTH, EAST, WEST };
+	int dists[4] = { -1, -1, -1, -1 };
+
+	// Arrange dirs in order of priority
+	/*
+	if (abs(position.x - _target.x) >= abs(position.y - _target.y))
+	{
+		dirs[0] = EAST;
+		dirs[1] = WEST;
+		dirs[2] = NORTH;
+		dirs[3] = SOUTH;
+	}
+	*/
+	// Get distance from each neighbour to target and the smallest index
+	int smallestIndex = 0;
+	int smallestValue = -1;
+
+	for (int i = 0; i < 4; i++)
+	{
+		int d = -1;
+
+		if (north && dirs[i] == NORTH)
+		{
+			d = GetDistanceSq(position.x, position.y - 1, _target);
+			dists[i] = d;
+		}
+		else if (east && dirs[i] == EAST)
+		{
+			d = GetDistanceSq(position.x + 1, position.y, _target);
+			dists[i] = d;
+		}
+		else if (south && dirs[i] == SOUTH)
+		{
+			d = GetDistanceSq(position.x, position.y + 1, _target);
+			dists[i] = d;
+		}
+		else if (west && dirs[i] == WEST)
+		{
+			d = GetDistanceSq(position.x - 1, position.y, _target);
+			dists[i] = d;
+		}
+
+		if (d != -1 && (d < smallestValue || smallestValue == -1))
+		{
+			smallestValue = d;
+			smallestIndex = i;
+		}
+	}
+
+	_nextDir = dirs[smallestIndex];
+}
+
+// Returns the exit in 'exits' that '_flowField' leads down towards the player
+// When the field points back the way the enemy came, the exit with the fewest steps to the player is taken instead
+// Returns 0x0 if the player can't be reached through any of them
+char Enemy::GetFlowDirection(Position tile, char exits)
+{
+    static const char DIRECTIONS[4] = { NORTH, SOUTH, EAST, WEST };
+
+    char direction = _flowField->GetDirection(tile.x, tile.y);
+
+    if (direction & exits)
+    {
+        return direction;
+    }
+
+    char best = 0x0;
+    int bestDistance = DISTANCE_UNREACHABLE;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (exits & DIRECTIONS[i])
+        {
+            Position next = _maze->GetAdjacentTilePos(tile.x, tile.y, DIRECTIONS[i]);
+            int distance = _flowField->GetDistance(next.x, next.y);
+
+            if (distance < bestDistance)
+            {
+                best = DIRECTIONS[i];
+                bestDistance = distance;
+            }
+        }
+    }
+
+    return best;
+}
+
+// Returns the exit in 'exits' with the fewest steps through the maze (from '_distanceTable') to the target
+// Ties go to NORTH, SOUTH, EAST then WEST, the same as 'GetNextDir'
+// Returns 0x0 if the target can't be reached through any of them
+char Enemy::GetTableDirection(Position tile, char exits)
+{
+    static const char DIRECTIONS[4] = { NORTH, SOUTH, EAST, WEST };
+
+    // Targets can be off the maze or inside a wall (e.g. Clyde's corner), so head for the closest floor tile to them
+    Position target = _maze->ScreenPosToTilePos(_target);
+    target = _maze->GetNearestFloorTile(target.x, target.y);
+
+    char best = 0x0;
+    int bestDistance = DISTANCE_UNREACHABLE;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (exits & DIRECTIONS[i])
+        {
+            Position next = _maze->GetAdjacentTilePos(tile.x, tile.y, DIRECTIONS[i]);
+            int distance = _distanceTable->GetDistance(next, target);
+
+            if (distance < bestDistance)
+            {
+                best = DIRECTIONS[i];
+                bestDistance = distance;
+            }
+        }
+    }
+
+    return best;
+}
+
+// Chooses the direction to leave the current tile in
+// The targeting AI is only run when there is more than one way to go (not counting turning back)
+void Enemy::ChooseDirection()
+{
+    Position tile = _maze->ScreenPosToTilePos(position);
+
+    // Every way out of the tile except back the way the ghost came
+    char exits = _maze->GetExits(tile.x, tile.y) & ~OppositeDirection(_lastDir);
+
+    // A single way out (along a corridor or round a corner) means there is no choice to make
+    if (exits == NORTH || exits == EAST || exits == SOUTH || exits == WEST)
+    {
+        _nextDir = exits;
+        return;
+    }
+
+    SetTarget();
+
+    // With a flow field, ghosts chasing the player itself (Blinky, and Clyde while far away) follow the field to it
+    const ActorState* player = _player->GetPreviousState();
+
+    if (_flowField != NULL && _target.x == player->position.x && _target.y == player->position.y)
+    {
+        char direction = GetFlowDirection(tile, exits);
+
+        if (direction != 0x0)
+        {
+            _nextDir = direction;
+            return;
+        }
+    }
+
+    // With a path finder, head along the shortest path to the target tile
+    // Falls back to the classic AI when already on the target tile or it can't be reached without turning back
+    if (_pathFinder != NULL)
+    {
+        char direction = _pathFinder->GetNextDirection(tile, _maze->ScreenPosToTilePos(_target), _lastDir, &_path);
+
+        if (direction != 0x0)
+        {
+            _nextDir = direction;
+            return;
+        }
+    }
+
+    // With a distance table, take the exit with the fewest steps left to the target tile
+    if (_distanceTable != NULL)
+    {
+        char direction = GetTableDirection(tile, exits);
+
+        if (direction != 0x0)
+        {
+            _nextDir = direction;
+            return;
+        }
+    }
+
+    // In a move batch, the direction is picked up in 'FinishMove' once the whole batch has been evaluated
+    if (_moveBatch != NULL)
+    {
+        _batchSlot = _moveBatch->Add(position, _target, exits);
+
+        if (_batchSlot != -1)
+        {
+            return;
+        }
+    }
+
+    GetNextDir();
+}
+
+Enemy::Enemy(Maze* maze, Player* player, uint16_t colour, char aiType, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
+{
+	_maze = maze;
+	_player = player;
+	_colour = colour;
+	_aiType = aiType;
+	_blinky = NULL;
+	_flowField = NULL;
+	_pathFinder = NULL;
+	PathFinder::ClearPath(&_path);
+	_distanceTable = NULL;
+	_moveBatch = NULL;
+	_batchSlot = -1;
+	_playerCollisions = true;
+	_zobrist = NULL;
+	_zobristActor = ZOBRIST_FIRST_ENEMY;
+	_zobristKey = 0;
+	_lastDir = 0x0;
+	_nextDir = 0x0;
+    _imageA = true;
+    PublishState();
+}
+
+Enemy::Enemy(Maze* maze, Player* player, Enemy* blinky, uint16_t colour, char aiType, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
+{
+	_maze = maze;
+	_player = player;
+	_colour = colour;
+	_aiType = aiType;
+	_blinky = blinky;
+	_flowField = NULL;
+	_pathFinder = NULL;
+	PathFinder::ClearPath(&_path);
+	_distanceTable = NULL;
+	_moveBatch = NULL;
+	_batchSlot = -1;
+	_playerCollisions = true;
+	_zobrist = NULL;
+	_zobristActor = ZOBRIST_FIRST_ENEMY;
+	_zobristKey = 0;
+	_lastDir = 0x0;
+	_nextDir = 0x0;
+    _imageA = true;
+    PublishState();
+}
+
+// Gives the enemy a flow field leading to the player (NULL to go back to the classic AI)
+// While the enemy targets the player directly (Blinky always, Clyde while far away), it follows the field along the shortest path
+// through the maze instead of heading in a straight line
+void Enemy::SetFlowField(FlowField* flowField)
+{
+    _flowField = flowField;
+}
+
+// Gives the enemy a path finder (NULL to go back to the classic AI)
+// The enemy still picks its target the same way, but follows the shortest path to it through the maze instead of heading in a straight line
+void Enemy::SetPathFinder(PathFinder* pathFinder)
+{
+    _pathFinder = pathFinder;
+    PathFinder::ClearPath(&_path);
+}
+
+// Gives the enemy a distance table (NULL to go back to the classic AI)
+// The enemy still picks its target the same way, but at each junction takes the exit with the fewest steps through the maze to it
+void Enemy::SetDistanceTable(DistanceTable* distanceTable)
+{
+    _distanceTable = distanceTable;
+}
+
+// Puts the enemy in a move batch (NULL to take it back out)
+// While in a batch the enemy doesn't move itself in the PLAY state, whatever owns the batch calls 'StartMove' and 'FinishMove' instead
+void Enemy::SetMoveBatch(GhostMoveBatch* moveBatch)
+{
+    _moveBatch = moveBatch;
+    _batchSlot = -1;
+}
+
+// Turns the enemy's own check for the player on or off (on by default)
+// Turned off by 'CollisionSystem::AddEnemy', as the system checks every actor at once
+void Enemy::SetPlayerCollisions(bool enabled)
+{
+    _playerCollisions = enabled;
+}
+
+// Starts the enemy's movement for this tick: sets its speed for the level (and whether it is in the tunnel)
+// Returns the number of one pixel moves ('StartMove' then 'FinishMove') to make this tick
+int Enemy::StartTick()
+{
+    const SpeedTableEntry* speeds = GetSpeeds(_player->GetLevel());
+    int tileX = position.x / TILE_SIZE;
+
+    if (position.y == TUNNEL_ROW * TILE_SIZE && (tileX < TUNNEL_LENGTH || tileX >= WIDTH - TUNNEL_LENGTH))
+    {
+        SetSpeed(speeds->ghostTunnel);
+    }
+    else
+    {
+        SetSpeed(speeds->ghost);
+    }
+
+    _moveStart = position;
+
+    return TakeSteps();
+}
+
+// First half of a move: picks a direction if the enemy is lined up with a tile
+// In a move batch the choice is added to the batch rather than made straight away
+void Enemy::StartMove()
+{
+    _batchSlot = -1;
+
+    _maze->MarkForRedraw(position);
+
+    // Ghosts can only turn when lined up with a tile, so a new direction is only chosen there
+    // Between tiles the ghost carries on the way it was already going
+    if (position.x % TILE_SIZE == 0 && position.y % TILE_SIZE == 0)
+    {
+        ChooseDirection();
+    }
+}
+
+// Forgets which way the enemy was moving (and any path it was following), as if it had just been constructed
+// Used by headless games so every game starts the same no matter how the last one ended
+void Enemy::ResetMovement()
+{
+    _lastDir = 0x0;
+    _nextDir = 0x0;
+    _batchSlot = -1;
+    _imageA = true;
+    _subPixel = 0;
+    _moveStart = position;
+    PathFinder::ClearPath(&_path);
+    UpdateZobrist();
+    PublishState();
+}
+
+// Stores the enemy's position and directions in 'state'
+void Enemy::SaveState(ActorState* state)
+{
+    state->position = position;
+    state->moveStart = _moveStart;
+    state->lastDir = _lastDir;
+    state->nextDir = _nextDir;
+    state->animationFrame = _imageA;
+    state->subPixel = (uint8_t)_subPixel;
+}
+
+// Puts the enemy's position and directions back from 'state'
+// Any path the enemy was following is forgotten, as it may not lead from the restored position
+void Enemy::LoadState(const ActorState* state)
+{
+    position = state->position;
+    _moveStart = state->moveStart;
+    _subPixel = state->subPixel;
+    _lastDir = state->lastDir;
+    _nextDir = state->nextDir;
+    _imageA = state->animationFrame;
+    _batchSlot = -1;
+    PathFinder::ClearPath(&_path);
+    UpdateZobrist();
+    PublishState();
+}
+
+// Copies the enemy's position and directions into the state returned by 'GetPreviousState'
+void Enemy::PublishState()
+{
+    SaveState(&_previousState);
+}
+
+// Swaps the enemy's key in '_zobrist' for one matching its current position and directions
+void Enemy::UpdateZobrist()
+{
+    if (_zobrist == NULL)
+    {
+        return;
+    }
+
+    ActorState state;
+    SaveState(&state);
+
+    uint64_t key = ZobristHash::GetActorKey(_zobristActor, &state);
+
+    _zobrist->Toggle(_zobristKey ^ key);
+    _zobristKey = key;
+}
+
+// Keeps the given hash up to date with the enemy's state (NULL to stop)
+// 'index' is the enemy's index in 'GameState::enemies'
+void Enemy::SetZobristHash(ZobristHash* zobrist, int index)
+{
+    // Take the enemy's key back out of the old hash before adding it to the new one
+    if (_zobrist != NULL)
+    {
+        _zobrist->Toggle(_zobristKey);
+    }
+
+    _zobrist = zobrist;
+    _zobristActor = ZOBRIST_FIRST_ENEMY + index;
+    _zobristKey = 0;
+    UpdateZobrist();
+}
+
+// Second half of a move: picks up the direction from the move batch (if one was added), moves and checks for the player
+void Enemy::FinishMove()
+{
+    if (_batchSlot != -1)
+    {
+        _nextDir = _moveBatch->GetDirection(_batchSlot);
+        _batchSlot = -1;
+    }
+
+    UpdatePosition(_nextDir);
+
+    _lastDir = _nextDir;
+
+    // Check for collision with the player
+    if (_playerCollisions && HasCollided(_player))
+    {
+        GAME_LOG(context, "Collided with Player!\n");
+        context->nextGameState = DEAD;
+    }
+
+    _imageA = !_imageA;
+
+    // Enemies moving themselves update the hash once at the end of 'Update', but batched ones can be moved after that
+    if (_moveBatch != NULL)
+    {
+        UpdateZobrist();
+    }
+}
+
+void Enemy::Init()
+{
+}
+
+void Enemy::Update()
+{
+    switch (context->curGameState) {
+    case STARTUP:
+        Visible = true;
+        MoveToStartPosition();
+        break;
+    case CONTINUE:
+        MoveToStartPosition();
+        break;
+    case NEXT_LEVEL:
+        MoveToStartPosition();
+        break;
+    case PLAY:
+        // Enemies in a move batch are moved by whatever owns the batch
+        if (_moveBatch == NULL)
+        {
+            int steps = StartTick();
+
+            for (int i = 0; i < steps; i++)
+            {
+                StartMove();
+                FinishMove();
+            }
+        }
+        break;
+    case DEAD:
+        break;
+    default:
+        Visible = false;
+        break;
+    }
+
+    UpdateZobrist();
+	//_nextDir = 0x0;
+}
+
+void Enemy::Draw()
+{
+    //BSP_LCD_DrawPixel(position.x, position.y, _colour);
+    BSP_LCD_SetTextColor(_colour);
+    //BSP_LCD_FillRect(position.x, position.y, TILE_SIZE, TILE_SIZE);
+
+    // The B image of each pair is straight after the A image
+    int frame = _imageA ? 0 : 1;
+
+    if (_lastDir == NORTH)
+    {
+        DrawSprite(SPRITE_GHOST_NORTH_A + frame, _colour);
+    }
+    else if (_lastDir == EAST)
+    {
+        DrawSpriteFlippedHorizontal(SPRITE_GHOST_HORIZONTAL_A + frame, _colour);
+    }
+    else if (_lastDir == SOUTH)
+    {
+        DrawSprite(SPRITE_GHOST_SOUTH_A + frame, _colour);
+    }
+    else
+    {
+        DrawSprite(SPRITE_GHOST_HORIZONTAL_A + frame, _colour);
+    }
+}
+
+/* ENEMY GROUP H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class moves a group of enemies together so that all of their decisions are made in one 'GhostMoveBatch'
+
+Each tick in the PLAY state every enemy picks its target and adds itself to the batch, the batch is evaluated, then every enemy moves
+Enemies can move more than one pixel in a tick (see 'Enemy::StartTick'), so this is done once for every pixel, with each pass
+only including the enemies that still have a pixel left to move
+Enemies in the group still need adding to the game engine to be drawn and to handle the other states
+
+NOTE: Like every other object, enemies in the group only see each other (and the player) as they were at the end of the last tick
+*/
+class EnemyGroup :
+    public BaseGameClass
+{
+private:
+    GhostMoveBatch _moveBatch;
+    Enemy* _enemies[MAX_BATCH_GHOSTS];
+    int _enemyCount;
+
+    // Number of one pixel moves each enemy makes this tick
+    int _steps[MAX_BATCH_GHOSTS];
+
+public:
+    // Constructs an empty group
+    EnemyGroup();
+
+    // Adds an enemy to the group, putting it in the group's move batch
+    // Returns false if the group is full
+    bool AddEnemy(Enemy* enemy);
+
+    // Returns the number of enemies in the group
+    int GetEnemyCount();
+
+    // Update function
+    // State:
+    //      PLAY: Move every enemy in the group
+    //      default: Do nothing (the enemies handle the other states themselves)
+    void Update();
+};
+
+/* ENEMY GROUP CPP */
+//////////////////////////////////////////////////////////////
+
+// Constructs an empty group
+EnemyGroup::EnemyGroup() : BaseGameClass(0, 0)
+{
+    _enemyCount = 0;
+    Visible = false;
+}
+
+// Adds an enemy to the group, putting it in the group's move batch
+// Returns false if the group is full
+bool EnemyGroup::AddEnemy(Enemy* enemy)
+{
+    if (_enemyCount >= MAX_BATCH_GHOSTS)
+    {
+        return false;
+    }
+
+    _enemies[_enemyCount] = enemy;
+    _enemyCount++;
+    enemy->SetMoveBatch(&_moveBatch);
+
+    return true;
+}
+
+// Returns the number of enemies in the group
+int EnemyGroup::GetEnemyCount()
+{
+    return _enemyCount;
+}
+
+// Update function
+// State:
+//      PLAY: Move every enemy in the group
+//      default: Do nothing (the enemies handle the other states themselves)
+void EnemyGroup::Update()
+{
+    switch (context->curGameState) {
+    case PLAY:
+    {
+        int passes = 0;
+
+        for (int i = 0; i < _enemyCount; i++)
+        {
+            _steps[i] = _enemies[i]->StartTick();
+
+            if (_steps[i] > passes)
+            {
+                passes = _steps[i];
+            }
+        }
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            _moveBatch.Clear();
+
+            for (int i = 0; i < _enemyCount; i++)
+            {
+                if (_steps[i] > pass)
+                {
+                    _enemies[i]->StartMove();
+                }
+            }
+
+            _moveBatch.Evaluate();
+
+            for (int i = 0; i < _enemyCount; i++)
+            {
+                if (_steps[i] > pass)
+                {
+                    _enemies[i]->FinishMove();
+                }
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* COLLISION SYSTEM H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class checks every actor added to it against every other once a tick using a 'CollisionGrid', instead of each enemy checking the player itself
+
+Each tick in the PLAY state, once every actor has moved and published its state ('LateUpdate'), the grid is filled with every actor's move
+from this tick ('GetPreviousState'), so collisions are noticed on the tick they happen and the result is the same wherever the system is added to the game engine
+Moves are swept, so actors moving more than a pixel a tick can't pass through each other
+Every overlapping pair is stored for the tick (see 'GetPair'), and a ghost overlapping the player loses the player a life
+*/
+class CollisionSystem :
+    public BaseGameClass
+{
+private:
+    CollisionGrid _grid;
+    BaseGameSprite* _actors[MAX_COLLISION_ACTORS];
+    char _categories[MAX_COLLISION_ACTORS];
+    int _actorCount;
+
+    // Pairs found in the last PLAY tick (actor indices are the order actors were added in)
+    CollisionPair _pairs[MAX_COLLISION_PAIRS];
+    int _pairCount;
+
+public:
+    // Constructs a system with no actors
+    CollisionSystem();
+
+    // Adds an actor of the given category ('COLLISION_*')
+    // Returns false if the system is full
+    bool AddActor(BaseGameSprite* actor, char category);
+
+    // Adds an enemy as a ghost, turning off the enemy's own check for the player
+    // Returns false if the system is full
+    bool AddEnemy(Enemy* enemy);
+
+    // Returns the number of actors added
+    int GetActorCount();
+
+    // Returns the actor added 'index'th
+    BaseGameSprite* GetActor(int index);
+
+    // Returns the number of overlapping pairs found in the last PLAY tick
+    int GetPairCount();
+
+    // Returns the 'index'th overlapping pair found in the last PLAY tick
+    const CollisionPair* GetPair(int index);
+
+    // Late update function, run once every actor has published this tick's move
+    // State:
+    //      PLAY: Find every overlapping pair and handle ghosts catching the player
+    //      default: Forget the pairs from the last tick
+    void LateUpdate();
+};
+
+/* COLLISION SYSTEM CPP */
+//////////////////////////////////////////////////////////////
+
+// Constructs a system with no actors
+CollisionSystem::CollisionSystem() : BaseGameClass(0, 0)
+{
+    _actorCount = 0;
+    _pairCount = 0;
+    Visible = false;
+}
+
+// Adds an actor of the given category ('COLLISION_*')
+// Returns false if the system is full
+bool CollisionSystem::AddActor(BaseGameSprite* actor, char category)
+{
+    if (_actorCount >= MAX_COLLISION_ACTORS)
+    {
+        return false;
+    }
+
+    _actors[_actorCount] = actor;
+    _categories[_actorCount] = category;
+    _actorCount++;
+
+    return true;
+}
+
+// Adds an enemy as a ghost, turning off the enemy's own check for the player
+// Returns false if the system is full
+bool CollisionSystem::AddEnemy(Enemy* enemy)
+{
+    if (!AddActor(enemy, COLLISION_GHOST))
+    {
+        return false;
+    }
+
+    enemy->SetPlayerCollisions(false);
+    return true;
+}
+
+// Returns the number of actors added
+int CollisionSystem::GetActorCount()
+{
+    return _actorCount;
+}
+
+// Returns the actor added 'index'th
+BaseGameSprite* CollisionSystem::GetActor(int index)
+{
+    return _actors[index];
+}
+
+// Returns the number of overlapping pairs found in the last PLAY tick
+int CollisionSystem::GetPairCount()
+{
+    return _pairCount;
+}
+
+// Returns the 'index'th overlapping pair found in the last PLAY tick
+const CollisionPair* CollisionSystem::GetPair(int index)
+{
+    return &_pairs[index];
+}
+
+// Late update function, run once every actor has published this tick's move
+// State:
+//      PLAY: Find every overlapping pair and handle ghosts catching the player
+//      default: Forget the pairs from the last tick
+void CollisionSystem::LateUpdate()
+{
+    switch (context->curGameState) {
+    case PLAY:
+        // Actors are added in the same order every tick, so their grid index is their index in '_actors'
+        _grid.Clear();
+
+        for (int i = 0; i < _actorCount; i++)
+        {
+            const ActorState* state = _actors[i]->GetPreviousState();
+            _grid.Add(state->moveStart, state->position, _categories[i]);
+        }
+
+        _pairCount = _grid.FindPairs(_pairs, MAX_COLLISION_PAIRS);
+
+        for (int i = 0; i < _pairCount; i++)
+        {
+            if (_pairs[i].categoryA == COLLISION_PLAYER && _pairs[i].categoryB == COLLISION_GHOST)
+            {
+                GAME_LOG(context, "Collided with Player!\n");
+                context->nextGameState = DEAD;
+            }
+        }
+        break;
+    default:
+        _pairCount = 0;
+        break;
+    }
+}
+
+/* SPLASH SCREEN H */
+//////////////////////////////////////////////////////////////
+class SplashScreen :
+	public BaseGameClass
+{
+private:
+    int _frameCount;
+public:
+
+    SplashScreen();
+
+    void Update();
+
+    void Draw();
+};
+
+/* SPLASH SCREEN CPP */
+//////////////////////////////////////////////////////////////
+
+SplashScreen::SplashScreen() : BaseGameClass(0, 0)
+{
+    _frameCount = 0;
+}
+
+void SplashScreen::Update()
+{
+    switch (context->curGameState) {
+    case SPLASH_SCREEN:
+        Visible = true;
+        _frameCount++;
+
+        if (_frameCount >= 50)
+        {
+            context->nextGameState = STARTUP;
+            _frameCount = 0;
+        }
+        break;
+    default:
+        Visible = false;
+        break;
+    }
+}
+
+void SplashScreen::Draw()
+{
+    BSP_LCD_Clear(LCD_COLOR_BLACK);
+    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+    BSP_LCD_SetBackColor(LCD_COLOR_BLACK);
+    BSP_LCD_DisplayStringAt(0, BSP_LCD_GetYSize() / 2 - 8, (uint8_t *) "A Pacman-Like Game", CENTER_MODE);
+    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2), (uint8_t *) "for MBED Simulator", CENTER_MODE);
+    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 16, (uint8_t *) "by Thomas Barnaby Gill", CENTER_MODE);
+    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 24, (uint8_t *) "University of Leeds", CENTER_MODE);
+}
+
+/* GAME OVER SCREEN H */
+//////////////////////////////////////////////////////////////
+class GameOverScreen :
+	public BaseGameClass
+{
+public:
+
+    GameOverScreen();
+
+    void Update();
+
+    void Draw();
+};
+
+/* SPLASH SCREEN CPP */
+//////////////////////////////////////////////////////////////
+
+GameOverScreen::GameOverScreen() : BaseGameClass(0, 0)
+{
+
+}
+
+void GameOverScreen::Update()
+{
+    switch (context->curGameState) {
+    case GAME_OVER:
+        Visible = true;
+
+        if (context->tsState.touchDetected)
+        {
+            context->nextGameState = STARTUP;
+        }
+        break;
+    default:
+        Visible = false;
+        break;
+    }
+}
+
+void GameOverScreen::Draw()
+{
+    BSP_LCD_Clear(LCD_COLOR_BLACK);
+    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
+    BSP_LCD_SetBackColor(LCD_COLOR_BLACK);
+    BSP_LCD_DisplayStringAt(0, BSP_LCD_GetYSize() / 2, (uint8_t *) "GAME OVER", CENTER_MODE);
+    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 16, (uint8_t *) "Touch Screen to Play Again...", CENTER_MODE);
+}
+
+/* PACMAN GAME H */
+//////////////////////////////////////////////////////////////
+
+/*
+This class holds every object of the game as it is played on the board (screens, maze, player, four enemies and the collision system),
+each one set up and added to the game's own 'GameEngine'
+
+'main()' and the tools that run the complete game (e.g. 'tools/replay.cpp') all make one of these, so they can't drift apart
+and a recording from the board plays out exactly as it did there
+Input recording, drawing and the LCD are left to the caller
+
+NOTE: The objects add up to several KB, the board's main thread stack is sized to hold them (see 'tools/budget.ini')
+*/
+class PacmanGame
+{
+private:
+    GameEngine _engine;
+
+    Maze _maze;
+    Player _player;
+
+    SplashScreen _splash;
+    GameOverScreen _gameOver;
+
+    Enemy _blinky;
+    Enemy _pinky;
+    Enemy _inky;
+    Enemy _clyde;
+
+    // Checks the player against the enemies
+    CollisionSystem _collisions;
+
+public:
+    // Constructs the game and adds every object to the engine, in the order they are updated and drawn
+    PacmanGame();
 
-    // Check if both tile positions are floor tiles
-    return IsFloor(tilePosA.x, tilePosA.y) && IsFloor(tilePosB.x, tilePosB.y);
-}
+    GameEngine* GetEngine();
 
-// Returns true if the tile position (x, y) contains a pellet
-bool Maze::IsPellet(int x, int y)
-{
-	return IsInBounds(x, y) && ((_pellets[y] >> x) & 0x1);
-}
+    Maze* GetMaze();
 
-// Removes the pellet at the tile position (x, y)
-// If there is a pellet at the given position, returns true
-// If there is no pellet at the given position, returns false
-bool Maze::TryRemovePellet(int x, int y) {
-    // Check if there is a pellet at the given position (x, y)
-    bool hasPellet = IsPellet(x, y);
+    Player* GetPlayer();
 
-    // If there is a pellet
-    if (hasPellet)
-    {
-        // Remove the pellet
-        _pellets[y] &= ~(0x1 << x); // Clear the x'th bit
-    }
-    
-    // Returns true if a pellet was removed
-    return hasPellet;
-}
+    // Returns the enemy at 'index' (in the order they are stored in 'GameState', Blinky first), or NULL if there isn't one
+    Enemy* GetEnemy(int index);
 
-// Converts the given screen position into a tile position
-// Once the tile position is acquired, 'TryRemovePellet' at the tile position is called
-bool Maze::TryRemovePelletScreenPos(Position screenPos) {
-    // Convert the screen position to a tile position
-    Position tilePos = ScreenPosToTilePos(screenPos);
+    // Only the tools that check a game against a recording need its state, so this is left out of the board's build
+#ifdef PACMAN_HOST
+    // Stores the complete state of the game in 'state'
+    void Snapshot(GameState* state);
+#endif
+};
 
-    // Try and remove a pellet at the tile position
-    return TryRemovePellet(tilePos.x, tilePos.y);
-}
+/* PACMAN GAME CPP */
+//////////////////////////////////////////////////////////////
 
-// Converts the given screen position (x, y) to a position on the tilemap
-// Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
-Position Maze::ScreenPosToTilePos(int x, int y)
+// Constructs the game and adds every object to the engine, in the order they are updated and drawn
+PacmanGame::PacmanGame() :
+    _player(&_maze, PLAYER_START_X, PLAYER_START_Y),
+    _blinky(&_maze, &_player, LCD_COLOR_RED, BLINKY_AI, BLINKY_START_X, GHOST_START_Y),
+    _pinky(&_maze, &_player, LCD_COLOR_MAGENTA, PINKY_AI, PINKY_START_X, GHOST_START_Y),
+    _inky(&_maze, &_player, &_blinky, LCD_COLOR_CYAN, INKY_AI, INKY_START_X, GHOST_START_Y),
+    _clyde(&_maze, &_player, LCD_COLOR_ORANGE, CLYDE_AI, CLYDE_START_X, GHOST_START_Y)
 {
-    // Divide the screen position by 'TILE_SIZE'
-	int tileX = x / TILE_SIZE;
-	int tileY = y / TILE_SIZE;
-    
-    // Create a new 'Position' struct to store the new tile position to
-    Position tilePos;
-
-    // Set the 'x' and 'y' of the new 'Position' struct to the tile positions
-    tilePos.x = tileX;
-    tilePos.y = tileY;
-    
-    // Return the new created 'Position' struct
-    return tilePos;
+    _collisions.AddActor(&_player, COLLISION_PLAYER);
+    _collisions.AddEnemy(&_blinky);
+    _collisions.AddEnemy(&_pinky);
+    _collisions.AddEnemy(&_inky);
+    _collisions.AddEnemy(&_clyde);
+
+    _engine.AddGameObject(&_splash);
+    _engine.AddGameObject(&_gameOver);
+    _engine.AddGameObject(&_maze);
+    _engine.AddGameObject(&_player);
+
+    _engine.AddGameObject(&_blinky);
+    _engine.AddGameObject(&_pinky);
+    _engine.AddGameObject(&_inky);
+    _engine.AddGameObject(&_clyde);
+    _engine.AddGameObject(&_collisions);
 }
 
-// Converts the given screen position (screenPos) to a position on the tilemap
-// Tiles are presumed to have dimensions TILE_SIZE * TILE_SIZE
-Position Maze::ScreenPosToTilePos(Position screenPos)
+GameEngine* PacmanGame::GetEngine()
 {
-	return ScreenPosToTilePos(screenPos.x, screenPos.y);
+    return &_engine;
 }
 
-// Update function
-// State:
-//      STARTUP: Make the maze visible + set '_initialDraw' to true + add the pellets to the maze
-//      CONTINUE: Set '_initalDraw' to true
-//      NEXT_LEVEL: Same as 'STARTUP' state
-//      PLAY: Do nothing
-//      DEAD: Do nothing
-//      default: Set the maze to be invisible
-void Maze::Update()
+Maze* PacmanGame::GetMaze()
 {
-    // Game State Switch
-    switch (CurGameState) {
-    // 
-    case STARTUP:
-        _initialDraw = true; // Set the intial draw flag
-        Visible = true; // Make the maze visible
-        SetPelletsClassicMaze(); // Fill the maze with pellets
-        break;
-    case CONTINUE:
-        _initialDraw = true; // Set the intial draw flag
-        break;
-    case NEXT_LEVEL:
-        _initialDraw = true; // Set the intial draw flag
-        Visible = true; // Make the maze visible
-        SetPelletsClassicMaze(); // Fill the maze with pellets
-        break;
-    case PLAY:
-        break;
-    case DEAD:
-        break;
-    default:
-        Visible = false; // Make the maze invisible
-        break;
-    }
+    return &_maze;
 }
 
-// Draws the maze tile at (x, y) onto the LCD
-void Maze::DrawTile(int x, int y)
+Player* PacmanGame::GetPlayer()
 {
-    // If the position is a floor tile or out of bounds
-    if (IsFloor(x, y) || !IsInBounds(x, y)) 
-    {
-        // Draw a black tile
-        BSP_LCD_SetTextColor(LCD_COLOR_BLACK);
-        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+    return &_player;
+}
 
-        // If the position is in bounds and contains a pellet
-        if (IsInBounds(x, y) && IsPellet(x, y))
-        {
-            // Draw a small yellow circle at the centre of the tile
-            BSP_LCD_SetTextColor(LCD_COLOR_YELLOW);
-            BSP_LCD_FillCircle((x * TILE_SIZE) + (TILE_SIZE / 2), (y * TILE_SIZE) + (TILE_SIZE / 2), 1);
-        }
-    } 
-    else 
+// Returns the enemy at 'index' (in the order they are stored in 'GameState', Blinky first), or NULL if there isn't one
+Enemy* PacmanGame::GetEnemy(int index)
+{
+    switch (index)
     {
-        // Draw a blue tile
-        BSP_LCD_SetTextColor(LCD_COLOR_BLUE);
-        BSP_LCD_FillRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE - 1);
+    case 0:
+        return &_blinky;
+    case 1:
+        return &_pinky;
+    case 2:
+        return &_inky;
+    case 3:
+        return &_clyde;
+    default:
+        return NULL;
     }
 }
 
-// Draw function
-// When '_initialDraw' is true, all tiles within the maze are draw
-// When 'initialDraw' is false, only positions in 'redrawStack' are drawn
-void Maze::Draw()
+#ifdef PACMAN_HOST
+// Stores the complete state of the game in 'state'
+void PacmanGame::Snapshot(GameState* state)
 {
-    // If the '_initialDraw' flag is high
-    if (_initialDraw)
-    {
-        // Unset the flag
-        _initialDraw = false;
+    GameContext* context = _engine.GetContext();
+
+    _maze.SaveState(state);
+    _player.SaveState(state);
+    _blinky.SaveState(&state->enemies[0]);
+    _pinky.SaveState(&state->enemies[1]);
+    _inky.SaveState(&state->enemies[2]);
+    _clyde.SaveState(&state->enemies[3]);
+    state->curGameState = context->curGameState;
+    state->nextGameState = context->nextGameState;
+}
+#endif // PACMAN_HOST
 
-        // Redraw every tile in the maze
-        for (int j = 0; j < HEIGHT; j++) {
-            for (int i = 0; i < WIDTH; i++) {
-                DrawTile(i, j);
-            }
-        }
-    }
-    else 
-    {
-        // While there are still tiles to be redrawn in the stack
-        while(!redrawStack.empty())
-        {
-            // Get the position to be redrawn from the top of the stack
-            Position redrawPos = redrawStack.top();
+/* PACMAN ENV H */
+//////////////////////////////////////////////////////////////
 
-            // Convert the screen position to a tile position
-            Position tilePos = ScreenPosToTilePos(redrawPos);
+// The training environments are only built on the host
+#ifdef PACMAN_HOST
+
+// Actions an agent can take each step
+#define ENV_ACTION_NONE 0
+#define ENV_ACTION_NORTH 1
+#define ENV_ACTION_EAST 2
+#define ENV_ACTION_SOUTH 3
+#define ENV_ACTION_WEST 4
+#define ENV_ACTIONS 5
+
+// Observation layout (one int per entry)
+// The first 'ENV_PLANES' blocks of 'HEIGHT' ints are bitboards in the same format as the '_maze' array in 'Maze'
+#define ENV_PLANE_FLOOR 0
+#define ENV_PLANE_PELLETS 1
+#define ENV_PLANE_PLAYER 2
+#define ENV_PLANE_ENEMIES 3
+#define ENV_PLANES 4
+
+// After the planes come 'ENV_FEATURES' ints
+#define ENV_FEATURE_PLAYER_X 0 // Screen position of the player
+#define ENV_FEATURE_PLAYER_Y 1
+#define ENV_FEATURE_PLAYER_DIR 2 // Direction the player last moved in
+#define ENV_FEATURE_ENEMY_X 3 // Screen position of each enemy (x then y, 'ENV_ENEMIES' pairs)
+#define ENV_FEATURE_LIVES 11
+#define ENV_FEATURE_LEVEL 12
+#define ENV_FEATURE_SCORE 13
+#define ENV_FEATURE_STATE 14
+#define ENV_FEATURES 16
+
+#define ENV_OBSERVATION_SIZE ((ENV_PLANES * HEIGHT) + ENV_FEATURES)
+
+#define ENV_ENEMIES 4
+
+// Reward for each pellet eaten and each life lost
+#define ENV_PELLET_REWARD 1.0f
+#define ENV_DEATH_REWARD -10.0f
 
-            // Redraw the tile and some surrounding tiles
-            DrawTile(tilePos.x, tilePos.y);
-            DrawTile(tilePos.x, tilePos.y + 1);
-            DrawTile(tilePos.x + 1, tilePos.y);
+/*
+This class wraps one headless game (maze, player and four enemies) with a gym style 'Reset' / 'Step' API for training player agents
 
-            // Remove the position from the top of the stack
-            redrawStack.pop();
-        }
-    }
-}
+Each env owns its own 'GameEngine' (and so its own 'GameContext'), so any number of envs can be stepped one after the other (or on different threads) without seeing each other's state
+Every tick is run by the engine ('GameEngine::RunHeadlessFrame'), so the env plays exactly the same way as the game on the board
+The player is steered by the action rather than the touchscreen, and the start screens are skipped straight into PLAY
+When the game is over, the step reports done and the env resets itself, so the observation returned is the first of the next game
 
-/* PLAYER H */
-//////////////////////////////////////////////////////////////
-class Player : public BaseGameSprite
+NOTE: Each env is a few KB, so arrays of them should be static or on the heap rather than on the stack
+*/
+class PacmanEnv
 {
 private:
-	Maze* _maze;
-	int _lives;
-    int _score;
-    int _level;
+    Maze _maze;
+    Player _player;
+    Enemy _blinky;
+    Enemy _pinky;
+    Enemy _inky;
+    Enemy _clyde;
 
-	char _nextDir;
+    // Checks the player against the enemies
+    CollisionSystem _collisions;
 
-    bool _mouthOpen;
+    // Kept up to date with the state of the game
+    ZobristHash _zobrist;
 
-    // 2D arrays to store simple, monocolour images
-    char _closedMouthImage[TILE_SIZE];
-    char _openMouthImage[TILE_SIZE];
+    // Runs the game's objects, and the state of this env's game ('_engine.GetContext()')
+    GameEngine _engine;
+    GameContext* _context;
 
-    void SetImageArrays();
+    // When false, 'Step' doesn't reset the game when it ends
+    bool _autoReset;
 
-	void SetDirection();
+    // Ticks stepped since the last reset
+    uint32_t _tick;
+
+    // When set, the player's direction on every step is recorded
+    InputRecorder* _recorder;
+
+    // Runs one tick of the game
+    void Tick();
 
 public:
-	char lastDir;
+    // Constructs a game ready to be reset
+    PacmanEnv();
 
-	Player(Maze* maze, int x, int y);
+    // Starts a new game and writes the first observation into 'observation' ('ENV_OBSERVATION_SIZE' ints, skipped if NULL)
+    void Reset(int32_t observation[]);
 
-	void Init();
+    // Runs one tick with the player steered by 'action' ('ENV_ACTION_*')
+    // Writes the next observation into 'observation' (skipped if NULL), the change in score into 'reward' and whether the game ended into 'done'
+    void Step(int action, int32_t observation[], float* reward, uint8_t* done);
 
-	void Update();
+    // Writes the current observation into 'observation' ('ENV_OBSERVATION_SIZE' ints)
+    void WriteObservation(int32_t observation[]);
 
-	void Draw();
-};
+    // Turns resetting the game when it ends on or off (on by default)
+    // With it off, the finished game can be inspected after 'Step' reports done, until 'Reset' is called
+    void SetAutoReset(bool enabled);
 
-/* PLAYER CPP */
-//////////////////////////////////////////////////////////////
-void Player::SetImageArrays()
-{
-    _closedMouthImage[0] = 0x18;
-    _closedMouthImage[1] = 0x3C;
-    _closedMouthImage[2] = 0x7E;
-    _closedMouthImage[3] = 0xFF;
-    _closedMouthImage[4] = 0xFF;
-    _closedMouthImage[5] = 0x7E;
-    _closedMouthImage[6] = 0x3C;
-    _closedMouthImage[7] = 0x18;
-
-    _openMouthImage[0] = 0x18;
-    _openMouthImage[1] = 0x3C;
-    _openMouthImage[2] = 0x7E;
-    _openMouthImage[3] = 0xF0;
-    _openMouthImage[4] = 0xE0;
-    _openMouthImage[5] = 0x70;
-    _openMouthImage[6] = 0x3E;
-    _openMouthImage[7] = 0x18;
-}
+    // Records the direction the player is steered in on every step into 'recorder' (NULL to stop)
+    // Each reset starts a new recording, so turn auto reset off to keep the recording of a finished game
+    void SetInputRecorder(InputRecorder* recorder);
 
-void Player::SetDirection()
-{
-    if(TS_State.touchDetected) {
-        /* Get X and Y position of the first touch post calibrated */
-        uint16_t x1 = TS_State.touchX[0];
-        uint16_t y1 = TS_State.touchY[0];
+    // Returns the env's maze, e.g. to build a 'MazeGraph' over for the ghosts to search
+    Maze* GetMaze();
 
-        // Get difference in x and y of the player character and the player's input
-        int xDiff = (position.x) - x1;
-        int yDiff = (position.y) - y1;
+    // Returns the env's player, e.g. to build a 'FlowField' leading to it
+    Player* GetPlayer();
 
-        // Find which has direction the greatest absolute value
-        if (abs(xDiff) >= abs(yDiff))
-        {
-            // More differece in the horizontal plane
-            // Check if direction was EAST or WEST of the player
-            if (xDiff < 0)
-            {
-                _nextDir = EAST;
-            }
-            else 
-            {
-                _nextDir = WEST;
-            }
-        }
-        else 
-        {
-            // More differece in the vertical plane
-            // Check if direction was NORTH or SOUTH of the player
-            if (yDiff < 0)
-            {
-                _nextDir = SOUTH;
-            }
-            else
-            {
-                _nextDir = NORTH;
-            }
-        }
-    }
+    // Gives every ghost the same path finder (NULL to go back to the classic AI), see 'Enemy::SetPathFinder'
+    // The path finder must have been made for this env's maze ('GetMaze')
+    void SetGhostPathFinder(PathFinder* pathFinder);
 
-}
+    // Gives every ghost the same distance table (NULL to go back to the classic AI), see 'Enemy::SetDistanceTable'
+    // The table must have been made for this env's maze ('GetMaze')
+    void SetGhostDistanceTable(DistanceTable* distanceTable);
 
+    // Gives every ghost the same flow field (NULL to go back to the classic AI), see 'Enemy::SetFlowField'
+    // The field must have been made for this env's maze and player ('GetMaze' and 'GetPlayer') and lead to the player
+    void SetGhostFlowField(FlowField* flowField);
 
-Player::Player(Maze* maze, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
-{
-	_maze = maze;
-	_nextDir = 0x0;
-	lastDir = EAST;
-    _score = 0;
-    _lives = 3;
-    _level = 1;
-    _mouthOpen = false;
+    int GetScore();
 
-    SetImageArrays();
-}
+    int GetLives();
 
-void Player::Init()
-{
-    _score = 0;
-    _lives = 10;
-}
+    int GetLevel();
 
-void Player::Update()
-{
-    switch (CurGameState) {
-    case STARTUP:
-        Visible = true;
-        Init();
-        MoveToStartPosition();
-        _mouthOpen = false;
+    // Returns the current game state ('PLAY', 'DEAD', ...)
+    char GetGameState();
 
-        if(TS_State.touchDetected) 
-        {
-            SetDirection();
-            NextGameState = PLAY;
-        }
-        break;
-    case CONTINUE:
-        MoveToStartPosition();
-        _mouthOpen = false;
+    // Returns the direction the player last moved in
+    char GetPlayerDirection();
 
-        if(TS_State.touchDetected) 
-        {
-            SetDirection();
-            NextGameState = PLAY;
-        }
-        break;
-    case NEXT_LEVEL:
-        MoveToStartPosition();
+    // Returns the directions the player could move in from the tile it is on (NORTH | EAST | SOUTH | WEST)
+    // Returns 0x0 unless the game is being played and the player is exactly on a tile, as it can only turn there
+    // On later levels the player moves more than a pixel a tick, so a tile it will pass over during the next tick also counts
+    char GetPlayerExits();
 
-        if(TS_State.touchDetected) 
-        {
-            SetDirection();
-            NextGameState = PLAY;
-        }
-        break;
-    case PLAY:
-        _maze->redrawStack.push(position);
+    // Stores the complete state of the game in 'state'
+    void Snapshot(GameState* state);
 
-        SetDirection();
+    // Puts the game back to the state stored in 'state' (by 'Snapshot' on this or any other env)
+    void Restore(const GameState* state);
 
-        if (_maze->IsFloorAdjacentScreenPos(position, _nextDir))
-        {
-            UpdatePosition(_nextDir);
-            _score += _maze->TryRemovePelletScreenPos(position);
-            lastDir = _nextDir;
-            _nextDir = 0x0;
-        }
-        else if (_maze->IsFloorAdjacentScreenPos(position, lastDir))
-        {
-            UpdatePosition(lastDir);
-            _score += _maze->TryRemovePelletScreenPos(position);
-        }
+    // Returns the Zobrist hash of the game's state (the same as 'ZobristHash::ComputeHash' of a 'Snapshot')
+    uint64_t GetHash();
+};
 
-        if (_score == _maze->maxPellets * _level)
-        {
-            _level++;
-            NextGameState = NEXT_LEVEL;
-        }
+/*
+This class steps a caller provided array of 'PacmanEnv's in lockstep
 
-        _mouthOpen = !_mouthOpen;
+Observations for every env are written into one contiguous buffer ('count' * 'ENV_OBSERVATION_SIZE' ints), env 'i' starting at 'i' * 'ENV_OBSERVATION_SIZE'
+Rewards and done flags are written into arrays with one entry per env
+Nothing is allocated, so a training loop can step it with the same buffers forever
+*/
+class PacmanVecEnv
+{
+private:
+    PacmanEnv* _envs;
+    int _count;
+
+public:
+    // Steps the 'count' envs in 'envs'
+    PacmanVecEnv(PacmanEnv envs[], int count);
+
+    // Returns the number of envs
+    int GetCount();
+
+    // Resets every env, writing their first observations into 'observations'
+    void Reset(int32_t observations[]);
+
+    // Steps every env with its action from 'actions', writing the results for env 'i' into entry 'i' of each array
+    void Step(const uint8_t actions[], int32_t observations[], float rewards[], uint8_t dones[]);
+};
+
+/* PACMAN ENV CPP */
+//////////////////////////////////////////////////////////////
 
-        break;
-    case DEAD:
-        NextGameState = CONTINUE;
-        _lives--;
-        printf("Score = %d\nLives = %d\n", _score, _lives);
+// Runs one tick of the game
+void PacmanEnv::Tick()
+{
+    _engine.RunHeadlessFrame();
+    _zobrist.UpdateGameState(_context->curGameState, _context->nextGameState);
+}
 
-        if (_lives == 0)
-        {
-            NextGameState = GAME_OVER;
-        }
-        break;
-    case GAME_OVER:
-        Visible = false;
-        _level = 1;
-    default:
-        Visible = false;
-        break;
-    }
+// Constructs a game ready to be reset
+PacmanEnv::PacmanEnv() :
+    _player(&_maze, PLAYER_START_X, PLAYER_START_Y),
+    _blinky(&_maze, &_player, LCD_COLOR_RED, BLINKY_AI, BLINKY_START_X, GHOST_START_Y),
+    _pinky(&_maze, &_player, LCD_COLOR_MAGENTA, PINKY_AI, PINKY_START_X, GHOST_START_Y),
+    _inky(&_maze, &_player, &_blinky, LCD_COLOR_CYAN, INKY_AI, INKY_START_X, GHOST_START_Y),
+    _clyde(&_maze, &_player, LCD_COLOR_ORANGE, CLYDE_AI, CLYDE_START_X, GHOST_START_Y),
+    _zobrist(&_maze)
+{
+    // Nothing is ever drawn, so positions don't need storing for redrawing
+    _maze.SetRedrawEnabled(false);
+    _player.SetExternalInput(true);
+
+    _context = _engine.GetContext();
+    _context->curGameState = GAME_OVER;
+    _context->nextGameState = GAME_OVER;
+    _context->logEnabled = false;
+    _autoReset = true;
+    _tick = 0;
+    _recorder = NULL;
+
+    // Nothing is ever drawn, and the start screens are skipped, so only the game itself is added
+    _engine.SetDrawEnabled(false);
+    _engine.AddGameObject(&_maze);
+    _engine.AddGameObject(&_player);
+    _engine.AddGameObject(&_blinky);
+    _engine.AddGameObject(&_pinky);
+    _engine.AddGameObject(&_inky);
+    _engine.AddGameObject(&_clyde);
+    _engine.AddGameObject(&_collisions);
+
+    _collisions.AddActor(&_player, COLLISION_PLAYER);
+    _collisions.AddEnemy(&_blinky);
+    _collisions.AddEnemy(&_pinky);
+    _collisions.AddEnemy(&_inky);
+    _collisions.AddEnemy(&_clyde);
+
+    _player.SetZobristHash(&_zobrist);
+    _blinky.SetZobristHash(&_zobrist, 0);
+    _pinky.SetZobristHash(&_zobrist, 1);
+    _inky.SetZobristHash(&_zobrist, 2);
+    _clyde.SetZobristHash(&_zobrist, 3);
+    _zobrist.UpdateGameState(_context->curGameState, _context->nextGameState);
 }
 
-void Player::Draw()
+// Starts a new game and writes the first observation into 'observation' ('ENV_OBSERVATION_SIZE' ints, skipped if NULL)
+void PacmanEnv::Reset(int32_t observation[])
 {
-    //BSP_LCD_DrawPixel(position.x, position.y, LCD_COLOR_YELLOW);
-    // BSP_LCD_SetTextColor(LCD_COLOR_YELLOW);
-    // BSP_LCD_FillRect(position.x, position.y, TILE_SIZE, TILE_SIZE);
+    _player.ResetMovement();
+    _blinky.ResetMovement();
+    _pinky.ResetMovement();
+    _inky.ResetMovement();
+    _clyde.ResetMovement();
 
-    if (!_mouthOpen)
-    {
-        DrawSprite(_closedMouthImage, LCD_COLOR_YELLOW);
-    }
-    else if (lastDir == NORTH)
-    {
-        DrawSpriteRotated90(_openMouthImage, LCD_COLOR_YELLOW);
-    }
-    else if (lastDir == WEST)
-    {
-        DrawSprite(_openMouthImage, LCD_COLOR_YELLOW);
-    }
-    else if (lastDir == SOUTH)
-    {
-        DrawSpriteRotated270(_openMouthImage, LCD_COLOR_YELLOW);
-    }
-    else if (lastDir == EAST)
-    {
-        DrawSpriteFlippedHorizontal(_openMouthImage, LCD_COLOR_YELLOW);
-    }
+    // One tick of GAME_OVER clears the level, then one of STARTUP puts everything back and (with the input always given) moves on to PLAY
+    _context->curGameState = GAME_OVER;
+    _context->nextGameState = GAME_OVER;
+    Tick();
 
-    // Draw game state info at the top of the screen
-    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-    BSP_LCD_SetBackColor(LCD_COLOR_BLUE);  
+    _context->curGameState = STARTUP;
+    _context->nextGameState = STARTUP;
+    Tick();
+
+    _tick = 0;
 
-    char buffer[20];
-    if (CurGameState == PLAY)
+    if (_recorder != NULL)
     {
-        sprintf(buffer, "  LEVEL %d  SCORE %d  LIVES %d   ", _level, _score, _lives);
+        _recorder->Clear();
     }
-    else 
+
+    if (observation != NULL)
     {
-        sprintf(buffer, "     TOUCH SCREEN TO START...");
+        WriteObservation(observation);
     }
-    BSP_LCD_DisplayStringAtLine(0, (uint8_t *) buffer);
 }
 
-/* ENEMY H */
-//////////////////////////////////////////////////////////////
-class Enemy :
-	public BaseGameSprite
+// Runs one tick with the player steered by 'action' ('ENV_ACTION_*')
+// Writes the next observation into 'observation' (skipped if NULL), the change in score into 'reward' and whether the game ended into 'done'
+void PacmanEnv::Step(int action, int32_t observation[], float* reward, uint8_t* done)
 {
-private:
-	Maze* _maze;
-	Player* _player;
-	Position _target;
-	Enemy* _blinky;
-	char _lastDir;
-	char _nextDir;
-	char _aiType;
-    uint16_t _colour;
-
-    char _horizontalLookImageA[TILE_SIZE];
-    char _horizontalLookImageB[TILE_SIZE];
-
-    char _northLookImageA[TILE_SIZE];
-    char _northLookImageB[TILE_SIZE];
-
-    char _southLookImageA[TILE_SIZE];
-    char _southLookImageB[TILE_SIZE];
-
-    bool _imageA;
-
-    void SetImageArrays();
-
-	int GetManhattanDist(int x0, int y0, int x1, int y1);
+    static const char actionDirs[ENV_ACTIONS] = { 0x0, NORTH, EAST, SOUTH, WEST };
 
-	int GetManhattanDist(Position start, Position target);
+    int score = _player.GetScore();
+    int lives = _player.GetLives();
 
-	int GetDistanceSq(int x0, int y0, int x1, int y1);
+    char direction = action > 0 && action < ENV_ACTIONS ? actionDirs[action] : 0x0;
 
-	int GetDistanceSq(int x0, int y0, Position target);
+    if (_recorder != NULL)
+    {
+        _recorder->RecordDirection(_tick, direction);
+    }
 
-	void SetTargetToPlayer();
+    _player.SetInput(direction);
+    Tick();
+    _tick++;
 
-	void SetTargetInfrontOfPlayer();
+    *reward = ((_player.GetScore() - score) * ENV_PELLET_REWARD) + ((lives - _player.GetLives()) * ENV_DEATH_REWARD);
+    *done = _context->curGameState == GAME_OVER;
 
-	void SetTargetBlockPlayer();
+    if (*done && _autoReset)
+    {
+        Reset(observation);
+    }
+    else if (observation != NULL)
+    {
+        WriteObservation(observation);
+    }
+}
 
-	void SetTargetClyde();
+// Writes the current observation into 'observation' ('ENV_OBSERVATION_SIZE' ints)
+void PacmanEnv::WriteObservation(int32_t observation[])
+{
+    int32_t* player = &observation[ENV_PLANE_PLAYER * HEIGHT];
+    int32_t* enemies = &observation[ENV_PLANE_ENEMIES * HEIGHT];
+    int32_t* features = &observation[ENV_PLANES * HEIGHT];
 
-	void SetTarget();
+    _maze.CopyFloor(&observation[ENV_PLANE_FLOOR * HEIGHT]);
+    _maze.CopyPellets(&observation[ENV_PLANE_PELLETS * HEIGHT]);
+    memset(player, 0, HEIGHT * sizeof(int32_t));
+    memset(enemies, 0, HEIGHT * sizeof(int32_t));
+    memset(features, 0, ENV_FEATURES * sizeof(int32_t));
 
-	void GetNextDir();
+    // Actors are marked on the tile under their centre
+    Position tile = _maze.ScreenPosToTilePos(_player.position.x + (TILE_SIZE / 2), _player.position.y + (TILE_SIZE / 2));
 
-public:
-	//char symbol = '~';
+    if (_maze.IsInBounds(tile.x, tile.y))
+    {
+        player[tile.y] |= 0x1 << tile.x;
+    }
 
-	Enemy(Maze* maze, Player* player, uint16_t colour, char aiType, int x, int y);
+    Enemy* enemyList[ENV_ENEMIES] = { &_blinky, &_pinky, &_inky, &_clyde };
 
-	Enemy(Maze* maze, Player* player, Enemy* blinky, uint16_t colour, char aiType, int x, int y);
+    for (int i = 0; i < ENV_ENEMIES; i++)
+    {
+        tile = _maze.ScreenPosToTilePos(enemyList[i]->position.x + (TILE_SIZE / 2), enemyList[i]->position.y + (TILE_SIZE / 2));
 
-	void Init();
+        if (_maze.IsInBounds(tile.x, tile.y))
+        {
+            enemies[tile.y] |= 0x1 << tile.x;
+        }
 
-	void Update();
+        features[ENV_FEATURE_ENEMY_X + (i * 2)] = enemyList[i]->position.x;
+        features[ENV_FEATURE_ENEMY_X + (i * 2) + 1] = enemyList[i]->position.y;
+    }
 
-	void Draw();
-};
+    features[ENV_FEATURE_PLAYER_X] = _player.position.x;
+    features[ENV_FEATURE_PLAYER_Y] = _player.position.y;
+    features[ENV_FEATURE_PLAYER_DIR] = _player.lastDir;
+    features[ENV_FEATURE_LIVES] = _player.GetLives();
+    features[ENV_FEATURE_LEVEL] = _player.GetLevel();
+    features[ENV_FEATURE_SCORE] = _player.GetScore();
+    features[ENV_FEATURE_STATE] = _context->curGameState;
+}
 
-/* ENEMY CPP */
-//////////////////////////////////////////////////////////////
-void Enemy::SetImageArrays()
-{
-    _horizontalLookImageA[0] = 0x18;
-    _horizontalLookImageA[1] = 0x3C;
-    _horizontalLookImageA[2] = 0x7E;
-    _horizontalLookImageA[3] = 0x6A;
-    _horizontalLookImageA[4] = 0x6A;
-    _horizontalLookImageA[5] = 0x7E;
-    _horizontalLookImageA[6] = 0x7E;
-    _horizontalLookImageA[7] = 0x2A;
-
-    _horizontalLookImageB[0] = 0x18;
-    _horizontalLookImageB[1] = 0x3C;
-    _horizontalLookImageB[2] = 0x7E;
-    _horizontalLookImageB[3] = 0x6A;
-    _horizontalLookImageB[4] = 0x6A;
-    _horizontalLookImageB[5] = 0x7E;
-    _horizontalLookImageB[6] = 0x7E;
-    _horizontalLookImageB[7] = 0x54;
-
-    _northLookImageA[0] = 0x18;
-    _northLookImageA[1] = 0x3C;
-    _northLookImageA[2] = 0x5A;
-    _northLookImageA[3] = 0x5A;
-    _northLookImageA[4] = 0x7E;
-    _northLookImageA[5] = 0x7E;
-    _northLookImageA[6] = 0x7E;
-    _northLookImageA[7] = 0x2A;
-
-    _northLookImageB[0] = 0x18;
-    _northLookImageB[1] = 0x3C;
-    _northLookImageB[2] = 0x5A;
-    _northLookImageB[3] = 0x5A;
-    _northLookImageB[4] = 0x7E;
-    _northLookImageB[5] = 0x7E;
-    _northLookImageB[6] = 0x7E;
-    _northLookImageB[7] = 0x54;
-
-    _southLookImageA[0] = 0x18;
-    _southLookImageA[1] = 0x3C;
-    _southLookImageA[2] = 0x5A;
-    _southLookImageA[3] = 0x5A;
-    _southLookImageA[4] = 0x7E;
-    _southLookImageA[5] = 0x7E;
-    _southLookImageA[6] = 0x7E;
-    _southLookImageA[7] = 0x2A;
-
-    _southLookImageB[0] = 0x18;
-    _southLookImageB[1] = 0x3C;
-    _southLookImageB[2] = 0x7E;
-    _southLookImageB[3] = 0x5A;
-    _southLookImageB[4] = 0x5A;
-    _southLookImageB[5] = 0x7E;
-    _southLookImageB[6] = 0x7E;
-    _southLookImageB[7] = 0x54;
+// Turns resetting the game when it ends on or off (on by default)
+// With it off, the finished game can be inspected after 'Step' reports done, until 'Reset' is called
+void PacmanEnv::SetAutoReset(bool enabled)
+{
+    _autoReset = enabled;
 }
 
-int Enemy::GetManhattanDist(int x0, int y0, int x1, int y1)
+// Records the direction the player is steered in on every step into 'recorder' (NULL to stop)
+// Each reset starts a new recording, so turn auto reset off to keep the recording of a finished game
+void PacmanEnv::SetInputRecorder(InputRecorder* recorder)
 {
-	return abs(x0 - x1) + abs(y0 - y1);
+    _recorder = recorder;
 }
 
-int Enemy::GetManhattanDist(Position start, Position target)
+// Returns the env's maze, e.g. to build a 'MazeGraph' over for the ghosts to search
+Maze* PacmanEnv::GetMaze()
 {
-	return GetManhattanDist(start.x, start.y, target.x, target.y);
+    return &_maze;
 }
 
-int Enemy::GetDistanceSq(int x0, int y0, int x1, int y1)
+// Returns the env's player, e.g. to build a 'FlowField' leading to it
+Player* PacmanEnv::GetPlayer()
 {
-	return ((x0 - x1) * (x0 - x1)) + ((y0 - y1) * (y0 - y1));
+    return &_player;
 }
 
-int Enemy::GetDistanceSq(int x0, int y0, Position target)
+// Gives every ghost the same path finder (NULL to go back to the classic AI), see 'Enemy::SetPathFinder'
+// The path finder must have been made for this env's maze ('GetMaze')
+void PacmanEnv::SetGhostPathFinder(PathFinder* pathFinder)
 {
-	return GetDistanceSq(x0, y0, target.x, target.y);
+    _blinky.SetPathFinder(pathFinder);
+    _pinky.SetPathFinder(pathFinder);
+    _inky.SetPathFinder(pathFinder);
+    _clyde.SetPathFinder(pathFinder);
 }
 
-void Enemy::SetTargetToPlayer()
+// Gives every ghost the same distance table (NULL to go back to the classic AI), see 'Enemy::SetDistanceTable'
+// The table must have been made for this env's maze ('GetMaze')
+void PacmanEnv::SetGhostDistanceTable(DistanceTable* distanceTable)
 {
-	_target = _player->position;
+    _blinky.SetDistanceTable(distanceTable);
+    _pinky.SetDistanceTable(distanceTable);
+    _inky.SetDistanceTable(distanceTable);
+    _clyde.SetDistanceTable(distanceTable);
 }
 
-void Enemy::SetTargetInfrontOfPlayer()
+// Gives every ghost the same flow field (NULL to go back to the classic AI), see 'Enemy::SetFlowField'
+// The field must have been made for this env's maze and player ('GetMaze' and 'GetPlayer') and lead to the player
+void PacmanEnv::SetGhostFlowField(FlowField* flowField)
 {
-	if (_player->lastDir == NORTH)
-	{
-		//_target = { _player->position.x, _player->position.y - 4 };
-		_target.x = _player->position.x;
-		_target.y = _player->position.y - (4 * TILE_SIZE);
-	}
-	else if (_player->lastDir == EAST)
-	{
-		//_target = { _player->position.x + 4, _player->position.y };
-		_target.x = _player->position.x + (4 * TILE_SIZE);
-		_target.y = _player->position.y;
-	}
-	else if (_player->lastDir == SOUTH)
-	{
-		//_target = { _player->position.x, _player->position.y + 4 };
-		_target.x = _player->position.x;
-		_target.y = _player->position.y + (4 * TILE_SIZE);
-	}
-	else if (_player->lastDir == WEST)
-	{
-		//_target = { _player->position.x - 4, _player->position.y };
-		_target.x = _player->position.x - (4 * TILE_SIZE);
-		_target.y = _player->position.y;
-	}
+    _blinky.SetFlowField(flowField);
+    _pinky.SetFlowField(flowField);
+    _inky.SetFlowField(flowField);
+    _clyde.SetFlowField(flowField);
 }
 
-void Enemy::SetTargetBlockPlayer()
+int PacmanEnv::GetScore()
 {
-	// Find two tiles ahed of the player
-	if (_player->lastDir == NORTH)
-	{
-		//_target = { _player->position.x, _player->position.y - 2 };
-		_target.x = _player->position.x;
-		_target.y = _player->position.y - (2 * TILE_SIZE);
-	}
-	else if (_player->lastDir == EAST)
-	{
-		//_target = { _player->position.x + 2, _player->position.y };
-		_target.x = _player->position.x + (2 * TILE_SIZE);
-		_target.y = _player->position.y;
-	}
-	else if (_player->lastDir == SOUTH)
-	{
-		//_target = { _player->position.x, _player->position.y + 2 };
-		_target.x = _player->position.x;
-		_target.y = _player->position.y + (2 * TILE_SIZE);
-	}
-	else if (_player->lastDir == WEST)
-	{
-		//_target = { _player->position.x - 2, _player->position.y };
-		_target.x = _player->position.x - (2 * TILE_SIZE);
-		_target.y = _player->position.y;
-	}
+    return _player.GetScore();
+}
 
-	// Rotate the target by 180 degrees in relation to blinky
-	//int xDiff = _target.x - _blinky->position.x;
-	//int yDiff = _target.y - _blinky->position.y;
-    _target.x = _target.x + (_target.x - _blinky->position.x);
-	_target.y = _target.y + (_target.y - _blinky->position.y);
-	//_target = { _target.x + (_target.x - _blinky->position.x), _target.y + (_target.y - _blinky->position.y) };
+int PacmanEnv::GetLives()
+{
+    return _player.GetLives();
 }
 
-void Enemy::SetTargetClyde()
+int PacmanEnv::GetLevel()
 {
-	// If distance to the player is greater than 8 tiles
-	if (GetManhattanDist(position, _player->position) > (8 * TILE_SIZE))
-	{
-		SetTargetToPlayer();
-	}
-	else
-	{
-		//_target = { 0, HEIGHT };
-		_target.x = 0;
-		_target.y = HEIGHT * TILE_SIZE;
-		
-	}
+    return _player.GetLevel();
+}
 
+// Returns the current game state ('PLAY', 'DEAD', ...)
+char PacmanEnv::GetGameState()
+{
+    return _context->curGameState;
 }
 
-void Enemy::SetTarget()
+// Returns the direction the player last moved in
+char PacmanEnv::GetPlayerDirection()
 {
-	if (_aiType == BLINKY_AI)
-	{
-		SetTargetToPlayer();
-	}
-	else if (_aiType == PINKY_AI)
-	{
-		SetTargetInfrontOfPlayer();
-	}
-	else if (_aiType == INKY_AI)
-	{
-		SetTargetBlockPlayer();
-	}
-	else if (_aiType == CLYDE_AI)
-	{
-		SetTargetClyde();
-	}
+    return _player.lastDir;
 }
 
-void Enemy::GetNextDir()
+// Returns the directions the player could move in from the tile it is on (NORTH | EAST | SOUTH | WEST)
+// Returns 0x0 unless the game is being played and the player is exactly on a tile, as it can only turn there
+char PacmanEnv::GetPlayerExits()
 {
-	// Find all possible tiles the enemy can move into, excluding the tile it has just moved away from
-	bool north = _lastDir != SOUTH && _maze->IsFloorAdjacentScreenPos(position, NORTH);
-	bool east = _lastDir != WEST && _maze->IsFloorAdjacentScreenPos(position, EAST);
-	bool south = _lastDir != NORTH && _maze->IsFloorAdjacentScreenPos(position, SOUTH);
-	bool west = _lastDir != EAST && _maze->IsFloorAdjacentScreenPos(position, WEST);
+    if (_context->curGameState != PLAY)
+    {
+        return 0x0;
+    }
 
-	// For each passable tile, get manhattan distance to target
-	int northDist = -1;
-	int eastDist = -1;
-	int southDist = -1;
-	int westDist = -1;
+    Position tile = _player.position;
 
-	char dirs[4] = { NORTH, SOUTH, EAST, WEST };
-	int dists[4] = { -1, -1, -1, -1 };
+    // Pixels until the player is lined up with the next tile along the way it is going
+    int distance = 0;
 
-	// Arrange dirs in order of priority
-	/*
-	if (abs(position.x - _target.x) >= abs(position.y - _target.y))
-	{
-		dirs[0] = EAST;
-		dirs[1] = WEST;
-		dirs[2] = NORTH;
-		dirs[3] = SOUTH;
-	}
-	*/
-	// Get distance from each neighbour to target and the smallest index
-	int smallestIndex = 0;
-	int smallestValue = -1;
+    if (_player.lastDir == EAST)
+    {
+        distance = (TILE_SIZE - (tile.x % TILE_SIZE)) % TILE_SIZE;
+        tile.x += distance;
+    }
+    else if (_player.lastDir == WEST)
+    {
+        distance = tile.x % TILE_SIZE;
+        tile.x -= distance;
+    }
+    else if (_player.lastDir == SOUTH)
+    {
+        distance = (TILE_SIZE - (tile.y % TILE_SIZE)) % TILE_SIZE;
+        tile.y += distance;
+    }
+    else if (_player.lastDir == NORTH)
+    {
+        distance = tile.y % TILE_SIZE;
+        tile.y -= distance;
+    }
 
-	for (int i = 0; i < 4; i++)
-	{
-		int d = -1;
+    // The player has to get to the tile and have a pixel left to turn with, otherwise it is decided once the player is on the tile
+    if ((tile.x % TILE_SIZE) != 0 || (tile.y % TILE_SIZE) != 0 || (distance > 0 && distance >= _player.GetNextSteps()))
+    {
+        return 0x0;
+    }
 
-		if (north && dirs[i] == NORTH)
-		{
-			d = GetDistanceSq(position.x, position.y - 1, _target);
-			dists[i] = d;
-		}
-		else if (east && dirs[i] == EAST)
-		{
-			d = GetDistanceSq(position.x + 1, position.y, _target);
-			dists[i] = d;
-		}
-		else if (south && dirs[i] == SOUTH)
-		{
-			d = GetDistanceSq(position.x, position.y + 1, _target);
-			dists[i] = d;
-		}
-		else if (west && dirs[i] == WEST)
-		{
-			d = GetDistanceSq(position.x - 1, position.y, _target);
-			dists[i] = d;
-		}
+    return _maze.GetExits(tile.x / TILE_SIZE, tile.y / TILE_SIZE);
+}
 
-		if (d != -1 && (d < smallestValue || smallestValue == -1))
-		{
-			smallestValue = d;
-			smallestIndex = i;
-		}
-	}
+// Stores the complete state of the game in 'state'
+void PacmanEnv::Snapshot(GameState* state)
+{
+    _maze.SaveState(state);
+    _player.SaveState(state);
+    _blinky.SaveState(&state->enemies[0]);
+    _pinky.SaveState(&state->enemies[1]);
+    _inky.SaveState(&state->enemies[2]);
+    _clyde.SaveState(&state->enemies[3]);
+    state->curGameState = _context->curGameState;
+    state->nextGameState = _context->nextGameState;
+}
 
-	_nextDir = dirs[smallestIndex];
+// Puts the game back to the state stored in 'state' (by 'Snapshot' on this or any other env)
+void PacmanEnv::Restore(const GameState* state)
+{
+    _maze.LoadState(state);
+    _player.LoadState(state);
+    _blinky.LoadState(&state->enemies[0]);
+    _pinky.LoadState(&state->enemies[1]);
+    _inky.LoadState(&state->enemies[2]);
+    _clyde.LoadState(&state->enemies[3]);
+    _context->curGameState = state->curGameState;
+    _context->nextGameState = state->nextGameState;
+    _zobrist.UpdateGameState(_context->curGameState, _context->nextGameState);
 }
 
-Enemy::Enemy(Maze* maze, Player* player, uint16_t colour, char aiType, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
+// Returns the Zobrist hash of the game's state (the same as 'ZobristHash::ComputeHash' of a 'Snapshot')
+uint64_t PacmanEnv::GetHash()
 {
-	_maze = maze;
-	_player = player;
-	_colour = colour;
-	_aiType = aiType;
-	_lastDir = 0x0;
-	_nextDir = 0x0;
-    _imageA = true;
-    SetImageArrays();
+    return _zobrist.GetHash();
+}
+
+// Steps the 'count' envs in 'envs'
+PacmanVecEnv::PacmanVecEnv(PacmanEnv envs[], int count)
+{
+    _envs = envs;
+    _count = count;
+}
+
+// Returns the number of envs
+int PacmanVecEnv::GetCount()
+{
+    return _count;
 }
 
-Enemy::Enemy(Maze* maze, Player* player, Enemy* blinky, uint16_t colour, char aiType, int x, int y) : BaseGameSprite(x * TILE_SIZE, y * TILE_SIZE)
+// Resets every env, writing their first observations into 'observations'
+void PacmanVecEnv::Reset(int32_t observations[])
 {
-	_maze = maze;
-	_player = player;
-	_colour = colour;
-	_aiType = aiType;
-	_blinky = blinky;
-	_lastDir = 0x0;
-	_nextDir = 0x0;
-    _imageA = true;
-    SetImageArrays();
+    for (int i = 0; i < _count; i++)
+    {
+        _envs[i].Reset(&observations[i * ENV_OBSERVATION_SIZE]);
+    }
 }
 
-void Enemy::Init()
+// Steps every env with its action from 'actions', writing the results for env 'i' into entry 'i' of each array
+void PacmanVecEnv::Step(const uint8_t actions[], int32_t observations[], float rewards[], uint8_t dones[])
 {
+    for (int i = 0; i < _count; i++)
+    {
+        _envs[i].Step(actions[i], &observations[i * ENV_OBSERVATION_SIZE], &rewards[i], &dones[i]);
+    }
 }
 
-void Enemy::Update()
+/* MCTS PLAYER H */
+//////////////////////////////////////////////////////////////
+
+// Max number of nodes in one search tree
+// NOTE: Each node stores a whole 'GameState' (about 250 bytes with the rest of the node), so a full tree is about 1 MB
+#define MCTS_MAX_NODES 4096
+
+// Number of ticks ahead of the root that each playout looks (a tree node or rollout stops once it gets this far)
+// Every playout covers the same number of ticks, so the number of pellets eaten can be compared between them
+#define MCTS_HORIZON_TICKS 320
+
+// Longest the player can go between two junctions before the leg is cut short (in ticks)
+#define MCTS_MAX_LEG_TICKS 512
+
+// UCB1 exploration constant (playout values are between 0 and 1)
+#define MCTS_EXPLORATION 0.7f
+
+// Number of playouts between checks of the clock when a search has a time limit
+#define MCTS_CLOCK_CHECK_PLAYOUTS 16
+
+// Returned by 'MctsPlayer::GetDirectionIndex' for anything that isn't a single direction
+#define MCTS_NO_DIRECTION -1
+
+// Struct used to store one node of the search tree
+// Each node is the game as it is when the player reaches a junction, reached by taking 'direction' from the parent's junction
+struct MctsNode
 {
-    switch (CurGameState) {
-    case STARTUP:
-        Visible = true;
-        MoveToStartPosition();
-        break;
-    case CONTINUE:
-        MoveToStartPosition();
-        break;
-    case NEXT_LEVEL:
-        MoveToStartPosition();
-        break;
-    case PLAY:
-        _maze->redrawStack.push(position);
+    GameState state;
+    int parent; // -1 for the root
+    int children[4]; // Child for each direction (N, E, S, W), -1 if it hasn't been expanded
+    char choices; // Directions that can be taken from this node (0x0 if playouts stop here)
+    char untried; // Choices that haven't been expanded yet
+    int ticks; // Ticks from the root to this node
+    bool alive; // False if a life was lost on the way to this node
+    int visits;
+    float valueSum;
+};
+
+// Struct used to store what a search found out about each direction from the root
+// Results from several searches of the same root (e.g. one per thread) can be combined with 'MctsPlayer::GetBestAction'
+struct MctsResult
+{
+    int visits[4]; // Number of playouts that went each way (N, E, S, W)
+    float valueSums[4]; // Total value of those playouts
+    int playouts;
+    int nodes;
+};
+
+/*
+This class plays the player in a 'PacmanEnv' with Monte Carlo tree search
+
+Decisions are only made at junctions: between them the player just follows the corridor it is in ('GetFollowAction')
+Each tree node is the game at the next junction after taking one direction, so the tree only branches where the player has a choice
+A playout picks a path down the tree with UCB1, expands one new junction, then takes random directions (never turning back) until
+'MCTS_HORIZON_TICKS' ticks after the root
+It is worth nothing if a life is lost, otherwise its value goes up with the number of pellets eaten
+
+Every search has its own 'PacmanEnv' that it restores 'GameState's into, so the game being played is never touched by a search
+Searches with different seeds can run on different threads at the same time (root parallelism) and their results be combined
+
+NOTE: Each search is about 1 MB, so they should be allocated on the heap
+*/
+class MctsPlayer
+{
+private:
+    // Game the playouts are run in
+    PacmanEnv _env;
+
+    MctsNode _nodes[MCTS_MAX_NODES];
+    int _nodeCount;
+
+    uint32_t _random;
+    float _exploration;
+    int _horizonTicks;
+
+    // Returns the next number from a xorshift random number generator
+    uint32_t NextRandom();
+
+    // Returns one of the directions in 'directions' at random
+    char PickRandomDirection(char directions);
+
+    // Takes 'direction' from a junction then follows the corridor to the next junction (or until a life is lost, or 'maxTicks' ticks have gone)
+    // Adds the number of ticks taken to 'ticks', returns false if a life was lost
+    bool PlayLeg(char direction, int maxTicks, int* ticks);
+
+    // Returns the directions a search can choose from at the current state of '_env' (0x0 if the game isn't at a junction)
+    char GetChoices();
+
+    // Adds a node for the current state of '_env', returning its index
+    int AddNode(int parent, int ticks, bool alive);
+
+    // Returns the child of 'node' with the highest UCB1 score
+    int SelectChild(int node);
+
+    // Returns the value of a playout that ended with '_env' (worth nothing if a life was lost)
+    float GetValue(const GameState* root, bool alive);
+
+    // Runs one playout from the root
+    void RunPlayout(const GameState* root);
+
+public:
+    // Constructs a search with the given random seed
+    MctsPlayer(uint32_t seed);
+
+    // Sets the UCB1 exploration constant ('MCTS_EXPLORATION' by default)
+    void SetExploration(float exploration);
+
+    // Sets how many ticks ahead each playout looks ('MCTS_HORIZON_TICKS' by default)
+    void SetHorizon(int ticks);
+
+    // Searches from 'root' until 'maxPlayouts' playouts have been run, 'maxMilliseconds' have gone by (ignored if 0) or the tree is full
+    // What was found about each direction from the root is written into 'result'
+    void Search(const GameState* root, int maxPlayouts, int maxMilliseconds, MctsResult* result);
+
+    // Returns the action to take in 'env', searching from its current state if the player is at a junction
+    // This is all that is needed to let the search play a game in place of the touchscreen
+    int GetAction(PacmanEnv* env, int maxPlayouts, int maxMilliseconds);
 
-        SetTarget();
-        GetNextDir();
-        UpdatePosition(_nextDir);
+    // Returns true if the player in 'env' is at a junction (more than one way to go without turning back), where a search is needed
+    static bool IsAtJunction(PacmanEnv* env);
 
-        _lastDir = _nextDir;
+    // Returns the action that keeps the player in 'env' following its corridor (round corners, 'ENV_ACTION_NONE' if it can go straight on)
+    static int GetFollowAction(PacmanEnv* env);
 
-        // Check for collision with the player
-        if (HasCollided(_player))
+    // Returns the action for the direction with the most visits over 'count' results of searching the same root
+    static int GetBestAction(const MctsResult results[], int count);
+
+    // Returns the index (0 - 3) of a single direction, or 'MCTS_NO_DIRECTION'
+    static int GetDirectionIndex(char direction);
+};
+
+/* MCTS PLAYER CPP */
+//////////////////////////////////////////////////////////////
+
+// Returns the next number from a xorshift random number generator
+uint32_t MctsPlayer::NextRandom()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+// Returns one of the directions in 'directions' at random
+char MctsPlayer::PickRandomDirection(char directions)
+{
+    char options[4];
+    int count = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (directions & (0x1 << i))
         {
-            printf("Collided with Player!\n");
-            NextGameState = DEAD;
+            options[count] = 0x1 << i;
+            count++;
         }
+    }
 
-        _imageA = !_imageA;
-        break;
-    case DEAD:
-        break;
-    default:
-        Visible = false;
-        break;
+    if (count == 0)
+    {
+        return 0x0;
     }
-	//_nextDir = 0x0;
+
+    return options[NextRandom() % count];
 }
 
-void Enemy::Draw()
+// Takes 'direction' from a junction then follows the corridor to the next junction (or until a life is lost, or 'maxTicks' ticks have gone)
+// Adds the number of ticks taken to 'ticks', returns false if a life was lost
+bool MctsPlayer::PlayLeg(char direction, int maxTicks, int* ticks)
 {
-    //BSP_LCD_DrawPixel(position.x, position.y, _colour);
-    BSP_LCD_SetTextColor(_colour);
-    //BSP_LCD_FillRect(position.x, position.y, TILE_SIZE, TILE_SIZE);
+    int action = 1 + GetDirectionIndex(direction);
+    int lives = _env.GetLives();
+    float reward;
+    uint8_t done;
 
-    if (_lastDir == NORTH)
+    for (int i = 0; i < maxTicks && i < MCTS_MAX_LEG_TICKS; i++)
     {
-        if (_imageA)
+        _env.Step(action, NULL, &reward, &done);
+        (*ticks)++;
+
+        if (done || _env.GetGameState() == DEAD || _env.GetLives() < lives)
         {
-            DrawSprite(_northLookImageA, _colour);
+            return false;
         }
-        else 
+
+        if (IsAtJunction(&_env))
         {
-            DrawSprite(_northLookImageB, _colour);
+            return true;
         }
+
+        action = GetFollowAction(&_env);
     }
-    else if (_lastDir == EAST)
+
+    return true;
+}
+
+// Returns the directions a search can choose from at the current state of '_env' (0x0 if the game isn't at a junction)
+char MctsPlayer::GetChoices()
+{
+    if (!IsAtJunction(&_env))
     {
-        if (_imageA)
-        {
-            DrawSpriteFlippedHorizontal(_horizontalLookImageA, _colour);
-        }
-        else 
-        {
-            DrawSpriteFlippedHorizontal(_horizontalLookImageB, _colour);
-        }
+        return 0x0;
     }
-    else if (_lastDir == SOUTH)
+
+    // Turning back is allowed at a junction, as it is the only way to get away from a ghost coming the other way
+    return _env.GetPlayerExits();
+}
+
+// Adds a node for the current state of '_env', returning its index
+int MctsPlayer::AddNode(int parent, int ticks, bool alive)
+{
+    int index = _nodeCount;
+    MctsNode* node = &_nodes[index];
+    _nodeCount++;
+
+    _env.Snapshot(&node->state);
+    node->parent = parent;
+    node->ticks = ticks;
+    node->alive = alive;
+    node->visits = 0;
+    node->valueSum = 0.0f;
+    node->choices = alive && ticks < _horizonTicks ? GetChoices() : 0x0;
+    node->untried = node->choices;
+
+    for (int i = 0; i < 4; i++)
     {
-        if (_imageA)
-        {
-            DrawSprite(_southLookImageA, _colour);
-        }
-        else 
-        {
-            DrawSprite(_southLookImageB, _colour);
-        }
+        node->children[i] = -1;
     }
-    else
+
+    return index;
+}
+
+// Returns the child of 'node' with the highest UCB1 score
+int MctsPlayer::SelectChild(int node)
+{
+    float logVisits = logf((float)_nodes[node].visits);
+    int best = -1;
+    float bestScore = -1.0f;
+
+    for (int i = 0; i < 4; i++)
     {
-        if (_imageA)
+        int child = _nodes[node].children[i];
+
+        if (child == -1)
         {
-            DrawSprite(_horizontalLookImageA, _colour);
+            continue;
         }
-        else 
+
+        // Every child has been visited at least once when it was expanded
+        float visits = (float)_nodes[child].visits;
+        float score = (_nodes[child].valueSum / visits) + (_exploration * sqrtf(logVisits / visits));
+
+        if (score > bestScore)
         {
-            DrawSprite(_horizontalLookImageB, _colour);
+            best = child;
+            bestScore = score;
         }
     }
+
+    return best;
 }
 
-/* SPLASH SCREEN H */
-//////////////////////////////////////////////////////////////
-class SplashScreen :
-	public BaseGameClass
+// Returns the value of a playout that ended with '_env' (worth nothing if a life was lost)
+float MctsPlayer::GetValue(const GameState* root, bool alive)
 {
-private:
-    int _frameCount;
-public:
+    if (!alive)
+    {
+        return 0.0f;
+    }
 
-    SplashScreen();
+    // The player eats at most one pellet per tile, so this is how many it could have eaten over the whole horizon
+    float maxPellets = (float)(_horizonTicks / TILE_SIZE);
+    float pellets = (float)(_env.GetScore() - root->score);
 
-    void Update();
+    // Staying alive is worth something on its own, so that a safe empty corridor beats one with pellets and a ghost
+    return 0.2f + (0.8f * fminf(1.0f, pellets / maxPellets));
+}
 
-    void Draw();
-};
+// Runs one playout from the root
+void MctsPlayer::RunPlayout(const GameState* root)
+{
+    int node = 0;
 
-/* SPLASH SCREEN CPP */
-//////////////////////////////////////////////////////////////
+    // Selection: go down the tree while every choice at the node has been tried
+    while (_nodes[node].choices != 0x0 && _nodes[node].untried == 0x0)
+    {
+        node = SelectChild(node);
+    }
 
-SplashScreen::SplashScreen() : BaseGameClass(0, 0)
+    _env.Restore(&_nodes[node].state);
+    int ticks = _nodes[node].ticks;
+    bool alive = _nodes[node].alive;
+
+    // Expansion: take one of the untried choices, as long as there is room for another node
+    if (_nodes[node].untried != 0x0 && _nodeCount < MCTS_MAX_NODES)
+    {
+        char direction = PickRandomDirection(_nodes[node].untried);
+        _nodes[node].untried &= ~direction;
+
+        alive = PlayLeg(direction, _horizonTicks - ticks, &ticks);
+
+        int child = AddNode(node, ticks, alive);
+        _nodes[node].children[GetDirectionIndex(direction)] = child;
+        node = child;
+    }
+
+    // Rollout: random directions (never turning back) until the horizon, or a life is lost
+    while (alive && ticks < _horizonTicks)
+    {
+        char choices = GetChoices();
+
+        if (choices == 0x0)
+        {
+            // Not at a junction (e.g. the level has just finished), let the game run on by itself
+            float reward;
+            uint8_t done;
+            _env.Step(GetFollowAction(&_env), NULL, &reward, &done);
+            ticks++;
+            continue;
+        }
+
+        char forward = choices & ~OppositeDirection(_env.GetPlayerDirection());
+        char direction = PickRandomDirection(forward != 0x0 ? forward : choices);
+
+        alive = PlayLeg(direction, _horizonTicks - ticks, &ticks);
+    }
+
+    float value = GetValue(root, alive);
+
+    // Backpropagation
+    while (node != -1)
+    {
+        _nodes[node].visits++;
+        _nodes[node].valueSum += value;
+        node = _nodes[node].parent;
+    }
+}
+
+// Constructs a search with the given random seed
+MctsPlayer::MctsPlayer(uint32_t seed)
 {
-    _frameCount = 0;
+    _random = seed | 0x1;
+    _exploration = MCTS_EXPLORATION;
+    _horizonTicks = MCTS_HORIZON_TICKS;
+    _nodeCount = 0;
+
+    _env.SetAutoReset(false);
 }
 
-void SplashScreen::Update()
+// Sets the UCB1 exploration constant ('MCTS_EXPLORATION' by default)
+void MctsPlayer::SetExploration(float exploration)
 {
-    switch (CurGameState) {
-    case SPLASH_SCREEN:
-        Visible = true;
-        _frameCount++;
+    _exploration = exploration;
+}
 
-        if (_frameCount >= 50)
+// Sets how many ticks ahead each playout looks ('MCTS_HORIZON_TICKS' by default)
+void MctsPlayer::SetHorizon(int ticks)
+{
+    _horizonTicks = ticks;
+}
+
+// Searches from 'root' until 'maxPlayouts' playouts have been run, 'maxMilliseconds' have gone by (ignored if 0) or the tree is full
+// What was found about each direction from the root is written into 'result'
+void MctsPlayer::Search(const GameState* root, int maxPlayouts, int maxMilliseconds, MctsResult* result)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    memset(result, 0, sizeof(MctsResult));
+
+    _env.Restore(root);
+    _nodeCount = 0;
+    AddNode(-1, 0, true);
+
+    for (int playout = 0; playout < maxPlayouts; playout++)
+    {
+        // Once the tree is full and every choice tried, playouts would only repeat rollouts from the same leaves
+        if (_nodeCount >= MCTS_MAX_NODES || _nodes[0].choices == 0x0)
         {
-            NextGameState = STARTUP;
-            _frameCount = 0;
+            break;
         }
-        break;
-    default:
-        Visible = false;
-        break;
+
+        if (maxMilliseconds > 0 && (playout % MCTS_CLOCK_CHECK_PLAYOUTS) == 0 &&
+            std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(maxMilliseconds))
+        {
+            break;
+        }
+
+        RunPlayout(root);
+        result->playouts++;
     }
-}
 
-void SplashScreen::Draw()
-{
-    BSP_LCD_Clear(LCD_COLOR_BLACK);
-    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-    BSP_LCD_SetBackColor(LCD_COLOR_BLACK);
-    BSP_LCD_DisplayStringAt(0, BSP_LCD_GetYSize() / 2 - 8, (uint8_t *) "A Pacman-Like Game", CENTER_MODE);
-    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2), (uint8_t *) "for MBED Simulator", CENTER_MODE);
-    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 16, (uint8_t *) "by Thomas Barnaby Gill", CENTER_MODE);
-    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 24, (uint8_t *) "University of Leeds", CENTER_MODE);
+    for (int i = 0; i < 4; i++)
+    {
+        int child = _nodes[0].children[i];
+
+        if (child != -1)
+        {
+            result->visits[i] = _nodes[child].visits;
+            result->valueSums[i] = _nodes[child].valueSum;
+        }
+    }
+
+    result->nodes = _nodeCount;
 }
 
-/* GAME OVER SCREEN H */
-//////////////////////////////////////////////////////////////
-class GameOverScreen :
-	public BaseGameClass
+// Returns the action to take in 'env', searching from its current state if the player is at a junction
+// This is all that is needed to let the search play a game in place of the touchscreen
+int MctsPlayer::GetAction(PacmanEnv* env, int maxPlayouts, int maxMilliseconds)
 {
-public:
+    if (!IsAtJunction(env))
+    {
+        return GetFollowAction(env);
+    }
 
-    GameOverScreen();
+    GameState root;
+    MctsResult result;
 
-    void Update();
+    env->Snapshot(&root);
+    Search(&root, maxPlayouts, maxMilliseconds, &result);
 
-    void Draw();
-};
+    return GetBestAction(&result, 1);
+}
 
-/* SPLASH SCREEN CPP */
-//////////////////////////////////////////////////////////////
+// Returns true if the player in 'env' is at a junction (more than one way to go without turning back), where a search is needed
+bool MctsPlayer::IsAtJunction(PacmanEnv* env)
+{
+    char exits = env->GetPlayerExits();
+    char forward = exits & ~OppositeDirection(env->GetPlayerDirection());
 
-GameOverScreen::GameOverScreen() : BaseGameClass(0, 0)
+    // Clear the lowest bit, anything left means there was more than one
+    return (forward & (forward - 1)) != 0x0;
+}
+
+// Returns the action that keeps the player in 'env' following its corridor (round corners, 'ENV_ACTION_NONE' if it can go straight on)
+int MctsPlayer::GetFollowAction(PacmanEnv* env)
 {
+    char exits = env->GetPlayerExits();
+    char forward = exits & ~OppositeDirection(env->GetPlayerDirection());
 
+    if (forward == 0x0 || (forward & env->GetPlayerDirection()))
+    {
+        // Not on a tile, going straight on, or at a dead end (where the player stops)
+        return ENV_ACTION_NONE;
+    }
+
+    int index = GetDirectionIndex(forward);
+    return index == MCTS_NO_DIRECTION ? ENV_ACTION_NONE : 1 + index;
 }
 
-void GameOverScreen::Update()
+// Returns the action for the direction with the most visits over 'count' results of searching the same root
+int MctsPlayer::GetBestAction(const MctsResult results[], int count)
 {
-    switch (CurGameState) {
-    case GAME_OVER:
-        Visible = true;
+    int best = MCTS_NO_DIRECTION;
+    int bestVisits = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        int visits = 0;
 
-        if (TS_State.touchDetected)
+        for (int j = 0; j < count; j++)
         {
-            NextGameState = STARTUP;
+            visits += results[j].visits[i];
+        }
+
+        if (visits > bestVisits)
+        {
+            best = i;
+            bestVisits = visits;
         }
-        break;
-    default:
-        Visible = false;
-        break;
     }
+
+    return best == MCTS_NO_DIRECTION ? ENV_ACTION_NONE : 1 + best;
 }
 
-void GameOverScreen::Draw()
+// Returns the index (0 - 3) of a single direction, or 'MCTS_NO_DIRECTION'
+int MctsPlayer::GetDirectionIndex(char direction)
 {
-    BSP_LCD_Clear(LCD_COLOR_BLACK);
-    BSP_LCD_SetTextColor(LCD_COLOR_WHITE);
-    BSP_LCD_SetBackColor(LCD_COLOR_BLACK);
-    BSP_LCD_DisplayStringAt(0, BSP_LCD_GetYSize() / 2, (uint8_t *) "GAME OVER", CENTER_MODE);
-    BSP_LCD_DisplayStringAt(0, (BSP_LCD_GetYSize() / 2) + 16, (uint8_t *) "Touch Screen to Play Again...", CENTER_MODE);
+    switch (direction)
+    {
+    case NORTH:
+        return 0;
+    case EAST:
+        return 1;
+    case SOUTH:
+        return 2;
+    case WEST:
+        return 3;
+    default:
+        return MCTS_NO_DIRECTION;
+    }
 }
 
+#endif // PACMAN_HOST
+
 /* Other Functions */
 //////////////////////////////////////////////////////////////
 void LCDInit()
@@ -1814,37 +9284,26 @@ void LCDInit()
 
 /* MAIN */
 //////////////////////////////////////////////////////////////
+
+// Tools that include this file to reuse the game (e.g. 'tools/batch_runner.cpp') define 'PACMAN_NO_MAIN' to leave this out
+#ifndef PACMAN_NO_MAIN
 int main()
 {
     printf("Starting game...\n");
 
-	GameEngine engine;
-	
-	Maze maze;
-
-	Player player(&maze, 13, 22);
+    // Every object of the game, set up the same way as in the tools that replay it
+    PacmanGame game;
+    GameEngine* engine = game.GetEngine();
 
-    SplashScreen splash;
-    GameOverScreen gameOver;
-
-	Enemy enemy1(&maze, &player, LCD_COLOR_RED, BLINKY_AI, 14, 12);
-	Enemy enemy2(&maze, &player, LCD_COLOR_MAGENTA, PINKY_AI, 12, 12);
-	Enemy enemy3(&maze, &player, &enemy1, LCD_COLOR_CYAN, INKY_AI, 10, 12);
-	Enemy enemy4(&maze, &player, LCD_COLOR_ORANGE, CLYDE_AI, 16, 12);
-
-    engine.AddGameObject(&splash);
-    engine.AddGameObject(&gameOver);
-	engine.AddGameObject(&maze);
-	engine.AddGameObject(&player);
-
-	engine.AddGameObject(&enemy1);
-	engine.AddGameObject(&enemy2);
-	engine.AddGameObject(&enemy3);
-	engine.AddGameObject(&enemy4);
+    // Every session is recorded, and printed over serial at each game over so it can be replayed (see 'tools/replay.cpp')
+    // Static as it is several KB, far more than the other objects on the main thread's stack
+    static InputRecorder recorder;
+    engine->SetInputRecorder(&recorder);
 
     printf("Initialising LCD...\n");
     LCDInit();
 
     printf("Entering main game loop...\n");
-	engine.MainGameLoop();
-}
\ No newline at end of file
+	engine->MainGameLoop();
+}
+#endif // PACMAN_NO_MAIN
\ No newline at end of file
@@ -0,0 +1,32 @@
+/*
+Fonts for the BSP shim (the same layout as the BSP's 'fonts.h')
+
+Each character is 'Height' rows of ('Width' + 7) / 8 bytes, with the leftmost pixel in the top bit
+Characters start at ' ' (0x20) and go up to '~' (0x7E)
+
+NOTE: Only 'Font8' (5 x 8 pixels) is provided, as it is the only font the game uses
+*/
+
+#ifndef SHIM_FONTS_H
+#define SHIM_FONTS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _tFont
+{
+    const uint8_t* table;
+    uint16_t Width;
+    uint16_t Height;
+} sFONT;
+
+extern sFONT Font8;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_FONTS_H
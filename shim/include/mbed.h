@@ -0,0 +1,38 @@
+/*
+MBED shim for native builds
+
+Provides the few parts of MBED the game uses, with time kept by a virtual clock rather than the real one (see 'shim.h'):
+    wait_ms, wait_us, wait  - Move the virtual clock forward (and return straight away)
+    us_ticker_read          - Returns the virtual clock in microseconds
+    error                   - Prints the message to stderr and stops the program
+*/
+
+#ifndef SHIM_MBED_H
+#define SHIM_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wait_ms(int ms);
+
+void wait_us(int us);
+
+void wait(float seconds);
+
+uint32_t us_ticker_read(void);
+
+void error(const char* format, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_MBED_H
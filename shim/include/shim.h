@@ -0,0 +1,147 @@
+/*
+BSP shim for native builds
+
+Lets the game build and run on a workstation in place of the MBED simulator, with:
+    - The ST7789H2 LCD emulated on a 240 x 240 RGB565 surface in memory
+    - The FT6x06 touchscreen read from a script of touches
+    - 'wait_ms' moving a virtual clock forward instead of sleeping
+
+Every BSP call, every pixel written to the LCD and every byte that would have been sent over the LCD's bus (16 bit FMC) and
+the touch controller's bus (I2C) is counted, so changes to drawing can be compared on a workstation with a cost model that is
+the same on every run
+
+LCD bus model (every transfer is one 16 bit write, so two bytes):
+    Setting the cursor or window        - 10 transfers (CASET and RASET commands, 4 parameters each)
+    Writing to the LCD's RAM            - 1 transfer for the RAMWR command, then 1 per pixel
+So a single pixel costs 12 transfers, and a line of N pixels costs 11 + N
+
+Touch bus model (I2C, counting address bytes):
+    Reading the number of touches       - 4 bytes
+    Reading each touch's position       - 7 bytes
+
+A program using the shim (e.g. the game's own 'main()', which never returns) can also be controlled with environment variables:
+    SHIM_TOUCH_SCRIPT=FILE  - Touch script loaded by 'BSP_TS_Init' (see 'Shim_LoadTouchScript')
+    SHIM_RUN_MS=N           - 'wait_ms' ends the program once the virtual clock reaches N milliseconds
+    SHIM_FRAME_PPM=FILE     - The LCD's surface is written to FILE as a PPM image when the program ends
+    SHIM_COUNTERS=1         - The counters are printed when the program ends
+*/
+
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the emulated LCD (in pixels)
+#define SHIM_LCD_WIDTH 240
+#define SHIM_LCD_HEIGHT 240
+
+// Most touches a script can hold
+#define SHIM_MAX_TOUCH_EVENTS 4096
+
+// BSP functions that are counted, one entry each in 'ShimCounters::calls'
+typedef enum
+{
+    SHIM_CALL_LCD_INIT,
+    SHIM_CALL_LCD_DEINIT,
+    SHIM_CALL_LCD_GET_X_SIZE,
+    SHIM_CALL_LCD_GET_Y_SIZE,
+    SHIM_CALL_LCD_GET_TEXT_COLOR,
+    SHIM_CALL_LCD_GET_BACK_COLOR,
+    SHIM_CALL_LCD_SET_TEXT_COLOR,
+    SHIM_CALL_LCD_SET_BACK_COLOR,
+    SHIM_CALL_LCD_SET_FONT,
+    SHIM_CALL_LCD_GET_FONT,
+    SHIM_CALL_LCD_CLEAR,
+    SHIM_CALL_LCD_CLEAR_STRING_LINE,
+    SHIM_CALL_LCD_DISPLAY_STRING_AT_LINE,
+    SHIM_CALL_LCD_DISPLAY_STRING_AT,
+    SHIM_CALL_LCD_DISPLAY_CHAR,
+    SHIM_CALL_LCD_READ_PIXEL,
+    SHIM_CALL_LCD_DRAW_PIXEL,
+    SHIM_CALL_LCD_DRAW_H_LINE,
+    SHIM_CALL_LCD_DRAW_V_LINE,
+    SHIM_CALL_LCD_DRAW_LINE,
+    SHIM_CALL_LCD_DRAW_RECT,
+    SHIM_CALL_LCD_DRAW_CIRCLE,
+    SHIM_CALL_LCD_FILL_RECT,
+    SHIM_CALL_LCD_FILL_CIRCLE,
+    SHIM_CALL_LCD_DISPLAY_ON,
+    SHIM_CALL_LCD_DISPLAY_OFF,
+    SHIM_CALL_TS_INIT,
+    SHIM_CALL_TS_DEINIT,
+    SHIM_CALL_TS_GET_STATE,
+    SHIM_CALL_WAIT,
+    SHIM_CALL_COUNT
+} ShimCall;
+
+// Stores everything counted since the last 'Shim_ResetCounters'
+typedef struct
+{
+    uint64_t calls[SHIM_CALL_COUNT]; // Calls made to each BSP function by the program (not by other BSP functions)
+    uint64_t pixelsWritten; // Pixels written to the LCD's RAM, including ones off the edge of the screen
+    uint64_t lcdBusBytes;
+    uint64_t touchBusBytes;
+} ShimCounters;
+
+// One change of the touchscreen's state in a script
+typedef struct
+{
+    uint32_t timeMs; // Time on the virtual clock the change happens at
+    uint8_t touched; // 0 when the screen is let go
+    uint16_t x;
+    uint16_t y;
+} ShimTouchEvent;
+
+// Returns the counters (which carry on counting)
+const ShimCounters* Shim_GetCounters(void);
+
+void Shim_ResetCounters(void);
+
+// Returns the name of the BSP function counted in 'calls[call]'
+const char* Shim_GetCallName(int call);
+
+// Prints every counter that isn't zero to 'file'
+void Shim_PrintCounters(FILE* file);
+
+// Returns the LCD's surface ('SHIM_LCD_WIDTH' * 'SHIM_LCD_HEIGHT' RGB565 pixels, a row at a time)
+const uint16_t* Shim_GetFramebuffer(void);
+
+// Returns a 64 bit hash (XXH64) of the LCD's surface, the same on any host
+// Fast enough to hash every frame: a few microseconds for the whole surface
+uint64_t Shim_HashFramebuffer(void);
+
+// Writes the LCD's surface to 'path' as a binary PPM image, returning 0 if it couldn't be written
+int Shim_WriteFramebufferPPM(const char* path);
+
+// Returns the virtual clock in microseconds (it only moves forward when the program waits)
+uint64_t Shim_GetTimeUs(void);
+
+// Moves the virtual clock forward
+void Shim_AdvanceTimeUs(uint64_t us);
+
+// Sets the touches to play back ('count' events in time order, at most 'SHIM_MAX_TOUCH_EVENTS')
+// The screen reads as the last event at or before the time on the virtual clock (not touched before the first)
+void Shim_SetTouchScript(const ShimTouchEvent* events, int count);
+
+// Loads a touch script from a text file, returning the number of events loaded (or -1 if it couldn't be read)
+// Each line is a time in milliseconds followed by 'x y' for a touch or '-' for letting go, '#' starts a comment:
+//     1000 120 120
+//     1100 -
+int Shim_LoadTouchScript(const char* path);
+
+// Touches the screen (or lets it go when 'touched' is 0) straight away, replacing any script
+void Shim_SetTouch(uint8_t touched, uint16_t x, uint16_t y);
+
+// Puts the LCD, touchscreen, clock and counters back to how they start
+void Shim_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_H
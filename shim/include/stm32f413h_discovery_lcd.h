@@ -0,0 +1,119 @@
+/*
+LCD half of the BSP shim for native builds
+
+Emulates the ST7789H2 240 x 240 LCD of the STM32F413H discovery board on an RGB565 surface in memory (see 'Shim_GetFramebuffer')
+The functions draw the same pixels as the BSP's (same circle and text algorithms) and send the same traffic to the controller,
+which is counted (see 'ShimCounters') rather than timed
+
+NOTE: Only the functions below are emulated, bitmaps, polygons and ellipses aren't
+*/
+
+#ifndef SHIM_STM32F413H_DISCOVERY_LCD_H
+#define SHIM_STM32F413H_DISCOVERY_LCD_H
+
+#include <stdint.h>
+
+#include "fonts.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LCD_OK 0x00
+#define LCD_ERROR 0x01
+#define LCD_TIMEOUT 0x02
+
+// RGB565 colours
+#define LCD_COLOR_BLUE ((uint16_t)0x001F)
+#define LCD_COLOR_GREEN ((uint16_t)0x07E0)
+#define LCD_COLOR_RED ((uint16_t)0xF800)
+#define LCD_COLOR_CYAN ((uint16_t)0x07FF)
+#define LCD_COLOR_MAGENTA ((uint16_t)0xF81F)
+#define LCD_COLOR_YELLOW ((uint16_t)0xFFE0)
+#define LCD_COLOR_LIGHTBLUE ((uint16_t)0x841F)
+#define LCD_COLOR_LIGHTGREEN ((uint16_t)0x87F0)
+#define LCD_COLOR_LIGHTRED ((uint16_t)0xFC10)
+#define LCD_COLOR_LIGHTCYAN ((uint16_t)0x87FF)
+#define LCD_COLOR_LIGHTMAGENTA ((uint16_t)0xFC1F)
+#define LCD_COLOR_LIGHTYELLOW ((uint16_t)0xFFF0)
+#define LCD_COLOR_DARKBLUE ((uint16_t)0x0010)
+#define LCD_COLOR_DARKGREEN ((uint16_t)0x0400)
+#define LCD_COLOR_DARKRED ((uint16_t)0x8000)
+#define LCD_COLOR_DARKCYAN ((uint16_t)0x0410)
+#define LCD_COLOR_DARKMAGENTA ((uint16_t)0x8010)
+#define LCD_COLOR_DARKYELLOW ((uint16_t)0x8400)
+#define LCD_COLOR_WHITE ((uint16_t)0xFFFF)
+#define LCD_COLOR_LIGHTGRAY ((uint16_t)0xD69A)
+#define LCD_COLOR_GRAY ((uint16_t)0x8410)
+#define LCD_COLOR_DARKGRAY ((uint16_t)0x4208)
+#define LCD_COLOR_BLACK ((uint16_t)0x0000)
+#define LCD_COLOR_BROWN ((uint16_t)0xA145)
+#define LCD_COLOR_ORANGE ((uint16_t)0xFD20)
+
+// Returns the y position of a line of text in the current font
+#define LINE(x) ((x) * (((sFONT*)BSP_LCD_GetFont())->Height))
+
+typedef enum
+{
+    CENTER_MODE = 0x01,
+    RIGHT_MODE = 0x02,
+    LEFT_MODE = 0x03
+} Line_ModeTypdef;
+
+uint8_t BSP_LCD_Init(void);
+
+uint8_t BSP_LCD_DeInit(void);
+
+uint32_t BSP_LCD_GetXSize(void);
+
+uint32_t BSP_LCD_GetYSize(void);
+
+uint16_t BSP_LCD_GetTextColor(void);
+
+uint16_t BSP_LCD_GetBackColor(void);
+
+void BSP_LCD_SetTextColor(uint16_t Color);
+
+void BSP_LCD_SetBackColor(uint16_t Color);
+
+void BSP_LCD_SetFont(sFONT* fonts);
+
+sFONT* BSP_LCD_GetFont(void);
+
+void BSP_LCD_Clear(uint16_t Color);
+
+void BSP_LCD_ClearStringLine(uint16_t Line);
+
+void BSP_LCD_DisplayStringAtLine(uint16_t Line, uint8_t* ptr);
+
+void BSP_LCD_DisplayStringAt(uint16_t Xpos, uint16_t Ypos, uint8_t* Text, Line_ModeTypdef Mode);
+
+void BSP_LCD_DisplayChar(uint16_t Xpos, uint16_t Ypos, uint8_t Ascii);
+
+uint16_t BSP_LCD_ReadPixel(uint16_t Xpos, uint16_t Ypos);
+
+void BSP_LCD_DrawPixel(uint16_t Xpos, uint16_t Ypos, uint16_t RGB_Code);
+
+void BSP_LCD_DrawHLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length);
+
+void BSP_LCD_DrawVLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length);
+
+void BSP_LCD_DrawLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+void BSP_LCD_DrawRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height);
+
+void BSP_LCD_DrawCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
+
+void BSP_LCD_FillRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height);
+
+void BSP_LCD_FillCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
+
+void BSP_LCD_DisplayOn(void);
+
+void BSP_LCD_DisplayOff(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_STM32F413H_DISCOVERY_LCD_H
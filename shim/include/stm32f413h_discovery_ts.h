@@ -0,0 +1,49 @@
+/*
+Touchscreen half of the BSP shim for native builds
+
+Emulates the FT6x06 touch controller of the STM32F413H discovery board, reading touches from a script (see 'Shim_SetTouchScript')
+at the time on the virtual clock, so runs are the same every time
+The I2C traffic a real read would cause is counted (see 'ShimCounters')
+*/
+
+#ifndef SHIM_STM32F413H_DISCOVERY_TS_H
+#define SHIM_STM32F413H_DISCOVERY_TS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TS_MAX_NB_TOUCH 2
+
+typedef struct
+{
+    uint8_t touchDetected; // Number of touches
+    uint16_t touchX[TS_MAX_NB_TOUCH];
+    uint16_t touchY[TS_MAX_NB_TOUCH];
+    uint8_t touchWeight[TS_MAX_NB_TOUCH];
+    uint8_t touchEventId[TS_MAX_NB_TOUCH];
+    uint8_t touchArea[TS_MAX_NB_TOUCH];
+    uint32_t gestureId;
+} TS_StateTypeDef;
+
+typedef enum
+{
+    TS_OK = 0x00,
+    TS_ERROR = 0x01,
+    TS_TIMEOUT = 0x02,
+    TS_DEVICE_NOT_FOUND = 0x03
+} TS_StatusTypeDef;
+
+uint8_t BSP_TS_Init(uint16_t ts_SizeX, uint16_t ts_SizeY);
+
+uint8_t BSP_TS_DeInit(void);
+
+uint8_t BSP_TS_GetState(TS_StateTypeDef* TS_State);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHIM_STM32F413H_DISCOVERY_TS_H
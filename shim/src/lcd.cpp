@@ -0,0 +1,429 @@
+/*
+ST7789H2 LCD emulation of the BSP shim
+
+Drawing follows the BSP: shapes are broken down into pixels and horizontal lines the same way, and only the controller's
+operations at the bottom ('WritePixel' and 'WriteLine') touch the surface and count bus traffic
+Pixels off the edge of the screen are still sent (and counted), but not stored
+*/
+
+#include <string.h>
+
+#include "stm32f413h_discovery_lcd.h"
+#include "shim_internal.h"
+
+uint16_t g_shimFramebuffer[SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT];
+
+static uint16_t _textColor = LCD_COLOR_BLACK;
+static uint16_t _backColor = LCD_COLOR_WHITE;
+static sFONT* _font = &Font8;
+
+/* CONTROLLER */
+//////////////////////////////////////////////////////////////
+
+// Stores a pixel on the surface if it is on the screen
+static void StorePixel(uint16_t x, uint16_t y, uint16_t color)
+{
+    if (x < SHIM_LCD_WIDTH && y < SHIM_LCD_HEIGHT)
+    {
+        g_shimFramebuffer[(y * SHIM_LCD_WIDTH) + x] = color;
+    }
+}
+
+// Sets the cursor, then writes one pixel
+static void WritePixel(uint16_t x, uint16_t y, uint16_t color)
+{
+    StorePixel(x, y, color);
+
+    g_shimCounters.pixelsWritten++;
+    g_shimCounters.lcdBusBytes += (SHIM_LCD_CURSOR_TRANSFERS + 2) * SHIM_LCD_TRANSFER_BYTES;
+}
+
+// Sets the cursor, then writes 'length' pixels going right
+static void WriteLine(uint16_t x, uint16_t y, uint16_t length, uint16_t color)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        StorePixel((uint16_t)(x + i), y, color);
+    }
+
+    g_shimCounters.pixelsWritten += length;
+    g_shimCounters.lcdBusBytes += (SHIM_LCD_CURSOR_TRANSFERS + 1 + length) * SHIM_LCD_TRANSFER_BYTES;
+}
+
+/* DRAWING */
+//////////////////////////////////////////////////////////////
+
+static void DrawHLine(uint16_t x, uint16_t y, uint16_t length)
+{
+    WriteLine(x, y, length, _textColor);
+}
+
+static void DrawVLine(uint16_t x, uint16_t y, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        WritePixel(x, (uint16_t)(y + i), _textColor);
+    }
+}
+
+// NOTE: Like the BSP's (a 'do { } while (Height--)' loop), this fills 'height' + 1 lines, which the game relies on
+static void FillRect(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    for (uint32_t i = 0; i <= height; i++)
+    {
+        DrawHLine(x, (uint16_t)(y + i), width);
+    }
+}
+
+// The BSP's midpoint circle, a pixel in each octant at a time
+static void DrawCircle(uint16_t x, uint16_t y, uint16_t radius)
+{
+    int32_t decision = 3 - (radius << 1);
+    uint32_t currentX = 0;
+    uint32_t currentY = radius;
+
+    while (currentX <= currentY)
+    {
+        WritePixel((uint16_t)(x + currentX), (uint16_t)(y - currentY), _textColor);
+        WritePixel((uint16_t)(x - currentX), (uint16_t)(y - currentY), _textColor);
+        WritePixel((uint16_t)(x + currentY), (uint16_t)(y - currentX), _textColor);
+        WritePixel((uint16_t)(x - currentY), (uint16_t)(y - currentX), _textColor);
+        WritePixel((uint16_t)(x + currentX), (uint16_t)(y + currentY), _textColor);
+        WritePixel((uint16_t)(x - currentX), (uint16_t)(y + currentY), _textColor);
+        WritePixel((uint16_t)(x + currentY), (uint16_t)(y + currentX), _textColor);
+        WritePixel((uint16_t)(x - currentY), (uint16_t)(y + currentX), _textColor);
+
+        if (decision < 0)
+        {
+            decision += (int32_t)(currentX << 2) + 6;
+        }
+        else
+        {
+            decision += (int32_t)((currentX - currentY) << 2) + 10;
+            currentY--;
+        }
+
+        currentX++;
+    }
+}
+
+// The BSP fills a circle with horizontal lines, then draws its outline over them
+static void FillCircle(uint16_t x, uint16_t y, uint16_t radius)
+{
+    int32_t decision = 3 - (radius << 1);
+    uint32_t currentX = 0;
+    uint32_t currentY = radius;
+
+    while (currentX <= currentY)
+    {
+        if (currentY > 0)
+        {
+            DrawHLine((uint16_t)(x - currentY), (uint16_t)(y + currentX), (uint16_t)(2 * currentY));
+            DrawHLine((uint16_t)(x - currentY), (uint16_t)(y - currentX), (uint16_t)(2 * currentY));
+        }
+
+        if (currentX > 0)
+        {
+            DrawHLine((uint16_t)(x - currentX), (uint16_t)(y - currentY), (uint16_t)(2 * currentX));
+            DrawHLine((uint16_t)(x - currentX), (uint16_t)(y + currentY), (uint16_t)(2 * currentX));
+        }
+
+        if (decision < 0)
+        {
+            decision += (int32_t)(currentX << 2) + 6;
+        }
+        else
+        {
+            decision += (int32_t)((currentX - currentY) << 2) + 10;
+            currentY--;
+        }
+
+        currentX++;
+    }
+
+    DrawCircle(x, y, radius);
+}
+
+// Draws a character a pixel at a time, in the text colour on the back colour
+static void DisplayChar(uint16_t x, uint16_t y, uint8_t ascii)
+{
+    if (ascii < ' ' || ascii > '~')
+    {
+        ascii = ' ';
+    }
+
+    int bytesPerRow = (_font->Width + 7) / 8;
+    int offset = (8 * bytesPerRow) - _font->Width;
+    const uint8_t* glyph = &_font->table[(ascii - ' ') * _font->Height * bytesPerRow];
+
+    for (int row = 0; row < _font->Height; row++)
+    {
+        const uint8_t* rowBytes = glyph + (bytesPerRow * row);
+        uint32_t line = 0;
+
+        for (int i = 0; i < bytesPerRow; i++)
+        {
+            line = (line << 8) | rowBytes[i];
+        }
+
+        for (int column = 0; column < _font->Width; column++)
+        {
+            bool set = (line & (1u << (_font->Width - column + offset - 1))) != 0;
+            WritePixel((uint16_t)(x + column), (uint16_t)(y + row), set ? _textColor : _backColor);
+        }
+    }
+}
+
+static void DisplayStringAt(uint16_t x, uint16_t y, const uint8_t* text, Line_ModeTypdef mode)
+{
+    int size = (int)strlen((const char*)text);
+    int charactersPerLine = SHIM_LCD_WIDTH / _font->Width;
+    int column;
+
+    switch (mode)
+    {
+    case CENTER_MODE:
+        column = x + (((charactersPerLine - size) * _font->Width) / 2);
+        break;
+    case RIGHT_MODE:
+        column = -x + ((charactersPerLine - size) * _font->Width);
+        break;
+    default:
+        column = x;
+        break;
+    }
+
+    // Like the BSP, text that would start off the screen starts at its left edge
+    if (column < 1 || column >= 0x8000)
+    {
+        column = 1;
+    }
+
+    // Only whole characters that fit on the line are drawn
+    for (int i = 0; text[i] != '\0' && SHIM_LCD_WIDTH - (i * _font->Width) >= _font->Width; i++)
+    {
+        DisplayChar((uint16_t)column, y, text[i]);
+        column += _font->Width;
+    }
+}
+
+void ShimResetLcd(void)
+{
+    memset(g_shimFramebuffer, 0, sizeof(g_shimFramebuffer));
+    _textColor = LCD_COLOR_BLACK;
+    _backColor = LCD_COLOR_WHITE;
+    _font = &Font8;
+}
+
+/* BSP */
+//////////////////////////////////////////////////////////////
+
+uint8_t BSP_LCD_Init(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_INIT]++;
+    ShimResetLcd();
+    return LCD_OK;
+}
+
+uint8_t BSP_LCD_DeInit(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DEINIT]++;
+    return LCD_OK;
+}
+
+uint32_t BSP_LCD_GetXSize(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_GET_X_SIZE]++;
+    return SHIM_LCD_WIDTH;
+}
+
+uint32_t BSP_LCD_GetYSize(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_GET_Y_SIZE]++;
+    return SHIM_LCD_HEIGHT;
+}
+
+uint16_t BSP_LCD_GetTextColor(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_GET_TEXT_COLOR]++;
+    return _textColor;
+}
+
+uint16_t BSP_LCD_GetBackColor(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_GET_BACK_COLOR]++;
+    return _backColor;
+}
+
+void BSP_LCD_SetTextColor(uint16_t Color)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_SET_TEXT_COLOR]++;
+    _textColor = Color;
+}
+
+void BSP_LCD_SetBackColor(uint16_t Color)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_SET_BACK_COLOR]++;
+    _backColor = Color;
+}
+
+void BSP_LCD_SetFont(sFONT* fonts)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_SET_FONT]++;
+    _font = fonts;
+}
+
+sFONT* BSP_LCD_GetFont(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_GET_FONT]++;
+    return _font;
+}
+
+// Fills the screen a line at a time in 'Color', leaving the text colour as it was
+void BSP_LCD_Clear(uint16_t Color)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_CLEAR]++;
+
+    for (uint16_t y = 0; y < SHIM_LCD_HEIGHT; y++)
+    {
+        WriteLine(0, y, SHIM_LCD_WIDTH, Color);
+    }
+}
+
+// Fills a line of text in the back colour
+void BSP_LCD_ClearStringLine(uint16_t Line)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_CLEAR_STRING_LINE]++;
+
+    uint16_t textColor = _textColor;
+    _textColor = _backColor;
+    FillRect(0, (uint16_t)(Line * _font->Height), SHIM_LCD_WIDTH, _font->Height);
+    _textColor = textColor;
+}
+
+void BSP_LCD_DisplayStringAtLine(uint16_t Line, uint8_t* ptr)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DISPLAY_STRING_AT_LINE]++;
+    DisplayStringAt(0, (uint16_t)(Line * _font->Height), ptr, LEFT_MODE);
+}
+
+void BSP_LCD_DisplayStringAt(uint16_t Xpos, uint16_t Ypos, uint8_t* Text, Line_ModeTypdef Mode)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DISPLAY_STRING_AT]++;
+    DisplayStringAt(Xpos, Ypos, Text, Mode);
+}
+
+void BSP_LCD_DisplayChar(uint16_t Xpos, uint16_t Ypos, uint8_t Ascii)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DISPLAY_CHAR]++;
+    DisplayChar(Xpos, Ypos, Ascii);
+}
+
+// Reading back costs the cursor, the RAMRD command, a dummy read and the pixel
+uint16_t BSP_LCD_ReadPixel(uint16_t Xpos, uint16_t Ypos)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_READ_PIXEL]++;
+    g_shimCounters.lcdBusBytes += (SHIM_LCD_CURSOR_TRANSFERS + 3) * SHIM_LCD_TRANSFER_BYTES;
+
+    if (Xpos < SHIM_LCD_WIDTH && Ypos < SHIM_LCD_HEIGHT)
+    {
+        return g_shimFramebuffer[(Ypos * SHIM_LCD_WIDTH) + Xpos];
+    }
+
+    return 0;
+}
+
+void BSP_LCD_DrawPixel(uint16_t Xpos, uint16_t Ypos, uint16_t RGB_Code)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_PIXEL]++;
+    WritePixel(Xpos, Ypos, RGB_Code);
+}
+
+void BSP_LCD_DrawHLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_H_LINE]++;
+    DrawHLine(Xpos, Ypos, Length);
+}
+
+void BSP_LCD_DrawVLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_V_LINE]++;
+    DrawVLine(Xpos, Ypos, Length);
+}
+
+// Bresenham's line, a pixel at a time
+void BSP_LCD_DrawLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_LINE]++;
+
+    int x = x1;
+    int y = y1;
+    int deltaX = x2 > x1 ? x2 - x1 : x1 - x2;
+    int deltaY = y2 > y1 ? y2 - y1 : y1 - y2;
+    int stepX = x2 >= x1 ? 1 : -1;
+    int stepY = y2 >= y1 ? 1 : -1;
+    int error = deltaX - deltaY;
+
+    while (true)
+    {
+        WritePixel((uint16_t)x, (uint16_t)y, _textColor);
+
+        if (x == x2 && y == y2)
+        {
+            break;
+        }
+
+        if (2 * error > -deltaY)
+        {
+            error -= deltaY;
+            x += stepX;
+        }
+
+        if (2 * error < deltaX)
+        {
+            error += deltaX;
+            y += stepY;
+        }
+    }
+}
+
+void BSP_LCD_DrawRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_RECT]++;
+
+    DrawHLine(Xpos, Ypos, Width);
+    DrawHLine(Xpos, (uint16_t)(Ypos + Height), Width);
+    DrawVLine(Xpos, Ypos, Height);
+    DrawVLine((uint16_t)(Xpos + Width), Ypos, Height);
+}
+
+void BSP_LCD_DrawCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DRAW_CIRCLE]++;
+    DrawCircle(Xpos, Ypos, Radius);
+}
+
+void BSP_LCD_FillRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_FILL_RECT]++;
+    FillRect(Xpos, Ypos, Width, Height);
+}
+
+void BSP_LCD_FillCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_FILL_CIRCLE]++;
+    FillCircle(Xpos, Ypos, Radius);
+}
+
+// Turning the display on or off is one command
+void BSP_LCD_DisplayOn(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DISPLAY_ON]++;
+    g_shimCounters.lcdBusBytes += SHIM_LCD_TRANSFER_BYTES;
+}
+
+void BSP_LCD_DisplayOff(void)
+{
+    g_shimCounters.calls[SHIM_CALL_LCD_DISPLAY_OFF]++;
+    g_shimCounters.lcdBusBytes += SHIM_LCD_TRANSFER_BYTES;
+}
@@ -0,0 +1,346 @@
+/*
+Counters, virtual clock and the MBED functions of the BSP shim
+*/
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbed.h"
+#include "shim_internal.h"
+
+ShimCounters g_shimCounters;
+
+static uint64_t _timeUs = 0;
+
+// When not 0, 'wait_ms' ends the program once the virtual clock gets to this many microseconds ('SHIM_RUN_MS')
+static uint64_t _runLimitUs = 0;
+
+static const char* CALL_NAMES[SHIM_CALL_COUNT] =
+{
+    "BSP_LCD_Init",
+    "BSP_LCD_DeInit",
+    "BSP_LCD_GetXSize",
+    "BSP_LCD_GetYSize",
+    "BSP_LCD_GetTextColor",
+    "BSP_LCD_GetBackColor",
+    "BSP_LCD_SetTextColor",
+    "BSP_LCD_SetBackColor",
+    "BSP_LCD_SetFont",
+    "BSP_LCD_GetFont",
+    "BSP_LCD_Clear",
+    "BSP_LCD_ClearStringLine",
+    "BSP_LCD_DisplayStringAtLine",
+    "BSP_LCD_DisplayStringAt",
+    "BSP_LCD_DisplayChar",
+    "BSP_LCD_ReadPixel",
+    "BSP_LCD_DrawPixel",
+    "BSP_LCD_DrawHLine",
+    "BSP_LCD_DrawVLine",
+    "BSP_LCD_DrawLine",
+    "BSP_LCD_DrawRect",
+    "BSP_LCD_DrawCircle",
+    "BSP_LCD_FillRect",
+    "BSP_LCD_FillCircle",
+    "BSP_LCD_DisplayOn",
+    "BSP_LCD_DisplayOff",
+    "BSP_TS_Init",
+    "BSP_TS_DeInit",
+    "BSP_TS_GetState",
+    "wait"
+};
+
+/* ENVIRONMENT */
+//////////////////////////////////////////////////////////////
+
+// Writes the frame and prints the counters when the program ends, if asked to
+static void OnExit()
+{
+    const char* framePath = getenv("SHIM_FRAME_PPM");
+
+    if (framePath != NULL && framePath[0] != '\0' && !Shim_WriteFramebufferPPM(framePath))
+    {
+        fprintf(stderr, "Shim: couldn't write '%s'\n", framePath);
+    }
+
+    const char* counters = getenv("SHIM_COUNTERS");
+
+    if (counters != NULL && counters[0] != '\0' && counters[0] != '0')
+    {
+        Shim_PrintCounters(stdout);
+    }
+}
+
+// Reads the environment variables before 'main()' runs
+struct ShimEnvironment
+{
+    ShimEnvironment()
+    {
+        const char* runMs = getenv("SHIM_RUN_MS");
+
+        if (runMs != NULL)
+        {
+            _runLimitUs = strtoull(runMs, NULL, 10) * 1000;
+        }
+
+        atexit(OnExit);
+    }
+};
+
+static ShimEnvironment _environment;
+
+/* COUNTERS */
+//////////////////////////////////////////////////////////////
+
+const ShimCounters* Shim_GetCounters(void)
+{
+    return &g_shimCounters;
+}
+
+void Shim_ResetCounters(void)
+{
+    memset(&g_shimCounters, 0, sizeof(g_shimCounters));
+}
+
+const char* Shim_GetCallName(int call)
+{
+    return call >= 0 && call < SHIM_CALL_COUNT ? CALL_NAMES[call] : "?";
+}
+
+void Shim_PrintCounters(FILE* file)
+{
+    fprintf(file, "Virtual time:     %llu us\n", (unsigned long long)_timeUs);
+    fprintf(file, "Pixels written:   %llu\n", (unsigned long long)g_shimCounters.pixelsWritten);
+    fprintf(file, "LCD bus bytes:    %llu\n", (unsigned long long)g_shimCounters.lcdBusBytes);
+    fprintf(file, "Touch bus bytes:  %llu\n", (unsigned long long)g_shimCounters.touchBusBytes);
+
+    for (int i = 0; i < SHIM_CALL_COUNT; i++)
+    {
+        if (g_shimCounters.calls[i] > 0)
+        {
+            fprintf(file, "    %-28s %llu\n", CALL_NAMES[i], (unsigned long long)g_shimCounters.calls[i]);
+        }
+    }
+}
+
+/* FRAMEBUFFER */
+//////////////////////////////////////////////////////////////
+
+const uint16_t* Shim_GetFramebuffer(void)
+{
+    return g_shimFramebuffer;
+}
+
+// XXH64 primes
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ull
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define XXH_PRIME64_3 0x165667B19E3779F9ull
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ull
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ull
+
+static uint64_t RotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Reads 8 or 4 bytes as a little endian number (the byte order XXH64 is defined in)
+static uint64_t Read64(const uint8_t* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static uint64_t Read32(const uint8_t* bytes)
+{
+    return (uint64_t)bytes[0] | ((uint64_t)bytes[1] << 8) | ((uint64_t)bytes[2] << 16) | ((uint64_t)bytes[3] << 24);
+}
+
+static uint64_t XxhRound(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = RotateLeft(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+static uint64_t XxhMergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= XxhRound(0, accumulator);
+    return (hash * XXH_PRIME64_1) + XXH_PRIME64_4;
+}
+
+// Hashes 'length' bytes with XXH64 (seed 0)
+// Four independent lanes of 8 bytes at a time, so it runs several times faster than a byte at a time hash like FNV-1a
+static uint64_t HashXxh64(const uint8_t* bytes, size_t length)
+{
+    const uint8_t* end = bytes + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t lanes[4] = { XXH_PRIME64_1 + XXH_PRIME64_2, XXH_PRIME64_2, 0, 0 - XXH_PRIME64_1 };
+
+        while (end - bytes >= 32)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                lanes[i] = XxhRound(lanes[i], Read64(bytes + (i * 8)));
+            }
+
+            bytes += 32;
+        }
+
+        hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+
+        for (int i = 0; i < 4; i++)
+        {
+            hash = XxhMergeRound(hash, lanes[i]);
+        }
+    }
+    else
+    {
+        hash = XXH_PRIME64_5;
+    }
+
+    hash += length;
+
+    while (end - bytes >= 8)
+    {
+        hash ^= XxhRound(0, Read64(bytes));
+        hash = (RotateLeft(hash, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+        bytes += 8;
+    }
+
+    if (end - bytes >= 4)
+    {
+        hash ^= Read32(bytes) * XXH_PRIME64_1;
+        hash = (RotateLeft(hash, 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+        bytes += 4;
+    }
+
+    while (bytes < end)
+    {
+        hash ^= *bytes * XXH_PRIME64_5;
+        hash = RotateLeft(hash, 11) * XXH_PRIME64_1;
+        bytes++;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+uint64_t Shim_HashFramebuffer(void)
+{
+    // Each pixel is hashed low byte first, so big endian hosts need a copy in that order
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    static uint8_t bytes[SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT * 2];
+
+    for (int i = 0; i < SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT; i++)
+    {
+        bytes[i * 2] = (uint8_t)(g_shimFramebuffer[i] & 0xFF);
+        bytes[(i * 2) + 1] = (uint8_t)(g_shimFramebuffer[i] >> 8);
+    }
+
+    return HashXxh64(bytes, sizeof(bytes));
+#else
+    return HashXxh64((const uint8_t*)g_shimFramebuffer, sizeof(g_shimFramebuffer));
+#endif
+}
+
+int Shim_WriteFramebufferPPM(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", SHIM_LCD_WIDTH, SHIM_LCD_HEIGHT);
+
+    for (int i = 0; i < SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT; i++)
+    {
+        uint16_t pixel = g_shimFramebuffer[i];
+
+        // Spread each channel over 8 bits, copying the top bits into the bottom so white stays white
+        uint8_t rgb[3];
+        rgb[0] = (uint8_t)(((pixel >> 11) << 3) | (pixel >> 13));
+        rgb[1] = (uint8_t)((((pixel >> 5) & 0x3F) << 2) | ((pixel >> 9) & 0x3));
+        rgb[2] = (uint8_t)(((pixel & 0x1F) << 3) | ((pixel >> 2) & 0x7));
+
+        fwrite(rgb, 1, sizeof(rgb), file);
+    }
+
+    return fclose(file) == 0;
+}
+
+/* VIRTUAL CLOCK */
+//////////////////////////////////////////////////////////////
+
+uint64_t Shim_GetTimeUs(void)
+{
+    return _timeUs;
+}
+
+void Shim_AdvanceTimeUs(uint64_t us)
+{
+    _timeUs += us;
+
+    if (_runLimitUs > 0 && _timeUs >= _runLimitUs)
+    {
+        exit(0);
+    }
+}
+
+void Shim_Reset(void)
+{
+    ShimResetLcd();
+    ShimResetTouch();
+    Shim_ResetCounters();
+    _timeUs = 0;
+}
+
+/* MBED */
+//////////////////////////////////////////////////////////////
+
+void wait_ms(int ms)
+{
+    g_shimCounters.calls[SHIM_CALL_WAIT]++;
+    Shim_AdvanceTimeUs(ms > 0 ? (uint64_t)ms * 1000 : 0);
+}
+
+void wait_us(int us)
+{
+    g_shimCounters.calls[SHIM_CALL_WAIT]++;
+    Shim_AdvanceTimeUs(us > 0 ? (uint64_t)us : 0);
+}
+
+void wait(float seconds)
+{
+    g_shimCounters.calls[SHIM_CALL_WAIT]++;
+    Shim_AdvanceTimeUs(seconds > 0 ? (uint64_t)(seconds * 1000000.0f) : 0);
+}
+
+uint32_t us_ticker_read(void)
+{
+    return (uint32_t)_timeUs;
+}
+
+void error(const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    vfprintf(stderr, format, arguments);
+    va_end(arguments);
+
+    abort();
+}
@@ -0,0 +1,35 @@
+/*
+State shared by the shim's source files
+*/
+
+#ifndef SHIM_INTERNAL_H
+#define SHIM_INTERNAL_H
+
+#include "shim.h"
+
+// Counted by every BSP function the program calls
+extern ShimCounters g_shimCounters;
+
+// The LCD's surface
+extern uint16_t g_shimFramebuffer[SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT];
+
+// Bytes in each transfer on the LCD's 16 bit bus
+#define SHIM_LCD_TRANSFER_BYTES 2
+
+// Transfers to set the cursor (CASET and RASET, 4 parameters each)
+#define SHIM_LCD_CURSOR_TRANSFERS 10
+
+// I2C bytes to read the number of touches, and each touch's position
+#define SHIM_TS_DETECT_BYTES 4
+#define SHIM_TS_TOUCH_BYTES 7
+
+// Puts the LCD back to how it starts (called by 'Shim_Reset')
+void ShimResetLcd(void);
+
+// Puts the touchscreen back to how it starts (called by 'Shim_Reset')
+void ShimResetTouch(void);
+
+// Reads the touch script named by 'SHIM_TOUCH_SCRIPT', if there is one (called by 'BSP_TS_Init')
+void ShimLoadTouchScriptFromEnvironment(void);
+
+#endif // SHIM_INTERNAL_H
@@ -0,0 +1,162 @@
+/*
+FT6x06 touchscreen emulation of the BSP shim
+
+Touches come from a script of events, looked up by the time on the virtual clock, so the same script always gives the same run
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f413h_discovery_ts.h"
+#include "shim_internal.h"
+
+static ShimTouchEvent _events[SHIM_MAX_TOUCH_EVENTS];
+static int _eventCount = 0;
+
+// Index of the event in effect at the time of the last read, as the clock only moves forward
+static int _currentEvent = -1;
+
+/* SCRIPT */
+//////////////////////////////////////////////////////////////
+
+void Shim_SetTouchScript(const ShimTouchEvent* events, int count)
+{
+    if (count > SHIM_MAX_TOUCH_EVENTS)
+    {
+        count = SHIM_MAX_TOUCH_EVENTS;
+    }
+
+    memcpy(_events, events, sizeof(ShimTouchEvent) * (count > 0 ? count : 0));
+    _eventCount = count > 0 ? count : 0;
+    _currentEvent = -1;
+}
+
+int Shim_LoadTouchScript(const char* path)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    char line[128];
+    int count = 0;
+
+    while (count < SHIM_MAX_TOUCH_EVENTS && fgets(line, sizeof(line), file) != NULL)
+    {
+        char* comment = strchr(line, '#');
+
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        unsigned int timeMs;
+        unsigned int x;
+        unsigned int y;
+        char released;
+
+        ShimTouchEvent* event = &_events[count];
+
+        if (sscanf(line, "%u %u %u", &timeMs, &x, &y) == 3)
+        {
+            event->timeMs = timeMs;
+            event->touched = 1;
+            event->x = (uint16_t)x;
+            event->y = (uint16_t)y;
+            count++;
+        }
+        else if (sscanf(line, "%u %c", &timeMs, &released) == 2 && released == '-')
+        {
+            event->timeMs = timeMs;
+            event->touched = 0;
+            event->x = 0;
+            event->y = 0;
+            count++;
+        }
+    }
+
+    fclose(file);
+
+    _eventCount = count;
+    _currentEvent = -1;
+    return count;
+}
+
+void Shim_SetTouch(uint8_t touched, uint16_t x, uint16_t y)
+{
+    _events[0].timeMs = 0;
+    _events[0].touched = touched;
+    _events[0].x = x;
+    _events[0].y = y;
+    _eventCount = 1;
+    _currentEvent = -1;
+}
+
+void ShimLoadTouchScriptFromEnvironment(void)
+{
+    const char* path = getenv("SHIM_TOUCH_SCRIPT");
+
+    if (path != NULL && path[0] != '\0' && Shim_LoadTouchScript(path) < 0)
+    {
+        fprintf(stderr, "Shim: couldn't read the touch script '%s'\n", path);
+    }
+}
+
+void ShimResetTouch(void)
+{
+    _eventCount = 0;
+    _currentEvent = -1;
+}
+
+/* BSP */
+//////////////////////////////////////////////////////////////
+
+uint8_t BSP_TS_Init(uint16_t ts_SizeX, uint16_t ts_SizeY)
+{
+    (void)ts_SizeX;
+    (void)ts_SizeY;
+
+    g_shimCounters.calls[SHIM_CALL_TS_INIT]++;
+    ShimLoadTouchScriptFromEnvironment();
+    return TS_OK;
+}
+
+uint8_t BSP_TS_DeInit(void)
+{
+    g_shimCounters.calls[SHIM_CALL_TS_DEINIT]++;
+    return TS_OK;
+}
+
+uint8_t BSP_TS_GetState(TS_StateTypeDef* TS_State)
+{
+    g_shimCounters.calls[SHIM_CALL_TS_GET_STATE]++;
+    g_shimCounters.touchBusBytes += SHIM_TS_DETECT_BYTES;
+
+    uint64_t timeMs = Shim_GetTimeUs() / 1000;
+
+    // Carry on from the last event read, unless the clock has been put back ('Shim_Reset')
+    if (_currentEvent >= 0 && _currentEvent < _eventCount && _events[_currentEvent].timeMs > timeMs)
+    {
+        _currentEvent = -1;
+    }
+
+    while (_currentEvent + 1 < _eventCount && _events[_currentEvent + 1].timeMs <= timeMs)
+    {
+        _currentEvent++;
+    }
+
+    memset(TS_State, 0, sizeof(TS_StateTypeDef));
+
+    if (_currentEvent >= 0 && _events[_currentEvent].touched)
+    {
+        TS_State->touchDetected = 1;
+        TS_State->touchX[0] = _events[_currentEvent].x;
+        TS_State->touchY[0] = _events[_currentEvent].y;
+
+        g_shimCounters.touchBusBytes += SHIM_TS_TOUCH_BYTES;
+    }
+
+    return TS_OK;
+}
@@ -0,0 +1,122 @@
+/*
+Tests for 'CollisionSystem' running in a 'GameEngine'
+
+A ghost is moved towards a player that stands still, and the player has to be caught on the very tick the two first overlap,
+wherever the system is added to the engine
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Row both actors are on
+#define TEST_ROW (10 * TILE_SIZE)
+
+// Ticks run before giving up on a collision
+#define MAX_TEST_TICKS 100
+
+// Sprite that moves a set number of pixels to the left every tick in the PLAY state
+class TestActor :
+    public BaseGameSprite
+{
+public:
+    int speed;
+
+    TestActor(int x, int y) : BaseGameSprite(x, y)
+    {
+        speed = 0;
+        Visible = false;
+    }
+
+    void Update()
+    {
+        if (context->curGameState == PLAY)
+        {
+            _moveStart = position;
+            position.x -= speed;
+        }
+    }
+};
+
+// Returns true if TILE_SIZE boxes moved in a straight line from 'startA' to 'endA' and from 'startB' to 'endB' along the same row overlap at any point
+static bool SweptOverlap(int startA, int endA, int startB, int endB)
+{
+    int leftA = startA < endA ? startA : endA;
+    int rightA = (startA > endA ? startA : endA) + TILE_SIZE;
+    int leftB = startB < endB ? startB : endB;
+    int rightB = (startB > endB ? startB : endB) + TILE_SIZE;
+
+    return leftA < rightB && leftB < rightA;
+}
+
+// Moves a ghost 'speed' pixels a tick towards the player from 'distance' pixels to its right
+// Checks that the game goes to DEAD on the first tick the two overlap and not before
+// With 'systemFirst' the system is added to the engine before the actors, otherwise after
+static void TestCaught(int distance, int speed, bool systemFirst)
+{
+    GameEngine engine;
+    TestActor player(TILE_SIZE, TEST_ROW);
+    TestActor ghost(TILE_SIZE + distance, TEST_ROW);
+    CollisionSystem collisions;
+
+    ghost.speed = speed;
+    collisions.AddActor(&player, COLLISION_PLAYER);
+    collisions.AddActor(&ghost, COLLISION_GHOST);
+
+    if (systemFirst)
+    {
+        engine.AddGameObject(&collisions);
+    }
+
+    engine.AddGameObject(&player);
+    engine.AddGameObject(&ghost);
+
+    if (!systemFirst)
+    {
+        engine.AddGameObject(&collisions);
+    }
+
+    GameContext* context = engine.GetContext();
+    context->logEnabled = false;
+    context->curGameState = PLAY;
+    context->nextGameState = PLAY;
+
+    for (int tick = 0; tick < MAX_TEST_TICKS; tick++)
+    {
+        int ghostStart = ghost.position.x;
+        engine.RunHeadlessFrame();
+
+        bool overlap = SweptOverlap(player.position.x, player.position.x, ghostStart, ghost.position.x);
+
+        // Stop at the first tick they disagree so a late system doesn't print a line for every tick after
+        if (overlap != (context->curGameState == DEAD))
+        {
+            printf("Ghost moving %d pixels a tick from %d pixels away, system %s: tick %d\n", speed, distance, systemFirst ? "first" : "last", tick);
+            CHECK_EQUAL(overlap ? DEAD : PLAY, context->curGameState);
+            return;
+        }
+
+        if (overlap)
+        {
+            CHECK_EQUAL(1, collisions.GetPairCount());
+            return;
+        }
+    }
+
+    CHECK(false);
+}
+
+int main()
+{
+    // Closing in a pixel at a time, so the overlap starts on one exact tick
+    TestCaught(3 * TILE_SIZE, 1, false);
+    TestCaught(3 * TILE_SIZE, 1, true);
+
+    // At the fastest speed an actor can move, from a distance that isn't a whole number of moves
+    TestCaught((3 * TILE_SIZE) + 1, TILE_SIZE / 2, false);
+    TestCaught((3 * TILE_SIZE) + 1, TILE_SIZE / 2, true);
+
+    return TestResult();
+}
@@ -0,0 +1,200 @@
+/*
+Tests for the fixed capacity containers ('RingBuffer', 'StaticVector' and 'BitSet')
+
+Checks that a ring buffer keeps its order as it wraps around the end of its array, what each overflow policy does once a
+container is full, and that 'BitSet::FindNext' finds bits on either side of the word boundaries and right at the end of the set
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+static void TestRingBufferWraparound()
+{
+    RingBuffer<int, 4> buffer;
+    int item = 0;
+
+    // Push and pop past the end of the array several times over, always with a few items in the buffer
+    int next = 0;
+    int expected = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(buffer.Push(next++));
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK_EQUAL(expected, buffer.Front());
+        CHECK(buffer.Pop(&item));
+        CHECK_EQUAL(expected, item);
+        expected++;
+
+        CHECK(buffer.Push(next++));
+        CHECK_EQUAL(3, buffer.GetCount());
+    }
+
+    // Emptying it gives back the rest in order
+    while (buffer.Pop(&item))
+    {
+        CHECK_EQUAL(expected, item);
+        expected++;
+    }
+
+    CHECK_EQUAL(next, expected);
+    CHECK(buffer.IsEmpty());
+    CHECK(!buffer.Pop(&item));
+}
+
+static void TestRingBufferReject()
+{
+    RingBuffer<int, 3, CONTAINER_REJECT> buffer;
+    int item = 0;
+
+    // Start part way round so the full buffer wraps
+    CHECK(buffer.Push(-1));
+    CHECK(buffer.Pop(&item));
+
+    CHECK(buffer.Push(1));
+    CHECK(buffer.Push(2));
+    CHECK(buffer.Push(3));
+    CHECK(buffer.IsFull());
+
+    // Nothing is changed
+    CHECK(!buffer.Push(4));
+    CHECK_EQUAL(3, buffer.GetCount());
+
+    for (int i = 1; i <= 3; i++)
+    {
+        CHECK(buffer.Pop(&item));
+        CHECK_EQUAL(i, item);
+    }
+
+    CHECK(buffer.IsEmpty());
+}
+
+static void TestRingBufferOverwrite()
+{
+    RingBuffer<int, 3, CONTAINER_OVERWRITE> buffer;
+    int item = 0;
+
+    CHECK(buffer.Push(1));
+    CHECK(buffer.Push(2));
+    CHECK(buffer.Push(3));
+
+    // The oldest items are dropped to make room
+    CHECK(buffer.Push(4));
+    CHECK(buffer.Push(5));
+    CHECK(buffer.IsFull());
+    CHECK_EQUAL(3, buffer.GetCount());
+
+    for (int i = 3; i <= 5; i++)
+    {
+        CHECK(buffer.Pop(&item));
+        CHECK_EQUAL(i, item);
+    }
+
+    CHECK(buffer.IsEmpty());
+
+    buffer.Push(6);
+    buffer.Clear();
+    CHECK(buffer.IsEmpty());
+    CHECK(!buffer.Pop(&item));
+}
+
+static void TestStaticVectorAtCapacity()
+{
+    StaticVector<int, 3, CONTAINER_REJECT> vector;
+
+    CHECK(vector.IsEmpty());
+    CHECK(!vector.PopBack());
+
+    CHECK(vector.PushBack(10));
+    CHECK(vector.PushBack(20));
+    CHECK(vector.PushBack(30));
+    CHECK(vector.IsFull());
+
+    // Nothing is changed
+    CHECK(!vector.PushBack(40));
+    CHECK_EQUAL(3, vector.GetCount());
+    CHECK_EQUAL(10, vector[0]);
+    CHECK_EQUAL(20, vector[1]);
+    CHECK_EQUAL(30, vector.Back());
+
+    // Room is made again by taking from the end
+    CHECK(vector.PopBack());
+    CHECK(!vector.IsFull());
+    CHECK(vector.PushBack(50));
+    CHECK_EQUAL(50, vector.Back());
+    CHECK_EQUAL(3, vector.GetCount());
+
+    vector.Clear();
+    CHECK(vector.IsEmpty());
+}
+
+static void TestBitSetFindNext()
+{
+    // Not a whole number of words, so the last word is only partly used
+    BitSet<130> bits;
+
+    CHECK_EQUAL(BITSET_NONE, bits.FindNext(0));
+
+    // Either side of each word boundary, and the last bit
+    const int set[] = { 0, 31, 32, 63, 64, 127, 128, 129 };
+    const int setCount = sizeof(set) / sizeof(set[0]);
+
+    for (int i = 0; i < setCount; i++)
+    {
+        CHECK(bits.Set(set[i]));
+    }
+
+    CHECK_EQUAL(setCount, bits.Count());
+
+    // Stepping through finds every set bit in order, then nothing
+    int found = 0;
+
+    for (int i = bits.FindNext(0); i != BITSET_NONE; i = bits.FindNext(i + 1))
+    {
+        CHECK(found < setCount);
+
+        if (found < setCount)
+        {
+            CHECK_EQUAL(set[found], i);
+        }
+
+        found++;
+    }
+
+    CHECK_EQUAL(setCount, found);
+
+    // Searching from the middle of a run of empty words
+    CHECK(bits.Reset(63));
+    CHECK(bits.Reset(64));
+    CHECK_EQUAL(127, bits.FindNext(33));
+
+    // Only the last bit left
+    bits.Clear();
+    CHECK(bits.Set(129));
+    CHECK_EQUAL(129, bits.FindNext(0));
+    CHECK_EQUAL(129, bits.FindNext(129));
+    CHECK_EQUAL(BITSET_NONE, bits.FindNext(130));
+
+    // Past the end is rejected rather than set
+    CHECK(!bits.Set(130));
+    CHECK(!bits.Test(130));
+    CHECK(!bits.Set(-1));
+    CHECK_EQUAL(1, bits.Count());
+}
+
+int main()
+{
+    TestRingBufferWraparound();
+    TestRingBufferReject();
+    TestRingBufferOverwrite();
+    TestStaticVectorAtCapacity();
+    TestBitSetFindNext();
+
+    return TestResult();
+}
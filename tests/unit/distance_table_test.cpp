@@ -0,0 +1,176 @@
+/*
+Tests for 'DistanceTable' against a plain breadth first search
+
+Checks every pair of floor tiles in the classic maze, then in a long winding maze whose longest paths are too long for the table,
+which have to come back as 'DISTANCE_SATURATED' rather than wrapping around to 'DISTANCE_UNREACHABLE'
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Fills 'distances' (indexed by (y * WIDTH) + x) with the number of steps from the tile (x, y) to every tile, -1 where it can't reach
+static void BreadthFirstSearch(Maze* maze, int x, int y, int distances[])
+{
+    static Position queue[WIDTH * HEIGHT];
+    int head = 0;
+    int tail = 0;
+
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        distances[i] = -1;
+    }
+
+    distances[(y * WIDTH) + x] = 0;
+    queue[tail].x = x;
+    queue[tail].y = y;
+    tail++;
+
+    while (head < tail)
+    {
+        Position current = queue[head];
+        head++;
+
+        for (char direction = NORTH; direction <= WEST; direction <<= 1)
+        {
+            // Through the tunnel too
+            Position next = maze->GetAdjacentTilePos(current.x, current.y, direction);
+
+            if (maze->IsFloor(next.x, next.y) && distances[(next.y * WIDTH) + next.x] == -1)
+            {
+                distances[(next.y * WIDTH) + next.x] = distances[(current.y * WIDTH) + current.x] + 1;
+                queue[tail] = next;
+                tail++;
+            }
+        }
+    }
+}
+
+// Checks the table's distance between every pair of floor tiles against a breadth first search
+// Returns the longest distance found by the searches
+static int CheckAllPairs(Maze* maze, DistanceTable* table)
+{
+    static int distances[WIDTH * HEIGHT];
+    int longest = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (!maze->IsFloor(x, y))
+            {
+                continue;
+            }
+
+            Position start;
+            start.x = x;
+            start.y = y;
+
+            BreadthFirstSearch(maze, x, y, distances);
+
+            for (int i = 0; i < WIDTH * HEIGHT; i++)
+            {
+                Position end;
+                end.x = i % WIDTH;
+                end.y = i / WIDTH;
+
+                int expected = distances[i];
+
+                if (expected == -1)
+                {
+                    expected = DISTANCE_UNREACHABLE;
+                }
+                else if (expected > DISTANCE_SATURATED)
+                {
+                    expected = DISTANCE_SATURATED;
+                }
+
+                if (distances[i] > longest)
+                {
+                    longest = distances[i];
+                }
+
+                // Stop at the first mismatch so a broken table doesn't print thousands of lines
+                if (expected != table->GetDistance(start, end))
+                {
+                    CHECK_EQUAL(expected, table->GetDistance(start, end));
+                    return longest;
+                }
+            }
+        }
+    }
+
+    return longest;
+}
+
+static void TestClassicMaze(Maze* maze, DistanceTable* table)
+{
+    CHECK_EQUAL(292, table->GetFloorTileCount());
+
+    int longest = CheckAllPairs(maze, table);
+    CHECK(longest < DISTANCE_SATURATED);
+
+    // Walls aren't in the table
+    Position wall;
+    wall.x = 0;
+    wall.y = 0;
+
+    Position floor;
+    floor.x = PLAYER_START_X;
+    floor.y = PLAYER_START_Y;
+
+    CHECK_EQUAL(-1, table->GetTileIndex(wall.x, wall.y));
+    CHECK_EQUAL(DISTANCE_UNREACHABLE, table->GetDistance(wall, floor));
+    CHECK_EQUAL(0, table->GetDistance(floor, floor));
+}
+
+static void TestLongMaze(Maze* maze, DistanceTable* table)
+{
+    // One corridor winding back and forth down the maze: 14 rows of 20 tiles joined at alternate ends, 292 steps from end to end
+    int layout[HEIGHT] = { 0 };
+
+    for (int row = 0; row < 14; row++)
+    {
+        int y = 2 + (row * 2);
+
+        for (int x = 4; x < 24; x++)
+        {
+            layout[y] |= 0x1 << x;
+        }
+
+        if (row < 13)
+        {
+            layout[y + 1] |= 0x1 << (row % 2 == 0 ? 23 : 4);
+        }
+    }
+
+    CHECK(maze->LoadMaze(layout, layout));
+    CHECK_EQUAL(293, table->GetFloorTileCount());
+
+    int longest = CheckAllPairs(maze, table);
+    CHECK_EQUAL(292, longest);
+
+    Position start;
+    start.x = 4;
+    start.y = 2;
+
+    Position end;
+    end.x = 4;
+    end.y = 28;
+
+    CHECK_EQUAL(DISTANCE_SATURATED, table->GetDistance(start, end));
+}
+
+int main()
+{
+    // The table is 100 KB on the host
+    static Maze maze;
+    static DistanceTable table(&maze);
+
+    TestClassicMaze(&maze, &table);
+    TestLongMaze(&maze, &table);
+
+    return TestResult();
+}
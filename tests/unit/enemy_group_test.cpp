@@ -0,0 +1,254 @@
+/*
+Tests for 'GhostMoveBatch' and 'EnemyGroup' against the ghosts deciding one at a time
+
+Random batches of up to 'MAX_BATCH_GHOSTS' ghosts (including ties, ghosts with no way out and positions far off the screen) are checked against
+a plain version of 'Enemy::GetNextDir', then two complete games are played with the same touches, one with every ghost in an 'EnemyGroup'
+and one without, and every ghost has to be in the same place after every frame
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Frames each game is played for
+#define GAME_FRAMES 20000
+
+// A new touch (or none) is picked every this many frames
+#define TOUCH_HOLD_FRAMES 17
+
+// Number of random batches checked
+#define RANDOM_BATCHES 2000
+
+// Returns the direction 'Enemy::GetNextDir' would pick from 'position' heading for 'target', allowed to move in 'exits'
+static char GetNextDir(Position position, Position target, char exits)
+{
+    const char dirs[4] = { NORTH, SOUTH, EAST, WEST };
+    const int offsetX[4] = { 0, 0, 1, -1 };
+    const int offsetY[4] = { -1, 1, 0, 0 };
+
+    long long best = -1;
+    char bestDir = NORTH;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if ((exits & dirs[i]) == 0)
+        {
+            continue;
+        }
+
+        long long dx = (long long)position.x + offsetX[i] - target.x;
+        long long dy = (long long)position.y + offsetY[i] - target.y;
+        long long d = (dx * dx) + (dy * dy);
+
+        if (best == -1 || d < best)
+        {
+            best = d;
+            bestDir = dirs[i];
+        }
+    }
+
+    return bestDir;
+}
+
+// Returns the next number from a linear congruential generator
+static uint32_t NextRandom(uint32_t* random)
+{
+    *random = (*random * 1103515245u) + 12345u;
+    return *random >> 8;
+}
+
+// Checks random batches against 'GetNextDir' above
+static void TestRandomBatches()
+{
+    // The batch is 6 KB
+    static GhostMoveBatch batch;
+    uint32_t random = 1;
+
+    for (int run = 0; run < RANDOM_BATCHES; run++)
+    {
+        static Position positions[MAX_BATCH_GHOSTS];
+        static Position targets[MAX_BATCH_GHOSTS];
+        static char exits[MAX_BATCH_GHOSTS];
+
+        int count = 1 + (NextRandom(&random) % MAX_BATCH_GHOSTS);
+
+        // Mostly on the screen (where ties are common), sometimes far enough off it to be clamped
+        int range = run % 10 == 0 ? BATCH_MAX_COORD - 1 : SCREEN_WIDTH;
+
+        batch.Clear();
+
+        for (int i = 0; i < count; i++)
+        {
+            positions[i].x = (int)(NextRandom(&random) % (2 * range)) - range;
+            positions[i].y = (int)(NextRandom(&random) % (2 * range)) - range;
+            targets[i].x = (int)(NextRandom(&random) % (2 * range)) - range;
+            targets[i].y = (int)(NextRandom(&random) % (2 * range)) - range;
+            exits[i] = (char)(NextRandom(&random) % 16);
+
+            CHECK_EQUAL(i, batch.Add(positions[i], targets[i], exits[i]));
+        }
+
+        CHECK_EQUAL(count, batch.GetCount());
+        batch.Evaluate();
+
+        for (int i = 0; i < count; i++)
+        {
+            char expected = GetNextDir(positions[i], targets[i], exits[i]);
+
+            // Stop at the first mismatch so a broken batch doesn't print thousands of lines
+            if (batch.GetDirection(i) != expected)
+            {
+                CHECK_EQUAL(expected, batch.GetDirection(i));
+                return;
+            }
+        }
+    }
+
+    // A full batch turns any more ghosts away
+    Position origin;
+    origin.x = 0;
+    origin.y = 0;
+
+    batch.Clear();
+
+    for (int i = 0; i < MAX_BATCH_GHOSTS; i++)
+    {
+        batch.Add(origin, origin, NORTH);
+    }
+
+    CHECK_EQUAL(-1, batch.Add(origin, origin, NORTH));
+    CHECK_EQUAL(MAX_BATCH_GHOSTS, batch.GetCount());
+}
+
+// Stores a complete game, set up the same way as 'main()' but with nothing drawn
+struct TestGame
+{
+    GameEngine engine;
+    Maze maze;
+    Player player;
+    SplashScreen splash;
+    GameOverScreen gameOver;
+    Enemy enemy1;
+    Enemy enemy2;
+    Enemy enemy3;
+    Enemy enemy4;
+    CollisionSystem collisions;
+    EnemyGroup group;
+
+    // Puts every ghost in 'group' when 'grouped' is true
+    TestGame(bool grouped) :
+        player(&maze, PLAYER_START_X, PLAYER_START_Y),
+        enemy1(&maze, &player, LCD_COLOR_RED, BLINKY_AI, BLINKY_START_X, GHOST_START_Y),
+        enemy2(&maze, &player, LCD_COLOR_MAGENTA, PINKY_AI, PINKY_START_X, GHOST_START_Y),
+        enemy3(&maze, &player, &enemy1, LCD_COLOR_CYAN, INKY_AI, INKY_START_X, GHOST_START_Y),
+        enemy4(&maze, &player, LCD_COLOR_ORANGE, CLYDE_AI, CLYDE_START_X, GHOST_START_Y)
+    {
+        collisions.AddActor(&player, COLLISION_PLAYER);
+        collisions.AddEnemy(&enemy1);
+        collisions.AddEnemy(&enemy2);
+        collisions.AddEnemy(&enemy3);
+        collisions.AddEnemy(&enemy4);
+
+        engine.AddGameObject(&splash);
+        engine.AddGameObject(&gameOver);
+        engine.AddGameObject(&maze);
+        engine.AddGameObject(&player);
+
+        if (grouped)
+        {
+            group.AddEnemy(&enemy1);
+            group.AddEnemy(&enemy2);
+            group.AddEnemy(&enemy3);
+            group.AddEnemy(&enemy4);
+            engine.AddGameObject(&group);
+        }
+
+        engine.AddGameObject(&enemy1);
+        engine.AddGameObject(&enemy2);
+        engine.AddGameObject(&enemy3);
+        engine.AddGameObject(&enemy4);
+        engine.AddGameObject(&collisions);
+
+        engine.GetContext()->logEnabled = false;
+        engine.SetDrawEnabled(false);
+        maze.SetRedrawEnabled(false);
+    }
+};
+
+// Returns true if both games have their ghosts in the same places and are in the same state
+static bool SameGame(TestGame* a, TestGame* b)
+{
+    Enemy* enemiesA[4] = { &a->enemy1, &a->enemy2, &a->enemy3, &a->enemy4 };
+    Enemy* enemiesB[4] = { &b->enemy1, &b->enemy2, &b->enemy3, &b->enemy4 };
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (enemiesA[i]->position.x != enemiesB[i]->position.x || enemiesA[i]->position.y != enemiesB[i]->position.y)
+        {
+            return false;
+        }
+    }
+
+    return a->player.position.x == b->player.position.x && a->player.position.y == b->player.position.y &&
+        a->engine.GetContext()->curGameState == b->engine.GetContext()->curGameState;
+}
+
+// Plays the same touches through a game with the ghosts deciding one at a time and one with them in a group
+static void TestGroupedGame()
+{
+    // Each game is a few KB
+    static TestGame single(false);
+    static TestGame grouped(true);
+
+    CHECK_EQUAL(0, single.group.GetEnemyCount());
+    CHECK_EQUAL(4, grouped.group.GetEnemyCount());
+
+    LCDInit();
+    single.engine.Init();
+    grouped.engine.Init();
+
+    uint32_t random = 12345;
+    int playFrames = 0;
+
+    for (int frame = 0; frame < GAME_FRAMES; frame++)
+    {
+        if (frame % TOUCH_HOLD_FRAMES == 0)
+        {
+            NextRandom(&random);
+            TS_StateTypeDef* touch = &single.engine.GetContext()->tsState;
+            touch->touchDetected = ((random >> 16) % 3) != 0;
+            touch->touchX[0] = (random >> 8) % SCREEN_WIDTH;
+            touch->touchY[0] = (random >> 20) % SCREEN_HEIGHT;
+            grouped.engine.GetContext()->tsState = *touch;
+        }
+
+        if (single.engine.GetContext()->curGameState == PLAY)
+        {
+            playFrames++;
+        }
+
+        single.engine.RunFrame();
+        grouped.engine.RunFrame();
+
+        // Stop at the first frame they differ so a broken group doesn't print thousands of lines
+        if (!SameGame(&single, &grouped))
+        {
+            printf("Games differ after frame %d\n", frame);
+            CHECK(SameGame(&single, &grouped));
+            return;
+        }
+    }
+
+    // Make sure the ghosts were actually moving for most of it
+    CHECK(playFrames > GAME_FRAMES / 2);
+}
+
+int main()
+{
+    TestRandomBatches();
+    TestGroupedGame();
+
+    return TestResult();
+}
@@ -0,0 +1,99 @@
+/*
+Tests for 'FlowField' in the classic maze
+
+Checks that following the direction grid from any tile reaches the target in exactly the number of steps in the distance grid,
+and that the field searches again when read after the player has moved or a pellet has been eaten
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Checks that walking the field's directions from every floor tile reaches a tile with a distance of 0 in the stored number of steps
+static void CheckDirections(Maze* maze, FlowField* field)
+{
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (!maze->IsFloor(x, y))
+            {
+                CHECK_EQUAL(DISTANCE_UNREACHABLE, field->GetDistance(x, y));
+                CHECK_EQUAL(0x0, field->GetDirection(x, y));
+                continue;
+            }
+
+            int distance = field->GetDistance(x, y);
+            Position tile;
+            tile.x = x;
+            tile.y = y;
+
+            for (int step = 0; step < distance; step++)
+            {
+                char direction = field->GetDirection(tile.x, tile.y);
+                tile = maze->GetAdjacentTilePos(tile.x, tile.y, direction);
+
+                if (!maze->IsFloor(tile.x, tile.y) || field->GetDistance(tile.x, tile.y) != distance - step - 1)
+                {
+                    CHECK(maze->IsFloor(tile.x, tile.y));
+                    CHECK_EQUAL(distance - step - 1, field->GetDistance(tile.x, tile.y));
+                    return;
+                }
+            }
+
+            CHECK_EQUAL(0x0, field->GetDirection(tile.x, tile.y));
+        }
+    }
+}
+
+// Moves the player to the tile (x, y) and publishes it, as 'GameEngine::Update' would at the end of a tick
+static void MovePlayer(Player* player, int x, int y)
+{
+    player->position.x = x * TILE_SIZE;
+    player->position.y = y * TILE_SIZE;
+    player->PublishState();
+}
+
+static void TestToPlayer(Maze* maze, Player* player)
+{
+    static FlowField field(maze, player, FLOW_TO_PLAYER);
+
+    CHECK_EQUAL(0, field.GetDistance(PLAYER_START_X, PLAYER_START_Y));
+    CheckDirections(maze, &field);
+
+    // Read after the player moves, the field leads to the new tile
+    MovePlayer(player, 1, 2);
+    CHECK_EQUAL(0, field.GetDistance(1, 2));
+    CHECK_EQUAL(2, field.GetDistance(1, 4));
+    CHECK_EQUAL(NORTH, field.GetDirection(1, 4));
+    CheckDirections(maze, &field);
+
+    MovePlayer(player, PLAYER_START_X, PLAYER_START_Y);
+}
+
+static void TestToPellets(Maze* maze, Player* player)
+{
+    static FlowField field(maze, player, FLOW_TO_PELLETS);
+
+    // Every pellet is a target
+    CHECK_EQUAL(0, field.GetDistance(1, 2));
+    CheckDirections(maze, &field);
+
+    // Once the corner pellet is eaten, it is one step from the pellets next to it
+    CHECK(maze->TryRemovePellet(1, 2));
+    CHECK_EQUAL(1, field.GetDistance(1, 2));
+    CheckDirections(maze, &field);
+}
+
+int main()
+{
+    static Maze maze;
+    static Player player(&maze, PLAYER_START_X, PLAYER_START_Y);
+
+    TestToPlayer(&maze, &player);
+    TestToPellets(&maze, &player);
+
+    return TestResult();
+}
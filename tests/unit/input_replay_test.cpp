@@ -0,0 +1,120 @@
+/*
+Tests for 'InputRecorder' and 'InputReplayer' through the complete game ('PacmanGame', the same objects as 'main()')
+
+A session is played with random touches and recorded, then the recording is played back through a second game from the start
+Both games have to end on the same frame with the same Zobrist hash, and a third game left alone has to end somewhere else
+(so the hash really does depend on the input)
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Frames each session is run for, long enough to get through the start screens and well into PLAY
+#define SESSION_FRAMES 3000
+
+// A new touch (or none) is picked every this many frames
+#define TOUCH_HOLD_FRAMES 17
+
+// Number of game states ('SPLASH_SCREEN' to 'GAME_OVER')
+#define GAME_STATES 8
+
+// Picks the touch held for the next few frames, with no touch a third of the time
+static void NextTouch(uint32_t* random, TS_StateTypeDef* state)
+{
+    *random = (*random * 1103515245u) + 12345u;
+
+    state->touchDetected = ((*random >> 16) % 3) != 0;
+    state->touchX[0] = (*random >> 8) % SCREEN_WIDTH;
+    state->touchY[0] = (*random >> 20) % SCREEN_HEIGHT;
+}
+
+// Gets the game ready to run headless, the same way as 'tools/replay.cpp' without '--draw'
+static GameContext* StartGame(PacmanGame* game)
+{
+    GameEngine* engine = game->GetEngine();
+    GameContext* context = engine->GetContext();
+
+    context->logEnabled = false;
+    engine->SetDrawEnabled(false);
+    game->GetMaze()->SetRedrawEnabled(false);
+    engine->Init();
+
+    return context;
+}
+
+// Returns the hash of the whole game's state
+static uint64_t GetHash(PacmanGame* game)
+{
+    GameState state;
+    memset(&state, 0, sizeof(state));
+    game->Snapshot(&state);
+
+    return ZobristHash::ComputeHash(&state);
+}
+
+int main()
+{
+    // Each game is several KB, and the recording is 8 KB
+    static PacmanGame recorded;
+    static PacmanGame replayed;
+    static PacmanGame untouched;
+    static InputRecorder recorder;
+
+    LCDInit();
+
+    // Play and record a session
+    GameContext* context = StartGame(&recorded);
+    recorded.GetEngine()->SetInputRecorder(&recorder);
+
+    bool reachedState[GAME_STATES] = { false };
+    uint32_t random = 12345;
+
+    for (int frame = 0; frame < SESSION_FRAMES; frame++)
+    {
+        if (frame % TOUCH_HOLD_FRAMES == 0)
+        {
+            NextTouch(&random, &context->tsState);
+        }
+
+        recorded.GetEngine()->RunFrame();
+
+        if (context->curGameState >= 0 && context->curGameState < GAME_STATES)
+        {
+            reachedState[(int)context->curGameState] = true;
+        }
+    }
+
+    CHECK(reachedState[PLAY]);
+    CHECK(recorder.GetCount() > 0);
+    CHECK(!recorder.IsTruncated());
+
+    // Play it back from the start
+    context = StartGame(&replayed);
+    InputReplayer replayer(recorder.GetEvents(), recorder.GetCount());
+
+    for (int frame = 0; frame < SESSION_FRAMES; frame++)
+    {
+        replayer.ApplyTouch(replayed.GetEngine()->GetFrame(), &context->tsState);
+        replayed.GetEngine()->RunFrame();
+    }
+
+    CHECK_EQUAL(recorded.GetEngine()->GetFrame(), replayed.GetEngine()->GetFrame());
+    CHECK_EQUAL(GetHash(&recorded), GetHash(&replayed));
+    CHECK_EQUAL(recorded.GetPlayer()->GetScore(), replayed.GetPlayer()->GetScore());
+
+    // Without the input, the game never leaves the splash screen
+    StartGame(&untouched);
+
+    for (int frame = 0; frame < SESSION_FRAMES; frame++)
+    {
+        untouched.GetEngine()->RunFrame();
+    }
+
+    CHECK_EQUAL(recorded.GetEngine()->GetFrame(), untouched.GetEngine()->GetFrame());
+    CHECK(GetHash(&recorded) != GetHash(&untouched));
+
+    return TestResult();
+}
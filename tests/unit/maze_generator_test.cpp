@@ -0,0 +1,142 @@
+/*
+Tests for 'MazeGenerator'
+
+Generates mazes from many seeds and checks each one tile by tile (rather than with 'MazeGenerator::IsValid', which the generator uses itself):
+mirrored left to right, every floor tile reachable from the player start, no dead ends, pellets only on the floor,
+and accepted by 'Maze::LoadMaze'
+Also checks that the same seed always gives the same mazes
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Seeds to generate from, and mazes to generate from each one
+#define TEST_SEEDS 64
+#define MAZES_PER_SEED 4
+
+static bool IsSet(const int board[], int x, int y)
+{
+    return (board[y] >> x) & 0x1;
+}
+
+// Returns the number of floor tiles next to the tile (x, y), including through the tunnel
+static int CountExits(const int maze[], int x, int y)
+{
+    int count = 0;
+
+    count += y > 0 && IsSet(maze, x, y - 1);
+    count += y < HEIGHT - 1 && IsSet(maze, x, y + 1);
+    count += IsSet(maze, (x + 1) % WIDTH, y);
+    count += IsSet(maze, (x + WIDTH - 1) % WIDTH, y);
+
+    return count;
+}
+
+// Returns the number of floor tiles that can be reached from the tile (x, y), including through the tunnel
+static int CountReachable(const int maze[], int x, int y)
+{
+    static Position queue[WIDTH * HEIGHT];
+    bool seen[HEIGHT][WIDTH] = { { false } };
+    int head = 0;
+    int tail = 0;
+
+    seen[y][x] = true;
+    queue[tail].x = x;
+    queue[tail].y = y;
+    tail++;
+
+    while (head < tail)
+    {
+        Position current = queue[head];
+        head++;
+
+        Position next[4];
+        next[0].x = current.x;
+        next[0].y = current.y - 1;
+        next[1].x = (current.x + 1) % WIDTH;
+        next[1].y = current.y;
+        next[2].x = current.x;
+        next[2].y = current.y + 1;
+        next[3].x = (current.x + WIDTH - 1) % WIDTH;
+        next[3].y = current.y;
+
+        for (int i = 0; i < 4; i++)
+        {
+            if (next[i].y >= 0 && next[i].y < HEIGHT && IsSet(maze, next[i].x, next[i].y) && !seen[next[i].y][next[i].x])
+            {
+                seen[next[i].y][next[i].x] = true;
+                queue[tail] = next[i];
+                tail++;
+            }
+        }
+    }
+
+    return tail;
+}
+
+static void CheckMaze(Maze* target, const int maze[], const int pellets[])
+{
+    int floorCount = 0;
+    bool symmetric = true;
+    bool noDeadEnds = true;
+    bool pelletsOnFloor = true;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            symmetric = symmetric && IsSet(maze, x, y) == IsSet(maze, WIDTH - 1 - x, y);
+            pelletsOnFloor = pelletsOnFloor && (!IsSet(pellets, x, y) || IsSet(maze, x, y));
+
+            if (IsSet(maze, x, y))
+            {
+                floorCount++;
+                noDeadEnds = noDeadEnds && CountExits(maze, x, y) >= 2;
+            }
+        }
+    }
+
+    CHECK(symmetric);
+    CHECK(noDeadEnds);
+    CHECK(pelletsOnFloor);
+    CHECK(IsSet(maze, PLAYER_START_X, PLAYER_START_Y));
+    CHECK_EQUAL(floorCount, CountReachable(maze, PLAYER_START_X, PLAYER_START_Y));
+    CHECK(target->LoadMaze(maze, pellets));
+}
+
+int main()
+{
+    static Maze maze;
+    int layout[HEIGHT];
+    int pellets[HEIGHT];
+    int failures = g_testFailures;
+
+    for (uint32_t seed = 1; seed <= TEST_SEEDS && g_testFailures == failures; seed++)
+    {
+        MazeGenerator generator(seed);
+
+        for (int i = 0; i < MAZES_PER_SEED; i++)
+        {
+            CHECK(generator.Generate(layout, pellets));
+            CheckMaze(&maze, layout, pellets);
+        }
+    }
+
+    // The same seed gives the same mazes, different seeds give different ones
+    MazeGenerator first(TEST_SEEDS);
+    MazeGenerator second(TEST_SEEDS);
+    MazeGenerator other(TEST_SEEDS + 1);
+    int again[HEIGHT];
+    int otherLayout[HEIGHT];
+
+    CHECK(first.Generate(layout, pellets));
+    CHECK(second.Generate(again, pellets));
+    CHECK(other.Generate(otherLayout, pellets));
+    CHECK(memcmp(layout, again, sizeof(layout)) == 0);
+    CHECK(memcmp(layout, otherLayout, sizeof(layout)) != 0);
+
+    return TestResult();
+}
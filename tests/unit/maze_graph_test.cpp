@@ -0,0 +1,242 @@
+/*
+Tests for 'MazeGraph' against the classic maze
+
+Checks the node and edge counts, that every floor tile belongs to exactly one node or edge, the lengths of a few known corridors
+(including the one through the tunnel) and that eating pellets keeps the pellet counts in step with the maze
+Then loads open mazes with more nodes and more edges than the graph can hold, which have to leave the graph empty rather than overrun it
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Nodes and edges in the classic maze
+#define CLASSIC_NODES 34
+#define CLASSIC_EDGES 54
+
+// Returns the edge leaving the node at the tile (x, y) in the given direction, or -1 if there isn't one
+static int GetEdgeFrom(MazeGraph* graph, int x, int y, char direction)
+{
+    int node = graph->GetNodeAt(x, y);
+
+    if (node < 0)
+    {
+        return -1;
+    }
+
+    return graph->GetNode(node)->edges[MazeGraph::DirectionIndex(direction)];
+}
+
+static void TestCounts(Maze* maze, MazeGraph* graph)
+{
+    CHECK_EQUAL(CLASSIC_NODES, graph->GetNodeCount());
+    CHECK_EQUAL(CLASSIC_EDGES, graph->GetEdgeCount());
+
+    // Every floor tile is either a node or covered by exactly one edge
+    int floorCount = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (!maze->IsFloor(x, y))
+            {
+                CHECK_EQUAL(-1, graph->GetNodeAt(x, y));
+                CHECK_EQUAL(-1, graph->GetEdgeAt(x, y));
+                continue;
+            }
+
+            floorCount++;
+            CHECK((graph->GetNodeAt(x, y) >= 0) != (graph->GetEdgeAt(x, y) >= 0));
+        }
+    }
+
+    int coveredCount = graph->GetNodeCount();
+    int degreeSum = 0;
+
+    for (int i = 0; i < graph->GetEdgeCount(); i++)
+    {
+        coveredCount += graph->GetEdge(i)->tileCount;
+    }
+
+    for (int i = 0; i < graph->GetNodeCount(); i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            degreeSum += graph->GetNode(i)->edges[j] >= 0;
+        }
+    }
+
+    CHECK_EQUAL(floorCount, coveredCount);
+    CHECK_EQUAL(2 * graph->GetEdgeCount(), degreeSum);
+}
+
+static void TestEdges(Maze* maze, MazeGraph* graph)
+{
+    for (int i = 0; i < graph->GetEdgeCount(); i++)
+    {
+        MazeGraphEdge* edge = graph->GetEdge(i);
+
+        CHECK_EQUAL(edge->tileCount + 1, edge->length);
+        CHECK_EQUAL(i, graph->GetNode(edge->nodeA)->edges[MazeGraph::DirectionIndex(edge->dirA)]);
+        CHECK_EQUAL(i, graph->GetNode(edge->nodeB)->edges[MazeGraph::DirectionIndex(edge->dirB)]);
+        CHECK_EQUAL(edge->nodeB, graph->GetOtherNode(i, edge->nodeA));
+
+        // Each step along the edge is one move from the step before it
+        for (int step = 1; step <= edge->length; step++)
+        {
+            Position previous = graph->GetStepTile(i, step - 1);
+            Position tile = graph->GetStepTile(i, step);
+            bool adjacent = false;
+
+            for (char direction = NORTH; direction <= WEST; direction <<= 1)
+            {
+                Position next = maze->GetAdjacentTilePos(previous.x, previous.y, direction);
+                adjacent = adjacent || (next.x == tile.x && next.y == tile.y);
+            }
+
+            CHECK(adjacent);
+
+            if (step < edge->length)
+            {
+                CHECK_EQUAL(i, graph->GetEdgeAt(tile.x, tile.y));
+                CHECK_EQUAL(step, graph->GetEdgeStep(i, tile.x, tile.y));
+            }
+        }
+    }
+
+    // Top left, from the junction under the top wall down to the left side
+    int corner = GetEdgeFrom(graph, 6, 2, WEST);
+    CHECK(corner >= 0);
+    CHECK_EQUAL(9, graph->GetEdge(corner)->length);
+    CHECK_EQUAL(graph->GetNodeAt(1, 6), graph->GetOtherNode(corner, graph->GetNodeAt(6, 2)));
+
+    // Through the tunnel, which leaves the west junction going west and arrives at the east junction from the east
+    int tunnel = GetEdgeFrom(graph, 6, TUNNEL_ROW, WEST);
+    CHECK(tunnel >= 0);
+    CHECK_EQUAL(13, graph->GetEdge(tunnel)->length);
+    CHECK_EQUAL(tunnel, GetEdgeFrom(graph, 21, TUNNEL_ROW, EAST));
+
+    // Bottom row, from the lower left corner to the middle
+    int bottom = GetEdgeFrom(graph, 12, 28, WEST);
+    CHECK(bottom >= 0);
+    CHECK_EQUAL(16, graph->GetEdge(bottom)->length);
+    CHECK_EQUAL(graph->GetNodeAt(3, 25), graph->GetOtherNode(bottom, graph->GetNodeAt(12, 28)));
+}
+
+// Returns the number of pellets left in the maze
+static int CountMazePellets(Maze* maze)
+{
+    int count = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            count += maze->IsPellet(x, y);
+        }
+    }
+
+    return count;
+}
+
+// Returns the number of pellets the graph holds on its nodes and edges
+static int CountGraphPellets(MazeGraph* graph)
+{
+    int count = 0;
+
+    for (int i = 0; i < graph->GetNodeCount(); i++)
+    {
+        count += graph->GetNode(i)->hasPellet;
+    }
+
+    for (int i = 0; i < graph->GetEdgeCount(); i++)
+    {
+        count += graph->GetEdge(i)->pelletCount;
+    }
+
+    return count;
+}
+
+static void TestPellets(Maze* maze, MazeGraph* graph)
+{
+    CHECK_EQUAL(CountMazePellets(maze), CountGraphPellets(graph));
+
+    // Eat along the top left corridor
+    int corner = GetEdgeFrom(graph, 6, 2, WEST);
+    int before = graph->GetEdge(corner)->pelletCount;
+    Position tile = graph->GetStepTile(corner, 1);
+
+    CHECK(maze->TryRemovePellet(tile.x, tile.y));
+    CHECK_EQUAL(before - 1, graph->GetEdge(corner)->pelletCount);
+    CHECK_EQUAL(CountMazePellets(maze), CountGraphPellets(graph));
+
+    // The maze fills itself with pellets again at the start of a game
+    static GameContext context;
+    memset(&context, 0, sizeof(context));
+    context.curGameState = STARTUP;
+    maze->context = &context;
+    maze->Update();
+
+    CHECK_EQUAL(before, graph->GetEdge(corner)->pelletCount);
+    CHECK_EQUAL(CountMazePellets(maze), CountGraphPellets(graph));
+}
+
+// Loads a maze that is open floor from (left, top) to (right, bottom), returning false if the maze turned it down
+static bool LoadOpenMaze(Maze* maze, int left, int top, int right, int bottom)
+{
+    int layout[HEIGHT] = { 0 };
+
+    for (int y = top; y <= bottom; y++)
+    {
+        for (int x = left; x <= right; x++)
+        {
+            layout[y] |= 0x1 << x;
+        }
+    }
+
+    return maze->LoadMaze(layout, layout);
+}
+
+static void TestLimits(Maze* maze, MazeGraph* graph)
+{
+    int floor[HEIGHT];
+    int pellets[HEIGHT];
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+
+    // 14 * 14 tiles, all but the corners are nodes
+    CHECK(LoadOpenMaze(maze, 7, 16, 20, 29));
+    CHECK(!graph->Build());
+    CHECK_EQUAL(0, graph->GetNodeCount());
+    CHECK_EQUAL(0, graph->GetEdgeCount());
+    CHECK_EQUAL(-1, graph->GetNodeAt(PLAYER_START_X, PLAYER_START_Y));
+
+    // 11 * 11 tiles, 117 nodes (under the limit) but 216 edges between them (over it)
+    CHECK(LoadOpenMaze(maze, 8, 17, 18, 27));
+    CHECK(!graph->Build());
+    CHECK_EQUAL(0, graph->GetNodeCount());
+    CHECK_EQUAL(0, graph->GetEdgeCount());
+
+    // Loading a maze that fits builds it again
+    CHECK(maze->LoadMaze(floor, pellets));
+    CHECK(graph->Build());
+    CHECK_EQUAL(34, graph->GetNodeCount());
+    CHECK_EQUAL(54, graph->GetEdgeCount());
+}
+
+int main()
+{
+    // The maze and graph are a few KB each
+    static Maze maze;
+    static MazeGraph graph(&maze);
+
+    TestCounts(&maze, &graph);
+    TestEdges(&maze, &graph);
+    TestPellets(&maze, &graph);
+    TestLimits(&maze, &graph);
+
+    return TestResult();
+}
@@ -0,0 +1,144 @@
+/*
+Tests for loading layouts into 'Maze'
+
+Checks that 'Maze::LoadMaze' accepts the classic maze and rejects layouts that are split in two, have pellets off the floor or
+can't be played from the player start, leaving the maze as it was
+Also checks 'BitboardSearch::FloodFill' against a plain breadth first search
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Returns the number of pellets left in the maze
+static int CountMazePellets(Maze* maze)
+{
+    int count = 0;
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            count += maze->IsPellet(x, y);
+        }
+    }
+
+    return count;
+}
+
+// Returns the number of steps from the tile (x, y) to the furthest floor tile it can reach, including through the tunnel
+static int GetEccentricity(Maze* maze, int x, int y)
+{
+    static Position queue[WIDTH * HEIGHT];
+    int distances[HEIGHT][WIDTH];
+    int head = 0;
+    int tail = 0;
+    int furthest = 0;
+
+    memset(distances, -1, sizeof(distances));
+    distances[y][x] = 0;
+    queue[tail].x = x;
+    queue[tail].y = y;
+    tail++;
+
+    while (head < tail)
+    {
+        Position current = queue[head];
+        head++;
+
+        for (char direction = NORTH; direction <= WEST; direction <<= 1)
+        {
+            Position next = maze->GetAdjacentTilePos(current.x, current.y, direction);
+
+            if (maze->IsFloor(next.x, next.y) && distances[next.y][next.x] == -1)
+            {
+                distances[next.y][next.x] = distances[current.y][current.x] + 1;
+                furthest = distances[next.y][next.x];
+                queue[tail] = next;
+                tail++;
+            }
+        }
+    }
+
+    return furthest;
+}
+
+static void TestClassicMaze(Maze* maze)
+{
+    int floor[HEIGHT];
+    int pellets[HEIGHT];
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+
+    // The constructor loaded it through the same checks
+    CHECK(BitboardSearch::IsConnected(floor));
+    CHECK(maze->ArePelletsReachable(PLAYER_START_X, PLAYER_START_Y));
+    CHECK(maze->LoadMaze(floor, pellets));
+
+    int start[HEIGHT] = { 0 };
+    int reached[HEIGHT];
+    start[PLAYER_START_Y] = 0x1 << PLAYER_START_X;
+
+    CHECK_EQUAL(GetEccentricity(maze, PLAYER_START_X, PLAYER_START_Y), BitboardSearch::FloodFill(floor, start, reached));
+    CHECK(memcmp(floor, reached, sizeof(floor)) == 0);
+}
+
+// Checks that the layout is rejected and the classic maze is left as it was
+static void CheckRejected(Maze* maze, const int floor[], const int pellets[])
+{
+    int before[HEIGHT];
+    int after[HEIGHT];
+    int pelletCount = CountMazePellets(maze);
+    maze->CopyFloor(before);
+
+    CHECK(!maze->LoadMaze(floor, pellets));
+
+    maze->CopyFloor(after);
+    CHECK(memcmp(before, after, sizeof(before)) == 0);
+    CHECK_EQUAL(pelletCount, CountMazePellets(maze));
+}
+
+static void TestRejectedLayouts(Maze* maze)
+{
+    int floor[HEIGHT];
+    int pellets[HEIGHT];
+
+    // A sealed room in the top left corner with a pellet in it, joined to nothing else
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        floor[y] &= ~0x3F;
+        pellets[y] &= ~0x3F;
+    }
+
+    floor[1] |= 0x6;
+    floor[2] |= 0x6;
+    pellets[1] |= 0x2;
+    CheckRejected(maze, floor, pellets);
+
+    // A pellet inside a wall
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+    pellets[0] |= 0x1;
+    CheckRejected(maze, floor, pellets);
+
+    // The player start walled off, so no pellet can be reached from it
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+    floor[PLAYER_START_Y] &= ~(0x1 << PLAYER_START_X);
+    CheckRejected(maze, floor, pellets);
+}
+
+int main()
+{
+    static Maze maze;
+
+    TestClassicMaze(&maze);
+    TestRejectedLayouts(&maze);
+
+    return TestResult();
+}
@@ -0,0 +1,137 @@
+/*
+Tests for 'PacmanEnv::Snapshot' and 'PacmanEnv::Restore'
+
+A game is played part of the way in, snapshotted, then played on for 'RESTORE_STEPS' steps with random actions
+The same actions are then played again after restoring the snapshot, into the same env and into a different one,
+and every step has to give the same observation, reward, done flag and hash as the first time
+This is done with the classic ghosts and with ghosts following a flow field, whose distances have to be rebuilt after a restore
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Steps played before the snapshot is taken
+#define WARMUP_STEPS 500
+
+// Steps played after the snapshot, and again after each restore
+#define RESTORE_STEPS 2000
+
+// Result of every step of the run after the snapshot
+struct EnvRun
+{
+    int32_t observations[RESTORE_STEPS][ENV_OBSERVATION_SIZE];
+    float rewards[RESTORE_STEPS];
+    uint8_t dones[RESTORE_STEPS];
+    uint64_t hashes[RESTORE_STEPS];
+};
+
+// Returns the action for the given step, held for a few steps at a time so the player gets somewhere
+static int GetAction(int step)
+{
+    uint32_t random = (uint32_t)(step / 8);
+    random = (random * 1103515245u) + 12345u;
+    return (random >> 16) % ENV_ACTIONS;
+}
+
+// Plays 'RESTORE_STEPS' steps from 'start' onwards, storing every result in 'run'
+static void Play(PacmanEnv* env, int start, EnvRun* run)
+{
+    for (int i = 0; i < RESTORE_STEPS; i++)
+    {
+        env->Step(GetAction(start + i), run->observations[i], &run->rewards[i], &run->dones[i]);
+        run->hashes[i] = env->GetHash();
+    }
+}
+
+// Returns the first step two runs differ at, or -1 if they are the same
+static int FindDifference(const EnvRun* a, const EnvRun* b)
+{
+    for (int i = 0; i < RESTORE_STEPS; i++)
+    {
+        if (memcmp(a->observations[i], b->observations[i], sizeof(a->observations[i])) != 0 ||
+            a->rewards[i] != b->rewards[i] || a->dones[i] != b->dones[i] || a->hashes[i] != b->hashes[i])
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Plays 'env' up to the snapshot and on from it, then restores the snapshot into 'env' and 'other' and plays the same steps again
+static void TestRestore(PacmanEnv* env, PacmanEnv* other)
+{
+    // Each run is a few hundred KB
+    static EnvRun original;
+    static EnvRun restored;
+
+    float reward;
+    uint8_t done;
+
+    env->Reset(NULL);
+    other->Reset(NULL);
+
+    for (int i = 0; i < WARMUP_STEPS; i++)
+    {
+        env->Step(GetAction(i), NULL, &reward, &done);
+    }
+
+    GameState snapshot;
+    env->Snapshot(&snapshot);
+    CHECK_EQUAL(ZobristHash::ComputeHash(&snapshot), env->GetHash());
+
+    Play(env, WARMUP_STEPS, &original);
+
+    // Make sure the run went somewhere: the game moved on from the snapshot and the player scored
+    CHECK(original.hashes[RESTORE_STEPS - 1] != ZobristHash::ComputeHash(&snapshot));
+
+    float score = 0.0f;
+
+    for (int i = 0; i < RESTORE_STEPS; i++)
+    {
+        score += original.rewards[i] > 0.0f ? original.rewards[i] : 0.0f;
+    }
+
+    CHECK(score > 0.0f);
+
+    // Into the same env
+    env->Restore(&snapshot);
+    CHECK_EQUAL(ZobristHash::ComputeHash(&snapshot), env->GetHash());
+
+    Play(env, WARMUP_STEPS, &restored);
+    CHECK_EQUAL(-1, FindDifference(&original, &restored));
+
+    // Into a different env, which has been playing a game of its own
+    for (int i = 0; i < WARMUP_STEPS / 2; i++)
+    {
+        other->Step(GetAction(i + 12345), NULL, &reward, &done);
+    }
+
+    other->Restore(&snapshot);
+    CHECK_EQUAL(ZobristHash::ComputeHash(&snapshot), other->GetHash());
+
+    Play(other, WARMUP_STEPS, &restored);
+    CHECK_EQUAL(-1, FindDifference(&original, &restored));
+}
+
+int main()
+{
+    // Each env is a few KB
+    static PacmanEnv env;
+    static PacmanEnv other;
+
+    TestRestore(&env, &other);
+
+    // The flow fields are rebuilt from the restored player and pellets
+    static FlowField envField(env.GetMaze(), env.GetPlayer(), FLOW_TO_PLAYER);
+    static FlowField otherField(other.GetMaze(), other.GetPlayer(), FLOW_TO_PLAYER);
+    env.SetGhostFlowField(&envField);
+    other.SetGhostFlowField(&otherField);
+
+    TestRestore(&env, &other);
+
+    return TestResult();
+}
@@ -0,0 +1,260 @@
+/*
+Tests for 'PathFinder' against 'DistanceTable'
+
+Every path found has to be as long as the table says the shortest path is, and following its directions from the start has to
+walk over floor tiles to the goal. Checks every pair of floor tiles in the classic maze and again after a new layout is loaded
+(which the 'MazeGraph' rebuilds itself for), then checks that a blocked direction is never taken
+
+The path kept by a follower is checked by counting searches: walking along it mustn't search again,
+but changing the goal, leaving the path or loading a new layout must
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Follows the directions of 'path' from 'start', returning false if it steps onto a wall or doesn't end at 'goal'
+static bool FollowsToGoal(Maze* maze, Position start, Position goal, MazePath* path)
+{
+    Position tile = start;
+
+    for (int i = 0; i < path->length; i++)
+    {
+        tile = maze->GetAdjacentTilePos(tile.x, tile.y, path->directions[i]);
+
+        if (!maze->IsFloor(tile.x, tile.y))
+        {
+            return false;
+        }
+    }
+
+    return tile.x == goal.x && tile.y == goal.y;
+}
+
+// Checks the path between every pair of floor tiles against the table
+// Pairs the table saturates for are only checked for reaching the goal
+static void CheckAllPairs(Maze* maze, DistanceTable* table, PathFinder* pathFinder)
+{
+    static MazePath path;
+
+    for (int a = 0; a < table->GetFloorTileCount(); a++)
+    {
+        for (int b = 0; b < table->GetFloorTileCount(); b++)
+        {
+            Position start = table->GetTile(a);
+            Position goal = table->GetTile(b);
+            uint8_t distance = table->GetDistance(a, b);
+
+            bool found = pathFinder->FindPath(start, goal, 0x0, &path);
+
+            // Stop at the first mismatch so a broken search doesn't print thousands of lines
+            if (found != (distance != DISTANCE_UNREACHABLE))
+            {
+                CHECK_EQUAL(distance != DISTANCE_UNREACHABLE, found);
+                return;
+            }
+
+            if (!found)
+            {
+                continue;
+            }
+
+            if (distance != DISTANCE_SATURATED && path.length != distance)
+            {
+                CHECK_EQUAL((int)distance, (int)path.length);
+                return;
+            }
+
+            if (!FollowsToGoal(maze, start, goal, &path))
+            {
+                CHECK(FollowsToGoal(maze, start, goal, &path));
+                return;
+            }
+        }
+    }
+}
+
+// Checks that paths from every floor tile never leave it in the blocked direction
+static void CheckBlockedDirections(DistanceTable* table, PathFinder* pathFinder, Position goal)
+{
+    static MazePath path;
+
+    for (int a = 0; a < table->GetFloorTileCount(); a++)
+    {
+        Position start = table->GetTile(a);
+
+        for (char blocked = NORTH; blocked <= WEST; blocked <<= 1)
+        {
+            if (pathFinder->FindPath(start, goal, blocked, &path) && path.length > 0 && path.directions[0] == blocked)
+            {
+                CHECK(path.directions[0] != blocked);
+                return;
+            }
+        }
+    }
+}
+
+static void TestClassicMaze(Maze* maze, DistanceTable* table, PathFinder* pathFinder)
+{
+    CheckAllPairs(maze, table, pathFinder);
+
+    Position goal;
+    goal.x = PLAYER_START_X;
+    goal.y = PLAYER_START_Y;
+
+    CheckBlockedDirections(table, pathFinder, goal);
+
+    // Blocking one of the two ways out of a corner leaves the other
+    Position corner;
+    corner.x = 1;
+    corner.y = 2;
+
+    static MazePath path;
+    CHECK(pathFinder->FindPath(corner, goal, EAST, &path));
+    CHECK_EQUAL(SOUTH, (int)path.directions[0]);
+    CHECK(pathFinder->FindPath(corner, goal, SOUTH, &path));
+    CHECK_EQUAL(EAST, (int)path.directions[0]);
+
+    // Walls have no path
+    Position wall;
+    wall.x = 0;
+    wall.y = 0;
+
+    CHECK(!pathFinder->FindPath(wall, goal, 0x0, &path));
+    CHECK(!pathFinder->FindPath(goal, wall, 0x0, &path));
+
+    // Already at the goal
+    CHECK(pathFinder->FindPath(goal, goal, 0x0, &path));
+    CHECK_EQUAL(0, (int)path.length);
+    PathFinder::ClearPath(&path);
+    CHECK_EQUAL(0x0, (int)pathFinder->GetNextDirection(goal, goal, 0x0, &path));
+}
+
+// Walks from 'start' to 'goal' asking for a direction on every tile, returns the number of searches that took
+static int WalkToGoal(Maze* maze, PathFinder* pathFinder, Position start, Position goal, MazePath* path)
+{
+    int searches = pathFinder->GetSearchCount();
+    Position tile = start;
+    char lastDir = 0x0;
+
+    for (int i = 0; i < MAX_FLOOR_TILES && (tile.x != goal.x || tile.y != goal.y); i++)
+    {
+        lastDir = pathFinder->GetNextDirection(tile, goal, lastDir, path);
+
+        if (lastDir == 0x0)
+        {
+            break;
+        }
+
+        tile = maze->GetAdjacentTilePos(tile.x, tile.y, lastDir);
+    }
+
+    CHECK(tile.x == goal.x && tile.y == goal.y);
+
+    return pathFinder->GetSearchCount() - searches;
+}
+
+static void TestPathCache(Maze* maze, PathFinder* pathFinder)
+{
+    static MazePath path;
+    PathFinder::ClearPath(&path);
+
+    Position start;
+    start.x = 1;
+    start.y = 2;
+
+    Position goal;
+    goal.x = 26;
+    goal.y = 28;
+
+    // One search for the whole walk
+    CHECK_EQUAL(1, WalkToGoal(maze, pathFinder, start, goal, &path));
+
+    // A new goal needs a new search, and so does the old one again after that
+    Position otherGoal;
+    otherGoal.x = 26;
+    otherGoal.y = 2;
+
+    int searches = pathFinder->GetSearchCount();
+    CHECK(pathFinder->GetNextDirection(start, otherGoal, 0x0, &path) != 0x0);
+    CHECK(pathFinder->GetNextDirection(start, goal, 0x0, &path) != 0x0);
+    CHECK_EQUAL(searches + 2, pathFinder->GetSearchCount());
+
+    // Asking again from the same tile follows the path
+    CHECK(pathFinder->GetNextDirection(start, goal, 0x0, &path) != 0x0);
+    CHECK_EQUAL(searches + 2, pathFinder->GetSearchCount());
+
+    // Leaving the path needs a new search, the corner's other way out isn't on it
+    Position offPath = maze->GetAdjacentTilePos(start.x, start.y, path.directions[0] == EAST ? SOUTH : EAST);
+
+    CHECK(pathFinder->GetNextDirection(offPath, goal, 0x0, &path) != 0x0);
+    CHECK_EQUAL(searches + 3, pathFinder->GetSearchCount());
+
+    // Loading a layout (even the same one) needs a new search
+    int floor[HEIGHT];
+    int pellets[HEIGHT];
+    maze->CopyFloor(floor);
+    maze->CopyPellets(pellets);
+
+    CHECK(pathFinder->GetNextDirection(offPath, goal, 0x0, &path) != 0x0);
+    CHECK_EQUAL(searches + 3, pathFinder->GetSearchCount());
+
+    CHECK(maze->LoadMaze(floor, pellets));
+    CHECK(pathFinder->GetNextDirection(offPath, goal, 0x0, &path) != 0x0);
+    CHECK_EQUAL(searches + 4, pathFinder->GetSearchCount());
+}
+
+static void TestLongMaze(Maze* maze, DistanceTable* table, PathFinder* pathFinder)
+{
+    // One corridor winding back and forth down the maze: 14 rows of 20 tiles joined at alternate ends, 292 steps from end to end
+    int layout[HEIGHT] = { 0 };
+
+    for (int row = 0; row < 14; row++)
+    {
+        int y = 2 + (row * 2);
+
+        for (int x = 4; x < 24; x++)
+        {
+            layout[y] |= 0x1 << x;
+        }
+
+        if (row < 13)
+        {
+            layout[y + 1] |= 0x1 << (row % 2 == 0 ? 23 : 4);
+        }
+    }
+
+    CHECK(maze->LoadMaze(layout, layout));
+    CheckAllPairs(maze, table, pathFinder);
+
+    // Longer than the table can hold
+    Position start;
+    start.x = 4;
+    start.y = 2;
+
+    Position end;
+    end.x = 4;
+    end.y = 28;
+
+    static MazePath path;
+    CHECK(pathFinder->FindPath(start, end, 0x0, &path));
+    CHECK_EQUAL(292, (int)path.length);
+    CHECK(FollowsToGoal(maze, start, end, &path));
+}
+
+int main()
+{
+    // The table is 100 KB on the host
+    static Maze maze;
+    static DistanceTable table(&maze);
+    static MazeGraph graph(&maze);
+    static PathFinder pathFinder(&maze, &graph);
+
+    TestClassicMaze(&maze, &table, &pathFinder);
+    TestPathCache(&maze, &pathFinder);
+    TestLongMaze(&maze, &table, &pathFinder);
+
+    return TestResult();
+}
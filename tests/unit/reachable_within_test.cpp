@@ -0,0 +1,83 @@
+/*
+Tests for 'Maze::GetReachableWithin()' (and 'BitboardSearch::ReachableWithin()') against the breadth first search distances in 'DistanceTable'
+
+A tile should be in the bitboard exactly when its distance from the start is at most the number of steps,
+checked from a few start tiles (including one next to the tunnel) for a range of step counts
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../../main.cpp"
+
+#include "test.h"
+
+// Checks the reachable tiles from the tile (x, y) for each step count against the table's distances
+static void CheckStart(Maze* maze, DistanceTable* table, int x, int y)
+{
+    const int steps[] = { 0, 1, 2, 5, 13, 20, 57, 100, DISTANCE_SATURATED + 10 };
+    const int stepCount = sizeof(steps) / sizeof(steps[0]);
+
+    Position start;
+    start.x = x;
+    start.y = y;
+
+    CHECK(maze->IsFloor(x, y));
+
+    for (int i = 0; i < stepCount; i++)
+    {
+        int reached[HEIGHT];
+        maze->GetReachableWithin(x, y, steps[i], reached);
+
+        for (int tileY = 0; tileY < HEIGHT; tileY++)
+        {
+            for (int tileX = 0; tileX < WIDTH; tileX++)
+            {
+                Position end;
+                end.x = tileX;
+                end.y = tileY;
+
+                int distance = table->GetDistance(start, end);
+                bool expected = distance != DISTANCE_UNREACHABLE && distance <= steps[i];
+                bool actual = ((reached[tileY] >> tileX) & 0x1) != 0;
+
+                // Stop at the first mismatch so a broken search doesn't print hundreds of lines
+                if (expected != actual)
+                {
+                    CHECK_EQUAL(expected, actual);
+                    return;
+                }
+            }
+        }
+    }
+
+    // Walls and tiles off the maze reach nothing
+    int reached[HEIGHT];
+    maze->GetReachableWithin(0, 0, 10, reached);
+    CHECK_EQUAL(0, BitboardSearch::CountTiles(reached));
+
+    maze->GetReachableWithin(-1, y, 10, reached);
+    CHECK_EQUAL(0, BitboardSearch::CountTiles(reached));
+}
+
+int main()
+{
+    // The table is 100 KB on the host
+    static Maze maze;
+    static DistanceTable table(&maze);
+
+    CheckStart(&maze, &table, PLAYER_START_X, PLAYER_START_Y);
+    CheckStart(&maze, &table, 1, 2);
+    CheckStart(&maze, &table, 26, 28);
+
+    // Next to the tunnel, so the search has to wrap around the edges
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        if (maze.IsFloor(0, y) && maze.IsFloor(WIDTH - 1, y))
+        {
+            CheckStart(&maze, &table, 0, y);
+            break;
+        }
+    }
+
+    return TestResult();
+}
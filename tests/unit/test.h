@@ -0,0 +1,56 @@
+/*
+Unit test checks
+
+Each test is a program that includes 'main.cpp' (with 'PACMAN_HOST' and 'PACMAN_NO_MAIN') and this header, and ends with
+'return TestResult();' so that CTest sees a failure as a non-zero exit code
+
+A failed check prints where it was and carries on, so one run shows every check that failed
+*/
+
+#ifndef PACMAN_TEST_H
+#define PACMAN_TEST_H
+
+#include <cstdio>
+
+// Number of checks that have failed so far
+static int g_testFailures = 0;
+
+// Fails the test (without stopping it) if 'condition' is false
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            g_testFailures++; \
+        } \
+    } while (0)
+
+// Fails the test (without stopping it) if 'actual' isn't equal to 'expected', printing both as long longs
+#define CHECK_EQUAL(expected, actual) \
+    do \
+    { \
+        long long checkExpected = (long long)(expected); \
+        long long checkActual = (long long)(actual); \
+        if (checkExpected != checkActual) \
+        { \
+            printf("%s:%d: CHECK_EQUAL(%s, %s) failed: expected %lld, got %lld\n", __FILE__, __LINE__, #expected, #actual, \
+                checkExpected, checkActual); \
+            g_testFailures++; \
+        } \
+    } while (0)
+
+// Prints how many checks failed and returns the exit code for 'main'
+static int TestResult()
+{
+    if (g_testFailures > 0)
+    {
+        printf("%d check(s) failed\n", g_testFailures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
+
+#endif // PACMAN_TEST_H
@@ -0,0 +1,626 @@
+/*
+Batch simulation runner
+
+Plays thousands of complete headless games across every core and prints the score, level and death tick distributions
+Used for balancing the ghost AI, where playing one game at a time on the board (or in the simulator) is far too slow
+
+Each worker thread owns its own 'PacmanEnv' (and so its own 'GameContext'), so nothing mutable is shared between games
+Games are handed out with a work stealing pool: every worker starts with an equal range of games and, once its own range is empty,
+steals half of the games left in another worker's range
+
+Inputs:
+    random      - A random direction held for a random number of ticks
+    scripted    - NORTH, EAST, SOUTH, WEST in turn, changing every 'SCRIPT_HOLD_TICKS' ticks (offset by the game number)
+    replay      - Actions read from a file (one digit per tick, see 'ENV_ACTION_*'), the same for every game, with no input once it runs out
+Every game's input only depends on '--seed' and the game number, so the results are the same for any number of threads
+
+Ghosts:
+    classic     - The targeting AI from the board, heading in a straight line for each ghost's target
+    astar       - The same targets, reached by the shortest path through the maze ('PathFinder' over a 'MazeGraph' of the corridors)
+    table       - The same targets, taking the exit at each junction with the fewest steps to them ('DistanceTable')
+    flow        - Ghosts chasing the player itself follow a 'FlowField' to it, the rest use the classic AI
+
+Each game's Zobrist hash is followed with Brent's cycle finding, so games that come back to a state they were already in (a loop if the input repeats too)
+are counted, and games that end in exactly the same state as another game are reported as duplicates
+
+Usage:
+    batch_runner [--games N] [--threads N] [--input random|scripted|replay] [--replay FILE] [--ghosts classic|astar|table|flow] [--seed N] [--max-ticks N] [--csv FILE]
+
+Build with CMake (see 'CMakeLists.txt'), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -pthread -Ishim/include tools/batch_runner.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o batch_runner
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../main.cpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// How the player is steered in each game
+#define INPUT_RANDOM 0
+#define INPUT_SCRIPTED 1
+#define INPUT_REPLAY 2
+
+// How the ghosts find their way to their targets
+#define GHOSTS_CLASSIC 0
+#define GHOSTS_PATH_FINDER 1
+#define GHOSTS_DISTANCE_TABLE 2
+#define GHOSTS_FLOW_FIELD 3
+
+// Number of ticks each direction is held for with scripted input
+#define SCRIPT_HOLD_TICKS 40
+
+// Longest a random direction is held for (in ticks)
+#define RANDOM_MAX_HOLD_TICKS 48
+
+// Number of bars printed for each distribution
+#define HISTOGRAM_BINS 10
+
+// Settings for a batch of games
+struct BatchSettings
+{
+    int games;
+    int threads;
+    int input;
+    int ghosts;
+    uint32_t seed;
+    int maxTicks;
+    std::vector<uint8_t> replay;
+    std::string csvPath;
+};
+
+// Stores how one game went
+struct GameResult
+{
+    int score;
+    int level;
+    int ticks;
+    bool finished; // False if the game hit '--max-ticks' before it was over
+    int repeatTick; // First tick the game came back to an earlier state (-1 if it never did)
+    uint64_t finalHash; // Zobrist hash of the state the game ended in
+};
+
+/* WORK QUEUE */
+//////////////////////////////////////////////////////////////
+
+// This class stores the range of game numbers a worker has left to play
+// The owner takes games from the front, other workers steal from the back
+class WorkQueue
+{
+private:
+    std::mutex _lock;
+    int _begin;
+    int _end;
+
+public:
+    WorkQueue()
+    {
+        _begin = 0;
+        _end = 0;
+    }
+
+    // Replaces the range of games with [begin, end)
+    void Set(int begin, int end)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _begin = begin;
+        _end = end;
+    }
+
+    // Takes the next game from the front of the range
+    // Returns false if the range is empty
+    bool Pop(int* game)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+
+        if (_begin >= _end)
+        {
+            return false;
+        }
+
+        *game = _begin;
+        _begin++;
+        return true;
+    }
+
+    // Takes half of the games left (rounded up) from the back of the range
+    // Returns false if the range is empty
+    bool Steal(int* begin, int* end)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+
+        int left = _end - _begin;
+
+        if (left <= 0)
+        {
+            return false;
+        }
+
+        *end = _end;
+        _end -= (left + 1) / 2;
+        *begin = _end;
+        return true;
+    }
+};
+
+/* WORKER */
+//////////////////////////////////////////////////////////////
+
+// Returns the next number from a xorshift random number generator
+static uint32_t NextRandom(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Plays one complete game in 'env' and stores how it went in 'result'
+// The tick of every death is added to 'deathTicks'
+static void PlayGame(PacmanEnv* env, const BatchSettings* settings, int game, GameResult* result, std::vector<int>* deathTicks)
+{
+    static const uint8_t scriptActions[4] = { ENV_ACTION_NORTH, ENV_ACTION_EAST, ENV_ACTION_SOUTH, ENV_ACTION_WEST };
+
+    // Seed each game from its number so the inputs don't depend on which thread plays it
+    uint32_t random = (settings->seed ^ ((uint32_t)game * 0x9E3779B9u)) | 0x1;
+    int action = ENV_ACTION_NONE;
+    int holdTicks = 0;
+
+    env->Reset(NULL);
+
+    result->finished = false;
+    result->ticks = 0;
+    result->repeatTick = -1;
+
+    // Brent's cycle finding: compare against a saved hash, saving a new one each time the number of ticks since the last save reaches a power of two
+    uint64_t savedHash = env->GetHash();
+    int power = 1;
+    int sinceSave = 0;
+
+    for (int tick = 0; tick < settings->maxTicks; tick++)
+    {
+        if (settings->input == INPUT_RANDOM)
+        {
+            if (holdTicks <= 0)
+            {
+                action = 1 + (NextRandom(&random) % (ENV_ACTIONS - 1));
+                holdTicks = 1 + (NextRandom(&random) % RANDOM_MAX_HOLD_TICKS);
+            }
+            holdTicks--;
+        }
+        else if (settings->input == INPUT_SCRIPTED)
+        {
+            action = scriptActions[((tick / SCRIPT_HOLD_TICKS) + game) % 4];
+        }
+        else
+        {
+            action = tick < (int)settings->replay.size() ? settings->replay[tick] : ENV_ACTION_NONE;
+        }
+
+        int lives = env->GetLives();
+        float reward;
+        uint8_t done;
+
+        env->Step(action, NULL, &reward, &done);
+        result->ticks = tick + 1;
+
+        if (env->GetLives() < lives)
+        {
+            deathTicks->push_back(tick);
+        }
+
+        uint64_t hash = env->GetHash();
+        sinceSave++;
+
+        if (result->repeatTick == -1 && hash == savedHash)
+        {
+            result->repeatTick = tick + 1;
+        }
+
+        if (sinceSave == power)
+        {
+            savedHash = hash;
+            power *= 2;
+            sinceSave = 0;
+        }
+
+        if (done)
+        {
+            result->finished = true;
+            break;
+        }
+    }
+
+    result->score = env->GetScore();
+    result->level = env->GetLevel();
+    result->finalHash = env->GetHash();
+}
+
+// Shared by every worker
+struct WorkerShared
+{
+    const BatchSettings* settings;
+    WorkQueue* queues;
+    GameResult* results; // One entry per game, each only written by the worker that played it
+};
+
+// Plays games until there are none left in any queue
+// Death ticks are kept per worker and merged once every worker has finished
+static void RunWorker(WorkerShared* shared, int worker, std::vector<int>* deathTicks)
+{
+    PacmanEnv* env = new PacmanEnv();
+    env->SetAutoReset(false);
+
+    // Each worker searches its own env's maze, so nothing is shared between threads
+    MazeGraph* graph = NULL;
+    PathFinder* pathFinder = NULL;
+    DistanceTable* distanceTable = NULL;
+    FlowField* flowField = NULL;
+
+    if (shared->settings->ghosts == GHOSTS_PATH_FINDER)
+    {
+        graph = new MazeGraph(env->GetMaze());
+        pathFinder = new PathFinder(env->GetMaze(), graph);
+        env->SetGhostPathFinder(pathFinder);
+    }
+    else if (shared->settings->ghosts == GHOSTS_DISTANCE_TABLE)
+    {
+        distanceTable = new DistanceTable(env->GetMaze());
+        env->SetGhostDistanceTable(distanceTable);
+    }
+    else if (shared->settings->ghosts == GHOSTS_FLOW_FIELD)
+    {
+        flowField = new FlowField(env->GetMaze(), env->GetPlayer(), FLOW_TO_PLAYER);
+        env->SetGhostFlowField(flowField);
+    }
+
+    int threads = shared->settings->threads;
+
+    while (true)
+    {
+        int game;
+
+        if (shared->queues[worker].Pop(&game))
+        {
+            PlayGame(env, shared->settings, game, &shared->results[game], deathTicks);
+            continue;
+        }
+
+        // Own queue is empty, so try to steal from the others (starting with the next worker along)
+        bool stolen = false;
+
+        for (int i = 1; i < threads && !stolen; i++)
+        {
+            int begin;
+            int end;
+
+            if (shared->queues[(worker + i) % threads].Steal(&begin, &end))
+            {
+                shared->queues[worker].Set(begin, end);
+                stolen = true;
+            }
+        }
+
+        // No games are ever added, so once nothing can be stolen every game has been handed out
+        if (!stolen)
+        {
+            break;
+        }
+    }
+
+    delete env;
+    delete pathFinder;
+    delete graph;
+    delete distanceTable;
+    delete flowField;
+}
+
+/* REPORT */
+//////////////////////////////////////////////////////////////
+
+// Prints the count, mean, percentiles and a histogram of 'values'
+static void PrintDistribution(const char* name, std::vector<int> values)
+{
+    printf("\n%s\n", name);
+
+    if (values.empty())
+    {
+        printf("    (none)\n");
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    double total = 0;
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        total += values[i];
+    }
+
+    int count = (int)values.size();
+    int minimum = values.front();
+    int maximum = values.back();
+
+    printf("    count %d  mean %.1f  min %d  p10 %d  p50 %d  p90 %d  p99 %d  max %d\n",
+        count, total / count, minimum,
+        values[(count * 10) / 100], values[(count * 50) / 100], values[(count * 90) / 100], values[(count * 99) / 100],
+        maximum);
+
+    // Split the range into equal width bins, each at least 1 wide
+    int binWidth = ((maximum - minimum) / HISTOGRAM_BINS) + 1;
+    int bins[HISTOGRAM_BINS] = { 0 };
+    int largestBin = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int bin = (values[i] - minimum) / binWidth;
+        bins[bin]++;
+        largestBin = std::max(largestBin, bins[bin]);
+    }
+
+    for (int bin = 0; bin < HISTOGRAM_BINS; bin++)
+    {
+        int low = minimum + (bin * binWidth);
+
+        if (low > maximum)
+        {
+            break;
+        }
+
+        int barLength = (bins[bin] * 40) / largestBin;
+
+        printf("    %8d - %-8d | %-40s %d\n", low, low + binWidth - 1, std::string(barLength, '#').c_str(), bins[bin]);
+    }
+}
+
+// Writes one line per game to the CSV file at 'path'
+static bool WriteCsv(const std::string& path, const std::vector<GameResult>& results)
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(file, "game,score,level,ticks,finished,repeat_tick,final_hash\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        fprintf(file, "%d,%d,%d,%d,%d,%d,%016llx\n", (int)i, results[i].score, results[i].level, results[i].ticks, results[i].finished ? 1 : 0,
+            results[i].repeatTick, (unsigned long long)results[i].finalHash);
+    }
+
+    fclose(file);
+    return true;
+}
+
+/* MAIN */
+//////////////////////////////////////////////////////////////
+
+// Reads the actions to replay from the file at 'path' (one digit per tick, anything else is skipped)
+static bool ReadReplay(const char* path, std::vector<uint8_t>* replay)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int c;
+
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (c >= '0' && c < '0' + ENV_ACTIONS)
+        {
+            replay->push_back((uint8_t)(c - '0'));
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static void PrintUsage()
+{
+    printf("Usage: batch_runner [--games N] [--threads N] [--input random|scripted|replay] [--replay FILE] [--ghosts classic|astar|table|flow] [--seed N] [--max-ticks N] [--csv FILE]\n");
+}
+
+int main(int argc, char** argv)
+{
+    BatchSettings settings;
+    settings.games = 1000;
+    settings.threads = (int)std::thread::hardware_concurrency();
+    settings.input = INPUT_RANDOM;
+    settings.ghosts = GHOSTS_CLASSIC;
+    settings.seed = 1;
+    settings.maxTicks = 200000;
+
+    const char* replayPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--games")
+        {
+            settings.games = atoi(value);
+        }
+        else if (arg == "--threads")
+        {
+            settings.threads = atoi(value);
+        }
+        else if (arg == "--input")
+        {
+            std::string input = value;
+
+            if (input == "random")
+            {
+                settings.input = INPUT_RANDOM;
+            }
+            else if (input == "scripted")
+            {
+                settings.input = INPUT_SCRIPTED;
+            }
+            else if (input == "replay")
+            {
+                settings.input = INPUT_REPLAY;
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--replay")
+        {
+            replayPath = value;
+        }
+        else if (arg == "--ghosts")
+        {
+            std::string ghosts = value;
+
+            if (ghosts == "classic")
+            {
+                settings.ghosts = GHOSTS_CLASSIC;
+            }
+            else if (ghosts == "astar")
+            {
+                settings.ghosts = GHOSTS_PATH_FINDER;
+            }
+            else if (ghosts == "table")
+            {
+                settings.ghosts = GHOSTS_DISTANCE_TABLE;
+            }
+            else if (ghosts == "flow")
+            {
+                settings.ghosts = GHOSTS_FLOW_FIELD;
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--seed")
+        {
+            settings.seed = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else if (arg == "--max-ticks")
+        {
+            settings.maxTicks = atoi(value);
+        }
+        else if (arg == "--csv")
+        {
+            settings.csvPath = value;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (settings.input == INPUT_REPLAY && (replayPath == NULL || !ReadReplay(replayPath, &settings.replay)))
+    {
+        printf("Couldn't read the replay file\n");
+        return 1;
+    }
+
+    settings.threads = std::max(1, std::min(settings.threads, std::max(1, settings.games)));
+    settings.games = std::max(0, settings.games);
+
+    // Split the games evenly between the workers to start with
+    std::vector<WorkQueue> queues(settings.threads);
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        queues[i].Set((settings.games * i) / settings.threads, (settings.games * (i + 1)) / settings.threads);
+    }
+
+    std::vector<GameResult> results(settings.games);
+    std::vector<std::vector<int> > deathTicks(settings.threads);
+
+    WorkerShared shared;
+    shared.settings = &settings;
+    shared.queues = &queues[0];
+    shared.results = results.empty() ? NULL : &results[0];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        workers.push_back(std::thread(RunWorker, &shared, i, &deathTicks[i]));
+    }
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        workers[i].join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Merge the results
+    std::vector<int> scores;
+    std::vector<int> levels;
+    std::vector<int> allDeathTicks;
+    std::vector<uint64_t> finalHashes;
+    long long totalTicks = 0;
+    int unfinished = 0;
+    int repeated = 0;
+
+    for (int i = 0; i < settings.games; i++)
+    {
+        scores.push_back(results[i].score);
+        levels.push_back(results[i].level);
+        finalHashes.push_back(results[i].finalHash);
+        totalTicks += results[i].ticks;
+        unfinished += results[i].finished ? 0 : 1;
+        repeated += results[i].repeatTick != -1 ? 1 : 0;
+    }
+
+    std::sort(finalHashes.begin(), finalHashes.end());
+    int distinct = (int)(std::unique(finalHashes.begin(), finalHashes.end()) - finalHashes.begin());
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        allDeathTicks.insert(allDeathTicks.end(), deathTicks[i].begin(), deathTicks[i].end());
+    }
+
+    printf("%d games (%d hit the tick limit) on %d threads in %.2f s (%.0f games/s, %.1f M ticks/s)\n",
+        settings.games, unfinished, settings.threads, seconds, settings.games / seconds, (totalTicks / seconds) / 1e6);
+    printf("%d games came back to an earlier state, %d duplicate games (same final state as another game)\n", repeated, settings.games - distinct);
+
+    PrintDistribution("Score", scores);
+    PrintDistribution("Level reached", levels);
+    PrintDistribution("Death tick", allDeathTicks);
+
+    if (!settings.csvPath.empty() && !WriteCsv(settings.csvPath, results))
+    {
+        printf("Couldn't write %s\n", settings.csvPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,926 @@
+/*
+Microbenchmarks
+
+Times the functions the frame rate depends on, each on its own with the same inputs every run, against the BSP shim:
+    sprite/draw                 - 'BaseGameSprite::DrawSprite' (the player, mouth open)
+    sprite/flipped_horizontal   - 'BaseGameSprite::DrawSpriteFlippedHorizontal' (a ghost)
+    sprite/rotated_90           - 'BaseGameSprite::DrawSpriteRotated90' (the player)
+    sprite/rotated_270          - 'BaseGameSprite::DrawSpriteRotated270' (the player)
+    maze/draw_tile              - 'Maze::DrawTile', every tile in the maze in turn
+    maze/full_redraw            - 'Maze::Draw' with '_initialDraw' set, so every tile is drawn
+    maze/is_floor_adjacent      - 'Maze::IsFloorAdjacentScreenPos', every tile in the maze in each direction
+    maze/generate               - 'MazeGenerator::Generate', the same sequence of mazes from the same seed every run
+    enemy/get_next_dir          - 'Enemy::GetNextDir' (Blinky), from every floor tile in the maze
+    enemy/move_batch            - 'GhostMoveBatch::Add' then 'Evaluate' for 'MAX_BATCH_GHOSTS' ghosts spread over the maze (as 'EnemyGroup' does)
+    enemy/move_scalar           - 'Enemy::GetNextDir' for the same 'MAX_BATCH_GHOSTS' ghosts one at a time, to compare against 'enemy/move_batch'
+    viewport/scroll             - 'Viewport::Draw' after moving the camera one tile diagonally, across a 'MAX_ARENA_SIZE' square
+                                  'ChunkedMaze' filled with copies of the classic maze
+    viewport/actors             - A frame of 'ARENA_WALKERS' sprites walking the same arena and eating its pellets, with the camera following
+                                  the first one and every sprite drawn through the viewport (so those out of view are culled)
+    game/play_tick              - A complete frame while playing ('GameEngine::RunFrame'), going back to the same
+                                  point in the game every 'PLAY_TICK_RUN' frames
+
+Each case is run until it has been going for at least one sample's worth of time (which also finds how many operations fit in a sample),
+then timed over '--samples' samples, reporting the median (and fastest) nanoseconds per operation
+LCD bytes and pixels per operation come from the shim's counters over one separate pass of 'countOps' operations from the start of the case,
+so they are the same on every run and any change to them is a real change in what is drawn
+
+Results can be written to a JSON file and compared against one written earlier (e.g. on the main branch)
+A case fails the comparison if it sends more bytes to the LCD than in the baseline, or if it is slower by more than '--tolerance'
+NOTE: Times are only comparable on the same machine, and should be taken from a Release build
+
+Usage:
+    bench [--filter TEXT] [--samples N] [--sample-ms N] [--json FILE] [--baseline FILE] [--tolerance F]
+
+Build with CMake (see 'CMakeLists.txt'), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -Ishim/include tools/bench.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o bench
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../main.cpp"
+
+#include "shim.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Most samples each case can be timed over
+#define MAX_SAMPLES 64
+
+// Frames played from the saved point in the game before going back to it in 'game/play_tick'
+#define PLAY_TICK_RUN 64
+
+// Most frames run while getting to the PLAY state before giving up
+#define MAX_STARTUP_FRAMES 10000
+
+// Seed 'maze/generate' starts from
+#define GENERATE_SEED 1
+
+// Camera moves made in 'viewport/scroll' before going back to the top left of the arena
+#define SCROLL_RUN (MAX_ARENA_SIZE - VIEW_TILES_Y)
+
+// Sprites walking the arena in 'viewport/actors', and the frames they walk for before starting again
+#define ARENA_WALKERS 64
+#define ARENA_RUN 256
+
+// Gives the benchmarks access to the private and protected functions they time (see the friend declarations in 'main.cpp')
+struct BenchmarkAccess
+{
+    static void DrawSprite(BaseGameSprite* sprite, int image, uint16_t colour)
+    {
+        sprite->DrawSprite(image, colour);
+    }
+
+    static void DrawSpriteFlippedHorizontal(BaseGameSprite* sprite, int image, uint16_t colour)
+    {
+        sprite->DrawSpriteFlippedHorizontal(image, colour);
+    }
+
+    static void DrawSpriteRotated90(BaseGameSprite* sprite, int image, uint16_t colour)
+    {
+        sprite->DrawSpriteRotated90(image, colour);
+    }
+
+    static void DrawSpriteRotated270(BaseGameSprite* sprite, int image, uint16_t colour)
+    {
+        sprite->DrawSpriteRotated270(image, colour);
+    }
+
+    static void DrawTile(Maze* maze, int x, int y)
+    {
+        maze->DrawTile(x, y);
+    }
+
+    // Makes the next 'Draw()' redraw the whole maze
+    static void SetInitialDraw(Maze* maze)
+    {
+        maze->_initialDraw = true;
+    }
+
+    // Returns the direction picked
+    static char GetNextDir(Enemy* enemy)
+    {
+        enemy->GetNextDir();
+        return enemy->_nextDir;
+    }
+
+    // Returns the direction picked heading for 'target' without excluding any way back, putting the enemy's target and last direction back afterwards
+    static char GetNextDir(Enemy* enemy, Position target)
+    {
+        Position lastTarget = enemy->_target;
+        char lastDir = enemy->_lastDir;
+
+        enemy->_target = target;
+        enemy->_lastDir = 0x0;
+        enemy->GetNextDir();
+
+        enemy->_target = lastTarget;
+        enemy->_lastDir = lastDir;
+        return enemy->_nextDir;
+    }
+};
+
+// Sprite that walks a 'ChunkedMaze' for 'viewport/actors', eating pellets as it goes
+// It carries straight on until it meets a wall, then turns to the first way open clockwise from the way it was going
+class ArenaWalker :
+    public BaseGameSprite
+{
+private:
+    ChunkedMaze* _arena;
+    char _direction;
+
+public:
+    int eaten;
+
+    ArenaWalker() : BaseGameSprite(0, 0)
+    {
+        _arena = NULL;
+        _direction = EAST;
+        eaten = 0;
+    }
+
+    // Puts the walker on the tile (x, y) of 'arena', drawn through 'viewport'
+    void Place(ChunkedMaze* arena, Viewport* viewport, int x, int y)
+    {
+        _arena = arena;
+        _direction = EAST;
+        position.x = x * TILE_SIZE;
+        position.y = y * TILE_SIZE;
+        eaten = 0;
+        SetViewport(viewport);
+    }
+
+    void Update()
+    {
+        static const char CLOCKWISE[4] = { NORTH, EAST, SOUTH, WEST };
+
+        if (position.x % TILE_SIZE == 0 && position.y % TILE_SIZE == 0)
+        {
+            eaten += _arena->TryRemovePellet(position.x / TILE_SIZE, position.y / TILE_SIZE);
+
+            int turn = MazeGraph::DirectionIndex(_direction);
+
+            for (int i = 0; i < 4 && !_arena->IsFloorAdjacentWorldPos(position, _direction); i++)
+            {
+                turn = (turn + 1) % 4;
+                _direction = CLOCKWISE[turn];
+            }
+        }
+
+        position.x += _direction == EAST ? 1 : _direction == WEST ? -1 : 0;
+        position.y += _direction == SOUTH ? 1 : _direction == NORTH ? -1 : 0;
+    }
+
+    void Draw()
+    {
+        DrawSprite(SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+};
+
+// Stores the game every case is run against, set up the same way as 'main()'
+struct BenchmarkGame
+{
+    GameEngine* engine;
+    GameContext* context;
+    Maze* maze;
+    Player* player;
+    Enemy* blinky;
+    Enemy* enemies[4];
+
+    // Point in the game 'game/play_tick' goes back to
+    GameState playStart;
+
+    // Screen positions of every floor tile, for 'enemy/get_next_dir'
+    std::vector<Position> floorTiles;
+
+    // Ghosts for 'enemy/move_batch' and 'enemy/move_scalar': screen positions, targets and the ways out of each position
+    Position batchPositions[MAX_BATCH_GHOSTS];
+    Position batchTargets[MAX_BATCH_GHOSTS];
+    char batchExits[MAX_BATCH_GHOSTS];
+    GhostMoveBatch* moveBatch;
+
+    // Large arena and the camera looking at it, for 'viewport/scroll' and 'viewport/actors'
+    ChunkedMaze* arena;
+    Viewport* viewport;
+
+    // Layout the arena is filled with copies of
+    int arenaLayout[HEIGHT];
+    int arenaPellets[HEIGHT];
+
+    // Sprites walking the arena, for 'viewport/actors'
+    ArenaWalker walkers[ARENA_WALKERS];
+
+    // Operations each case has run since its 'Setup', used to step through tiles and frames
+    long next;
+};
+
+static BenchmarkGame g_game;
+
+// Generator for 'maze/generate', put back to 'GENERATE_SEED' before each run
+static MazeGenerator g_generator(GENERATE_SEED);
+
+// Stops the compiler from throwing away results that are never used
+static volatile int g_sink;
+
+// One benchmark
+struct BenchmarkCase
+{
+    const char* name;
+    long countOps; // Operations the LCD counters are averaged over (a whole pass through the case's inputs)
+    void (*Setup)();
+    void (*Run)(long ops);
+};
+
+// Result of one benchmark, as written to (and read from) the JSON file
+struct BenchmarkResult
+{
+    std::string name;
+    double nsPerOp; // Median of the samples
+    double minNsPerOp;
+    double lcdBytesPerOp;
+    double pixelsPerOp;
+    long opsPerSample;
+};
+
+static void SetupNone()
+{
+    g_game.next = 0;
+}
+
+static void RunDrawSprite(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        BenchmarkAccess::DrawSprite(g_game.player, SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+}
+
+static void RunDrawSpriteFlippedHorizontal(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        BenchmarkAccess::DrawSpriteFlippedHorizontal(g_game.blinky, SPRITE_GHOST_HORIZONTAL_A, LCD_COLOR_RED);
+    }
+}
+
+static void RunDrawSpriteRotated90(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        BenchmarkAccess::DrawSpriteRotated90(g_game.player, SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+}
+
+static void RunDrawSpriteRotated270(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        BenchmarkAccess::DrawSpriteRotated270(g_game.player, SPRITE_PLAYER_OPEN, LCD_COLOR_YELLOW);
+    }
+}
+
+static void RunDrawTile(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        int tile = (int)(g_game.next++ % (WIDTH * HEIGHT));
+        BenchmarkAccess::DrawTile(g_game.maze, tile % WIDTH, tile / WIDTH);
+    }
+}
+
+static void RunFullRedraw(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        BenchmarkAccess::SetInitialDraw(g_game.maze);
+        g_game.maze->Draw();
+    }
+}
+
+static void RunIsFloorAdjacent(long ops)
+{
+    static const char DIRECTIONS[4] = { NORTH, EAST, SOUTH, WEST };
+
+    int found = 0;
+
+    for (long i = 0; i < ops; i++)
+    {
+        int index = (int)(g_game.next++ % (WIDTH * HEIGHT * 4));
+        int tile = index / 4;
+
+        Position screenPos;
+        screenPos.x = (tile % WIDTH) * TILE_SIZE;
+        screenPos.y = (tile / WIDTH) * TILE_SIZE;
+
+        found += g_game.maze->IsFloorAdjacentScreenPos(screenPos, DIRECTIONS[index % 4]);
+    }
+
+    g_sink = found;
+}
+
+static void SetupGenerate()
+{
+    g_game.next = 0;
+    g_generator = MazeGenerator(GENERATE_SEED);
+}
+
+static void RunGenerate(long ops)
+{
+    int maze[HEIGHT];
+    int pellets[HEIGHT];
+    int found = 0;
+
+    for (long i = 0; i < ops; i++)
+    {
+        found += g_generator.Generate(maze, pellets);
+    }
+
+    g_sink = found;
+}
+
+// Moves Blinky to each floor tile in turn, putting it back afterwards so the PLAY tick isn't affected
+static void RunGetNextDir(long ops)
+{
+    Position start = g_game.blinky->position;
+    int found = 0;
+
+    for (long i = 0; i < ops; i++)
+    {
+        g_game.blinky->position = g_game.floorTiles[g_game.next++ % g_game.floorTiles.size()];
+        found += BenchmarkAccess::GetNextDir(g_game.blinky);
+    }
+
+    g_game.blinky->position = start;
+    g_sink = found;
+}
+
+// Gathers every ghost into the batch and picks all of their directions at once
+static void RunMoveBatch(long ops)
+{
+    int found = 0;
+
+    for (long i = 0; i < ops; i++)
+    {
+        g_game.moveBatch->Clear();
+
+        for (int ghost = 0; ghost < MAX_BATCH_GHOSTS; ghost++)
+        {
+            g_game.moveBatch->Add(g_game.batchPositions[ghost], g_game.batchTargets[ghost], g_game.batchExits[ghost]);
+        }
+
+        g_game.moveBatch->Evaluate();
+        found += g_game.moveBatch->GetDirection(i % MAX_BATCH_GHOSTS);
+    }
+
+    g_sink = found;
+}
+
+// Moves Blinky to each ghost's position in turn, putting it back afterwards so the PLAY tick isn't affected
+static void RunMoveScalar(long ops)
+{
+    Position start = g_game.blinky->position;
+    int found = 0;
+
+    for (long i = 0; i < ops; i++)
+    {
+        for (int ghost = 0; ghost < MAX_BATCH_GHOSTS; ghost++)
+        {
+            g_game.blinky->position = g_game.batchPositions[ghost];
+            found += BenchmarkAccess::GetNextDir(g_game.blinky, g_game.batchTargets[ghost]);
+        }
+    }
+
+    g_game.blinky->position = start;
+    g_sink = found;
+}
+
+// Puts the camera back at the top left of the arena with the whole screen drawn
+static void SetupScroll()
+{
+    g_game.next = 0;
+    g_game.viewport->MoveTo(0, 0);
+    g_game.viewport->Invalidate();
+    g_game.viewport->Draw();
+}
+
+static void RunScroll(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        int step = (int)(++g_game.next % SCROLL_RUN);
+        g_game.viewport->MoveTo(step, step);
+        g_game.viewport->Draw();
+    }
+}
+
+// Puts every pellet back in the arena and the walkers back at the player's start in copies of the maze spread across it,
+// with the camera following the first walker and the whole screen drawn
+static void SetupActors()
+{
+    g_game.next = 0;
+    g_game.arena->RepeatLayout(g_game.arenaLayout, g_game.arenaPellets);
+
+    for (int i = 0; i < ARENA_WALKERS; i++)
+    {
+        int copyX = (i % 8) * 4;
+        int copyY = (i / 8) * 4;
+        g_game.walkers[i].Place(g_game.arena, g_game.viewport, (copyX * WIDTH) + PLAYER_START_X, (copyY * HEIGHT) + PLAYER_START_Y);
+    }
+
+    g_game.viewport->Follow(&g_game.walkers[0]);
+    g_game.viewport->MoveTo(0, 0);
+    g_game.viewport->Update();
+    g_game.viewport->Invalidate();
+    g_game.viewport->Draw();
+}
+
+// Runs frames the way 'GameEngine::RunFrame' would with the viewport added before the walkers
+static void RunActors(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        if (++g_game.next % ARENA_RUN == 0)
+        {
+            SetupActors();
+        }
+
+        g_game.viewport->Update();
+
+        for (int w = 0; w < ARENA_WALKERS; w++)
+        {
+            g_game.walkers[w].Update();
+        }
+
+        g_game.viewport->Draw();
+
+        for (int w = 0; w < ARENA_WALKERS; w++)
+        {
+            g_game.walkers[w].Draw();
+        }
+    }
+
+    g_sink = g_game.walkers[0].eaten;
+}
+
+// Puts the game back to the start of the PLAY state
+static void RestorePlayStart()
+{
+    g_game.maze->LoadState(&g_game.playStart);
+    g_game.player->LoadState(&g_game.playStart);
+
+    for (int i = 0; i < 4; i++)
+    {
+        g_game.enemies[i]->LoadState(&g_game.playStart.enemies[i]);
+    }
+
+    g_game.context->curGameState = PLAY;
+    g_game.context->nextGameState = PLAY;
+}
+
+static void RunPlayTick(long ops)
+{
+    for (long i = 0; i < ops; i++)
+    {
+        if (g_game.next++ % PLAY_TICK_RUN == 0)
+        {
+            RestorePlayStart();
+        }
+
+        g_game.engine->RunFrame();
+    }
+}
+
+static const BenchmarkCase CASES[] =
+{
+    { "sprite/draw", 1, SetupNone, RunDrawSprite },
+    { "sprite/flipped_horizontal", 1, SetupNone, RunDrawSpriteFlippedHorizontal },
+    { "sprite/rotated_90", 1, SetupNone, RunDrawSpriteRotated90 },
+    { "sprite/rotated_270", 1, SetupNone, RunDrawSpriteRotated270 },
+    { "maze/draw_tile", WIDTH * HEIGHT, SetupNone, RunDrawTile },
+    { "maze/full_redraw", 1, SetupNone, RunFullRedraw },
+    { "maze/is_floor_adjacent", WIDTH * HEIGHT * 4, SetupNone, RunIsFloorAdjacent },
+    { "maze/generate", 1, SetupGenerate, RunGenerate },
+    { "enemy/get_next_dir", 0, SetupNone, RunGetNextDir }, // One pass over 'floorTiles', filled in once the maze is loaded
+    { "enemy/move_batch", 1, SetupNone, RunMoveBatch },
+    { "enemy/move_scalar", 1, SetupNone, RunMoveScalar },
+    { "viewport/scroll", SCROLL_RUN, SetupScroll, RunScroll },
+    { "viewport/actors", ARENA_RUN - 1, SetupActors, RunActors }, // One run of the walkers, stopping short of going back to the start
+    { "game/play_tick", PLAY_TICK_RUN, SetupNone, RunPlayTick },
+};
+
+#define CASE_COUNT ((int)(sizeof(CASES) / sizeof(CASES[0])))
+
+// Returns how long 'ops' operations of 'benchmark' take in nanoseconds
+static double TimeRun(const BenchmarkCase* benchmark, long ops)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    benchmark->Run(ops);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void RunBenchmark(const BenchmarkCase* benchmark, long countOps, int samples, double sampleNs, BenchmarkResult* result)
+{
+    result->name = benchmark->name;
+
+    // Counters over one pass from the start of the case
+    benchmark->Setup();
+    Shim_ResetCounters();
+    benchmark->Run(countOps);
+
+    const ShimCounters* counters = Shim_GetCounters();
+    result->lcdBytesPerOp = (double)counters->lcdBusBytes / countOps;
+    result->pixelsPerOp = (double)counters->pixelsWritten / countOps;
+
+    // Warm up, doubling the operations in a sample until it takes long enough
+    benchmark->Setup();
+    long ops = 1;
+
+    while (TimeRun(benchmark, ops) < sampleNs)
+    {
+        ops *= 2;
+    }
+
+    double nsPerOp[MAX_SAMPLES];
+
+    for (int i = 0; i < samples; i++)
+    {
+        nsPerOp[i] = TimeRun(benchmark, ops) / ops;
+    }
+
+    std::sort(nsPerOp, nsPerOp + samples);
+
+    result->nsPerOp = nsPerOp[samples / 2];
+    result->minNsPerOp = nsPerOp[0];
+    result->opsPerSample = ops;
+}
+
+// Builds the game and plays it (with the same touches as 'tools/heap_check.cpp') until it gets to the PLAY state
+// Returns false if it never does
+static bool StartGame()
+{
+    GameContext* context = g_game.context;
+    uint32_t random = 12345;
+
+    LCDInit();
+    g_game.engine->Init();
+
+    for (int frame = 0; frame < MAX_STARTUP_FRAMES; frame++)
+    {
+        if (context->curGameState == PLAY)
+        {
+            g_game.maze->SaveState(&g_game.playStart);
+            g_game.player->SaveState(&g_game.playStart);
+
+            for (int i = 0; i < 4; i++)
+            {
+                g_game.enemies[i]->SaveState(&g_game.playStart.enemies[i]);
+            }
+
+            // Nothing is touched while playing, so the player carries on the way it is going
+            context->tsState.touchDetected = 0;
+
+            for (int y = 0; y < HEIGHT; y++)
+            {
+                for (int x = 0; x < WIDTH; x++)
+                {
+                    if (g_game.maze->IsFloor(x, y))
+                    {
+                        Position screenPos;
+                        screenPos.x = x * TILE_SIZE;
+                        screenPos.y = y * TILE_SIZE;
+                        g_game.floorTiles.push_back(screenPos);
+                    }
+                }
+            }
+
+            // Spread the ghosts over the maze, each heading for a different floor tile
+            static const char DIRECTIONS[4] = { NORTH, EAST, SOUTH, WEST };
+            int floorCount = (int)g_game.floorTiles.size();
+
+            for (int ghost = 0; ghost < MAX_BATCH_GHOSTS; ghost++)
+            {
+                Position screenPos = g_game.floorTiles[(ghost * 7) % floorCount];
+                char exits = 0x0;
+
+                for (int i = 0; i < 4; i++)
+                {
+                    if (g_game.maze->IsFloorAdjacentScreenPos(screenPos, DIRECTIONS[i]))
+                    {
+                        exits |= DIRECTIONS[i];
+                    }
+                }
+
+                g_game.batchPositions[ghost] = screenPos;
+                g_game.batchTargets[ghost] = g_game.floorTiles[((ghost * 31) + 5) % floorCount];
+                g_game.batchExits[ghost] = exits;
+            }
+
+            return true;
+        }
+
+        if (frame % 17 == 0)
+        {
+            random = (random * 1103515245u) + 12345u;
+            context->tsState.touchDetected = ((random >> 16) % 3) != 0;
+            context->tsState.touchX[0] = (random >> 8) % SCREEN_WIDTH;
+            context->tsState.touchY[0] = (random >> 20) % SCREEN_HEIGHT;
+        }
+
+        g_game.engine->RunFrame();
+    }
+
+    return false;
+}
+
+static bool WriteJson(const std::string& path, const std::vector<BenchmarkResult>& results)
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    // One benchmark a line, which is what 'ReadJson' expects
+    fprintf(file, "{\n    \"benchmarks\": [\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+
+        fprintf(file, "        { \"name\": \"%s\", \"ns_per_op\": %.2f, \"min_ns_per_op\": %.2f, \"lcd_bytes_per_op\": %.2f, \"pixels_per_op\": %.2f, \"ops_per_sample\": %ld }%s\n",
+            result.name.c_str(), result.nsPerOp, result.minNsPerOp, result.lcdBytesPerOp, result.pixelsPerOp, result.opsPerSample,
+            i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(file, "    ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+// Reads the number after '"key":' in 'line', returning false if it isn't there
+static bool ReadJsonNumber(const std::string& line, const char* key, double* value)
+{
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t found = line.find(pattern);
+
+    if (found == std::string::npos)
+    {
+        return false;
+    }
+
+    *value = strtod(line.c_str() + found + pattern.size(), NULL);
+    return true;
+}
+
+// Reads a file written by 'WriteJson', returning false if it couldn't be read
+static bool ReadJson(const std::string& path, std::vector<BenchmarkResult>* results)
+{
+    FILE* file = fopen(path.c_str(), "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    char buffer[512];
+
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        std::string line = buffer;
+        size_t nameStart = line.find("\"name\": \"");
+
+        if (nameStart == std::string::npos)
+        {
+            continue;
+        }
+
+        nameStart += 9;
+        size_t nameEnd = line.find('"', nameStart);
+
+        BenchmarkResult result;
+        double opsPerSample = 0;
+        result.name = line.substr(nameStart, nameEnd - nameStart);
+
+        if (nameEnd != std::string::npos &&
+            ReadJsonNumber(line, "ns_per_op", &result.nsPerOp) &&
+            ReadJsonNumber(line, "min_ns_per_op", &result.minNsPerOp) &&
+            ReadJsonNumber(line, "lcd_bytes_per_op", &result.lcdBytesPerOp) &&
+            ReadJsonNumber(line, "pixels_per_op", &result.pixelsPerOp) &&
+            ReadJsonNumber(line, "ops_per_sample", &opsPerSample))
+        {
+            result.opsPerSample = (long)opsPerSample;
+            results->push_back(result);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Prints each result next to its baseline, returning the number of regressions
+static int CompareResults(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double tolerance)
+{
+    int regressions = 0;
+
+    printf("\n%-28s %12s %12s %8s %14s %14s\n", "Compared to baseline", "ns/op", "baseline", "change", "LCD bytes/op", "baseline");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        const BenchmarkResult* previous = NULL;
+
+        for (size_t j = 0; j < baseline.size(); j++)
+        {
+            if (baseline[j].name == result.name)
+            {
+                previous = &baseline[j];
+            }
+        }
+
+        if (previous == NULL)
+        {
+            printf("%-28s %12.1f %12s\n", result.name.c_str(), result.nsPerOp, "(new)");
+            continue;
+        }
+
+        double change = previous->nsPerOp > 0 ? (result.nsPerOp / previous->nsPerOp) - 1.0 : 0.0;
+
+        // LCD bytes are the same on every run, so allow for nothing more than rounding in the file
+        bool slower = change > tolerance;
+        bool moreBytes = result.lcdBytesPerOp > previous->lcdBytesPerOp + 0.01;
+
+        printf("%-28s %12.1f %12.1f %+7.1f%% %14.1f %14.1f%s\n", result.name.c_str(), result.nsPerOp, previous->nsPerOp, change * 100.0,
+            result.lcdBytesPerOp, previous->lcdBytesPerOp, slower || moreBytes ? "  REGRESSED" : "");
+
+        if (slower || moreBytes)
+        {
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+static void PrintUsage()
+{
+    printf("Usage: bench [--filter TEXT] [--samples N] [--sample-ms N] [--json FILE] [--baseline FILE] [--tolerance F]\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string jsonPath;
+    std::string baselinePath;
+    int samples = 9;
+    double sampleMs = 20.0;
+    double tolerance = 0.25;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--filter")
+        {
+            filter = value;
+        }
+        else if (arg == "--samples")
+        {
+            samples = atoi(value);
+        }
+        else if (arg == "--sample-ms")
+        {
+            sampleMs = atof(value);
+        }
+        else if (arg == "--json")
+        {
+            jsonPath = value;
+        }
+        else if (arg == "--baseline")
+        {
+            baselinePath = value;
+        }
+        else if (arg == "--tolerance")
+        {
+            tolerance = atof(value);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (samples < 1 || samples > MAX_SAMPLES || sampleMs <= 0)
+    {
+        printf("--samples must be from 1 to %d and --sample-ms more than 0\n", MAX_SAMPLES);
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> baseline;
+
+    if (!baselinePath.empty() && !ReadJson(baselinePath, &baseline))
+    {
+        printf("Couldn't read %s\n", baselinePath.c_str());
+        return 1;
+    }
+
+    // Set up the same way as 'main()'
+    PacmanGame game;
+    GameEngine* engine = game.GetEngine();
+
+    g_game.engine = engine;
+    g_game.context = engine->GetContext();
+    g_game.maze = game.GetMaze();
+    g_game.player = game.GetPlayer();
+    g_game.blinky = game.GetEnemy(0);
+
+    for (int i = 0; i < 4; i++)
+    {
+        g_game.enemies[i] = game.GetEnemy(i);
+    }
+
+    g_game.context->logEnabled = false;
+
+    // The batch is 6 KB
+    static GhostMoveBatch moveBatch;
+    g_game.moveBatch = &moveBatch;
+
+    // The arena is 256 KB
+    static ChunkedMaze arena(MAX_ARENA_SIZE, MAX_ARENA_SIZE);
+    g_game.maze->CopyFloor(g_game.arenaLayout);
+    g_game.maze->CopyPellets(g_game.arenaPellets);
+
+    if (!arena.RepeatLayout(g_game.arenaLayout, g_game.arenaPellets))
+    {
+        printf("The arena ran out of chunks\n");
+        return 1;
+    }
+
+    Viewport viewport(&arena);
+    g_game.arena = &arena;
+    g_game.viewport = &viewport;
+
+    if (!StartGame())
+    {
+        printf("The game never got to the PLAY state\n");
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> results;
+
+    printf("%-28s %12s %12s %14s %12s %12s\n", "Benchmark", "ns/op", "min ns/op", "LCD bytes/op", "pixels/op", "ops/sample");
+
+    for (int i = 0; i < CASE_COUNT; i++)
+    {
+        const BenchmarkCase* benchmark = &CASES[i];
+
+        if (!filter.empty() && std::string(benchmark->name).find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        long countOps = benchmark->countOps > 0 ? benchmark->countOps : (long)g_game.floorTiles.size();
+
+        BenchmarkResult result;
+        RunBenchmark(benchmark, countOps, samples, sampleMs * 1000000.0, &result);
+        results.push_back(result);
+
+        printf("%-28s %12.1f %12.1f %14.1f %12.1f %12ld\n", result.name.c_str(), result.nsPerOp, result.minNsPerOp,
+            result.lcdBytesPerOp, result.pixelsPerOp, result.opsPerSample);
+    }
+
+    if (!jsonPath.empty() && !WriteJson(jsonPath, results))
+    {
+        printf("Couldn't write %s\n", jsonPath.c_str());
+        return 1;
+    }
+
+    if (!baselinePath.empty())
+    {
+        int regressions = CompareResults(results, baseline, tolerance);
+
+        if (regressions > 0)
+        {
+            printf("FAILED: %d benchmarks regressed (more LCD bytes, or more than %.0f%% slower)\n", regressions, tolerance * 100.0);
+            return 1;
+        }
+
+        printf("No regressions\n");
+    }
+
+    return 0;
+}
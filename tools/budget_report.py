@@ -0,0 +1,446 @@
+#!/usr/bin/env python3
+"""
+Memory budget report
+
+Breaks down the flash, RAM and worst case stack depth of a build by subsystem ('GameEngine', 'Maze', 'Player', 'Enemy', the screens, the BSP, ...)
+and checks them against the budgets in a config file (see 'tools/budget.ini'), failing if any budget (or the size of the device) is exceeded
+Used to find out exactly what a framebuffer or lookup table costs before flashing a unit
+
+Sizes come from the symbols in the linked ELF:
+    flash   - .text + .rodata + .data (the initial values of '.data' are stored in flash and copied to RAM at startup)
+    RAM     - .data + .bss
+
+Stack depths come from the '.ci' files written by GCC's '-fcallgraph-info=su' (one per translation unit), which hold every function's own
+stack usage (as '-fstack-usage' gives) and the calls it makes
+The worst case of a function is its own usage plus the worst case of anything it calls, and a subsystem's worst case is that of its deepest function
+Functions are named by demangling their symbols, so they match the names read from the ELF (and complete object constructors that are aliases of
+base object ones get their stack usage)
+Virtual calls can't be followed by the compiler, so the functions they may call are given in the config's '[indirect_calls]' section
+Functions with no stack usage (e.g. from libraries built without '-fcallgraph-info') use the sizes in '[stack_assumptions]', or 0 (and are listed)
+Recursion and dynamically sized stack frames make a worst case unbounded, which always fails
+
+Usage:
+    budget_report.py --elf FILE --ci FILE [FILE ...] [--config FILE] [--nm TOOL] [--cxxfilt TOOL] [--details N]
+
+    --nm        - nm to read the ELF with (e.g. 'arm-none-eabi-nm' for the target, the default is 'nm')
+    --cxxfilt   - c++filt to demangle the call graph with (the default is 'c++filt')
+    --details   - Also list the N biggest symbols and deepest functions of each subsystem
+
+Build the game with:
+    -fstack-usage -fcallgraph-info=su
+The native build does this and runs the report with its 'budget_report' target (see 'CMakeLists.txt')
+"""
+
+import argparse
+import configparser
+import glob
+import os
+import re
+import subprocess
+import sys
+
+# nm symbol types for each section, lower case types are the same but local
+SECTION_TYPES = {
+    "t": "text", "w": "text",
+    "r": "rodata",
+    "d": "data", "g": "data", "v": "data",
+    "b": "bss", "s": "bss",
+}
+
+SECTIONS = ["text", "rodata", "data", "bss"]
+
+# Name of the node the compiler calls through for every call it can't follow
+INDIRECT_CALL = "__indirect_call"
+
+# Stands for a worst case that can't be bounded
+UNBOUNDED = -1
+
+OTHER_SUBSYSTEM = "Other"
+
+# Symbols the compiler makes for a class, named after the class
+CLASS_SYMBOL_PREFIXES = ["vtable for ", "typeinfo for ", "typeinfo name for ", "VTT for ", "construction vtable for "]
+
+
+class Subsystems:
+    """
+    Sorts symbols into subsystems using the ordered '[subsystems]' patterns from the config (the first pattern a name matches wins)
+    Patterns are matched against the qualified name only (e.g. 'Maze::Update' for 'Maze::Update()'), so a type in the arguments doesn't count
+    """
+
+    def __init__(self, config):
+        self.names = []
+        self._patterns = []
+
+        for name, pattern in config.items("subsystems"):
+            self.names.append(name)
+            self._patterns.append(re.compile(pattern))
+
+        self.names.append(OTHER_SUBSYSTEM)
+
+    @staticmethod
+    def GetQualifiedName(symbol):
+        for prefix in CLASS_SYMBOL_PREFIXES:
+            if symbol.startswith(prefix):
+                return symbol[len(prefix):] + "::"
+
+        return symbol.split("(", 1)[0]
+
+    def Find(self, symbol):
+        qualifiedName = self.GetQualifiedName(symbol)
+
+        for name, pattern in zip(self.names, self._patterns):
+            if pattern.search(qualifiedName):
+                return name
+
+        return OTHER_SUBSYSTEM
+
+
+class Function:
+    """
+    Stores one function from the call graph
+    """
+
+    def __init__(self, title, name):
+        self.title = title
+        self.name = name
+        self.stack = None # Own stack usage in bytes, None if unknown
+        self.dynamic = False # True if the frame size depends on the call (and isn't bounded)
+        self.calls = set() # Titles of the functions called
+        self.indirect = False # True if it makes calls the compiler couldn't follow
+        self.worst = None # Worst case depth of anything starting here, worked out by 'CallGraph'
+        self.worstPath = []
+
+
+class CallGraph:
+    """
+    Call graph read from '.ci' files, with the worst case stack depth of every function
+    """
+
+    _NODE = re.compile(r'^node: \{ title: "([^"]*)" label: "([^"]*)"')
+    _EDGE = re.compile(r'^edge: \{ sourcename: "([^"]*)" targetname: "([^"]*)"')
+    _STACK = re.compile(r"^(\d+) bytes \(([^)]*)\)$")
+
+    def __init__(self):
+        self.functions = {}
+        self.unknown = set() # Titles of called functions with no stack usage
+        self.unresolved = set() # Titles of functions making indirect calls not covered by the config
+
+    def _GetFunction(self, title):
+        function = self.functions.get(title)
+
+        if function is None:
+            function = Function(title, title)
+            self.functions[title] = function
+
+        return function
+
+    def Read(self, path):
+        with open(path) as file:
+            for line in file:
+                node = self._NODE.match(line)
+
+                if node:
+                    # The label is a name, then where it is defined, then its stack usage
+                    # The names aren't always usable (e.g. for clones of functions), so 'Demangle' names every function from its symbol instead
+                    label = node.group(2).split("\\n")
+                    function = self._GetFunction(node.group(1))
+
+                    for part in label[1:]:
+                        stack = self._STACK.match(part)
+
+                        if stack:
+                            function.stack = int(stack.group(1))
+                            function.dynamic = "dynamic" in stack.group(2) and "bounded" not in stack.group(2)
+
+                    continue
+
+                edge = self._EDGE.match(line)
+
+                if edge:
+                    source = self._GetFunction(edge.group(1))
+
+                    if edge.group(2) == INDIRECT_CALL:
+                        source.indirect = True
+                    else:
+                        source.calls.add(edge.group(2))
+                        self._GetFunction(edge.group(2))
+
+        self.functions.pop(INDIRECT_CALL, None)
+
+    def Demangle(self, cxxfilt):
+        """
+        Names every function by demangling its symbol
+        Local symbols are prefixed with the file they are in, which is dropped
+        """
+        titles = list(self.functions)
+        symbols = "\n".join(title.rsplit(":", 1)[-1] for title in titles)
+        output = subprocess.run([cxxfilt], input=symbols, check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+        for title, name in zip(titles, output.splitlines()):
+            self.functions[title].name = name
+
+    def ResolveIndirectCalls(self, config):
+        """
+        Adds the calls given in '[indirect_calls]' ('caller pattern = callee pattern') to every function that makes indirect calls
+        """
+        rules = [(re.compile(caller), re.compile(callee)) for caller, callee in config.items("indirect_calls")]
+
+        for function in self.functions.values():
+            if not function.indirect:
+                continue
+
+            resolved = False
+
+            for caller, callee in rules:
+                if caller.search(function.name):
+                    resolved = True
+
+                    for other in self.functions.values():
+                        if other is not function and callee.search(other.name):
+                            function.calls.add(other.title)
+
+            if not resolved:
+                self.unresolved.add(function.title)
+
+    def Solve(self, assumptions):
+        """
+        Works out the worst case stack depth of every function
+        Functions that can recurse or have unbounded frames get 'UNBOUNDED'
+        """
+        known = dict((function.name, function) for function in self.functions.values() if function.stack is not None)
+
+        for function in self.functions.values():
+            if function.stack is None:
+                if function.name in known:
+                    # Another symbol for the same function (e.g. a constructor alias), so it costs what that one does
+                    function.stack = 0
+                    function.calls.add(known[function.name].title)
+                elif function.name in assumptions:
+                    function.stack = assumptions[function.name]
+                else:
+                    function.stack = 0
+                    self.unknown.add(function.title)
+
+        for title in self.functions:
+            self._Visit(title, set())
+
+    def _Visit(self, title, visiting):
+        function = self.functions[title]
+
+        if function.worst is not None:
+            return function.worst
+
+        if title in visiting:
+            # Recursion, so the depth depends on the data
+            return UNBOUNDED
+
+        visiting.add(title)
+
+        worst = 0
+        worstPath = []
+        unbounded = function.dynamic
+
+        for call in function.calls:
+            depth = self._Visit(call, visiting)
+
+            if depth == UNBOUNDED:
+                unbounded = True
+                worstPath = [call]
+            elif not unbounded and depth > worst:
+                worst = depth
+                worstPath = self.functions[call].worstPath
+
+        visiting.discard(title)
+
+        function.worst = UNBOUNDED if unbounded else function.stack + worst
+        function.worstPath = [title] + worstPath
+        return function.worst
+
+
+def ReadSymbols(nm, elf):
+    """
+    Returns (demangled name, section, size) for every symbol with a size in 'elf'
+    """
+    output = subprocess.run([nm, "--print-size", "--demangle", "--defined-only", elf], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    symbols = []
+
+    for line in output.splitlines():
+        parts = line.split(None, 3)
+
+        # Symbols without a size (labels, section markers) only have an address, type and name
+        if len(parts) < 4:
+            continue
+
+        section = SECTION_TYPES.get(parts[2].lower())
+
+        if section is not None:
+            symbols.append((parts[3], section, int(parts[1], 16)))
+
+    return symbols
+
+
+def FormatBytes(count):
+    if count == UNBOUNDED:
+        return "unbounded"
+
+    return "%d" % count
+
+
+def ParseSize(value):
+    """
+    Reads a size from the config, allowing a 'K' or 'M' suffix
+    """
+    value = value.strip().upper()
+    scale = 1
+
+    if value.endswith("K"):
+        scale = 1024
+        value = value[:-1]
+    elif value.endswith("M"):
+        scale = 1024 * 1024
+        value = value[:-1]
+
+    return int(value, 0) * scale
+
+
+def CheckBudget(failures, what, used, budget):
+    if budget is None:
+        return ""
+
+    if used == UNBOUNDED or used > budget:
+        failures.append("%s uses %s bytes, over its budget of %d" % (what, FormatBytes(used), budget))
+        return " !"
+
+    return ""
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Breaks down flash, RAM and worst case stack by subsystem and checks them against budgets")
+    parser.add_argument("--elf", required=True)
+    parser.add_argument("--ci", nargs="+", required=True, help="'.ci' files (or directories containing them) written by '-fcallgraph-info=su'")
+    parser.add_argument("--config", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "budget.ini"))
+    parser.add_argument("--nm", default="nm")
+    parser.add_argument("--cxxfilt", default="c++filt")
+    parser.add_argument("--details", type=int, default=0)
+    arguments = parser.parse_args()
+
+    # Only "=" separates keys from values, as the "[indirect_calls]" patterns have "::" in them
+    config = configparser.ConfigParser(interpolation=None, delimiters=("=",))
+    config.optionxform = str # Keep the case of subsystem and function names
+    config.read(arguments.config)
+
+    subsystems = Subsystems(config)
+
+    # Sizes of each section by subsystem
+    sizes = dict((name, dict((section, 0) for section in SECTIONS)) for name in subsystems.names)
+    bySubsystem = dict((name, []) for name in subsystems.names)
+
+    for name, section, size in ReadSymbols(arguments.nm, arguments.elf):
+        subsystem = subsystems.Find(name)
+        sizes[subsystem][section] += size
+        bySubsystem[subsystem].append((size, section, name))
+
+    # Worst case stack of each subsystem
+    graph = CallGraph()
+
+    for path in arguments.ci:
+        paths = glob.glob(os.path.join(path, "**", "*.ci"), recursive=True) if os.path.isdir(path) else [path]
+
+        for ciPath in paths:
+            graph.Read(ciPath)
+
+    graph.Demangle(arguments.cxxfilt)
+
+    assumptions = dict((name, ParseSize(value)) for name, value in config.items("stack_assumptions")) if config.has_section("stack_assumptions") else {}
+
+    if config.has_section("indirect_calls"):
+        graph.ResolveIndirectCalls(config)
+
+    graph.Solve(assumptions)
+
+    deepest = dict((name, None) for name in subsystems.names)
+
+    for function in graph.functions.values():
+        subsystem = subsystems.Find(function.name)
+        current = deepest[subsystem]
+
+        if current is None or current.worst != UNBOUNDED and (function.worst == UNBOUNDED or function.worst > current.worst):
+            deepest[subsystem] = function
+
+    # Print the report, checking every budget as it goes
+    failures = []
+    totals = dict((section, 0) for section in SECTIONS)
+
+    print("%-12s %9s %9s %9s %9s %10s %10s %11s  %s" % ("Subsystem", ".text", ".rodata", ".data", ".bss", "Flash", "RAM", "Stack", "Deepest function"))
+
+    for name in subsystems.names:
+        size = sizes[name]
+        flash = size["text"] + size["rodata"] + size["data"]
+        ram = size["data"] + size["bss"]
+        function = deepest[name]
+        stack = function.worst if function is not None else 0
+
+        for section in SECTIONS:
+            totals[section] += size[section]
+
+        budgets = config[name] if config.has_section(name) else {}
+        flashMark = CheckBudget(failures, "%s flash" % name, flash, ParseSize(budgets["flash"]) if "flash" in budgets else None)
+        ramMark = CheckBudget(failures, "%s RAM" % name, ram, ParseSize(budgets["ram"]) if "ram" in budgets else None)
+        stackMark = CheckBudget(failures, "%s stack" % name, stack, ParseSize(budgets["stack"]) if "stack" in budgets else None)
+
+        print("%-12s %9d %9d %9d %9d %10s %10s %11s  %s" % (name, size["text"], size["rodata"], size["data"], size["bss"],
+            "%d%s" % (flash, flashMark), "%d%s" % (ram, ramMark), FormatBytes(stack) + stackMark, function.name if function is not None else "-"))
+
+        if arguments.details > 0:
+            for symbolSize, section, symbol in sorted(bySubsystem[name], reverse=True)[:arguments.details]:
+                print("%14s %-7s %8d  %s" % ("", section, symbolSize, symbol))
+
+            functions = sorted((other for other in graph.functions.values() if subsystems.Find(other.name) == name),
+                key=lambda other: (other.worst != UNBOUNDED, -other.worst))
+
+            for other in functions[:arguments.details]:
+                print("%14s %-7s %8s  %s" % ("", "stack", FormatBytes(other.worst), " -> ".join(graph.functions[title].name for title in other.worstPath)))
+
+    flash = totals["text"] + totals["rodata"] + totals["data"]
+    ram = totals["data"] + totals["bss"]
+
+    print("%-12s %9d %9d %9d %9d %10d %10d" % ("Total", totals["text"], totals["rodata"], totals["data"], totals["bss"], flash, ram))
+
+    # The device's own limits, with the main stack counted against RAM as it is carved out of it
+    device = config["device"] if config.has_section("device") else {}
+    entry = graph.functions.get(device.get("entry", "main"))
+    mainStack = entry.worst if entry is not None else 0
+
+    if "flash" in device:
+        CheckBudget(failures, "The build's flash", flash, ParseSize(device["flash"]))
+
+    if "stack" in device:
+        CheckBudget(failures, "The main stack (from '%s')" % device.get("entry", "main"), mainStack, ParseSize(device["stack"]))
+
+    if "ram" in device:
+        CheckBudget(failures, "The build's RAM (with the main stack)", ram + max(mainStack, 0), ParseSize(device["ram"]))
+
+    print("\nMain stack: %s bytes" % FormatBytes(mainStack))
+
+    if entry is not None and len(entry.worstPath) > 1:
+        print("    " + " -> ".join(graph.functions[title].name for title in entry.worstPath))
+
+    if graph.unknown:
+        print("\nStack usage unknown (counted as 0): %s" % ", ".join(sorted(graph.functions[title].name for title in graph.unknown)))
+
+    if graph.unresolved:
+        print("\nIndirect calls not covered by '[indirect_calls]': %s" % ", ".join(sorted(graph.functions[title].name for title in graph.unresolved)))
+
+    if failures:
+        print("\nFAILED:")
+
+        for failure in failures:
+            print("    " + failure)
+
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,475 @@
+/*
+Golden frame regression test
+
+Plays a touch script (see 'Shim_LoadTouchScript') through the complete game against the BSP shim, frame by frame the same way as
+'GameEngine::MainGameLoop', and hashes the LCD's surface after every frame ('Shim_HashFramebuffer')
+The hashes are compared against a golden file written by an earlier run with '--update', so any change to what ends up on the screen
+(a sprite leaving a trail, a tile not being redrawn, ...) fails on the first frame it shows up in
+
+On the first frame that doesn't match, a PNG is written to the '--diff-dir' directory with three panels:
+    The last frame that matched | The frame that didn't | The pixels that changed between the two in red
+NOTE: Only hashes are stored, so the expected frame itself can't be shown. The last frame that matched is the closest known good
+one, and the third panel shows everything that was drawn on the frame that went wrong
+
+Golden files have one hash a line in hex, with 'xN' after it when the same frame is repeated N times, and '#' starting a comment
+
+Refactoring the renderer shouldn't change a single pixel, so the golden files should only be updated (and the changes to them
+reviewed) when what is drawn is meant to change
+
+Usage:
+    golden_frames --script FILE --golden FILE [--update] [--frames N] [--diff-dir DIR]
+
+Build with CMake (where each session in 'tests/golden' is run by ctest), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -Ishim/include tools/golden_frames.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o golden_frames
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../main.cpp"
+
+#include "shim.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Frames run by '--update' when there is no golden file to take the number from
+#define DEFAULT_FRAMES 6000
+
+// Panels in the diff image ('previous | current | changed')
+#define DIFF_PANELS 3
+
+// Most bytes in one stored (uncompressed) deflate block
+#define DEFLATE_MAX_STORED 65535
+
+/* PNG */
+//////////////////////////////////////////////////////////////
+
+static uint32_t g_crcTable[256];
+
+static void BuildCrcTable()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+
+        g_crcTable[i] = crc;
+    }
+}
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    // Built the first time a CRC is needed
+    if (g_crcTable[1] == 0)
+    {
+        BuildCrcTable();
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = g_crcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static void AppendBigEndian(std::vector<uint8_t>* bytes, uint32_t value)
+{
+    bytes->push_back((uint8_t)(value >> 24));
+    bytes->push_back((uint8_t)(value >> 16));
+    bytes->push_back((uint8_t)(value >> 8));
+    bytes->push_back((uint8_t)value);
+}
+
+static void WriteChunk(FILE* file, const char* type, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> chunk;
+    AppendBigEndian(&chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    // The CRC covers the type and the data, but not the length
+    uint32_t crc = UpdateCrc(0xFFFFFFFFu, &chunk[4], chunk.size() - 4) ^ 0xFFFFFFFFu;
+    AppendBigEndian(&chunk, crc);
+
+    fwrite(&chunk[0], 1, chunk.size(), file);
+}
+
+// Writes an 8 bit RGB image to 'path' as a PNG, returning false if it couldn't be written
+// The image data is stored without compressing it, which keeps this short and is fine for the odd diff image
+static bool WritePng(const char* path, const std::vector<uint8_t>& rgb, int width, int height)
+{
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(SIGNATURE, 1, sizeof(SIGNATURE), file);
+
+    std::vector<uint8_t> header;
+    AppendBigEndian(&header, width);
+    AppendBigEndian(&header, height);
+    header.push_back(8); // Bits per channel
+    header.push_back(2); // RGB
+    header.push_back(0); // Deflate
+    header.push_back(0); // Adaptive filtering
+    header.push_back(0); // Not interlaced
+    WriteChunk(file, "IHDR", header);
+
+    // Every row starts with its filter type (0, none)
+    std::vector<uint8_t> raw;
+
+    for (int y = 0; y < height; y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + (y * width * 3), rgb.begin() + ((y + 1) * width * 3));
+    }
+
+    // A zlib stream of stored deflate blocks
+    std::vector<uint8_t> data;
+    data.push_back(0x78);
+    data.push_back(0x01);
+
+    for (size_t offset = 0; offset < raw.size(); offset += DEFLATE_MAX_STORED)
+    {
+        size_t length = raw.size() - offset < DEFLATE_MAX_STORED ? raw.size() - offset : DEFLATE_MAX_STORED;
+
+        data.push_back(offset + length == raw.size() ? 1 : 0); // Last block flag
+        data.push_back((uint8_t)length);
+        data.push_back((uint8_t)(length >> 8));
+        data.push_back((uint8_t)~length);
+        data.push_back((uint8_t)(~length >> 8));
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        adlerA = (adlerA + raw[i]) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+
+    AppendBigEndian(&data, (adlerB << 16) | adlerA);
+    WriteChunk(file, "IDAT", data);
+
+    WriteChunk(file, "IEND", std::vector<uint8_t>());
+
+    return fclose(file) == 0;
+}
+
+// Spreads an RGB565 pixel over 8 bit channels (the same way as 'Shim_WriteFramebufferPPM')
+static void ToRgb(uint16_t pixel, uint8_t* rgb)
+{
+    rgb[0] = (uint8_t)(((pixel >> 11) << 3) | (pixel >> 13));
+    rgb[1] = (uint8_t)((((pixel >> 5) & 0x3F) << 2) | ((pixel >> 9) & 0x3));
+    rgb[2] = (uint8_t)(((pixel & 0x1F) << 3) | ((pixel >> 2) & 0x7));
+}
+
+// Writes the 'previous | current | changed' diff image, returning the number of pixels that changed (or -1 if it couldn't be written)
+static int WriteDiff(const char* path, const uint16_t* previous, const uint16_t* current)
+{
+    int width = SHIM_LCD_WIDTH * DIFF_PANELS;
+    std::vector<uint8_t> rgb(width * SHIM_LCD_HEIGHT * 3);
+    int changed = 0;
+
+    for (int y = 0; y < SHIM_LCD_HEIGHT; y++)
+    {
+        for (int x = 0; x < SHIM_LCD_WIDTH; x++)
+        {
+            int pixel = (y * SHIM_LCD_WIDTH) + x;
+            uint8_t* row = &rgb[y * width * 3];
+
+            ToRgb(previous[pixel], row + (x * 3));
+            ToRgb(current[pixel], row + ((SHIM_LCD_WIDTH + x) * 3));
+
+            // Changed pixels in red over a dimmed copy of the frame
+            uint8_t* diff = row + (((SHIM_LCD_WIDTH * 2) + x) * 3);
+
+            if (previous[pixel] != current[pixel])
+            {
+                diff[0] = 255;
+                diff[1] = 0;
+                diff[2] = 0;
+                changed++;
+            }
+            else
+            {
+                ToRgb(current[pixel], diff);
+                diff[0] /= 4;
+                diff[1] /= 4;
+                diff[2] /= 4;
+            }
+        }
+    }
+
+    return WritePng(path, rgb, width, SHIM_LCD_HEIGHT) ? changed : -1;
+}
+
+/* GOLDEN FILES */
+//////////////////////////////////////////////////////////////
+
+// Reads a golden file into one hash a frame, returning false if it couldn't be read
+static bool ReadGolden(const std::string& path, std::vector<uint64_t>* hashes)
+{
+    FILE* file = fopen(path.c_str(), "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    char line[128];
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+        {
+            continue;
+        }
+
+        char* end;
+        uint64_t hash = strtoull(line, &end, 16);
+        long repeats = 1;
+
+        while (*end == ' ')
+        {
+            end++;
+        }
+
+        if (*end == 'x')
+        {
+            repeats = strtol(end + 1, NULL, 10);
+        }
+
+        hashes->insert(hashes->end(), repeats, hash);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool WriteGolden(const std::string& path, const std::string& scriptPath, const std::vector<uint64_t>& hashes)
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(file, "# Hash of the LCD after each frame of '%s' (written by 'golden_frames --update')\n", scriptPath.c_str());
+    fprintf(file, "# %d frames\n", (int)hashes.size());
+
+    for (size_t i = 0; i < hashes.size();)
+    {
+        size_t repeats = 1;
+
+        while (i + repeats < hashes.size() && hashes[i + repeats] == hashes[i])
+        {
+            repeats++;
+        }
+
+        if (repeats > 1)
+        {
+            fprintf(file, "%016llx x%d\n", (unsigned long long)hashes[i], (int)repeats);
+        }
+        else
+        {
+            fprintf(file, "%016llx\n", (unsigned long long)hashes[i]);
+        }
+
+        i += repeats;
+    }
+
+    return fclose(file) == 0;
+}
+
+// Returns the name of the file at 'path' without its directory or extension
+static std::string GetSessionName(const std::string& path)
+{
+    size_t start = path.find_last_of("/\\");
+    start = start == std::string::npos ? 0 : start + 1;
+
+    size_t end = path.find_last_of('.');
+    end = end == std::string::npos || end < start ? path.size() : end;
+
+    return path.substr(start, end - start);
+}
+
+static void PrintUsage()
+{
+    printf("Usage: golden_frames --script FILE --golden FILE [--update] [--frames N] [--diff-dir DIR]\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string scriptPath;
+    std::string goldenPath;
+    std::string diffDir = ".";
+    bool update = false;
+    int frames = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--update")
+        {
+            update = true;
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--script")
+        {
+            scriptPath = value;
+        }
+        else if (arg == "--golden")
+        {
+            goldenPath = value;
+        }
+        else if (arg == "--frames")
+        {
+            frames = atoi(value);
+        }
+        else if (arg == "--diff-dir")
+        {
+            diffDir = value;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (scriptPath.empty() || goldenPath.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<uint64_t> golden;
+    bool haveGolden = ReadGolden(goldenPath, &golden);
+
+    if (!update && !haveGolden)
+    {
+        printf("Couldn't read %s (write it with --update)\n", goldenPath.c_str());
+        return 1;
+    }
+
+    // Without '--frames', the same number of frames as the golden file
+    if (frames <= 0)
+    {
+        frames = haveGolden && !golden.empty() ? (int)golden.size() : DEFAULT_FRAMES;
+    }
+
+    // Set up the same way as 'main()'
+    PacmanGame game;
+    GameEngine* engine = game.GetEngine();
+
+    GameContext* context = engine->GetContext();
+    context->logEnabled = false;
+
+    Shim_Reset();
+    LCDInit();
+
+    // Replaces any script from 'SHIM_TOUCH_SCRIPT'
+    if (Shim_LoadTouchScript(scriptPath.c_str()) < 0)
+    {
+        printf("Couldn't read %s\n", scriptPath.c_str());
+        return 1;
+    }
+
+    engine->Init();
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(frames);
+
+    // The frame before the current one, for the diff image
+    static uint16_t previous[SHIM_LCD_WIDTH * SHIM_LCD_HEIGHT];
+    memcpy(previous, Shim_GetFramebuffer(), sizeof(previous));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        // The same as 'GameEngine::MainGameLoop'
+        BSP_TS_GetState(&context->tsState);
+        engine->RunFrame();
+
+        uint64_t hash = Shim_HashFramebuffer();
+        hashes.push_back(hash);
+
+        if (!update && (frame >= (int)golden.size() || hash != golden[frame]))
+        {
+            printf("FAILED: frame %d (%.2f s) of %s hashed %016llx", frame, Shim_GetTimeUs() / 1000000.0, scriptPath.c_str(), (unsigned long long)hash);
+
+            if (frame < (int)golden.size())
+            {
+                printf(", expected %016llx\n", (unsigned long long)golden[frame]);
+            }
+            else
+            {
+                printf(", past the end of %s\n", goldenPath.c_str());
+            }
+
+            char diffPath[512];
+            snprintf(diffPath, sizeof(diffPath), "%s/%s_frame%d.png", diffDir.c_str(), GetSessionName(goldenPath).c_str(), frame);
+
+            int changed = WriteDiff(diffPath, previous, Shim_GetFramebuffer());
+
+            if (changed < 0)
+            {
+                printf("Couldn't write %s\n", diffPath);
+            }
+            else
+            {
+                printf("Wrote %s (last matching frame | this frame | %d pixels changed between them)\n", diffPath, changed);
+            }
+
+            return 1;
+        }
+
+        memcpy(previous, Shim_GetFramebuffer(), sizeof(previous));
+
+        wait_ms(10);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (update)
+    {
+        if (!WriteGolden(goldenPath, scriptPath, hashes))
+        {
+            printf("Couldn't write %s\n", goldenPath.c_str());
+            return 1;
+        }
+
+        printf("Wrote %d frames to %s\n", frames, goldenPath.c_str());
+        return 0;
+    }
+
+    printf("%d frames of %s match (%.0f frames a second)\n", frames, scriptPath.c_str(), frames / seconds);
+    return 0;
+}
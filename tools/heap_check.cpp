@@ -0,0 +1,138 @@
+/*
+Heap allocation check
+
+Runs the complete game (the same objects as 'main()', drawing included) through 'GameEngine::RunFrame' with random touches,
+and counts every heap allocation made after initialisation with 'HeapGuard'
+Fails if anything was allocated, listing how many allocations each frame made and where they were called from
+
+Frames are counted by game state, so a run that never got to PLAY (or barely played) is easy to spot
+
+Usage:
+    heap_check [--frames N] [--seed N]
+
+Build with CMake (see 'CMakeLists.txt'), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -rdynamic -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -Ishim/include tools/heap_check.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o heap_check
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#define PACMAN_HEAP_TRACE
+#define PACMAN_HEAP_WRAP_MALLOC
+#include "../main.cpp"
+
+#include <cstdlib>
+#include <string>
+
+// Number of game states a frame can be counted in ('SPLASH_SCREEN' to 'GAME_OVER')
+#define GAME_STATES 8
+
+// A new touch (or none) is picked every this many frames
+#define TOUCH_HOLD_FRAMES 17
+
+static const char* STATE_NAMES[GAME_STATES] = { "SPLASH_SCREEN", "MAIN_MENU", "STARTUP", "PLAY", "CONTINUE", "NEXT_LEVEL", "DEAD", "GAME_OVER" };
+
+// Picks the touch held for the next few frames, with no touch a third of the time
+static void NextTouch(uint32_t* random, TS_StateTypeDef* state)
+{
+    *random = (*random * 1103515245u) + 12345u;
+
+    state->touchDetected = ((*random >> 16) % 3) != 0;
+    state->touchX[0] = (*random >> 8) % SCREEN_WIDTH;
+    state->touchY[0] = (*random >> 20) % SCREEN_HEIGHT;
+}
+
+static void PrintUsage()
+{
+    printf("Usage: heap_check [--frames N] [--seed N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    int frames = 100000;
+    uint32_t seed = 12345;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--frames")
+        {
+            frames = atoi(value);
+        }
+        else if (arg == "--seed")
+        {
+            seed = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    // Set up the same way as 'main()'
+    PacmanGame game;
+    GameEngine* engine = game.GetEngine();
+
+    GameContext* context = engine->GetContext();
+    context->logEnabled = false;
+
+    LCDInit();
+    engine->Init();
+
+    int stateFrames[GAME_STATES] = { 0 };
+    long stateAllocations[GAME_STATES] = { 0 };
+    uint32_t random = seed;
+
+    HeapGuard::Lock();
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        if (frame % TOUCH_HOLD_FRAMES == 0)
+        {
+            NextTouch(&random, &context->tsState);
+        }
+
+        // Counted against the state the frame was run in
+        int state = context->curGameState;
+
+        engine->RunFrame();
+
+        if (state >= 0 && state < GAME_STATES)
+        {
+            stateFrames[state]++;
+            stateAllocations[state] += HeapGuard::GetFrameAllocations();
+        }
+    }
+
+    HeapGuard::Unlock();
+
+    printf("%d frames\n", frames);
+
+    for (int i = 0; i < GAME_STATES; i++)
+    {
+        if (stateFrames[i] > 0)
+        {
+            printf("    %-14s %8d frames  %6ld allocations\n", STATE_NAMES[i], stateFrames[i], stateAllocations[i]);
+        }
+    }
+
+    if (HeapGuard::GetTotalAllocations() > 0)
+    {
+        printf("FAILED: %ld heap allocations after initialisation\n", HeapGuard::GetTotalAllocations());
+        HeapGuard::PrintCallSites();
+        return 1;
+    }
+
+    printf("No heap allocations after initialisation\n");
+    return 0;
+}
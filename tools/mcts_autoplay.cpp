@@ -0,0 +1,275 @@
+/*
+Monte Carlo tree search autoplayer
+
+Plays complete headless games with 'MctsPlayer' steering the player in place of the touchscreen, and prints how far it got
+and how fast the searches ran. Playouts per second is the number to watch when changing the simulation, as every playout
+is a few hundred ticks of the headless game
+
+It is also used as a soak test: the searches get to levels that no one gets to by hand, and at every junction the state's
+Zobrist hash is checked against one worked out from scratch (the run fails if they ever differ)
+
+Searches use root parallelism: at each junction every thread searches the same state with its own 'MctsPlayer' (and seed),
+then the visits of each direction from the root are added up and the most visited direction is taken
+
+Usage:
+    mcts_autoplay [--games N] [--threads N] [--playouts N] [--ms N] [--horizon N] [--seed N] [--max-ticks N] [--target-level N]
+
+    --playouts      - Playouts each thread runs per junction
+    --ms            - Time limit for each search in milliseconds (0 for no limit), searches stop at whichever limit comes first
+    --target-level  - Stop a game once it reaches this level (0 to play until the game is over)
+
+Build with CMake (see 'CMakeLists.txt'), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -pthread -Ishim/include tools/mcts_autoplay.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o mcts_autoplay
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../main.cpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// Settings for a run of games
+struct AutoplaySettings
+{
+    int games;
+    int threads;
+    int playouts;
+    int milliseconds;
+    int horizon;
+    uint32_t seed;
+    int maxTicks;
+    int targetLevel;
+};
+
+// Stores how one game went
+struct AutoplayResult
+{
+    int score;
+    int level;
+    int ticks;
+    int decisions; // Number of junctions searched
+    long long playouts; // Total over every thread
+    double searchSeconds; // Time spent searching
+    int hashMismatches; // Junctions where the incremental hash didn't match one worked out from scratch
+};
+
+/* SEARCH */
+//////////////////////////////////////////////////////////////
+
+// Runs one search (on its own thread)
+static void RunSearch(MctsPlayer* player, const GameState* root, const AutoplaySettings* settings, MctsResult* result)
+{
+    player->Search(root, settings->playouts, settings->milliseconds, result);
+}
+
+// Searches 'root' with every player at once and returns the action the combined results pick
+static int SearchInParallel(std::vector<MctsPlayer*>& players, const GameState* root, const AutoplaySettings* settings, long long* playouts)
+{
+    std::vector<MctsResult> results(players.size());
+    std::vector<std::thread> workers;
+
+    // The calling thread runs the first search itself
+    for (size_t i = 1; i < players.size(); i++)
+    {
+        workers.push_back(std::thread(RunSearch, players[i], root, settings, &results[i]));
+    }
+
+    RunSearch(players[0], root, settings, &results[0]);
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        *playouts += results[i].playouts;
+    }
+
+    return MctsPlayer::GetBestAction(&results[0], (int)results.size());
+}
+
+// Plays one complete game (or until the target level) and stores how it went in 'result'
+static void PlayGame(PacmanEnv* env, std::vector<MctsPlayer*>& players, const AutoplaySettings* settings, AutoplayResult* result)
+{
+    memset(result, 0, sizeof(AutoplayResult));
+
+    env->Reset(NULL);
+
+    for (int tick = 0; tick < settings->maxTicks; tick++)
+    {
+        int action;
+
+        if (MctsPlayer::IsAtJunction(env))
+        {
+            GameState root;
+            env->Snapshot(&root);
+
+            if (ZobristHash::ComputeHash(&root) != env->GetHash())
+            {
+                result->hashMismatches++;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            action = SearchInParallel(players, &root, settings, &result->playouts);
+            result->searchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result->decisions++;
+        }
+        else
+        {
+            action = MctsPlayer::GetFollowAction(env);
+        }
+
+        float reward;
+        uint8_t done;
+
+        env->Step(action, NULL, &reward, &done);
+        result->ticks = tick + 1;
+
+        if (done || (settings->targetLevel > 0 && env->GetLevel() >= settings->targetLevel))
+        {
+            break;
+        }
+    }
+
+    result->score = env->GetScore();
+    result->level = env->GetLevel();
+}
+
+/* MAIN */
+//////////////////////////////////////////////////////////////
+
+static void PrintUsage()
+{
+    printf("Usage: mcts_autoplay [--games N] [--threads N] [--playouts N] [--ms N] [--horizon N] [--seed N] [--max-ticks N] [--target-level N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    AutoplaySettings settings;
+    settings.games = 1;
+    settings.threads = (int)std::thread::hardware_concurrency();
+    settings.playouts = 256;
+    settings.milliseconds = 0;
+    settings.horizon = MCTS_HORIZON_TICKS;
+    settings.seed = 1;
+    settings.maxTicks = 100000;
+    settings.targetLevel = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--games")
+        {
+            settings.games = atoi(value);
+        }
+        else if (arg == "--threads")
+        {
+            settings.threads = atoi(value);
+        }
+        else if (arg == "--playouts")
+        {
+            settings.playouts = atoi(value);
+        }
+        else if (arg == "--ms")
+        {
+            settings.milliseconds = atoi(value);
+        }
+        else if (arg == "--horizon")
+        {
+            settings.horizon = atoi(value);
+        }
+        else if (arg == "--seed")
+        {
+            settings.seed = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else if (arg == "--max-ticks")
+        {
+            settings.maxTicks = atoi(value);
+        }
+        else if (arg == "--target-level")
+        {
+            settings.targetLevel = atoi(value);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    settings.threads = std::max(1, settings.threads);
+
+    // Each search is about 1 MB, so they live on the heap
+    std::vector<MctsPlayer*> players;
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        players.push_back(new MctsPlayer(settings.seed + ((uint32_t)i * 0x9E3779B9u)));
+        players[i]->SetHorizon(settings.horizon);
+    }
+
+    PacmanEnv* env = new PacmanEnv();
+    env->SetAutoReset(false);
+
+    long long totalPlayouts = 0;
+    long long totalTicks = 0;
+    int totalDecisions = 0;
+    int totalMismatches = 0;
+    double searchSeconds = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int game = 0; game < settings.games; game++)
+    {
+        AutoplayResult result;
+        PlayGame(env, players, &settings, &result);
+
+        printf("game %d: score %d  level %d  ticks %d  junctions %d  playouts %lld  (%.0f playouts/s)\n",
+            game, result.score, result.level, result.ticks, result.decisions, result.playouts,
+            result.searchSeconds > 0 ? result.playouts / result.searchSeconds : 0.0);
+
+        totalPlayouts += result.playouts;
+        totalTicks += result.ticks;
+        totalDecisions += result.decisions;
+        totalMismatches += result.hashMismatches;
+        searchSeconds += result.searchSeconds;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%d games on %d threads in %.2f s\n", settings.games, settings.threads, seconds);
+    printf("playouts/s %.0f  (%lld playouts, %.2f ms per junction, %.0f game ticks/s)\n",
+        searchSeconds > 0 ? totalPlayouts / searchSeconds : 0.0, totalPlayouts,
+        totalDecisions > 0 ? (searchSeconds * 1000.0) / totalDecisions : 0.0, totalTicks / seconds);
+
+    for (int i = 0; i < settings.threads; i++)
+    {
+        delete players[i];
+    }
+
+    delete env;
+
+    if (totalMismatches > 0)
+    {
+        printf("FAILED: the Zobrist hash didn't match the state at %d junctions\n", totalMismatches);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,373 @@
+/*
+Input replay player
+
+Plays back a recording made by 'InputRecorder' (see 'main.cpp'), e.g. one cut out of a kiosk's serial log, and prints how the game ended
+The game is set up the same way as 'main()' and run a frame at a time the same way as 'GameEngine::MainGameLoop', so a recording
+from the board plays out exactly as it did there
+
+Recordings of touches are played through the complete game:
+    fast            - As fast as the host can run it, with nothing drawn (the default)
+    --draw          - As fast as the host can run it, drawing every frame to the BSP shim's LCD ('--ppm' writes the last frame)
+    --realtime      - Drawing every frame and waiting 10 ms between frames, like the board
+
+Recordings of directions (made by 'PacmanEnv', e.g. of an agent) are played through a headless 'PacmanEnv', from the start of a game
+
+The hash printed is the Zobrist hash of the final state ('ZobristHash::ComputeHash'), so two runs can be checked against each other
+With '--repeat', the recording is played several times and the frame rate of the fastest and median runs are printed, for using
+recordings as benchmark workloads
+
+Usage:
+    replay FILE [--frames N] [--draw] [--realtime] [--ppm FILE] [--repeat N]
+
+Build with CMake (see 'CMakeLists.txt'), or by hand from the root of the repo against the BSP shim:
+    g++ -O2 -std=c++11 -Ishim/include tools/replay.cpp shim/src/font8.cpp shim/src/lcd.cpp shim/src/shim.cpp shim/src/ts.cpp -o replay
+*/
+
+#define PACMAN_HOST
+#define PACMAN_NO_MAIN
+#include "../main.cpp"
+
+#include "shim.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// Frames run after the last event of a recording when '--frames' isn't given
+#define REPLAY_TAIL_FRAMES 500
+
+// Number of game states ('SPLASH_SCREEN' to 'GAME_OVER')
+#define GAME_STATES 8
+
+static const char* STATE_NAMES[GAME_STATES] = { "SPLASH_SCREEN", "MAIN_MENU", "STARTUP", "PLAY", "CONTINUE", "NEXT_LEVEL", "DEAD", "GAME_OVER" };
+
+struct ReplaySettings
+{
+    int frames;
+    bool draw;
+    bool realtime;
+    std::string ppmPath;
+};
+
+// How a replay ended
+struct ReplayResult
+{
+    int frames;
+    char state;
+    int score;
+    int lives;
+    int level;
+    uint64_t hash;
+    double seconds;
+};
+
+// Reads a recording in the format printed by 'InputRecorder::Print', returning false (after printing why) if it couldn't be read
+static bool ReadRecording(const char* path, std::vector<InputEvent>* events, bool* directions)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        printf("Couldn't read %s\n", path);
+        return false;
+    }
+
+    char buffer[128];
+    int lineNumber = 0;
+    *directions = false;
+
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        lineNumber++;
+
+        char* comment = strchr(buffer, '#');
+
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        unsigned long tick;
+        unsigned int x;
+        unsigned int y;
+        char name[8];
+
+        InputEvent event;
+
+        if (sscanf(buffer, "%lu %u %u", &tick, &x, &y) == 3)
+        {
+            event.x = (uint16_t)x;
+            event.y = (uint16_t)y;
+        }
+        else if (sscanf(buffer, "%lu %7s", &tick, name) == 2 && strlen(name) == 1 && strchr("-NESW0", name[0]) != NULL)
+        {
+            static const char DIRECTIONS[] = { NORTH, EAST, SOUTH, WEST, 0x0 };
+
+            event.x = name[0] == '-' ? INPUT_RELEASED : INPUT_DIRECTION;
+            event.y = name[0] == '-' ? 0 : DIRECTIONS[strchr("NESW0", name[0]) - "NESW0"];
+            *directions = *directions || name[0] != '-';
+        }
+        else if (strspn(buffer, " \t\r\n") == strlen(buffer))
+        {
+            continue;
+        }
+        else
+        {
+            printf("%s:%d: expected 'tick x y', 'tick -' or 'tick N|E|S|W|0'\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+
+        event.tick = (uint32_t)tick;
+
+        if (!events->empty() && event.tick < events->back().tick)
+        {
+            printf("%s:%d: ticks must be in order\n", path, lineNumber);
+            fclose(file);
+            return false;
+        }
+
+        events->push_back(event);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Plays a recording of touches through the complete game
+static void ReplayTouches(const std::vector<InputEvent>& events, const ReplaySettings* settings, ReplayResult* result)
+{
+    // Set up the same way as 'main()'
+    PacmanGame game;
+    GameEngine* engine = game.GetEngine();
+
+    GameContext* context = engine->GetContext();
+    context->logEnabled = false;
+
+    bool draw = settings->draw || settings->realtime;
+    engine->SetDrawEnabled(draw);
+    game.GetMaze()->SetRedrawEnabled(draw);
+
+    Shim_Reset();
+    LCDInit();
+    engine->Init();
+
+    InputReplayer replayer(events.empty() ? NULL : &events[0], (int)events.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < settings->frames; frame++)
+    {
+        replayer.ApplyTouch(engine->GetFrame(), &context->tsState);
+        engine->RunFrame();
+
+        if (settings->realtime)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    GameState state;
+    memset(&state, 0, sizeof(state));
+    game.Snapshot(&state);
+
+    Player* player = game.GetPlayer();
+
+    result->frames = settings->frames;
+    result->state = context->curGameState;
+    result->score = player->GetScore();
+    result->lives = player->GetLives();
+    result->level = player->GetLevel();
+    result->hash = ZobristHash::ComputeHash(&state);
+}
+
+// Plays a recording of directions through a headless game, stopping early if the game ends
+static void ReplayDirections(const std::vector<InputEvent>& events, const ReplaySettings* settings, ReplayResult* result)
+{
+    static const char DIRECTIONS[ENV_ACTIONS] = { 0x0, NORTH, EAST, SOUTH, WEST };
+
+    // Each env is a few KB
+    static PacmanEnv env;
+
+    env.SetAutoReset(false);
+    env.Reset(NULL);
+
+    InputReplayer replayer(events.empty() ? NULL : &events[0], (int)events.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int frame = 0;
+
+    while (frame < settings->frames)
+    {
+        char direction = replayer.GetDirection(frame);
+        int action = ENV_ACTION_NONE;
+
+        for (int i = 0; i < ENV_ACTIONS; i++)
+        {
+            if (DIRECTIONS[i] == direction)
+            {
+                action = i;
+            }
+        }
+
+        float reward;
+        uint8_t done;
+        env.Step(action, NULL, &reward, &done);
+        frame++;
+
+        if (settings->realtime)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (done)
+        {
+            break;
+        }
+    }
+
+    result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result->frames = frame;
+    result->state = env.GetGameState();
+    result->score = env.GetScore();
+    result->lives = env.GetLives();
+    result->level = env.GetLevel();
+    result->hash = env.GetHash();
+}
+
+static void PrintUsage()
+{
+    printf("Usage: replay FILE [--frames N] [--draw] [--realtime] [--ppm FILE] [--repeat N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    ReplaySettings settings;
+    settings.frames = 0;
+    settings.draw = false;
+    settings.realtime = false;
+    int repeat = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--draw")
+        {
+            settings.draw = true;
+            continue;
+        }
+        else if (arg == "--realtime")
+        {
+            settings.realtime = true;
+            continue;
+        }
+        else if (arg.compare(0, 2, "--") != 0 && path.empty())
+        {
+            path = arg;
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (arg == "--frames")
+        {
+            settings.frames = atoi(value);
+        }
+        else if (arg == "--ppm")
+        {
+            settings.ppmPath = value;
+            settings.draw = true;
+        }
+        else if (arg == "--repeat")
+        {
+            repeat = atoi(value);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (path.empty() || repeat < 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<InputEvent> events;
+    bool directions;
+
+    if (!ReadRecording(path.c_str(), &events, &directions))
+    {
+        return 1;
+    }
+
+    if (settings.frames <= 0)
+    {
+        settings.frames = (events.empty() ? 0 : (int)events.back().tick) + REPLAY_TAIL_FRAMES;
+    }
+
+    if (directions && !settings.ppmPath.empty())
+    {
+        printf("Recordings of directions are played headless, so there is no frame for --ppm\n");
+        return 1;
+    }
+
+    std::vector<double> seconds;
+    ReplayResult result;
+
+    for (int i = 0; i < repeat; i++)
+    {
+        if (directions)
+        {
+            ReplayDirections(events, &settings, &result);
+        }
+        else
+        {
+            ReplayTouches(events, &settings, &result);
+        }
+
+        seconds.push_back(result.seconds);
+    }
+
+    if (!settings.ppmPath.empty() && !Shim_WriteFramebufferPPM(settings.ppmPath.c_str()))
+    {
+        printf("Couldn't write %s\n", settings.ppmPath.c_str());
+        return 1;
+    }
+
+    printf("%d events of %s, played as %s\n", (int)events.size(), path.c_str(), directions ? "directions (headless)" : "touches");
+    printf("%d frames, ending in %s\n", result.frames, result.state >= 0 && result.state < GAME_STATES ? STATE_NAMES[(int)result.state] : "?");
+    printf("Score %d, lives %d, level %d\n", result.score, result.lives, result.level);
+    printf("Hash %016llx\n", (unsigned long long)result.hash);
+
+    std::sort(seconds.begin(), seconds.end());
+
+    if (repeat > 1)
+    {
+        printf("%d runs: fastest %.2f ms (%.0f frames a second), median %.2f ms (%.0f frames a second)\n", repeat,
+            seconds[0] * 1000.0, result.frames / seconds[0], seconds[repeat / 2] * 1000.0, result.frames / seconds[repeat / 2]);
+    }
+    else
+    {
+        printf("%.2f ms (%.0f frames a second)\n", seconds[0] * 1000.0, result.frames / seconds[0]);
+    }
+
+    return 0;
+}